@@ -244,6 +244,9 @@ struct operation_info
  * allow_poolset: Indicates whether benchmark may use poolset files.
  *                If set to false and fname points to a poolset, an error
  *                will be returned.
+ * pmem_stats	: Indicates whether the number of cache line flushes and
+ *                fences per operation, counted by libpmem, should be
+ *                reported.
  * According to multithread and single_operation flags it may be
  * invoked in different ways:
  *  +-------------+----------+-------------------------------------+
@@ -283,6 +286,7 @@ struct benchmark_info
 	bool measure_time;
 	bool rm_file;
 	bool allow_poolset;
+	bool pmem_stats;
 };
 
 void *pmembench_get_priv(struct benchmark *bench);
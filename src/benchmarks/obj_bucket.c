@@ -0,0 +1,247 @@
+/*
+ * Copyright 2015-2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *      * Neither the name of the copyright holder nor the names of its
+ *        contributors may be used to endorse or promote products derived
+ *        from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_bucket.c -- benchmarks for the block containers of the heap buckets
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+#include "libpmemobj.h"
+#include "benchmark.h"
+#include "heap.h"
+#include "bucket.h"
+#include "redo.h"
+#include "heap_layout.h"
+
+/*
+ * prog_args - command line parsed arguments
+ */
+struct prog_args {
+	char *container_name;	/* block container type */
+	unsigned nblocks;	/* number of blocks inserted at init */
+	unsigned max_size;	/* maximum size of a block in units */
+};
+
+/*
+ * bucket_bench - variables used in benchmark, passed within functions
+ */
+struct bucket_bench {
+	struct prog_args *pa;	/* prog_args structure */
+	struct bucket *b;	/* benchmarked bucket */
+	uint32_t *sizes;	/* requested size of each operation */
+};
+
+/*
+ * parse_container -- parses command line "--container" and returns
+ * proper block container type enum
+ */
+static enum block_container_type
+parse_container(const char *arg)
+{
+	if (strcmp(arg, "ctree") == 0)
+		return CONTAINER_CTREE;
+	else if (strcmp(arg, "seglists") == 0)
+		return CONTAINER_SEGLISTS;
+	else
+		return CONTAINER_UNKNOWN;
+}
+
+/*
+ * bucket_init -- benchmark initialization, creates a huge bucket and fills
+ * it with blocks of random sizes
+ */
+static int
+bucket_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	assert(bench != NULL);
+	assert(args != NULL);
+	assert(args->opts != NULL);
+
+	struct bucket_bench *bb = malloc(sizeof (struct bucket_bench));
+	if (bb == NULL) {
+		perror("malloc");
+		return -1;
+	}
+
+	bb->pa = args->opts;
+
+	enum block_container_type type =
+		parse_container(bb->pa->container_name);
+	if (type == CONTAINER_UNKNOWN) {
+		fprintf(stderr, "wrong container type\n");
+		goto err;
+	}
+
+	if (bb->pa->max_size == 0) {
+		fprintf(stderr, "wrong max-size\n");
+		goto err;
+	}
+
+	bb->b = bucket_new(0, BUCKET_HUGE, type, CHUNKSIZE, UINT32_MAX);
+	if (bb->b == NULL) {
+		perror("bucket_new");
+		goto err;
+	}
+
+	srand(args->seed);
+
+	struct memory_block m = {0, 0, 0, 0};
+	for (unsigned i = 0; i < bb->pa->nblocks; ++i) {
+		m.chunk_id = i % MAX_CHUNK;
+		m.zone_id = i / MAX_CHUNK;
+		m.size_idx = 1 + (uint32_t)rand() % bb->pa->max_size;
+
+		if (CNT_OP(bb->b, insert, NULL, m) != 0) {
+			fprintf(stderr, "insert failed\n");
+			goto err_bucket;
+		}
+	}
+
+	size_t n_ops = args->n_ops_per_thread * args->n_threads;
+	bb->sizes = malloc(n_ops * sizeof (*bb->sizes));
+	if (bb->sizes == NULL) {
+		perror("malloc");
+		goto err_bucket;
+	}
+
+	for (size_t i = 0; i < n_ops; ++i)
+		bb->sizes[i] = 1 + (uint32_t)rand() % bb->pa->max_size;
+
+	pmembench_set_priv(bench, bb);
+
+	return 0;
+
+err_bucket:
+	bucket_delete(bb->b);
+err:
+	free(bb);
+	return -1;
+}
+
+/*
+ * bucket_exit -- benchmark clean up
+ */
+static int
+bucket_exit(struct benchmark *bench, struct benchmark_args *args)
+{
+	struct bucket_bench *bb = pmembench_get_priv(bench);
+
+	bucket_delete(bb->b);
+	free(bb->sizes);
+	free(bb);
+
+	return 0;
+}
+
+/*
+ * bucket_op -- removes the best-fit block for the requested size and puts it
+ * back, which is what an allocation followed by a free does to the bucket
+ */
+static int
+bucket_op(struct benchmark *bench, struct operation_info *info)
+{
+	struct bucket_bench *bb = pmembench_get_priv(bench);
+
+	size_t idx = info->worker->index * info->args->n_ops_per_thread +
+		info->index;
+
+	struct memory_block m = {0, 0, bb->sizes[idx], 0};
+	if (CNT_OP(bb->b, get_rm_bestfit, &m) != 0)
+		return 0; /* nothing big enough, not an error */
+
+	return CNT_OP(bb->b, insert, NULL, m);
+}
+
+/* structure defining command line arguments */
+static struct benchmark_clo bucket_clo[] = {
+	{
+		.opt_short	= 'c',
+		.opt_long	= "container",
+		.descr		= "The block container type: ctree or seglists",
+		.type		= CLO_TYPE_STR,
+		.off		= clo_field_offset(struct prog_args,
+							container_name),
+		.def		= "ctree",
+	},
+	{
+		.opt_short	= 'n',
+		.opt_long	= "nblocks",
+		.descr		= "Number of blocks in the container",
+		.def		= "10000",
+		.off		= clo_field_offset(struct prog_args, nblocks),
+		.type		= CLO_TYPE_UINT,
+		.type_uint	= {
+			.size	= clo_field_size(struct prog_args, nblocks),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 0,
+			.max	= UINT_MAX,
+		},
+	},
+	{
+		.opt_short	= 'm',
+		.opt_long	= "max-size",
+		.descr		= "Maximum size of a block in units",
+		.def		= "128",
+		.off		= clo_field_offset(struct prog_args, max_size),
+		.type		= CLO_TYPE_UINT,
+		.type_uint	= {
+			.size	= clo_field_size(struct prog_args, max_size),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 1,
+			.max	= UINT16_MAX,
+		},
+	},
+};
+
+/*
+ * stores information about bucket benchmark
+ */
+static struct benchmark_info bucket_info = {
+	.name		= "obj_bucket",
+	.brief		= "Benchmark for the block containers of buckets",
+	.init		= bucket_init,
+	.exit		= bucket_exit,
+	.multithread	= true,
+	.multiops	= true,
+	.operation	= bucket_op,
+	.measure_time	= true,
+	.clos		= bucket_clo,
+	.nclos		= ARRAY_SIZE(bucket_clo),
+	.opts_size	= sizeof (struct prog_args),
+	.rm_file	= true,
+	.allow_poolset	= false,
+};
+
+REGISTER_BENCHMARK(bucket_info);
@@ -0,0 +1,277 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *      * Neither the name of the copyright holder nor the names of its
+ *        contributors may be used to endorse or promote products derived
+ *        from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_heap_populate.c -- benchmarks for the population of heap zones at open
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+
+#include "libpmemobj.h"
+#include "benchmark.h"
+#include "heap.h"
+
+#define	LAYOUT_NAME "obj_heap_populate"
+#define	POPULATE_THREADS_VAR "PMEMOBJ_HEAP_POPULATE_THREADS"
+
+/*
+ * prog_args - command line parsed arguments
+ */
+struct prog_args {
+	size_t pool_size;		/* size of the pool */
+	size_t alloc_size;		/* size of objects filling the pool */
+	unsigned populate_threads;	/* number of zone population threads */
+	bool wait_ready;		/* measure until all zones are ready */
+};
+
+/*
+ * populate_bench - variables used in benchmark, passed within functions
+ */
+struct populate_bench {
+	struct prog_args *pa;	/* prog_args structure */
+	const char *fname;	/* pool file name */
+	PMEMobjpool *pop;	/* pool opened by the current operation */
+	PMEMoid oid;		/* object allocated by the current operation */
+};
+
+/*
+ * populate_fill -- fills the pool with objects and frees every other one,
+ * so that the zones consist of both free and used chunks
+ */
+static void
+populate_fill(PMEMobjpool *pop, size_t size)
+{
+	while (pmemobj_alloc(pop, NULL, size, 0, NULL, NULL) == 0)
+		;
+
+	PMEMoid oid = pmemobj_first(pop, 0);
+	while (!OID_IS_NULL(oid)) {
+		PMEMoid next = pmemobj_next(oid);
+		pmemobj_free(&oid);
+
+		oid = OID_IS_NULL(next) ? OID_NULL : pmemobj_next(next);
+	}
+}
+
+/*
+ * populate_init -- benchmark initialization, creates and fills the pool
+ */
+static int
+populate_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	assert(bench != NULL);
+	assert(args != NULL);
+	assert(args->opts != NULL);
+
+	struct populate_bench *pb = malloc(sizeof (struct populate_bench));
+	if (pb == NULL) {
+		perror("malloc");
+		return -1;
+	}
+
+	pb->pa = args->opts;
+	pb->fname = args->fname;
+	pb->pop = NULL;
+	pb->oid = OID_NULL;
+
+	char nthreads[16];
+	snprintf(nthreads, sizeof (nthreads), "%u", pb->pa->populate_threads);
+	if (setenv(POPULATE_THREADS_VAR, nthreads, 1) != 0) {
+		perror("setenv");
+		goto err;
+	}
+
+	size_t psize = args->is_poolset ? 0 : pb->pa->pool_size;
+	PMEMobjpool *pop = pmemobj_create(args->fname, LAYOUT_NAME, psize,
+		args->fmode);
+	if (pop == NULL) {
+		fprintf(stderr, "%s\n", pmemobj_errormsg());
+		goto err;
+	}
+
+	populate_fill(pop, pb->pa->alloc_size);
+
+	pmemobj_close(pop);
+
+	pmembench_set_priv(bench, pb);
+
+	return 0;
+
+err:
+	free(pb);
+	return -1;
+}
+
+/*
+ * populate_exit -- benchmark clean up
+ */
+static int
+populate_exit(struct benchmark *bench, struct benchmark_args *args)
+{
+	struct populate_bench *pb = pmembench_get_priv(bench);
+
+	unsetenv(POPULATE_THREADS_VAR);
+	free(pb);
+
+	return 0;
+}
+
+/*
+ * populate_op -- opens the pool and allocates the first object, optionally
+ * waits until the volatile state of all zones is ready
+ */
+static int
+populate_op(struct benchmark *bench, struct operation_info *info)
+{
+	struct populate_bench *pb = pmembench_get_priv(bench);
+
+	pb->pop = pmemobj_open(pb->fname, LAYOUT_NAME);
+	if (pb->pop == NULL) {
+		fprintf(stderr, "%s\n", pmemobj_errormsg());
+		return -1;
+	}
+
+	if (pmemobj_alloc(pb->pop, &pb->oid, info->args->dsize,
+			0, NULL, NULL) != 0) {
+		perror("pmemobj_alloc");
+		return -1;
+	}
+
+	if (pb->pa->wait_ready)
+		heap_populate_wait(pb->pop);
+
+	return 0;
+}
+
+/*
+ * populate_op_exit -- frees the object and closes the pool, not measured
+ */
+static int
+populate_op_exit(struct benchmark *bench, struct operation_info *info)
+{
+	struct populate_bench *pb = pmembench_get_priv(bench);
+
+	if (pb->pop == NULL)
+		return 0;
+
+	if (!OID_IS_NULL(pb->oid))
+		pmemobj_free(&pb->oid);
+
+	pmemobj_close(pb->pop);
+	pb->pop = NULL;
+
+	return 0;
+}
+
+/* structure defining command line arguments */
+static struct benchmark_clo populate_clo[] = {
+	{
+		.opt_short	= 'p',
+		.opt_long	= "pool-size",
+		.descr		= "Size of the pool in bytes",
+		.def		= "68719476736",
+		.off		= clo_field_offset(struct prog_args, pool_size),
+		.type		= CLO_TYPE_UINT,
+		.type_uint	= {
+			.size	= clo_field_size(struct prog_args, pool_size),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= PMEMOBJ_MIN_POOL,
+			.max	= SIZE_MAX,
+		},
+	},
+	{
+		.opt_short	= 'a',
+		.opt_long	= "alloc-size",
+		.descr		= "Size of objects filling the pool",
+		.def		= "1048576",
+		.off		= clo_field_offset(struct prog_args,
+							alloc_size),
+		.type		= CLO_TYPE_UINT,
+		.type_uint	= {
+			.size	= clo_field_size(struct prog_args, alloc_size),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 1,
+			.max	= PMEMOBJ_MAX_ALLOC_SIZE,
+		},
+	},
+	{
+		.opt_short	= 'P',
+		.opt_long	= "populate-threads",
+		.descr		= "Number of threads populating the zones "
+				"in background, 0 means lazy population",
+		.def		= "0",
+		.off		= clo_field_offset(struct prog_args,
+							populate_threads),
+		.type		= CLO_TYPE_UINT,
+		.type_uint	= {
+			.size	= clo_field_size(struct prog_args,
+							populate_threads),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 0,
+			.max	= 64,
+		},
+	},
+	{
+		.opt_short	= 'w',
+		.opt_long	= "wait-ready",
+		.descr		= "Measure the time until all zones are ready "
+				"instead of the time to the first allocation",
+		.def		= "false",
+		.off		= clo_field_offset(struct prog_args,
+							wait_ready),
+		.type		= CLO_TYPE_FLAG,
+	},
+};
+
+/*
+ * stores information about heap population benchmark
+ */
+static struct benchmark_info populate_info = {
+	.name		= "obj_heap_populate",
+	.brief		= "Benchmark for the population of heap zones at open",
+	.init		= populate_init,
+	.exit		= populate_exit,
+	.multithread	= false,
+	.multiops	= true,
+	.operation	= populate_op,
+	.op_exit	= populate_op_exit,
+	.measure_time	= true,
+	.clos		= populate_clo,
+	.nclos		= ARRAY_SIZE(populate_clo),
+	.opts_size	= sizeof (struct prog_args),
+	.rm_file	= true,
+	.allow_poolset	= true,
+};
+
+REGISTER_BENCHMARK(populate_info);
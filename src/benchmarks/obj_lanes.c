@@ -37,10 +37,15 @@
 #include <assert.h>
 #include <errno.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include "libpmemobj.h"
 #include "benchmark.h"
+#include "util.h"
 #include "lane.h"
+#include "redo.h"
+#include "list.h"
+#include "obj.h"
 
 /*
  * The number of times to repeat the operation, used to get more accurate
@@ -49,11 +54,15 @@
  */
 #define	OPERATION_REPEAT_COUNT 10000
 
+/* time for which the busy lane is held at once, in microseconds */
+#define	BUSY_LANE_HOLD_US 1000
+
 /*
  * prog_args - command line parsed arguments
  */
 struct prog_args {
 	char *lane_section_name;	/* lane section to be held */
+	bool busy_lane;			/* keep one of the lanes busy */
 };
 
 /*
@@ -63,8 +72,83 @@ struct obj_bench {
 	PMEMobjpool *pop;			/* persistent pool handle */
 	struct prog_args *pa;			/* prog_args structure */
 	enum lane_section_type lane_type;	/* lane section to be held */
+
+	pthread_t busy_thread;			/* thread holding a lane */
+	int busy_stop;
+	int busy_started;
 };
 
+/*
+ * busy_lane_worker -- keeps holding a lane for long periods of time, like
+ * a thread running long transactions
+ */
+static void *
+busy_lane_worker(void *arg)
+{
+	struct obj_bench *ob = arg;
+	struct lane_section *section;
+
+	while (!ob->busy_stop) {
+		lane_hold(ob->pop, &section, ob->lane_type);
+		ob->busy_started = 1;
+		usleep(BUSY_LANE_HOLD_US);
+		lane_release(ob->pop);
+
+		sched_yield();
+	}
+
+	return NULL;
+}
+
+/*
+ * churn_worker -- a short-lived thread which holds a lane once
+ */
+static void *
+churn_worker(void *arg)
+{
+	struct obj_bench *ob = arg;
+	struct lane_section *section;
+
+	lane_hold(ob->pop, &section, ob->lane_type);
+	lane_release(ob->pop);
+
+	return NULL;
+}
+
+/*
+ * busy_lane_start -- (internal) starts the thread keeping one lane busy and
+ * then runs as many short-lived threads as there are lanes
+ *
+ * The threads which exited leave their lanes idle, but if the lanes were
+ * assigned in a round-robin fashion, the first benchmark thread would get
+ * the same lane as the busy thread.
+ */
+static int
+busy_lane_start(struct obj_bench *ob)
+{
+	ob->busy_stop = 0;
+	ob->busy_started = 0;
+
+	if (pthread_create(&ob->busy_thread, NULL, busy_lane_worker, ob)) {
+		perror("pthread_create");
+		return -1;
+	}
+
+	while (!__sync_fetch_and_add(&ob->busy_started, 0))
+		sched_yield();
+
+	for (uint64_t i = 1; i < ob->pop->nlanes; ++i) {
+		pthread_t t;
+		if (pthread_create(&t, NULL, churn_worker, ob)) {
+			perror("pthread_create");
+			return -1;
+		}
+		pthread_join(t, NULL);
+	}
+
+	return 0;
+}
+
 /*
  * parse_lane_section -- parses command line "--lane_section" and returns
  * proper lane section type enum
@@ -113,11 +197,20 @@ lanes_init(struct benchmark *bench, struct benchmark_args *args)
 	ob->lane_type = parse_lane_section(ob->pa->lane_section_name);
 	if (ob->lane_type == MAX_LANE_SECTION) {
 		fprintf(stderr, "wrong lane type\n");
-		goto err;
+		goto err_close;
 	}
 
+	if (ob->pa->busy_lane && busy_lane_start(ob) != 0)
+		goto err_busy;
+
 	return 0;
 
+err_busy:
+	ob->busy_stop = 1;
+	if (ob->busy_started)
+		pthread_join(ob->busy_thread, NULL);
+err_close:
+	pmemobj_close(ob->pop);
 err:
 	free(ob);
 	return -1;
@@ -131,6 +224,11 @@ lanes_exit(struct benchmark *bench, struct benchmark_args *args)
 {
 	struct obj_bench *ob = pmembench_get_priv(bench);
 
+	if (ob->pa->busy_lane) {
+		ob->busy_stop = 1;
+		pthread_join(ob->busy_thread, NULL);
+	}
+
 	pmemobj_close(ob->pop);
 	free(ob);
 
@@ -167,6 +265,13 @@ static struct benchmark_clo lanes_clo[] = {
 							lane_section_name),
 		.def		= "allocator",
 	},
+	{
+		.opt_short	= 'b',
+		.opt_long	= "busy_lane",
+		.descr		= "Keep one lane busy after a churn of threads",
+		.type		= CLO_TYPE_FLAG,
+		.off		= clo_field_offset(struct prog_args, busy_lane),
+	},
 };
 
 /*
@@ -186,6 +291,7 @@ static struct benchmark_info lanes_info = {
 	.opts_size	= sizeof (struct prog_args),
 	.rm_file	= true,
 	.allow_poolset	= true,
+	.pmem_stats	= true,
 };
 
 REGISTER_BENCHMARK(lanes_info);
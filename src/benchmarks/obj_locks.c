@@ -741,6 +741,7 @@ static struct benchmark_info locks_info = {
 	.opts_size	= sizeof (struct prog_args),
 	.rm_file	= true,
 	.allow_poolset	= true,
+	.pmem_stats	= true,
 };
 
 REGISTER_BENCHMARK(locks_info);
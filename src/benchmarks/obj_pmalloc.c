@@ -362,6 +362,7 @@ static struct benchmark_info pmalloc_info = {
 	.opts_size	= sizeof (struct prog_args),
 	.rm_file	= true,
 	.allow_poolset	= true,
+	.pmem_stats	= true,
 };
 
 /*
@@ -381,6 +382,7 @@ static struct benchmark_info pfree_info = {
 	.opts_size	= sizeof (struct prog_args),
 	.rm_file	= true,
 	.allow_poolset	= true,
+	.pmem_stats	= true,
 };
 
 REGISTER_BENCHMARK(pmalloc_info);
@@ -0,0 +1,424 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *      * Neither the name of the copyright holder nor the names of its
+ *        contributors may be used to endorse or promote products derived
+ *        from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * obj_recovery.c -- benchmark for the recovery of lanes at pool open
+ *
+ * Every operation forks a process which runs transactions in many threads
+ * and kills it in the middle of the workload, then the time of opening
+ * the pool, which recovers all of the interrupted transactions, is measured.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "libpmemobj.h"
+#include "benchmark.h"
+
+#define	LAYOUT_NAME "obj_recovery"
+#define	RECOVERY_THREADS_VAR "PMEMOBJ_RECOVERY_THREADS"
+
+#define	MAX_CRASH_THREADS 1024
+#define	RANGE_SIZE 64
+
+/*
+ * prog_args - command line parsed arguments
+ */
+struct prog_args {
+	size_t pool_size;		/* size of the pool */
+	unsigned crash_threads;		/* number of threads killed in a tx */
+	unsigned tx_ranges;		/* number of ranges added by every tx */
+	unsigned recovery_threads;	/* number of lane recovery threads */
+};
+
+/*
+ * recovery_slot -- objects modified by a single thread of the workload
+ */
+struct recovery_slot {
+	PMEMoid data;	/* object snapshotted by the transactions */
+	PMEMoid obj;	/* object reallocated by every transaction */
+};
+
+struct recovery_root {
+	struct recovery_slot slots[MAX_CRASH_THREADS];
+};
+
+/*
+ * recovery_bench - variables used in benchmark, passed within functions
+ */
+struct recovery_bench {
+	struct prog_args *pa;	/* prog_args structure */
+	const char *fname;	/* pool file name */
+	size_t dsize;		/* size of the reallocated objects */
+	PMEMobjpool *pop;	/* pool opened by the current operation */
+};
+
+/*
+ * crash_worker_args -- arguments of a single workload thread
+ */
+struct crash_worker_args {
+	PMEMobjpool *pop;
+	struct recovery_slot *slot;
+	unsigned tx_ranges;
+	size_t dsize;
+	int ready_fd;		/* pipe notified once the thread is in a tx */
+};
+
+/*
+ * crash_worker -- runs transactions until the process is killed
+ */
+static void *
+crash_worker(void *arg)
+{
+	struct crash_worker_args *a = arg;
+	struct recovery_slot *slot = a->slot;
+	int ready = 0;
+
+	for (;;) {
+		TX_BEGIN(a->pop) {
+			pmemobj_tx_add_range_direct(slot, sizeof (*slot));
+			if (!OID_IS_NULL(slot->obj))
+				pmemobj_tx_free(slot->obj);
+			slot->obj = pmemobj_tx_alloc(a->dsize, 0);
+
+			char *data = pmemobj_direct(slot->data);
+			for (unsigned i = 0; i < a->tx_ranges; ++i) {
+				pmemobj_tx_add_range(slot->data,
+					i * RANGE_SIZE, RANGE_SIZE);
+				data[i * RANGE_SIZE]++;
+			}
+
+			if (!ready) {
+				char c = 0;
+				if (write(a->ready_fd, &c, 1) != 1)
+					_exit(1);
+				ready = 1;
+			}
+		} TX_END
+	}
+
+	return NULL;
+}
+
+/*
+ * crash_workload -- (internal) runs the workload in the child process
+ */
+static void
+crash_workload(struct recovery_bench *rb, int ready_fd)
+{
+	PMEMobjpool *pop = pmemobj_open(rb->fname, LAYOUT_NAME);
+	if (pop == NULL) {
+		fprintf(stderr, "%s\n", pmemobj_errormsg());
+		_exit(1);
+	}
+
+	struct recovery_root *root = pmemobj_direct(pmemobj_root(pop,
+		sizeof (struct recovery_root)));
+
+	unsigned nthreads = rb->pa->crash_threads;
+	pthread_t *threads = malloc(sizeof (pthread_t) * nthreads);
+	struct crash_worker_args *args =
+		malloc(sizeof (struct crash_worker_args) * nthreads);
+	if (threads == NULL || args == NULL)
+		_exit(1);
+
+	for (unsigned i = 0; i < nthreads; ++i) {
+		args[i].pop = pop;
+		args[i].slot = &root->slots[i];
+		args[i].tx_ranges = rb->pa->tx_ranges;
+		args[i].dsize = rb->dsize;
+		args[i].ready_fd = ready_fd;
+
+		if (pthread_create(&threads[i], NULL, crash_worker, &args[i]))
+			_exit(1);
+	}
+
+	/* the threads never finish, the process is killed by the parent */
+	for (;;)
+		pause();
+}
+
+/*
+ * recovery_init -- benchmark initialization, creates the pool and the objects
+ * snapshotted by the workload
+ */
+static int
+recovery_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	assert(bench != NULL);
+	assert(args != NULL);
+	assert(args->opts != NULL);
+
+	struct recovery_bench *rb = malloc(sizeof (struct recovery_bench));
+	if (rb == NULL) {
+		perror("malloc");
+		return -1;
+	}
+
+	rb->pa = args->opts;
+	rb->fname = args->fname;
+	rb->dsize = args->dsize;
+	rb->pop = NULL;
+
+	if (rb->pa->crash_threads > MAX_CRASH_THREADS) {
+		fprintf(stderr, "too many crash threads, max %d\n",
+			MAX_CRASH_THREADS);
+		goto err;
+	}
+
+	char nthreads[16];
+	snprintf(nthreads, sizeof (nthreads), "%u", rb->pa->recovery_threads);
+	if (setenv(RECOVERY_THREADS_VAR, nthreads, 1) != 0) {
+		perror("setenv");
+		goto err;
+	}
+
+	size_t psize = args->is_poolset ? 0 : rb->pa->pool_size;
+	PMEMobjpool *pop = pmemobj_create(args->fname, LAYOUT_NAME, psize,
+		args->fmode);
+	if (pop == NULL) {
+		fprintf(stderr, "%s\n", pmemobj_errormsg());
+		goto err;
+	}
+
+	PMEMoid root = pmemobj_root(pop, sizeof (struct recovery_root));
+	struct recovery_root *r = pmemobj_direct(root);
+	size_t data_size = (size_t)rb->pa->tx_ranges * RANGE_SIZE;
+
+	for (unsigned i = 0; i < rb->pa->crash_threads; ++i) {
+		if (pmemobj_zalloc(pop, &r->slots[i].data, data_size, 0)) {
+			perror("pmemobj_zalloc");
+			pmemobj_close(pop);
+			goto err;
+		}
+	}
+
+	pmemobj_close(pop);
+
+	pmembench_set_priv(bench, rb);
+
+	return 0;
+
+err:
+	free(rb);
+	return -1;
+}
+
+/*
+ * recovery_exit -- benchmark clean up
+ */
+static int
+recovery_exit(struct benchmark *bench, struct benchmark_args *args)
+{
+	struct recovery_bench *rb = pmembench_get_priv(bench);
+
+	unsetenv(RECOVERY_THREADS_VAR);
+	free(rb);
+
+	return 0;
+}
+
+/*
+ * recovery_op_init -- runs the workload in a child process and kills it once
+ * all of its threads are in the middle of a transaction, not measured
+ */
+static int
+recovery_op_init(struct benchmark *bench, struct operation_info *info)
+{
+	struct recovery_bench *rb = pmembench_get_priv(bench);
+
+	int fds[2];
+	if (pipe(fds)) {
+		perror("pipe");
+		return -1;
+	}
+
+	pid_t pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return -1;
+	}
+
+	if (pid == 0) {
+		close(fds[0]);
+		crash_workload(rb, fds[1]);
+	}
+
+	close(fds[1]);
+
+	int ret = 0;
+	char c;
+	for (unsigned i = 0; i < rb->pa->crash_threads; ++i) {
+		if (read(fds[0], &c, 1) != 1) {
+			fprintf(stderr, "workload process failed\n");
+			ret = -1;
+			break;
+		}
+	}
+
+	close(fds[0]);
+
+	kill(pid, SIGKILL);
+	if (waitpid(pid, NULL, 0) != pid) {
+		perror("waitpid");
+		return -1;
+	}
+
+	return ret;
+}
+
+/*
+ * recovery_op -- opens the pool, which recovers the interrupted transactions
+ */
+static int
+recovery_op(struct benchmark *bench, struct operation_info *info)
+{
+	struct recovery_bench *rb = pmembench_get_priv(bench);
+
+	rb->pop = pmemobj_open(rb->fname, LAYOUT_NAME);
+	if (rb->pop == NULL) {
+		fprintf(stderr, "%s\n", pmemobj_errormsg());
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * recovery_op_exit -- closes the pool, not measured
+ */
+static int
+recovery_op_exit(struct benchmark *bench, struct operation_info *info)
+{
+	struct recovery_bench *rb = pmembench_get_priv(bench);
+
+	if (rb->pop != NULL) {
+		pmemobj_close(rb->pop);
+		rb->pop = NULL;
+	}
+
+	return 0;
+}
+
+/* structure defining command line arguments */
+static struct benchmark_clo recovery_clo[] = {
+	{
+		.opt_short	= 'p',
+		.opt_long	= "pool-size",
+		.descr		= "Size of the pool in bytes",
+		.def		= "1073741824",
+		.off		= clo_field_offset(struct prog_args, pool_size),
+		.type		= CLO_TYPE_UINT,
+		.type_uint	= {
+			.size	= clo_field_size(struct prog_args, pool_size),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= PMEMOBJ_MIN_POOL,
+			.max	= SIZE_MAX,
+		},
+	},
+	{
+		.opt_short	= 'c',
+		.opt_long	= "crash-threads",
+		.descr		= "Number of threads running transactions "
+				"when the process is killed",
+		.def		= "64",
+		.off		= clo_field_offset(struct prog_args,
+							crash_threads),
+		.type		= CLO_TYPE_UINT,
+		.type_uint	= {
+			.size	= clo_field_size(struct prog_args,
+							crash_threads),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 1,
+			.max	= MAX_CRASH_THREADS,
+		},
+	},
+	{
+		.opt_short	= 'n',
+		.opt_long	= "tx-ranges",
+		.descr		= "Number of ranges snapshotted by every "
+				"transaction",
+		.def		= "16",
+		.off		= clo_field_offset(struct prog_args, tx_ranges),
+		.type		= CLO_TYPE_UINT,
+		.type_uint	= {
+			.size	= clo_field_size(struct prog_args, tx_ranges),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 1,
+			.max	= UINT_MAX,
+		},
+	},
+	{
+		.opt_short	= 'R',
+		.opt_long	= "recovery-threads",
+		.descr		= "Number of threads recovering the lanes",
+		.def		= "1",
+		.off		= clo_field_offset(struct prog_args,
+							recovery_threads),
+		.type		= CLO_TYPE_UINT,
+		.type_uint	= {
+			.size	= clo_field_size(struct prog_args,
+							recovery_threads),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 1,
+			.max	= 64,
+		},
+	},
+};
+
+/*
+ * stores information about lane recovery benchmark
+ */
+static struct benchmark_info recovery_info = {
+	.name		= "obj_recovery",
+	.brief		= "Benchmark for the recovery of lanes at pool open",
+	.init		= recovery_init,
+	.exit		= recovery_exit,
+	.multithread	= false,
+	.multiops	= true,
+	.operation	= recovery_op,
+	.op_init	= recovery_op_init,
+	.op_exit	= recovery_op_exit,
+	.measure_time	= true,
+	.clos		= recovery_clo,
+	.nclos		= ARRAY_SIZE(recovery_clo),
+	.opts_size	= sizeof (struct prog_args),
+	.rm_file	= true,
+	.allow_poolset	= true,
+};
+
+REGISTER_BENCHMARK(recovery_info);
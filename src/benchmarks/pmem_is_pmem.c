@@ -0,0 +1,284 @@
+/*
+ * Copyright 2015-2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *      * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *      * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *      * Neither the name of the copyright holder nor the names of its
+ *        contributors may be used to endorse or promote products derived
+ *        from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * pmem_is_pmem.c -- benchmark for pmem_is_pmem function
+ *
+ * The benchmark creates the requested number of additional mappings in the
+ * process to grow /proc/self/smaps and measures pmem_is_pmem() on a range
+ * of a file mapped either with pmem_map() or with plain mmap().
+ */
+
+#include <libpmem.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "benchmark.h"
+
+/*
+ * is_pmem_args -- benchmark specific command line options
+ */
+struct is_pmem_args
+{
+	unsigned mappings;	/* number of additional mappings */
+	bool no_pmem_map;	/* map the file with mmap() */
+};
+
+/*
+ * is_pmem_bench -- benchmark context
+ */
+struct is_pmem_bench {
+	struct is_pmem_args *pargs; /* benchmark specific arguments */
+	size_t fsize;		/* file size */
+	size_t pagesize;	/* system page size */
+	void *addr;		/* mapped file address */
+	void **mappings;	/* additional mappings */
+};
+
+static struct benchmark_clo is_pmem_clo[] = {
+	{
+		.opt_short	= 'm',
+		.opt_long	= "mappings",
+		.descr		= "Number of additional mappings in the process",
+		.def		= "0",
+		.off		= clo_field_offset(struct is_pmem_args,
+					mappings),
+		.type		= CLO_TYPE_UINT,
+		.type_uint	= {
+			.size	= clo_field_size(struct is_pmem_args,
+					mappings),
+			.base	= CLO_INT_BASE_DEC,
+			.min	= 0,
+			.max	= UINT_MAX,
+		},
+	},
+	{
+		.opt_short	= 'M',
+		.opt_long	= "no-pmem-map",
+		.descr		= "Map the file using mmap() instead of "
+					"pmem_map()",
+		.def		= "false",
+		.off		= clo_field_offset(struct is_pmem_args,
+					no_pmem_map),
+		.type		= CLO_TYPE_FLAG
+	},
+};
+
+/*
+ * is_pmem_op -- actual benchmark operation
+ */
+static int
+is_pmem_op(struct benchmark *bench, struct operation_info *info)
+{
+	struct is_pmem_bench *pb =
+		(struct is_pmem_bench *)pmembench_get_priv(bench);
+
+	size_t len = info->args->dsize;
+	size_t nchunks = pb->fsize / len;
+	char *addr = (char *)pb->addr + (info->index % nchunks) * len;
+
+	(void) pmem_is_pmem(addr, len);
+
+	return 0;
+}
+
+/*
+ * create_mappings -- create additional mappings in the process
+ *
+ * Every other page is made read-only so that adjacent mappings are not
+ * merged by the kernel, and each of them gets its own entry in smaps.
+ */
+static int
+create_mappings(struct is_pmem_bench *pb)
+{
+	unsigned n = pb->pargs->mappings;
+	if (n == 0)
+		return 0;
+
+	pb->mappings = calloc(n, sizeof (*pb->mappings));
+	if (pb->mappings == NULL) {
+		perror("calloc");
+		return -1;
+	}
+
+	for (unsigned i = 0; i < n; i++) {
+		int prot = (i % 2) ? PROT_READ : PROT_READ|PROT_WRITE;
+		pb->mappings[i] = mmap(NULL, pb->pagesize, prot,
+				MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+		if (pb->mappings[i] == MAP_FAILED) {
+			perror("mmap");
+			pb->mappings[i] = NULL;
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * remove_mappings -- remove additional mappings
+ */
+static void
+remove_mappings(struct is_pmem_bench *pb)
+{
+	if (pb->mappings == NULL)
+		return;
+
+	for (unsigned i = 0; i < pb->pargs->mappings; i++) {
+		if (pb->mappings[i] != NULL)
+			munmap(pb->mappings[i], pb->pagesize);
+	}
+
+	free(pb->mappings);
+}
+
+/*
+ * is_pmem_init -- initialization function
+ */
+static int
+is_pmem_init(struct benchmark *bench, struct benchmark_args *args)
+{
+	assert(bench != NULL);
+	assert(args != NULL);
+	assert(args->opts != NULL);
+
+	int ret = 0;
+
+	struct is_pmem_bench *pb = calloc(1, sizeof (struct is_pmem_bench));
+	if (!pb) {
+		perror("calloc");
+		return -1;
+	}
+
+	pb->pargs = args->opts;
+	pb->pagesize = (size_t)sysconf(_SC_PAGESIZE);
+	pb->fsize = args->dsize * args->n_ops_per_thread;
+
+	if (args->dsize == 0 || pb->fsize == 0) {
+		fprintf(stderr, "invalid data size\n");
+		ret = -1;
+		goto err_free_pb;
+	}
+
+	if (create_mappings(pb) != 0) {
+		ret = -1;
+		goto err_remove_mappings;
+	}
+
+	int fd = open(args->fname, O_CREAT | O_EXCL | O_RDWR, args->fmode);
+	if (fd == -1) {
+		perror(args->fname);
+		ret = -1;
+		goto err_remove_mappings;
+	}
+
+	if ((errno = posix_fallocate(fd, 0, (off_t)pb->fsize)) != 0) {
+		perror("posix_fallocate");
+		ret = -1;
+		goto err_close_file;
+	}
+
+	if (pb->pargs->no_pmem_map) {
+		pb->addr = mmap(NULL, pb->fsize, PROT_READ|PROT_WRITE,
+				MAP_SHARED, fd, 0);
+		if (pb->addr == MAP_FAILED) {
+			perror("mmap");
+			ret = -1;
+			goto err_close_file;
+		}
+	} else {
+		pb->addr = pmem_map(fd);
+		if (pb->addr == NULL) {
+			perror("pmem_map");
+			ret = -1;
+			goto err_close_file;
+		}
+	}
+
+	close(fd);
+
+	pmembench_set_priv(bench, pb);
+
+	return 0;
+
+err_close_file:
+	close(fd);
+err_remove_mappings:
+	remove_mappings(pb);
+err_free_pb:
+	free(pb);
+
+	return ret;
+}
+
+/*
+ * is_pmem_exit -- benchmark cleanup function
+ */
+static int
+is_pmem_exit(struct benchmark *bench, struct benchmark_args *args)
+{
+	struct is_pmem_bench *pb =
+		(struct is_pmem_bench *)pmembench_get_priv(bench);
+
+	if (pb->pargs->no_pmem_map)
+		munmap(pb->addr, pb->fsize);
+	else
+		pmem_unmap(pb->addr, pb->fsize);
+
+	remove_mappings(pb);
+	free(pb);
+
+	return 0;
+}
+
+/* Stores information about benchmark. */
+static struct benchmark_info is_pmem_info = {
+	.name		= "pmem_is_pmem",
+	.brief		= "Benchmark for pmem_is_pmem() operation",
+	.init		= is_pmem_init,
+	.exit		= is_pmem_exit,
+	.multithread	= true,
+	.multiops	= true,
+	.operation	= is_pmem_op,
+	.measure_time	= true,
+	.clos		= is_pmem_clo,
+	.nclos		= ARRAY_SIZE(is_pmem_clo),
+	.opts_size	= sizeof (struct is_pmem_args),
+	.rm_file	= true,
+	.allow_poolset	= false,
+};
+
+REGISTER_BENCHMARK(is_pmem_info);
@@ -54,6 +54,7 @@
 #include "clo.h"
 #include "config_reader.h"
 #include "util.h"
+#include "libpmem.h"
 
 /*
  * struct pmembench -- main context
@@ -103,6 +104,15 @@ struct latency
 	double std_dev;
 };
 
+/*
+ * struct persist_stats -- flushes and fences counted by libpmem
+ */
+struct persist_stats
+{
+	uint64_t flushes;
+	uint64_t fences;
+};
+
 /*
  * struct bench_list -- list of available benchmarks
  */
@@ -425,6 +435,8 @@ pmembench_print_header(struct pmembench *pb, struct benchmark *bench,
 		"latency-min;"
 		"latency-max;"
 		"latency-std-dev");
+	if (bench->info->pmem_stats)
+		printf(";flushes-per-op;fences-per-op");
 	size_t i;
 	for (i = 0; i < bench->nclos; i++) {
 		if (!bench->clos[i].ignore_in_res) {
@@ -440,7 +452,8 @@ pmembench_print_header(struct pmembench *pb, struct benchmark *bench,
 static void
 pmembench_print_results(struct benchmark *bench, struct benchmark_args *args,
 				size_t n_threads, size_t n_ops,
-				struct results *stats, struct latency *latency)
+				struct results *stats, struct latency *latency,
+				struct persist_stats *pstats)
 {
 	double opsps = n_threads * n_ops / stats->avg;
 	printf("%f;%f;%f;%f;%f;%f;%ld;%ld;%ld;%f", stats->avg,
@@ -454,6 +467,12 @@ pmembench_print_results(struct benchmark *bench, struct benchmark_args *args,
 			latency->max,
 			latency->std_dev);
 
+	if (bench->info->pmem_stats) {
+		double total_ops = (double)n_threads * n_ops * args->repeats;
+		printf(";%f;%f", pstats->flushes / total_ops,
+				pstats->fences / total_ops);
+	}
+
 	size_t i;
 	for (i = 0; i < bench->nclos; i++) {
 		if (!bench->clos[i].ignore_in_res)
@@ -464,6 +483,19 @@ pmembench_print_results(struct benchmark *bench, struct benchmark_args *args,
 	printf("\n");
 }
 
+/*
+ * pmembench_persist_stats -- (internal) get flushes and fences counted so far
+ */
+static void
+pmembench_persist_stats(struct persist_stats *pstats)
+{
+	struct pmem_stats stats;
+	pmem_stats_get(&stats);
+
+	pstats->flushes = stats.flush_lines;
+	pstats->fences = stats.fences;
+}
+
 /*
  * pmembench_parse_clos -- parse command line arguments for benchmark
  */
@@ -940,6 +972,9 @@ pmembench_run(struct pmembench *pb, struct benchmark *bench)
 
 	pmembench_print_header(pb, bench, clovec);
 
+	if (bench->info->pmem_stats)
+		pmem_stats_enable(1);
+
 	size_t args_i;
 	for (args_i = 0; args_i < clovec->nargs; args_i++) {
 		args = clo_vec_get_args(clovec, args_i);
@@ -971,6 +1006,8 @@ pmembench_run(struct pmembench *pb, struct benchmark *bench)
 							sizeof (double));
 		assert(workers_times != NULL);
 
+		struct persist_stats pstats = {0, 0};
+
 		for (unsigned int i = 0; i < args->repeats; i++) {
 			if (bench->info->rm_file) {
 				ret = pmembench_remove_file(args->fname);
@@ -1003,6 +1040,9 @@ pmembench_run(struct pmembench *pb, struct benchmark *bench)
 				goto out;
 			}
 
+			struct persist_stats pstats_start;
+			pmembench_persist_stats(&pstats_start);
+
 			unsigned int j;
 			for (j = 0; j < args->n_threads; j++) {
 				benchmark_worker_run(workers[j]);
@@ -1016,6 +1056,13 @@ pmembench_run(struct pmembench *pb, struct benchmark *bench)
 					"thread number %d failed \n", j);
 				}
 			}
+
+			struct persist_stats pstats_end;
+			pmembench_persist_stats(&pstats_end);
+			pstats.flushes += pstats_end.flushes -
+					pstats_start.flushes;
+			pstats.fences += pstats_end.fences -
+					pstats_start.fences;
 			if (ret == 0)
 				pmembench_get_results(workers, n_threads,
 						&stats[i],
@@ -1038,11 +1085,13 @@ pmembench_run(struct pmembench *pb, struct benchmark *bench)
 		pmembench_get_total_results(stats, workers_times, &total,
 					&latency, args->repeats, n_threads);
 		pmembench_print_results(bench, args, n_threads, n_ops,
-							&total, &latency);
+						&total, &latency, &pstats);
 		free(stats);
 		free(workers_times);
 	}
 out:
+	if (bench->info->pmem_stats)
+		pmem_stats_enable(0);
 out_release_args:
 	clo_vec_free(clovec);
 
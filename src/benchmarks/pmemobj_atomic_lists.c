@@ -1057,6 +1057,7 @@ static struct benchmark_info obj_insert = {
 	.opts_size	= sizeof (struct obj_list_args),
 	.rm_file	= true,
 	.allow_poolset	= true,
+	.pmem_stats	= true,
 };
 REGISTER_BENCHMARK(obj_insert);
 
@@ -1078,6 +1079,7 @@ static struct benchmark_info obj_remove = {
 	.opts_size	= sizeof (struct obj_list_args),
 	.rm_file	= true,
 	.allow_poolset	= true,
+	.pmem_stats	= true,
 };
 REGISTER_BENCHMARK(obj_remove);
 
@@ -1098,6 +1100,7 @@ static struct benchmark_info obj_insert_new = {
 	.opts_size	= sizeof (struct obj_list_args),
 	.rm_file	= true,
 	.allow_poolset	= true,
+	.pmem_stats	= true,
 };
 REGISTER_BENCHMARK(obj_insert_new);
 
@@ -1119,6 +1122,7 @@ static struct benchmark_info obj_remove_free = {
 	.opts_size	= sizeof (struct obj_list_args),
 	.rm_file	= true,
 	.allow_poolset	= true,
+	.pmem_stats	= true,
 };
 REGISTER_BENCHMARK(obj_remove_free);
 
@@ -1139,5 +1143,6 @@ static struct benchmark_info obj_move = {
 	.opts_size	= sizeof (struct obj_list_args),
 	.rm_file	= true,
 	.allow_poolset	= true,
+	.pmem_stats	= true,
 };
 REGISTER_BENCHMARK(obj_move);
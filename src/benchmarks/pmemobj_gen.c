@@ -653,6 +653,7 @@ static struct benchmark_info obj_open = {
 	.opts_size	= sizeof (struct pobj_args),
 	.rm_file	= true,
 	.allow_poolset	= true,
+	.pmem_stats	= true,
 };
 
 REGISTER_BENCHMARK(obj_open);
@@ -673,6 +674,7 @@ static struct benchmark_info obj_direct = {
 	.opts_size	= sizeof (struct pobj_args),
 	.rm_file	= true,
 	.allow_poolset	= true,
+	.pmem_stats	= true,
 };
 
 REGISTER_BENCHMARK(obj_direct);
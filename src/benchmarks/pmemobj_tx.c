@@ -54,6 +54,9 @@
  */
 #define	MAX_OPS 10000
 
+/* size of a single field added to undo log in the small-ranges mode */
+#define	SMALL_RANGE_SIZE sizeof (uint64_t)
+
 TOID_DECLARE(struct item, 0);
 
 struct obj_tx_bench;
@@ -93,6 +96,9 @@ struct obj_tx_args {
 	 *		  one transaction.
 	 *		- range - fields of one object are added to undo
 	 *		  log many times in one transaction.
+	 *		- small-ranges - consecutive 8-byte fields of one
+	 *		  object are added to undo log one by one in one
+	 *		  transaction.
 	 *		- all-obj - all objects are added to undo log in
 	 *		  one transaction.
 	 *		- range-nested - fields of one object are added to undo
@@ -326,6 +332,7 @@ enum op_mode {
 	OP_MODE_ONE_OBJ_NESTED,
 	OP_MODE_ONE_OBJ_RANGE,
 	OP_MODE_ONE_OBJ_NESTED_RANGE,
+	OP_MODE_ONE_OBJ_SMALL_RANGES,
 	OP_MODE_ALL_OBJ,
 	OP_MODE_ALL_OBJ_NESTED,
 	OP_MODE_UNKNOWN
@@ -660,6 +667,8 @@ parse_op_mode_add_range(const char *arg)
 		return OP_MODE_ONE_OBJ_RANGE;
 	else if (strcmp(arg, "range-nested") == 0)
 		return OP_MODE_ONE_OBJ_NESTED_RANGE;
+	else if (strcmp(arg, "small-ranges") == 0)
+		return OP_MODE_ONE_OBJ_SMALL_RANGES;
 	else if (strcmp(arg, "all-obj") == 0)
 		return OP_MODE_ALL_OBJ;
 	else if (strcmp(arg, "all-obj-nested") == 0)
@@ -775,6 +784,18 @@ off_range(struct obj_tx_bench *obj_bench, unsigned int idx)
 	return offset;
 }
 
+/*
+ * off_small_range -- returns offset of a single small field in object.
+ */
+static struct offset
+off_small_range(struct obj_tx_bench *obj_bench, unsigned int idx)
+{
+	struct offset offset;
+	offset.size = SMALL_RANGE_SIZE;
+	offset.off = offset.size * idx;
+	return offset;
+}
+
 /*
  * rand_values -- allocates array and if range mode calculates random
  * values as allocation sizes for each object otherwise populates whole array
@@ -954,8 +975,13 @@ obj_tx_add_range_init(struct benchmark *bench, struct benchmark_args *args)
 			args->dsize = args->n_ops_per_thread;
 
 		obj_bench->sizes[0] = args->dsize;
+	} else if (obj_bench->op_mode == OP_MODE_ONE_OBJ_SMALL_RANGES) {
+		obj_bench->fn_off = off_small_range;
+		obj_bench->sizes[0] = args->n_ops_per_thread *
+						SMALL_RANGE_SIZE;
 	}
 	obj_bench->lib_op = (obj_bench->op_mode == OP_MODE_ONE_OBJ ||
+		obj_bench->op_mode == OP_MODE_ONE_OBJ_SMALL_RANGES ||
 				obj_bench->op_mode == OP_MODE_ALL_OBJ) ?
 				ADD_RANGE_MODE_ONE_TX :
 				ADD_RANGE_MODE_NESTED_TX;
@@ -1154,6 +1180,7 @@ static struct benchmark_info obj_tx_alloc = {
 	.opts_size	= sizeof (struct obj_tx_args),
 	.rm_file	= true,
 	.allow_poolset	= true,
+	.pmem_stats	= true,
 };
 
 REGISTER_BENCHMARK(obj_tx_alloc);
@@ -1174,6 +1201,7 @@ static struct benchmark_info obj_tx_free = {
 	.opts_size	= sizeof (struct obj_tx_args),
 	.rm_file	= true,
 	.allow_poolset	= true,
+	.pmem_stats	= true,
 };
 
 REGISTER_BENCHMARK(obj_tx_free);
@@ -1194,6 +1222,7 @@ static struct benchmark_info obj_tx_realloc = {
 	.opts_size	= sizeof (struct obj_tx_args),
 	.rm_file	= true,
 	.allow_poolset	= true,
+	.pmem_stats	= true,
 };
 
 REGISTER_BENCHMARK(obj_tx_realloc);
@@ -1214,6 +1243,7 @@ static struct benchmark_info obj_tx_add_range = {
 	.opts_size	= sizeof (struct obj_tx_args),
 	.rm_file	= true,
 	.allow_poolset	= true,
+	.pmem_stats	= true,
 };
 
 REGISTER_BENCHMARK(obj_tx_add_range);
@@ -188,6 +188,8 @@ util_unmap_part(struct pool_set_part *part)
 	LOG(3, "part %p", part);
 
 	if (part->addr != NULL && part->size != 0) {
+		pmem_ranges_delete(part->addr, part->size);
+
 		LOG(4, "munmap: addr %p size %zu", part->addr, part->size);
 		if (munmap(part->addr, part->size) != 0) {
 			ERR("!munmap: %s", part->path);
@@ -311,6 +313,42 @@ util_poolset_fdclose(struct pool_set *set)
 	}
 }
 
+/*
+ * util_poolset_set_incompat -- adds incompat features to the headers of all
+ *	the parts of an open pool set
+ *
+ * Each header is updated together with its checksum. The file descriptors of
+ * the parts have to be still open.
+ */
+int
+util_poolset_set_incompat(struct pool_set *set, uint32_t incompat)
+{
+	LOG(3, "set %p incompat %#x", set, incompat);
+
+	for (unsigned r = 0; r < set->nreplicas; r++) {
+		struct pool_replica *rep = set->replica[r];
+
+		for (unsigned p = 0; p < rep->nparts; p++) {
+			struct pool_set_part *part = &rep->part[p];
+
+			if (util_map_hdr(part, MAP_SHARED) != 0) {
+				LOG(2, "header mapping failed - part #%d", p);
+				return -1;
+			}
+
+			struct pool_hdr *hdrp = part->hdr;
+			hdrp->incompat_features = htole32(incompat |
+				le32toh(hdrp->incompat_features));
+			util_checksum(hdrp, sizeof (*hdrp), &hdrp->checksum, 1);
+			pmem_msync(hdrp, sizeof (*hdrp));
+
+			util_unmap_hdr(part);
+		}
+	}
+
+	return 0;
+}
+
 /*
  * parser_get_next_token -- (internal) extract token from string
  */
@@ -1169,6 +1207,7 @@ util_replica_create(struct pool_set *set, unsigned repidx, int flags,
 		addr = (char *)addr + rep->part[p].size;
 	}
 
+	pmem_ranges_insert(rep->part[0].addr, rep->part[0].size);
 	rep->is_pmem = pmem_is_pmem(rep->part[0].addr, rep->part[0].size);
 
 	ASSERTeq(mapsize, rep->repsize);
@@ -1248,7 +1287,8 @@ util_uuid_to_string(uuid_t u, char *buf)
  * f81d4fae-7dec-11d0-a765-00a0c91e6bf6
  */
 int
-util_uuid_from_string(const char *uuid, struct uuid *ud)
+util_uuid_from_string(const char uuid[POOL_HDR_UUID_STR_LEN],
+	struct uuid *ud)
 {
 	if (strlen(uuid) != 36) {
 		LOG(2, "invalid uuid string");
@@ -1441,6 +1481,7 @@ util_replica_open(struct pool_set *set, unsigned repidx, int flags)
 		addr = (char *)addr + rep->part[p].size;
 	}
 
+	pmem_ranges_insert(rep->part[0].addr, rep->part[0].size);
 	rep->is_pmem = pmem_is_pmem(rep->part[0].addr, rep->part[0].size);
 
 	ASSERTeq(mapsize, rep->repsize);
@@ -97,6 +97,66 @@ util_mutex_unlock(pthread_mutex_t *m)
 	}
 }
 
+/*
+ * util_cond_init -- pthread_cond_init variant that never fails from
+ * caller perspective. If pthread_cond_init failed, this function aborts
+ * the program.
+ */
+static inline void
+util_cond_init(pthread_cond_t *c, const pthread_condattr_t *condattr)
+{
+	int tmp = pthread_cond_init(c, condattr);
+	if (tmp) {
+		errno = tmp;
+		FATAL("!pthread_cond_init");
+	}
+}
+
+/*
+ * util_cond_destroy -- pthread_cond_destroy variant that never fails from
+ * caller perspective. If pthread_cond_destroy failed, this function aborts
+ * the program.
+ */
+static inline void
+util_cond_destroy(pthread_cond_t *c)
+{
+	int tmp = pthread_cond_destroy(c);
+	if (tmp) {
+		errno = tmp;
+		FATAL("!pthread_cond_destroy");
+	}
+}
+
+/*
+ * util_cond_wait -- pthread_cond_wait variant that never fails from
+ * caller perspective. If pthread_cond_wait failed, this function aborts
+ * the program.
+ */
+static inline void
+util_cond_wait(pthread_cond_t *c, pthread_mutex_t *m)
+{
+	int tmp = pthread_cond_wait(c, m);
+	if (tmp) {
+		errno = tmp;
+		FATAL("!pthread_cond_wait");
+	}
+}
+
+/*
+ * util_cond_broadcast -- pthread_cond_broadcast variant that never fails from
+ * caller perspective. If pthread_cond_broadcast failed, this function aborts
+ * the program.
+ */
+static inline void
+util_cond_broadcast(pthread_cond_t *c)
+{
+	int tmp = pthread_cond_broadcast(c);
+	if (tmp) {
+		errno = tmp;
+		FATAL("!pthread_cond_broadcast");
+	}
+}
+
 /*
  * util_rwlock_unlock -- pthread_rwlock_unlock variant that never fails from
  * caller perspective. If pthread_rwlock_unlock failed, this function aborts
@@ -58,6 +58,13 @@ void util_set_alloc_funcs(
 void *util_map(int fd, size_t len, int cow, size_t req_align);
 int util_unmap(void *addr, size_t len);
 
+/*
+ * ranges whose pmem_is_pmem() answer is remembered by libpmem, the pool
+ * libraries report the replicas they map and unmap
+ */
+void pmem_ranges_insert(void *addr, size_t len);
+void pmem_ranges_delete(void *addr, size_t len);
+
 int util_tmpfile(const char *dir, size_t size);
 void *util_map_tmpfile(const char *dir, size_t size, size_t req_align);
 
@@ -232,6 +239,7 @@ void util_poolset_close(struct pool_set *set, int del);
 void util_poolset_free(struct pool_set *set);
 int util_poolset_chmod(struct pool_set *set, mode_t mode);
 void util_poolset_fdclose(struct pool_set *set);
+int util_poolset_set_incompat(struct pool_set *set, uint32_t incompat);
 int util_is_poolset(const char *path);
 int util_poolset_foreach_part(const char *path,
 	int (*cb)(const char *part_file, void *arg), void *arg);
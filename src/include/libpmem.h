@@ -48,6 +48,7 @@ extern "C" {
 #endif
 
 #include <sys/types.h>
+#include <stdint.h>
 
 void *pmem_map(int fd);
 int pmem_unmap(void *addr, size_t len);
@@ -56,7 +57,28 @@ void pmem_persist(const void *addr, size_t len);
 int pmem_msync(const void *addr, size_t len);
 void pmem_flush(const void *addr, size_t len);
 void pmem_drain(void);
+
+/* a single range passed to pmem_persistv() and pmem_flushv() */
+struct pmem_vec {
+	const void *addr;
+	size_t len;
+};
+
+void pmem_persistv(const struct pmem_vec *vec, size_t cnt);
+void pmem_flushv(const struct pmem_vec *vec, size_t cnt);
 int pmem_has_hw_drain(void);
+/* flush/fence statistics, see pmem_stats_enable() */
+struct pmem_stats {
+	uint64_t flush_bytes;	/* number of bytes passed to flush functions */
+	uint64_t flush_lines;	/* number of cache lines flushed */
+	uint64_t fences;	/* number of store fences issued */
+	uint64_t drains;	/* number of calls to pmem_drain() */
+	uint64_t movnt_bytes;	/* number of bytes stored with movnt */
+};
+
+void pmem_stats_enable(int enable);
+void pmem_stats_get(struct pmem_stats *stats);
+
 void *pmem_memmove_persist(void *pmemdest, const void *src, size_t len);
 void *pmem_memcpy_persist(void *pmemdest, const void *src, size_t len);
 void *pmem_memset_persist(void *pmemdest, int c, size_t len);
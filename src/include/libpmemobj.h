@@ -91,6 +91,27 @@ const char *pmemobj_check_version(
 PMEMobjpool *pmemobj_open(const char *path, const char *layout);
 PMEMobjpool *pmemobj_create(const char *path, const char *layout,
 	size_t poolsize, mode_t mode);
+
+/*
+ * Flags of pmemobj_xcreate(). With POBJ_XCREATE_NO_TYPE_LISTS the objects are
+ * not linked on the per-type lists, pmemobj_first() and pmemobj_next() walk
+ * the heap instead.
+ */
+#define	POBJ_XCREATE_NO_TYPE_LISTS ((uint64_t)1 << 0)
+#define	POBJ_XCREATE_VALID_FLAGS (POBJ_XCREATE_NO_TYPE_LISTS)
+
+/*
+ * Attributes of a pool created by pmemobj_xcreate(), fixed for its lifetime.
+ * Zeroed fields, or a NULL pointer, select the defaults.
+ */
+struct pobj_create_attr {
+	uint64_t nlanes; /* number of lanes */
+	uint64_t lane_section_size; /* size of each section of a lane */
+};
+
+PMEMobjpool *pmemobj_xcreate(const char *path, const char *layout,
+	size_t poolsize, mode_t mode, uint64_t flags,
+	const struct pobj_create_attr *attr);
 void pmemobj_close(PMEMobjpool *pop);
 int pmemobj_check(const char *path, const char *layout);
 
@@ -353,8 +374,8 @@ pmemobj_direct(PMEMoid oid)
 /*
  * Non-transactional atomic allocations
  *
- * Those functions can be used outside transactions. The allocations are always
- * aligned to the cache-line boundary.
+ * Those functions can be used outside transactions. The allocations are
+ * aligned to the cache-line boundary, unless allocated from a custom class.
  */
 
 /*
@@ -373,6 +394,113 @@ int pmemobj_alloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 int pmemobj_zalloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 	unsigned int type_num);
 
+/*
+ * Flags of pmemobj_xalloc(). The allocation class id, as returned by
+ * pmemobj_alloc_class_register(), is passed using POBJ_CLASS_ID(id),
+ * id 0 picks the best fitting predefined class.
+ */
+#define	POBJ_XALLOC_ZERO ((uint64_t)1 << 0)
+#define	POBJ_XALLOC_CLASS_SHIFT 48
+#define	POBJ_XALLOC_CLASS_MASK ((uint64_t)0xFFFF << POBJ_XALLOC_CLASS_SHIFT)
+#define	POBJ_CLASS_ID(id) ((uint64_t)(id) << POBJ_XALLOC_CLASS_SHIFT)
+#define	POBJ_XALLOC_VALID_FLAGS (POBJ_XALLOC_ZERO | POBJ_XALLOC_CLASS_MASK)
+
+/*
+ * Allocates a new object like pmemobj_alloc(), flags can request zeroing
+ * and an explicit allocation class.
+ */
+int pmemobj_xalloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
+	unsigned int type_num, uint64_t flags,
+	void (*constructor)(PMEMobjpool *pop, void *ptr, void *arg), void *arg);
+
+/*
+ * Allocates n objects of the same size and type, their ids are stored in the
+ * oids array. The objects are made persistent in groups, with a single redo
+ * log commit per group, either all of them are allocated or none.
+ */
+int pmemobj_alloc_batch(PMEMobjpool *pop, PMEMoid oids[], size_t n,
+	size_t size, unsigned int type_num,
+	void (*constructor)(PMEMobjpool *pop, void *ptr, void *arg), void *arg);
+
+/*
+ * Registers an allocation class for objects of unit_size usable bytes, of
+ * which at least units_per_run must fit into a single run. Returns the class
+ * id or -1 on error. Objects of such classes are only 8-byte aligned.
+ */
+int pmemobj_alloc_class_register(PMEMobjpool *pop, size_t unit_size,
+	unsigned units_per_run);
+
+#define	POBJ_MAX_ALLOC_CLASSES 255
+
+/*
+ * Occupancy of the runs of a single allocation class.
+ */
+struct pobj_alloc_class_stats {
+	unsigned class_id;
+	size_t unit_size;	/* including the object metadata */
+	uint64_t nruns;
+	uint64_t units_used;
+	uint64_t units_free;
+};
+
+/*
+ * Occupancy of the heap. The free chunks are neither used by objects that
+ * are too big for the runs, nor by the runs themselves. The fragmentation is
+ * the fraction of free memory, both in chunks and in runs, that lies outside
+ * of the largest free extent of chunks.
+ */
+struct pobj_heap_stats {
+	size_t chunk_size;
+	uint64_t chunks_total;
+	uint64_t chunks_free;
+	uint64_t chunks_huge;
+	uint64_t chunks_run;
+	size_t largest_free_extent;	/* in bytes */
+	double fragmentation;
+	unsigned zones_pending;		/* zones not loaded yet */
+	unsigned nclasses;
+	struct pobj_alloc_class_stats classes[POBJ_MAX_ALLOC_CLASSES];
+};
+
+/*
+ * Retrieves the heap statistics. They are maintained by the allocator, so
+ * this is cheap to call. Parts of the heap that are still being loaded
+ * after the pool was opened are not counted, only their number is reported.
+ */
+int pmemobj_heap_stats(PMEMobjpool *pop, struct pobj_heap_stats *stats);
+
+/*
+ * Old and new location of an object moved by pmemobj_defrag().
+ */
+struct pobj_remap {
+	PMEMoid old_oid;
+	PMEMoid new_oid;
+};
+
+/*
+ * Called by pmemobj_defrag() inside of the transaction that moves the objects,
+ * must update all of the references to the old objects transactionally.
+ * Nonzero return value aborts the transaction and stops the defragmentation.
+ */
+typedef int (*pmemobj_relocate_fn)(PMEMobjpool *pop,
+	const struct pobj_remap *remap, size_t nremap, void *arg);
+
+struct pobj_defrag_result {
+	size_t relocated;	/* number of moved objects */
+	size_t runs_released;	/* number of runs turned into free chunks */
+	int complete;		/* the scan reached the end of the heap */
+};
+
+/*
+ * Moves the objects out of at most max_runs runs in which no more than
+ * max_occupancy percent of the memory is used, and gives the runs back to
+ * the heap. Each call continues the scan of the heap where the previous one
+ * stopped. No other thread may use the pool in the meantime.
+ */
+int pmemobj_defrag(PMEMobjpool *pop, unsigned max_occupancy, size_t max_runs,
+	pmemobj_relocate_fn relocate, void *arg,
+	struct pobj_defrag_result *result);
+
 /*
  * Resizes an existing object.
  */
@@ -396,6 +524,52 @@ int pmemobj_strdup(PMEMobjpool *pop, PMEMoid *oidp, const char *s,
  */
 void pmemobj_free(PMEMoid *oidp);
 
+/*
+ * Frees n existing objects of the same pool, null object ids are skipped.
+ */
+int pmemobj_free_batch(PMEMoid oids[], size_t n);
+
+/*
+ * Action prepared by pmemobj_reserve() or pmemobj_set_value() and carried out
+ * by pmemobj_publish(). The fields are private.
+ */
+struct pobj_action {
+	uint64_t type;
+	uint64_t data[3];
+};
+
+/*
+ * Maximum number of actions published at once, reduced by two for every
+ * additional type of the reserved objects.
+ */
+#define	POBJ_MAX_ACTIONS 60
+
+/*
+ * Reserves memory for an object without allocating it in the pool. The object
+ * has to be filled and persisted by the application before it's allocated by
+ * pmemobj_publish(), or the memory has to be returned by pmemobj_cancel().
+ */
+PMEMoid pmemobj_reserve(PMEMobjpool *pop, struct pobj_action *act,
+	size_t size, unsigned int type_num);
+
+/*
+ * Prepares setting of the 8-byte value at ptr, which must be in the pool.
+ */
+void pmemobj_set_value(PMEMobjpool *pop, struct pobj_action *act,
+	uint64_t *ptr, uint64_t value);
+
+/*
+ * Allocates all the reserved objects and sets all the values atomically.
+ */
+int pmemobj_publish(PMEMobjpool *pop, struct pobj_action *actv,
+	size_t actvcnt);
+
+/*
+ * Returns the memory of the reserved objects, ignores the other actions.
+ */
+void pmemobj_cancel(PMEMobjpool *pop, struct pobj_action *actv,
+	size_t actvcnt);
+
 /*
  * Returns the number of usable bytes in the object. May be greater than
  * the requested size of the object because of internal alignment.
@@ -487,6 +661,21 @@ PMEMoid pmemobj_first(PMEMobjpool *pop, unsigned int type_num);
  */
 PMEMoid pmemobj_next(PMEMoid oid);
 
+/*
+ * Calls cb for every object of type_num, or of any type with
+ * POBJ_WALK_ANY_TYPE, by scanning the heap sequentially. The heap is split
+ * into nparts disjoint ranges and only the part-th one is walked, so nparts
+ * threads can walk the whole pool in parallel. Within a range the objects
+ * are visited in address order. A nonzero value returned by cb stops the walk
+ * and is returned, -1 is returned on error.
+ */
+#define	POBJ_WALK_ANY_TYPE (~0U)
+
+typedef int (*pmemobj_walk_fn)(PMEMobjpool *pop, PMEMoid oid, void *arg);
+
+int pmemobj_walk(PMEMobjpool *pop, unsigned type_num, unsigned part,
+	unsigned nparts, pmemobj_walk_fn cb, void *arg);
+
 #define	POBJ_FIRST(pop, t) (\
 { TOID(t) _pobj_ret = (TOID(t))pmemobj_first((pop), TOID_TYPE_NUM(t));\
 _pobj_ret; })
@@ -782,6 +971,14 @@ enum pobj_tx_lock {
 	TX_LOCK_RWLOCK	/* PMEMrwlock */
 };
 
+/*
+ * Transaction parameters, passed to pmemobj_tx_begin() in the same list as
+ * the locks, their values don't overlap with enum pobj_tx_lock.
+ */
+enum pobj_tx_param {
+	TX_PARAM_REDO = 0x100	/* no argument, keep writes in the redo log */
+};
+
 /*
  * Starts a new transaction in the current thread.
  * If called within an open transaction, starts a nested transaction.
@@ -866,6 +1063,9 @@ int pmemobj_tx_errno(void);
 #define	TX_BEGIN_LOCK(pop, ...)\
 _POBJ_TX_BEGIN(pop, ##__VA_ARGS__)
 
+#define	TX_BEGIN_PARAM(pop, ...)\
+_POBJ_TX_BEGIN(pop, ##__VA_ARGS__)
+
 #define	TX_BEGIN(pop) _POBJ_TX_BEGIN(pop, TX_LOCK_NONE)
 
 #define	TX_ONABORT\
@@ -925,6 +1125,30 @@ int pmemobj_tx_add_range(PMEMoid oid, uint64_t off, size_t size);
  */
 int pmemobj_tx_add_range_direct(const void *ptr, size_t size);
 
+/*
+ * Transactionally writes the data to the given memory region.
+ * In a transaction started with TX_PARAM_REDO the data is kept in the redo
+ * log and written in place when the transaction commits, the region must
+ * then be read with pmemobj_tx_read until the end of the transaction.
+ * Otherwise it's equivalent to pmemobj_tx_add_range_direct and memcpy.
+ *
+ * If successful, returns zero.
+ * Otherwise, state changes to TX_STAGE_ONABORT and an error number is returned.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+int pmemobj_tx_write(void *dest, const void *src, size_t size);
+
+/*
+ * Reads the given memory region, including the data written with
+ * pmemobj_tx_write in the current transaction.
+ *
+ * Always returns zero.
+ *
+ * This function must be called during TX_STAGE_WORK.
+ */
+int pmemobj_tx_read(void *dest, const void *src, size_t size);
+
 /*
  * Transactionally allocates a new object.
  *
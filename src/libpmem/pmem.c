@@ -86,6 +86,8 @@
  *
  *	Copy using MOVNTDQ, up to any non-64-byte aligned end portion.
  *	(The MOVNT instructions bypass the cache, so no flush is required.)
+ *	When AVX2 or AVX-512 is available, the 256-bit or 512-bit forms
+ *	of the non-temporal store are used for the bulk of the range.
  *
  *	Copy any unaligned end portion using MOV.
  *
@@ -126,6 +128,19 @@
  *
  *	SFENCE
  *
+ * For several unrelated ranges which have to be persistent at the same point,
+ * the vectored variants take an array of (addr, len) pairs:
+ *
+ * pmem_persistv(vec, cnt)
+ *
+ *		pmem_flushv(vec, cnt);
+ *		pmem_drain();
+ *
+ * pmem_flushv(vec, cnt)
+ *
+ *	Sorts the ranges, merges the ones sharing a cache line and then
+ *	flushes every cache line only once
+ *
  * When PCOMMIT is unavailable, either because the platform doesn't support it
  * or because it has been inhibited by the caller by setting PMEM_NO_PCOMMIT=1,
  * the pmem_drain() function degenerates into this:
@@ -185,10 +200,21 @@
  *	Func_memmove_nodrain is used by memmove_nodrain() to call one of:
  *		memmove_nodrain_normal()
  *		memmove_nodrain_movnt()
+ *		memmove_nodrain_movnt_avx2()
+ *		memmove_nodrain_movnt_avx512f()
  *
  *	Func_memset_nodrain is used by memset_nodrain() to call one of:
  *		memset_nodrain_normal()
  *		memset_nodrain_movnt()
+ *		memset_nodrain_movnt_avx2()
+ *		memset_nodrain_movnt_avx512f()
+ *
+ * FLUSH/FENCE STATISTICS
+ *
+ * When turned on with pmem_stats_enable() or PMEM_STATS=1, the number of
+ * flushed bytes and cache lines, fences, drains and bytes written with
+ * non-temporal stores are counted per thread and summed up by
+ * pmem_stats_get().  When off, the cost is a single branch per call.
  *
  * DEBUG LOGGING
  *
@@ -203,7 +229,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
-#include <xmmintrin.h>
+#include <immintrin.h>
 
 #include "libpmem.h"
 
@@ -228,6 +254,9 @@
 
 #define	ALIGN_MASK	(FLUSH_ALIGN - 1)
 
+/* number of ranges pmem_flushv() sorts and merges at once */
+#define	PMEM_FLUSHV_BATCH 16
+
 #define	CHUNK_SIZE	128 /* 16*8 */
 #define	CHUNK_SHIFT	7
 #define	CHUNK_MASK	(CHUNK_SIZE - 1)
@@ -240,6 +269,16 @@
 #define	MOVNT_MASK	(MOVNT_SIZE - 1)
 #define	MOVNT_SHIFT	4
 
+#define	AVX2_SIZE	32
+#define	AVX2_SHIFT	5
+#define	AVX2_CHUNK_SHIFT	8 /* 32*8 */
+#define	AVX2_CHUNK_MASK	((1 << AVX2_CHUNK_SHIFT) - 1)
+
+#define	AVX512_SIZE	64
+#define	AVX512_SHIFT	6
+#define	AVX512_CHUNK_SHIFT	9 /* 64*8 */
+#define	AVX512_CHUNK_MASK	((1 << AVX512_CHUNK_SHIFT) - 1)
+
 #define	MOVNT_THRESHOLD	256
 
 #define	PROCMAXLEN 2048 /* maximum expected line length in /proc files */
@@ -247,6 +286,134 @@
 static size_t Movnt_threshold = MOVNT_THRESHOLD;
 static int Has_hw_drain;
 
+/*
+ * Flush/fence statistics
+ *
+ * When enabled, every thread gets its own set of counters, so the flush
+ * paths never share a cache line.  The sets are linked on a global list
+ * which is only ever pushed to, so pmem_stats_get() can walk it without
+ * locking.  The counters of the threads which already exited stay on the
+ * list, so the totals are never lost; the list is freed in pmem_fini().
+ */
+struct pmem_stats_thread {
+	struct pmem_stats stats;
+	struct pmem_stats_thread *next;
+};
+
+static int Stats_enabled;
+static struct pmem_stats_thread *Stats_threads;
+static __thread struct pmem_stats_thread *Stats_thread;
+
+/* used when the per-thread counters could not be allocated */
+static struct pmem_stats Stats_fallback;
+
+/*
+ * stats_thread_register -- (internal) allocate counters for calling thread
+ */
+static struct pmem_stats *
+stats_thread_register(void)
+{
+	struct pmem_stats_thread *st = Malloc(sizeof (*st));
+	if (st == NULL) {
+		/* counting shared between threads is racy, but still useful */
+		return &Stats_fallback;
+	}
+
+	memset(&st->stats, 0, sizeof (st->stats));
+
+	do {
+		st->next = Stats_threads;
+	} while (!__sync_bool_compare_and_swap(&Stats_threads, st->next, st));
+
+	Stats_thread = st;
+
+	return &st->stats;
+}
+
+/*
+ * stats_thread -- (internal) return counters of the calling thread
+ */
+static inline struct pmem_stats *
+stats_thread(void)
+{
+	if (Stats_thread != NULL)
+		return &Stats_thread->stats;
+
+	return stats_thread_register();
+}
+
+/*
+ * PMEM_STATS_ADD -- update counter of the calling thread, if enabled
+ */
+#define	PMEM_STATS_ADD(field, val) do {\
+	if (Stats_enabled)\
+		stats_thread()->field += (val);\
+} while (0)
+
+/*
+ * flush_nlines -- (internal) number of cache lines covering the given range
+ */
+static inline uint64_t
+flush_nlines(const void *addr, size_t len)
+{
+	if (len == 0)
+		return 0;
+
+	uintptr_t start = (uintptr_t)addr & ~(FLUSH_ALIGN - 1);
+	uintptr_t end = (uintptr_t)addr + len;
+
+	return (end - start + FLUSH_ALIGN - 1) / FLUSH_ALIGN;
+}
+
+/*
+ * pmem_stats_enable -- turn flush/fence statistics on or off
+ */
+void
+pmem_stats_enable(int enable)
+{
+	LOG(3, "enable %d", enable);
+
+	Stats_enabled = enable;
+}
+
+/*
+ * pmem_stats_get -- sum up flush/fence statistics of all threads
+ */
+void
+pmem_stats_get(struct pmem_stats *stats)
+{
+	LOG(3, "stats %p", stats);
+
+	*stats = Stats_fallback;
+
+	for (struct pmem_stats_thread *st = Stats_threads; st != NULL;
+			st = st->next) {
+		stats->flush_bytes += st->stats.flush_bytes;
+		stats->flush_lines += st->stats.flush_lines;
+		stats->fences += st->stats.fences;
+		stats->drains += st->stats.drains;
+		stats->movnt_bytes += st->stats.movnt_bytes;
+	}
+}
+
+/*
+ * pmem_stats_fini -- (internal) free per-thread statistics
+ */
+static void
+pmem_stats_fini(void)
+{
+	Stats_enabled = 0;
+
+	struct pmem_stats_thread *st = Stats_threads;
+	while (st != NULL) {
+		struct pmem_stats_thread *next = st->next;
+		Free(st);
+		st = next;
+	}
+
+	Stats_threads = NULL;
+}
+
 /*
  * pmem_has_hw_drain -- return whether or not HW drain (PCOMMIT) was found
  */
@@ -277,6 +444,8 @@ predrain_fence_sfence(void)
 	LOG(15, NULL);
 
 	_mm_sfence();	/* ensure CLWB or CLFLUSHOPT completes before PCOMMIT */
+
+	PMEM_STATS_ADD(fences, 1);
 }
 
 /*
@@ -314,6 +483,8 @@ drain_pcommit(void)
 	Func_predrain_fence();
 	_mm_pcommit();
 	_mm_sfence();
+
+	PMEM_STATS_ADD(fences, 1);
 }
 
 /*
@@ -333,6 +504,8 @@ pmem_drain(void)
 {
 	LOG(10, NULL);
 
+	PMEM_STATS_ADD(drains, 1);
+
 	Func_drain();
 }
 
@@ -414,6 +587,12 @@ pmem_flush(const void *addr, size_t len)
 
 	VALGRIND_DO_CHECK_MEM_IS_ADDRESSABLE(addr, len);
 
+	if (Stats_enabled) {
+		struct pmem_stats *stats = stats_thread();
+		stats->flush_bytes += len;
+		stats->flush_lines += flush_nlines(addr, len);
+	}
+
 	Func_flush(addr, len);
 }
 
@@ -429,6 +608,94 @@ pmem_persist(const void *addr, size_t len)
 	pmem_drain();
 }
 
+/*
+ * flushv_batch -- (internal) flush up to PMEM_FLUSHV_BATCH ranges
+ *
+ * The ranges are extended to cache line boundaries, sorted by address
+ * and merged, so each cache line is flushed only once.
+ */
+static void
+flushv_batch(const struct pmem_vec *vec, size_t cnt)
+{
+	ASSERT(cnt <= PMEM_FLUSHV_BATCH);
+
+	uintptr_t start[PMEM_FLUSHV_BATCH];
+	uintptr_t end[PMEM_FLUSHV_BATCH];
+	size_t n = 0;
+
+	for (size_t i = 0; i < cnt; ++i) {
+		if (vec[i].len == 0)
+			continue;
+
+		uintptr_t s = (uintptr_t)vec[i].addr & ~(FLUSH_ALIGN - 1);
+		uintptr_t e = ((uintptr_t)vec[i].addr + vec[i].len +
+				FLUSH_ALIGN - 1) & ~(FLUSH_ALIGN - 1);
+
+		/* insertion sort, the number of ranges is small */
+		size_t j;
+		for (j = n; j > 0 && start[j - 1] > s; --j) {
+			start[j] = start[j - 1];
+			end[j] = end[j - 1];
+		}
+		start[j] = s;
+		end[j] = e;
+		n++;
+	}
+
+	size_t i = 0;
+	while (i < n) {
+		uintptr_t s = start[i];
+		uintptr_t e = end[i];
+
+		for (++i; i < n && start[i] <= e; ++i) {
+			if (end[i] > e)
+				e = end[i];
+		}
+
+		PMEM_STATS_ADD(flush_lines, (e - s) / FLUSH_ALIGN);
+
+		Func_flush((const void *)s, e - s);
+	}
+}
+
+/*
+ * pmem_flushv -- flush processor cache for the given set of ranges
+ */
+void
+pmem_flushv(const struct pmem_vec *vec, size_t cnt)
+{
+	LOG(10, "vec %p cnt %zu", vec, cnt);
+
+	for (size_t i = 0; i < cnt; ++i) {
+		VALGRIND_DO_CHECK_MEM_IS_ADDRESSABLE(vec[i].addr, vec[i].len);
+		PMEM_STATS_ADD(flush_bytes, vec[i].len);
+	}
+
+	/*
+	 * Cache lines shared by ranges from different batches may be
+	 * flushed more than once, which is harmless.
+	 */
+	while (cnt > PMEM_FLUSHV_BATCH) {
+		flushv_batch(vec, PMEM_FLUSHV_BATCH);
+		vec += PMEM_FLUSHV_BATCH;
+		cnt -= PMEM_FLUSHV_BATCH;
+	}
+
+	flushv_batch(vec, cnt);
+}
+
+/*
+ * pmem_persistv -- make any cached changes to a set of ranges persistent
+ */
+void
+pmem_persistv(const struct pmem_vec *vec, size_t cnt)
+{
+	LOG(15, "vec %p cnt %zu", vec, cnt);
+
+	pmem_flushv(vec, cnt);
+	pmem_drain();
+}
+
 /*
  * pmem_msync -- flush to persistence via msync
  *
@@ -591,11 +858,300 @@ is_pmem_proc(const void *addr, size_t len)
 	return retval;
 }
 
+/*
+ * RANGES OF MAPPINGS CREATED BY PMEM_MAP AND THE POOL LIBRARIES
+ *
+ * Scanning /proc/self/smaps costs time proportional to the number of
+ * mappings in the process, so the answer for every range mapped by
+ * pmem_map(), or by the pool libraries for the replicas of their pools,
+ * is remembered here, in an array of non-overlapping ranges sorted by
+ * address.  The range is forgotten before it's unmapped, so that a new
+ * mapping at the same address never finds a stale answer.  The answer is
+ * computed lazily, the first time pmem_is_pmem() is called for any part of
+ * the range.  Lookups are a binary search.
+ *
+ * Other ranges are not tracked, because there is no way to find out when
+ * they go away; pmem_is_pmem() falls back to the smaps scan for them.
+ *
+ * libpmem doesn't depend on libpthread, so the array is protected by
+ * a simple spin lock.  It is never held across the smaps scan, so every
+ * range carries the generation in which it was mapped, and the answer is
+ * stored only if the range hasn't been remapped meanwhile.
+ */
+enum pmem_range_state {
+	PMEM_RANGE_UNKNOWN,	/* smaps not consulted yet */
+	PMEM_RANGE_PMEM,	/* the whole range is pmem */
+	PMEM_RANGE_NOT_PMEM,	/* some part of the range isn't pmem */
+};
+
+struct pmem_range {
+	uintptr_t start;
+	uintptr_t end;
+	uint64_t gen;
+	enum pmem_range_state state;
+};
+
+#define	PMEM_RANGES_INIT_SIZE 16
+
+static struct {
+	struct pmem_range *ranges;	/* sorted by start address */
+	size_t nranges;
+	size_t size;			/* number of allocated entries */
+	uint64_t gen;			/* generation of the last mapping */
+	int lock;
+} Pmem_ranges;
+
+/*
+ * pmem_ranges_lock -- (internal) acquire the ranges spin lock
+ */
+static void
+pmem_ranges_lock(void)
+{
+	while (__sync_lock_test_and_set(&Pmem_ranges.lock, 1))
+		while (__atomic_load_n(&Pmem_ranges.lock, __ATOMIC_RELAXED))
+			_mm_pause();
+}
+
+/*
+ * pmem_ranges_unlock -- (internal) release the ranges spin lock
+ */
+static void
+pmem_ranges_unlock(void)
+{
+	__sync_lock_release(&Pmem_ranges.lock);
+}
+
+/*
+ * pmem_ranges_find -- (internal) return the index of the first range which
+ *	ends above the given address
+ *
+ * Returns nranges if there is no such range.  Must be called with the lock
+ * held.
+ */
+static size_t
+pmem_ranges_find(uintptr_t addr)
+{
+	size_t lo = 0;
+	size_t hi = Pmem_ranges.nranges;
+
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (Pmem_ranges.ranges[mid].end <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/*
+ * pmem_ranges_remove -- (internal) forget the given address range
+ *
+ * Ranges partially overlapping with the given one are trimmed, or split
+ * in two.  Must be called with the lock held.
+ *
+ * Returns -1 if splitting a range failed due to lack of memory, in which
+ * case the whole range being split is forgotten.
+ */
+static int
+pmem_ranges_remove(uintptr_t start, uintptr_t end)
+{
+	int ret = 0;
+	size_t i = pmem_ranges_find(start);
+
+	while (i < Pmem_ranges.nranges &&
+			Pmem_ranges.ranges[i].start < end) {
+		struct pmem_range *r = &Pmem_ranges.ranges[i];
+
+		if (r->start < start && r->end > end) {
+			/* the range has to be split */
+			if (Pmem_ranges.nranges == Pmem_ranges.size) {
+				size_t nsize = 2 * Pmem_ranges.size;
+				struct pmem_range *n = Realloc(
+					Pmem_ranges.ranges,
+					nsize * sizeof (*n));
+				if (n == NULL) {
+					ERR("!Realloc");
+					ret = -1;
+					r->end = start;
+					break;
+				}
+				Pmem_ranges.ranges = n;
+				Pmem_ranges.size = nsize;
+				r = &Pmem_ranges.ranges[i];
+			}
+			memmove(r + 1, r, (Pmem_ranges.nranges - i) *
+					sizeof (*r));
+			Pmem_ranges.nranges++;
+			r->end = start;
+			(r + 1)->start = end;
+			break;
+		} else if (r->start < start) {
+			r->end = start;
+			i++;
+		} else if (r->end > end) {
+			r->start = end;
+			break;
+		} else {
+			memmove(r, r + 1, (Pmem_ranges.nranges - i - 1) *
+					sizeof (*r));
+			Pmem_ranges.nranges--;
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * pmem_ranges_insert -- start tracking a newly mapped range
+ *
+ * Any stale ranges overlapping with the new one (i.e. unmapped without
+ * pmem_unmap()) are forgotten first.
+ */
+void
+pmem_ranges_insert(void *addr, size_t len)
+{
+	uintptr_t start = (uintptr_t)addr;
+	uintptr_t end = start + len;
+
+	pmem_ranges_lock();
+
+	if (pmem_ranges_remove(start, end) != 0)
+		goto out;
+
+	if (Pmem_ranges.nranges == Pmem_ranges.size) {
+		size_t nsize = Pmem_ranges.size ?
+			2 * Pmem_ranges.size : PMEM_RANGES_INIT_SIZE;
+		struct pmem_range *n = Realloc(Pmem_ranges.ranges,
+				nsize * sizeof (*n));
+		if (n == NULL) {
+			/* not fatal, pmem_is_pmem() will just be slower */
+			ERR("!Realloc");
+			goto out;
+		}
+		Pmem_ranges.ranges = n;
+		Pmem_ranges.size = nsize;
+	}
+
+	size_t i = pmem_ranges_find(start);
+	struct pmem_range *r = &Pmem_ranges.ranges[i];
+	memmove(r + 1, r, (Pmem_ranges.nranges - i) * sizeof (*r));
+	r->start = start;
+	r->end = end;
+	r->gen = ++Pmem_ranges.gen;
+	r->state = PMEM_RANGE_UNKNOWN;
+	Pmem_ranges.nranges++;
+
+out:
+	pmem_ranges_unlock();
+}
+
+/*
+ * pmem_ranges_delete -- stop tracking a range about to be unmapped
+ */
+void
+pmem_ranges_delete(void *addr, size_t len)
+{
+	pmem_ranges_lock();
+	(void) pmem_ranges_remove((uintptr_t)addr, (uintptr_t)addr + len);
+	pmem_ranges_unlock();
+}
+
+/*
+ * pmem_ranges_fini -- (internal) free the ranges array
+ */
+static void
+pmem_ranges_fini(void)
+{
+	Free(Pmem_ranges.ranges);
+	Pmem_ranges.ranges = NULL;
+	Pmem_ranges.nranges = 0;
+	Pmem_ranges.size = 0;
+}
+
+/*
+ * is_pmem_ranges -- (internal) use the tracked ranges to implement
+ *	pmem_is_pmem(), falling back to is_pmem_proc()
+ *
+ * If the given range is entirely covered by ranges created by pmem_map(),
+ * the answer is taken from them (consulting /proc for a whole tracked
+ * range the first time it's needed).  Otherwise the answer comes
+ * directly from /proc.
+ */
+static int
+is_pmem_ranges(const void *addr, size_t len)
+{
+	uintptr_t start = (uintptr_t)addr;
+	uintptr_t end = start + len;
+
+	for (;;) {
+		uintptr_t ustart = 0;	/* range with unknown state */
+		uintptr_t uend = 0;
+		uint64_t ugen = 0;
+		int retval = -1;	/* not covered by tracked ranges */
+
+		pmem_ranges_lock();
+
+		uintptr_t cur = start;
+		size_t i = pmem_ranges_find(start);
+		for (; i < Pmem_ranges.nranges; i++) {
+			struct pmem_range *r = &Pmem_ranges.ranges[i];
+			if (r->start > cur)
+				break;	/* gap */
+
+			if (r->state == PMEM_RANGE_NOT_PMEM) {
+				retval = 0;
+				break;
+			} else if (r->state == PMEM_RANGE_UNKNOWN) {
+				ustart = r->start;
+				uend = r->end;
+				ugen = r->gen;
+				break;
+			}
+
+			cur = r->end;
+			if (cur >= end) {
+				retval = 1;
+				break;
+			}
+		}
+
+		pmem_ranges_unlock();
+
+		if (uend != 0) {
+			/* learn the state of the whole tracked range */
+			enum pmem_range_state state = is_pmem_proc(
+				(void *)ustart, uend - ustart) ?
+				PMEM_RANGE_PMEM : PMEM_RANGE_NOT_PMEM;
+
+			pmem_ranges_lock();
+			i = pmem_ranges_find(ustart);
+			if (i < Pmem_ranges.nranges &&
+					Pmem_ranges.ranges[i].start == ustart &&
+					Pmem_ranges.ranges[i].end == uend &&
+					Pmem_ranges.ranges[i].gen == ugen)
+				Pmem_ranges.ranges[i].state = state;
+			pmem_ranges_unlock();
+
+			/* the range may have changed meanwhile, look again */
+			continue;
+		}
+
+		if (retval >= 0) {
+			LOG(4, "tracked range, returning %d", retval);
+			return retval;
+		}
+
+		return is_pmem_proc(addr, len);
+	}
+}
+
 /*
  * pmem_is_pmem() calls through Func_is_pmem to do the work.  Although
  * initialized to is_pmem_never(), once the existence of the clflush
  * feature is confirmed by pmem_init() at library initialization time,
- * Func_is_pmem is set to is_pmem_proc().  That's the most common case
+ * Func_is_pmem is set to is_pmem_ranges().  That's the most common case
  * on modern hardware.
  */
 static int (*Func_is_pmem)(const void *addr, size_t len) = is_pmem_never;
@@ -633,6 +1189,8 @@ pmem_map(int fd)
 	if ((addr = util_map(fd, (size_t)stbuf.st_size, 0, 0)) == NULL)
 		return NULL;    /* util_map() set errno, called LOG */
 
+	pmem_ranges_insert(addr, (size_t)stbuf.st_size);
+
 	LOG(3, "returning %p", addr);
 
 	VALGRIND_REGISTER_PMEM_MAPPING(addr, stbuf.st_size);
@@ -648,6 +1206,9 @@ pmem_unmap(void *addr, size_t len)
 {
 	LOG(3, "addr %p len %zu", addr, len);
 
+	/* the range may be reused by another thread as soon as it's unmapped */
+	pmem_ranges_delete(addr, len);
+
 	int ret = util_unmap(addr, len);
 
 	VALGRIND_REMOVE_PMEM_MAPPING(addr, len);
@@ -669,17 +1230,346 @@ memmove_nodrain_normal(void *pmemdest, const void *src, size_t len)
 }
 
 /*
- * memmove_nodrain_movnt -- (internal) memmove to pmem without hw drain, movnt
+ * Each non-temporal copy/set variant below is split into a common part,
+ * which takes care of the unaligned head of the destination range (using
+ * regular stores followed by a flush) and the tail that is not a multiple
+ * of MOVNT_SIZE (dwords and bytes), and a bulk kernel which copies or sets
+ * the rest using the widest non-temporal stores available.  The bulk
+ * kernels are always called with a FLUSH_ALIGN aligned destination and
+ * process all the MOVNT_SIZE multiple part of the range they are given.
  */
-static void *
-memmove_nodrain_movnt(void *pmemdest, const void *src, size_t len)
+typedef void (*movnt_copy_fn)(char *dest, const char *src, size_t len);
+typedef void (*movnt_set_fn)(char *dest, int c, size_t len);
+
+/*
+ * movnt_fw_sse2 -- (internal) forward copy using 128-bit movnt
+ */
+static void
+movnt_fw_sse2(char *dest, const char *src, size_t len)
 {
-	LOG(15, "pmemdest %p src %p len %zu", pmemdest, src, len);
+	__m128i xmm0, xmm1, xmm2, xmm3, xmm4, xmm5, xmm6, xmm7;
+	__m128i *d = (__m128i *)dest;
+	const __m128i *s = (const __m128i *)src;
+	size_t i;
+
+	size_t cnt = len >> CHUNK_SHIFT;
+	for (i = 0; i < cnt; i++) {
+		xmm0 = _mm_loadu_si128(s);
+		xmm1 = _mm_loadu_si128(s + 1);
+		xmm2 = _mm_loadu_si128(s + 2);
+		xmm3 = _mm_loadu_si128(s + 3);
+		xmm4 = _mm_loadu_si128(s + 4);
+		xmm5 = _mm_loadu_si128(s + 5);
+		xmm6 = _mm_loadu_si128(s + 6);
+		xmm7 = _mm_loadu_si128(s + 7);
+		s += 8;
+		_mm_stream_si128(d,	xmm0);
+		_mm_stream_si128(d + 1,	xmm1);
+		_mm_stream_si128(d + 2,	xmm2);
+		_mm_stream_si128(d + 3,	xmm3);
+		_mm_stream_si128(d + 4,	xmm4);
+		_mm_stream_si128(d + 5, xmm5);
+		_mm_stream_si128(d + 6,	xmm6);
+		_mm_stream_si128(d + 7,	xmm7);
+		VALGRIND_DO_FLUSH(d, 8 * sizeof (*d));
+		d += 8;
+	}
+
+	/* copy the tail (<128 bytes) in 16 bytes chunks */
+	cnt = (len & CHUNK_MASK) >> MOVNT_SHIFT;
+	for (i = 0; i < cnt; i++) {
+		xmm0 = _mm_loadu_si128(s);
+		_mm_stream_si128(d, xmm0);
+		VALGRIND_DO_FLUSH(d, sizeof (*d));
+		s++;
+		d++;
+	}
+}
 
+/*
+ * movnt_bw_sse2 -- (internal) backward copy using 128-bit movnt
+ *
+ * The dest and src arguments point to the end of the ranges.
+ */
+static void
+movnt_bw_sse2(char *dest, const char *src, size_t len)
+{
 	__m128i xmm0, xmm1, xmm2, xmm3, xmm4, xmm5, xmm6, xmm7;
+	__m128i *d = (__m128i *)dest;
+	const __m128i *s = (const __m128i *)src;
+	size_t i;
+
+	size_t cnt = len >> CHUNK_SHIFT;
+	for (i = 0; i < cnt; i++) {
+		xmm0 = _mm_loadu_si128(s - 1);
+		xmm1 = _mm_loadu_si128(s - 2);
+		xmm2 = _mm_loadu_si128(s - 3);
+		xmm3 = _mm_loadu_si128(s - 4);
+		xmm4 = _mm_loadu_si128(s - 5);
+		xmm5 = _mm_loadu_si128(s - 6);
+		xmm6 = _mm_loadu_si128(s - 7);
+		xmm7 = _mm_loadu_si128(s - 8);
+		s -= 8;
+		_mm_stream_si128(d - 1, xmm0);
+		_mm_stream_si128(d - 2, xmm1);
+		_mm_stream_si128(d - 3, xmm2);
+		_mm_stream_si128(d - 4, xmm3);
+		_mm_stream_si128(d - 5, xmm4);
+		_mm_stream_si128(d - 6, xmm5);
+		_mm_stream_si128(d - 7, xmm6);
+		_mm_stream_si128(d - 8, xmm7);
+		d -= 8;
+		VALGRIND_DO_FLUSH(d, 8 * sizeof (*d));
+	}
+
+	/* copy the tail (<128 bytes) in 16 bytes chunks */
+	cnt = (len & CHUNK_MASK) >> MOVNT_SHIFT;
+	for (i = 0; i < cnt; i++) {
+		d--;
+		s--;
+		xmm0 = _mm_loadu_si128(s);
+		_mm_stream_si128(d, xmm0);
+		VALGRIND_DO_FLUSH(d, sizeof (*d));
+	}
+}
+
+/*
+ * movnt_fw_avx2 -- (internal) forward copy using 256-bit movnt
+ */
+__attribute__((target("avx2")))
+static void
+movnt_fw_avx2(char *dest, const char *src, size_t len)
+{
+	__m256i ymm0, ymm1, ymm2, ymm3, ymm4, ymm5, ymm6, ymm7;
+	__m256i *d = (__m256i *)dest;
+	const __m256i *s = (const __m256i *)src;
+	size_t i;
+
+	size_t cnt = len >> AVX2_CHUNK_SHIFT;
+	for (i = 0; i < cnt; i++) {
+		ymm0 = _mm256_loadu_si256(s);
+		ymm1 = _mm256_loadu_si256(s + 1);
+		ymm2 = _mm256_loadu_si256(s + 2);
+		ymm3 = _mm256_loadu_si256(s + 3);
+		ymm4 = _mm256_loadu_si256(s + 4);
+		ymm5 = _mm256_loadu_si256(s + 5);
+		ymm6 = _mm256_loadu_si256(s + 6);
+		ymm7 = _mm256_loadu_si256(s + 7);
+		s += 8;
+		_mm256_stream_si256(d, ymm0);
+		_mm256_stream_si256(d + 1, ymm1);
+		_mm256_stream_si256(d + 2, ymm2);
+		_mm256_stream_si256(d + 3, ymm3);
+		_mm256_stream_si256(d + 4, ymm4);
+		_mm256_stream_si256(d + 5, ymm5);
+		_mm256_stream_si256(d + 6, ymm6);
+		_mm256_stream_si256(d + 7, ymm7);
+		VALGRIND_DO_FLUSH(d, 8 * sizeof (*d));
+		d += 8;
+	}
+
+	/* copy the tail (<256 bytes) in 32 bytes chunks */
+	cnt = (len & AVX2_CHUNK_MASK) >> AVX2_SHIFT;
+	for (i = 0; i < cnt; i++) {
+		ymm0 = _mm256_loadu_si256(s);
+		_mm256_stream_si256(d, ymm0);
+		VALGRIND_DO_FLUSH(d, sizeof (*d));
+		s++;
+		d++;
+	}
+
+	/* copy the remaining 16 bytes chunk, if any */
+	if (len & (AVX2_SIZE - MOVNT_SIZE)) {
+		__m128i xmm0 = _mm_loadu_si128((const __m128i *)s);
+		_mm_stream_si128((__m128i *)d, xmm0);
+		VALGRIND_DO_FLUSH(d, MOVNT_SIZE);
+	}
+}
+
+/*
+ * movnt_bw_avx2 -- (internal) backward copy using 256-bit movnt
+ *
+ * The dest and src arguments point to the end of the ranges.
+ */
+__attribute__((target("avx2")))
+static void
+movnt_bw_avx2(char *dest, const char *src, size_t len)
+{
+	__m256i ymm0, ymm1, ymm2, ymm3, ymm4, ymm5, ymm6, ymm7;
+	__m256i *d = (__m256i *)dest;
+	const __m256i *s = (const __m256i *)src;
+	size_t i;
+
+	size_t cnt = len >> AVX2_CHUNK_SHIFT;
+	for (i = 0; i < cnt; i++) {
+		ymm0 = _mm256_loadu_si256(s - 1);
+		ymm1 = _mm256_loadu_si256(s - 2);
+		ymm2 = _mm256_loadu_si256(s - 3);
+		ymm3 = _mm256_loadu_si256(s - 4);
+		ymm4 = _mm256_loadu_si256(s - 5);
+		ymm5 = _mm256_loadu_si256(s - 6);
+		ymm6 = _mm256_loadu_si256(s - 7);
+		ymm7 = _mm256_loadu_si256(s - 8);
+		s -= 8;
+		_mm256_stream_si256(d - 1, ymm0);
+		_mm256_stream_si256(d - 2, ymm1);
+		_mm256_stream_si256(d - 3, ymm2);
+		_mm256_stream_si256(d - 4, ymm3);
+		_mm256_stream_si256(d - 5, ymm4);
+		_mm256_stream_si256(d - 6, ymm5);
+		_mm256_stream_si256(d - 7, ymm6);
+		_mm256_stream_si256(d - 8, ymm7);
+		d -= 8;
+		VALGRIND_DO_FLUSH(d, 8 * sizeof (*d));
+	}
+
+	/* copy the tail (<256 bytes) in 32 bytes chunks */
+	cnt = (len & AVX2_CHUNK_MASK) >> AVX2_SHIFT;
+	for (i = 0; i < cnt; i++) {
+		d--;
+		s--;
+		ymm0 = _mm256_loadu_si256(s);
+		_mm256_stream_si256(d, ymm0);
+		VALGRIND_DO_FLUSH(d, sizeof (*d));
+	}
+
+	/* copy the remaining 16 bytes chunk, if any */
+	if (len & (AVX2_SIZE - MOVNT_SIZE)) {
+		__m128i *d128 = (__m128i *)d - 1;
+		const __m128i *s128 = (const __m128i *)s - 1;
+		__m128i xmm0 = _mm_loadu_si128(s128);
+		_mm_stream_si128(d128, xmm0);
+		VALGRIND_DO_FLUSH(d128, sizeof (*d128));
+	}
+}
+
+/*
+ * movnt_fw_avx512f -- (internal) forward copy using 512-bit movnt
+ */
+__attribute__((target("avx512f")))
+static void
+movnt_fw_avx512f(char *dest, const char *src, size_t len)
+{
+	__m512i zmm0, zmm1, zmm2, zmm3, zmm4, zmm5, zmm6, zmm7;
+	__m512i *d = (__m512i *)dest;
+	const __m512i *s = (const __m512i *)src;
+	size_t i;
+
+	size_t cnt = len >> AVX512_CHUNK_SHIFT;
+	for (i = 0; i < cnt; i++) {
+		zmm0 = _mm512_loadu_si512(s);
+		zmm1 = _mm512_loadu_si512(s + 1);
+		zmm2 = _mm512_loadu_si512(s + 2);
+		zmm3 = _mm512_loadu_si512(s + 3);
+		zmm4 = _mm512_loadu_si512(s + 4);
+		zmm5 = _mm512_loadu_si512(s + 5);
+		zmm6 = _mm512_loadu_si512(s + 6);
+		zmm7 = _mm512_loadu_si512(s + 7);
+		s += 8;
+		_mm512_stream_si512(d, zmm0);
+		_mm512_stream_si512(d + 1, zmm1);
+		_mm512_stream_si512(d + 2, zmm2);
+		_mm512_stream_si512(d + 3, zmm3);
+		_mm512_stream_si512(d + 4, zmm4);
+		_mm512_stream_si512(d + 5, zmm5);
+		_mm512_stream_si512(d + 6, zmm6);
+		_mm512_stream_si512(d + 7, zmm7);
+		VALGRIND_DO_FLUSH(d, 8 * sizeof (*d));
+		d += 8;
+	}
+
+	/* copy the tail (<512 bytes) in 64 bytes chunks */
+	cnt = (len & AVX512_CHUNK_MASK) >> AVX512_SHIFT;
+	for (i = 0; i < cnt; i++) {
+		zmm0 = _mm512_loadu_si512(s);
+		_mm512_stream_si512(d, zmm0);
+		VALGRIND_DO_FLUSH(d, sizeof (*d));
+		s++;
+		d++;
+	}
+
+	/* copy the rest (<64 bytes) in 16 bytes chunks */
+	__m128i *d128 = (__m128i *)d;
+	const __m128i *s128 = (const __m128i *)s;
+	cnt = (len & (AVX512_SIZE - 1)) >> MOVNT_SHIFT;
+	for (i = 0; i < cnt; i++) {
+		__m128i xmm0 = _mm_loadu_si128(s128);
+		_mm_stream_si128(d128, xmm0);
+		VALGRIND_DO_FLUSH(d128, sizeof (*d128));
+		s128++;
+		d128++;
+	}
+}
+
+/*
+ * movnt_bw_avx512f -- (internal) backward copy using 512-bit movnt
+ *
+ * The dest and src arguments point to the end of the ranges.
+ */
+__attribute__((target("avx512f")))
+static void
+movnt_bw_avx512f(char *dest, const char *src, size_t len)
+{
+	__m512i zmm0, zmm1, zmm2, zmm3, zmm4, zmm5, zmm6, zmm7;
+	__m512i *d = (__m512i *)dest;
+	const __m512i *s = (const __m512i *)src;
+	size_t i;
+
+	size_t cnt = len >> AVX512_CHUNK_SHIFT;
+	for (i = 0; i < cnt; i++) {
+		zmm0 = _mm512_loadu_si512(s - 1);
+		zmm1 = _mm512_loadu_si512(s - 2);
+		zmm2 = _mm512_loadu_si512(s - 3);
+		zmm3 = _mm512_loadu_si512(s - 4);
+		zmm4 = _mm512_loadu_si512(s - 5);
+		zmm5 = _mm512_loadu_si512(s - 6);
+		zmm6 = _mm512_loadu_si512(s - 7);
+		zmm7 = _mm512_loadu_si512(s - 8);
+		s -= 8;
+		_mm512_stream_si512(d - 1, zmm0);
+		_mm512_stream_si512(d - 2, zmm1);
+		_mm512_stream_si512(d - 3, zmm2);
+		_mm512_stream_si512(d - 4, zmm3);
+		_mm512_stream_si512(d - 5, zmm4);
+		_mm512_stream_si512(d - 6, zmm5);
+		_mm512_stream_si512(d - 7, zmm6);
+		_mm512_stream_si512(d - 8, zmm7);
+		d -= 8;
+		VALGRIND_DO_FLUSH(d, 8 * sizeof (*d));
+	}
+
+	/* copy the tail (<512 bytes) in 64 bytes chunks */
+	cnt = (len & AVX512_CHUNK_MASK) >> AVX512_SHIFT;
+	for (i = 0; i < cnt; i++) {
+		d--;
+		s--;
+		zmm0 = _mm512_loadu_si512(s);
+		_mm512_stream_si512(d, zmm0);
+		VALGRIND_DO_FLUSH(d, sizeof (*d));
+	}
+
+	/* copy the rest (<64 bytes) in 16 bytes chunks */
+	__m128i *d128 = (__m128i *)d;
+	const __m128i *s128 = (const __m128i *)s;
+	cnt = (len & (AVX512_SIZE - 1)) >> MOVNT_SHIFT;
+	for (i = 0; i < cnt; i++) {
+		d128--;
+		s128--;
+		__m128i xmm0 = _mm_loadu_si128(s128);
+		_mm_stream_si128(d128, xmm0);
+		VALGRIND_DO_FLUSH(d128, sizeof (*d128));
+	}
+}
+
+/*
+ * memmove_nodrain_movnt_common -- (internal) memmove to pmem without hw drain,
+ *	using the given movnt bulk copy kernels
+ */
+static void *
+memmove_nodrain_movnt_common(void *pmemdest, const void *src, size_t len,
+	movnt_copy_fn copy_fw, movnt_copy_fn copy_bw)
+{
 	size_t i;
-	__m128i *d;
-	__m128i *s;
 	void *dest1 = pmemdest;
 	size_t cnt;
 
@@ -722,51 +1612,20 @@ memmove_nodrain_movnt(void *pmemdest, const void *src, size_t len)
 			len -= cnt;
 		}
 
-		d = (__m128i *)dest1;
-		s = (__m128i *)src;
-
-		cnt = len >> CHUNK_SHIFT;
-		for (i = 0; i < cnt; i++) {
-			xmm0 = _mm_loadu_si128(s);
-			xmm1 = _mm_loadu_si128(s + 1);
-			xmm2 = _mm_loadu_si128(s + 2);
-			xmm3 = _mm_loadu_si128(s + 3);
-			xmm4 = _mm_loadu_si128(s + 4);
-			xmm5 = _mm_loadu_si128(s + 5);
-			xmm6 = _mm_loadu_si128(s + 6);
-			xmm7 = _mm_loadu_si128(s + 7);
-			s += 8;
-			_mm_stream_si128(d,	xmm0);
-			_mm_stream_si128(d + 1,	xmm1);
-			_mm_stream_si128(d + 2,	xmm2);
-			_mm_stream_si128(d + 3,	xmm3);
-			_mm_stream_si128(d + 4,	xmm4);
-			_mm_stream_si128(d + 5, xmm5);
-			_mm_stream_si128(d + 6,	xmm6);
-			_mm_stream_si128(d + 7,	xmm7);
-			VALGRIND_DO_FLUSH(d, 8 * sizeof (*d));
-			d += 8;
-		}
-
-		/* copy the tail (<128 bytes) in 16 bytes chunks */
-		len &= CHUNK_MASK;
-		if (len != 0) {
-			cnt = len >> MOVNT_SHIFT;
-			for (i = 0; i < cnt; i++) {
-				xmm0 = _mm_loadu_si128(s);
-				_mm_stream_si128(d, xmm0);
-				VALGRIND_DO_FLUSH(d, sizeof (*d));
-				s++;
-				d++;
-			}
-		}
+		/* copy everything up to the last 16 bytes chunk */
+		cnt = len & ~(size_t)MOVNT_MASK;
+		copy_fw(dest1, src, cnt);
+		PMEM_STATS_ADD(movnt_bytes, cnt + (len & MOVNT_MASK &
+				~(size_t)DWORD_MASK));
+		dest1 = (char *)dest1 + cnt;
+		src = (char *)src + cnt;
 
 		/* copy the last bytes (<16), first dwords then bytes */
 		len &= MOVNT_MASK;
 		if (len != 0) {
 			cnt = len >> DWORD_SHIFT;
-			int32_t *d32 = (int32_t *)d;
-			int32_t *s32 = (int32_t *)s;
+			int32_t *d32 = (int32_t *)dest1;
+			int32_t *s32 = (int32_t *)src;
 			for (i = 0; i < cnt; i++) {
 				_mm_stream_si32(d32, *s32);
 				VALGRIND_DO_FLUSH(d32, sizeof (*d32));
@@ -814,51 +1673,20 @@ memmove_nodrain_movnt(void *pmemdest, const void *src, size_t len)
 			len -= cnt;
 		}
 
-		d = (__m128i *)dest1;
-		s = (__m128i *)src;
-
-		cnt = len >> CHUNK_SHIFT;
-		for (i = 0; i < cnt; i++) {
-			xmm0 = _mm_loadu_si128(s - 1);
-			xmm1 = _mm_loadu_si128(s - 2);
-			xmm2 = _mm_loadu_si128(s - 3);
-			xmm3 = _mm_loadu_si128(s - 4);
-			xmm4 = _mm_loadu_si128(s - 5);
-			xmm5 = _mm_loadu_si128(s - 6);
-			xmm6 = _mm_loadu_si128(s - 7);
-			xmm7 = _mm_loadu_si128(s - 8);
-			s -= 8;
-			_mm_stream_si128(d - 1, xmm0);
-			_mm_stream_si128(d - 2, xmm1);
-			_mm_stream_si128(d - 3, xmm2);
-			_mm_stream_si128(d - 4, xmm3);
-			_mm_stream_si128(d - 5, xmm4);
-			_mm_stream_si128(d - 6, xmm5);
-			_mm_stream_si128(d - 7, xmm6);
-			_mm_stream_si128(d - 8, xmm7);
-			d -= 8;
-			VALGRIND_DO_FLUSH(d, 8 * sizeof (*d));
-		}
-
-		/* copy the tail (<128 bytes) in 16 bytes chunks */
-		len &= CHUNK_MASK;
-		if (len != 0) {
-			cnt = len >> MOVNT_SHIFT;
-			for (i = 0; i < cnt; i++) {
-				d--;
-				s--;
-				xmm0 = _mm_loadu_si128(s);
-				_mm_stream_si128(d, xmm0);
-				VALGRIND_DO_FLUSH(d, sizeof (*d));
-			}
-		}
+		/* copy everything down to the first 16 bytes chunk */
+		cnt = len & ~(size_t)MOVNT_MASK;
+		copy_bw(dest1, src, cnt);
+		PMEM_STATS_ADD(movnt_bytes, cnt + (len & MOVNT_MASK &
+				~(size_t)DWORD_MASK));
+		dest1 = (char *)dest1 - cnt;
+		src = (char *)src - cnt;
 
 		/* copy the last bytes (<16), first dwords then bytes */
 		len &= MOVNT_MASK;
 		if (len != 0) {
 			cnt = len >> DWORD_SHIFT;
-			int32_t *d32 = (int32_t *)d;
-			int32_t *s32 = (int32_t *)s;
+			int32_t *d32 = (int32_t *)dest1;
+			int32_t *s32 = (int32_t *)src;
 			for (i = 0; i < cnt; i++) {
 				d32--;
 				s32--;
@@ -885,6 +1713,44 @@ memmove_nodrain_movnt(void *pmemdest, const void *src, size_t len)
 	return pmemdest;
 }
 
+/*
+ * memmove_nodrain_movnt -- (internal) memmove to pmem without hw drain, movnt
+ */
+static void *
+memmove_nodrain_movnt(void *pmemdest, const void *src, size_t len)
+{
+	LOG(15, "pmemdest %p src %p len %zu", pmemdest, src, len);
+
+	return memmove_nodrain_movnt_common(pmemdest, src, len,
+			movnt_fw_sse2, movnt_bw_sse2);
+}
+
+/*
+ * memmove_nodrain_movnt_avx2 -- (internal) memmove to pmem without hw drain,
+ *	256-bit movnt
+ */
+static void *
+memmove_nodrain_movnt_avx2(void *pmemdest, const void *src, size_t len)
+{
+	LOG(15, "pmemdest %p src %p len %zu", pmemdest, src, len);
+
+	return memmove_nodrain_movnt_common(pmemdest, src, len,
+			movnt_fw_avx2, movnt_bw_avx2);
+}
+
+/*
+ * memmove_nodrain_movnt_avx512f -- (internal) memmove to pmem without hw
+ *	drain, 512-bit movnt
+ */
+static void *
+memmove_nodrain_movnt_avx512f(void *pmemdest, const void *src, size_t len)
+{
+	LOG(15, "pmemdest %p src %p len %zu", pmemdest, src, len);
+
+	return memmove_nodrain_movnt_common(pmemdest, src, len,
+			movnt_fw_avx512f, movnt_bw_avx512f);
+}
+
 /*
  * pmem_memmove_nodrain() calls through Func_memmove_nodrain to do the work.
  * Although initialized to memmove_nodrain_normal(), once the existence of the
@@ -955,18 +1821,133 @@ memset_nodrain_normal(void *pmemdest, int c, size_t len)
 }
 
 /*
- * memset_nodrain_movnt -- (internal) memset to pmem without hw drain, movnt
+ * movnt_set_sse2 -- (internal) memset using 128-bit movnt
  */
-static void *
-memset_nodrain_movnt(void *pmemdest, int c, size_t len)
+static void
+movnt_set_sse2(char *dest, int c, size_t len)
 {
-	LOG(15, "pmemdest %p c 0x%x len %zu", pmemdest, c, len);
+	__m128i xmm0 = _mm_set1_epi8((char)c);
+	__m128i *d = (__m128i *)dest;
+	size_t i;
 
+	size_t cnt = len >> CHUNK_SHIFT;
+	for (i = 0; i < cnt; i++) {
+		_mm_stream_si128(d, xmm0);
+		_mm_stream_si128(d + 1, xmm0);
+		_mm_stream_si128(d + 2, xmm0);
+		_mm_stream_si128(d + 3, xmm0);
+		_mm_stream_si128(d + 4, xmm0);
+		_mm_stream_si128(d + 5, xmm0);
+		_mm_stream_si128(d + 6, xmm0);
+		_mm_stream_si128(d + 7, xmm0);
+		VALGRIND_DO_FLUSH(d, 8 * sizeof (*d));
+		d += 8;
+	}
+
+	/* memset the tail (<128 bytes) in 16 bytes chunks */
+	cnt = (len & CHUNK_MASK) >> MOVNT_SHIFT;
+	for (i = 0; i < cnt; i++) {
+		_mm_stream_si128(d, xmm0);
+		VALGRIND_DO_FLUSH(d, sizeof (*d));
+		d++;
+	}
+}
+
+/*
+ * movnt_set_avx2 -- (internal) memset using 256-bit movnt
+ */
+__attribute__((target("avx2")))
+static void
+movnt_set_avx2(char *dest, int c, size_t len)
+{
+	__m256i ymm0 = _mm256_set1_epi8((char)c);
+	__m256i *d = (__m256i *)dest;
+	size_t i;
+
+	size_t cnt = len >> AVX2_CHUNK_SHIFT;
+	for (i = 0; i < cnt; i++) {
+		_mm256_stream_si256(d, ymm0);
+		_mm256_stream_si256(d + 1, ymm0);
+		_mm256_stream_si256(d + 2, ymm0);
+		_mm256_stream_si256(d + 3, ymm0);
+		_mm256_stream_si256(d + 4, ymm0);
+		_mm256_stream_si256(d + 5, ymm0);
+		_mm256_stream_si256(d + 6, ymm0);
+		_mm256_stream_si256(d + 7, ymm0);
+		VALGRIND_DO_FLUSH(d, 8 * sizeof (*d));
+		d += 8;
+	}
+
+	/* memset the tail (<256 bytes) in 32 bytes chunks */
+	cnt = (len & AVX2_CHUNK_MASK) >> AVX2_SHIFT;
+	for (i = 0; i < cnt; i++) {
+		_mm256_stream_si256(d, ymm0);
+		VALGRIND_DO_FLUSH(d, sizeof (*d));
+		d++;
+	}
+
+	/* memset the remaining 16 bytes chunk, if any */
+	if (len & (AVX2_SIZE - MOVNT_SIZE)) {
+		_mm_stream_si128((__m128i *)d, _mm256_castsi256_si128(ymm0));
+		VALGRIND_DO_FLUSH(d, MOVNT_SIZE);
+	}
+}
+
+/*
+ * movnt_set_avx512f -- (internal) memset using 512-bit movnt
+ */
+__attribute__((target("avx512f")))
+static void
+movnt_set_avx512f(char *dest, int c, size_t len)
+{
+	__m512i zmm0 = _mm512_set1_epi32((int)(0x01010101u * (uint8_t)c));
+	__m512i *d = (__m512i *)dest;
+	size_t i;
+
+	size_t cnt = len >> AVX512_CHUNK_SHIFT;
+	for (i = 0; i < cnt; i++) {
+		_mm512_stream_si512(d, zmm0);
+		_mm512_stream_si512(d + 1, zmm0);
+		_mm512_stream_si512(d + 2, zmm0);
+		_mm512_stream_si512(d + 3, zmm0);
+		_mm512_stream_si512(d + 4, zmm0);
+		_mm512_stream_si512(d + 5, zmm0);
+		_mm512_stream_si512(d + 6, zmm0);
+		_mm512_stream_si512(d + 7, zmm0);
+		VALGRIND_DO_FLUSH(d, 8 * sizeof (*d));
+		d += 8;
+	}
+
+	/* memset the tail (<512 bytes) in 64 bytes chunks */
+	cnt = (len & AVX512_CHUNK_MASK) >> AVX512_SHIFT;
+	for (i = 0; i < cnt; i++) {
+		_mm512_stream_si512(d, zmm0);
+		VALGRIND_DO_FLUSH(d, sizeof (*d));
+		d++;
+	}
+
+	/* memset the rest (<64 bytes) in 16 bytes chunks */
+	__m128i xmm0 = _mm512_castsi512_si128(zmm0);
+	__m128i *d128 = (__m128i *)d;
+	cnt = (len & (AVX512_SIZE - 1)) >> MOVNT_SHIFT;
+	for (i = 0; i < cnt; i++) {
+		_mm_stream_si128(d128, xmm0);
+		VALGRIND_DO_FLUSH(d128, sizeof (*d128));
+		d128++;
+	}
+}
+
+/*
+ * memset_nodrain_movnt_common -- (internal) memset to pmem without hw drain,
+ *	using the given movnt bulk set kernel
+ */
+static void *
+memset_nodrain_movnt_common(void *pmemdest, int c, size_t len,
+	movnt_set_fn set)
+{
 	size_t i;
 	void *dest1 = pmemdest;
 	size_t cnt;
-	__m128i xmm0;
-	__m128i *d;
 
 	if (len < Movnt_threshold) {
 		memset(pmemdest, c, len);
@@ -988,44 +1969,22 @@ memset_nodrain_movnt(void *pmemdest, int c, size_t len)
 		dest1 = (char *)dest1 + cnt;
 	}
 
-	xmm0 = _mm_set1_epi8((char)c);
-
-	d = (__m128i *)dest1;
-	cnt = len / CHUNK_SIZE;
-	if (cnt != 0) {
-		for (i = 0; i < cnt; i++) {
-			_mm_stream_si128(d, xmm0);
-			_mm_stream_si128(d + 1, xmm0);
-			_mm_stream_si128(d + 2, xmm0);
-			_mm_stream_si128(d + 3, xmm0);
-			_mm_stream_si128(d + 4, xmm0);
-			_mm_stream_si128(d + 5, xmm0);
-			_mm_stream_si128(d + 6, xmm0);
-			_mm_stream_si128(d + 7, xmm0);
-			VALGRIND_DO_FLUSH(d, 8 * sizeof (*d));
-			d += 8;
-		}
-	}
-	/* memset the tail (<128 bytes) in 16 bytes chunks */
-	len &= CHUNK_MASK;
-	if (len != 0) {
-		cnt = len >> MOVNT_SHIFT;
-		for (i = 0; i < cnt; i++) {
-			_mm_stream_si128(d, xmm0);
-			VALGRIND_DO_FLUSH(d, sizeof (*d));
-			d++;
-		}
-	}
+	/* memset everything up to the last 16 bytes chunk */
+	cnt = len & ~(size_t)MOVNT_MASK;
+	set(dest1, c, cnt);
+	PMEM_STATS_ADD(movnt_bytes, cnt + (len & MOVNT_MASK &
+			~(size_t)DWORD_MASK));
+	dest1 = (char *)dest1 + cnt;
 
 	/* memset the last bytes (<16), first dwords then bytes */
 	len &= MOVNT_MASK;
 	if (len != 0) {
-		int32_t *d32 = (int32_t *)d;
+		int32_t *d32 = (int32_t *)dest1;
+		int32_t c32 = (int32_t)(0x01010101u * (uint8_t)c);
 		cnt = len >> DWORD_SHIFT;
 		if (cnt != 0) {
 			for (i = 0; i < cnt; i++) {
-				_mm_stream_si32(d32,
-					_mm_cvtsi128_si32(xmm0));
+				_mm_stream_si32(d32, c32);
 				VALGRIND_DO_FLUSH(d32, sizeof (*d32));
 				d32++;
 			}
@@ -1045,6 +2004,42 @@ memset_nodrain_movnt(void *pmemdest, int c, size_t len)
 	return pmemdest;
 }
 
+/*
+ * memset_nodrain_movnt -- (internal) memset to pmem without hw drain, movnt
+ */
+static void *
+memset_nodrain_movnt(void *pmemdest, int c, size_t len)
+{
+	LOG(15, "pmemdest %p c 0x%x len %zu", pmemdest, c, len);
+
+	return memset_nodrain_movnt_common(pmemdest, c, len, movnt_set_sse2);
+}
+
+/*
+ * memset_nodrain_movnt_avx2 -- (internal) memset to pmem without hw drain,
+ *	256-bit movnt
+ */
+static void *
+memset_nodrain_movnt_avx2(void *pmemdest, int c, size_t len)
+{
+	LOG(15, "pmemdest %p c 0x%x len %zu", pmemdest, c, len);
+
+	return memset_nodrain_movnt_common(pmemdest, c, len, movnt_set_avx2);
+}
+
+/*
+ * memset_nodrain_movnt_avx512f -- (internal) memset to pmem without hw drain,
+ *	512-bit movnt
+ */
+static void *
+memset_nodrain_movnt_avx512f(void *pmemdest, int c, size_t len)
+{
+	LOG(15, "pmemdest %p c 0x%x len %zu", pmemdest, c, len);
+
+	return memset_nodrain_movnt_common(pmemdest, c, len,
+			movnt_set_avx512f);
+}
+
 /*
  * pmem_memset_nodrain() calls through Func_memset_nodrain to do the work.
  * Although initialized to memset_nodrain_normal(), once the existence of the
@@ -1091,6 +2086,8 @@ pmem_parse_cpuinfo(char *line)
 	static const char clflushopt[] = " clflushopt ";
 	static const char pcommit[] = " pcommit ";
 	static const char sse2[] = " sse2 ";
+	static const char avx2[] = " avx2 ";
+	static const char avx512f[] = " avx512f ";
 
 	if (strncmp(flagspfx, line, sizeof (flagspfx) - 1) != 0)
 		return 0;
@@ -1104,7 +2101,7 @@ pmem_parse_cpuinfo(char *line)
 		*nl = ' ';
 
 	if (strstr(flags, clflush) != NULL) {
-		Func_is_pmem = is_pmem_proc;
+		Func_is_pmem = is_pmem_ranges;
 		LOG(3, "clflush supported");
 	}
 
@@ -1172,7 +2169,40 @@ pmem_parse_cpuinfo(char *line)
 		}
 	}
 
-	if (Func_memmove_nodrain == memmove_nodrain_movnt)
+	/*
+	 * The wider movnt variants are only used when movnt is in use at all,
+	 * so PMEM_NO_MOVNT disables them as well.
+	 */
+	if (strstr(flags, avx2) != NULL) {
+		LOG(3, "avx2 supported");
+
+		char *e = getenv("PMEM_NO_AVX2");
+		if (e && strcmp(e, "1") == 0)
+			LOG(3, "PMEM_NO_AVX2 forced no avx2");
+		else if (Func_memmove_nodrain == memmove_nodrain_movnt) {
+			Func_memmove_nodrain = memmove_nodrain_movnt_avx2;
+			Func_memset_nodrain = memset_nodrain_movnt_avx2;
+		}
+	}
+
+	if (strstr(flags, avx512f) != NULL) {
+		LOG(3, "avx512f supported");
+
+		char *e = getenv("PMEM_NO_AVX512F");
+		if (e && strcmp(e, "1") == 0)
+			LOG(3, "PMEM_NO_AVX512F forced no avx512f");
+		else if (Func_memmove_nodrain == memmove_nodrain_movnt ||
+			Func_memmove_nodrain == memmove_nodrain_movnt_avx2) {
+			Func_memmove_nodrain = memmove_nodrain_movnt_avx512f;
+			Func_memset_nodrain = memset_nodrain_movnt_avx512f;
+		}
+	}
+
+	if (Func_memmove_nodrain == memmove_nodrain_movnt_avx512f)
+		LOG(3, "using movnt avx512f");
+	else if (Func_memmove_nodrain == memmove_nodrain_movnt_avx2)
+		LOG(3, "using movnt avx2");
+	else if (Func_memmove_nodrain == memmove_nodrain_movnt)
 		LOG(3, "using movnt");
 	else if (Func_memmove_nodrain == memmove_nodrain_normal)
 		LOG(3, "not using movnt");
@@ -1229,6 +2259,16 @@ pmem_init(void)
 		}
 	}
 
+	/*
+	 * Flush/fence statistics can be also turned on without modifying
+	 * the application, to be queried with pmem_stats_get().
+	 */
+	ptr = getenv("PMEM_STATS");
+	if (ptr && atoi(ptr) == 1) {
+		LOG(3, "PMEM_STATS enabled flush/fence statistics");
+		Stats_enabled = 1;
+	}
+
 	/*
 	 * For debugging/testing, allow pmem_is_pmem() to be forced
 	 * to always true or never true using environment variable
@@ -1249,3 +2289,18 @@ pmem_init(void)
 			Func_is_pmem = is_pmem_always;
 	}
 }
+
+/*
+ * pmem_fini -- libpmem cleanup routine for pmem.c
+ *
+ * Called automatically when the process terminates.
+ */
+__attribute__((destructor))
+static void
+pmem_fini(void)
+{
+	LOG(3, NULL);
+
+	pmem_ranges_fini();
+	pmem_stats_fini();
+}
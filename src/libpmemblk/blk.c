@@ -571,6 +571,7 @@ pmemblk_close(PMEMblkpool *pbp)
 #endif
 
 	VALGRIND_REMOVE_PMEM_MAPPING(pbp->addr, pbp->size);
+	pmem_ranges_delete(pbp->addr, pbp->size);
 	util_unmap(pbp->addr, pbp->size);
 }
 
@@ -313,6 +313,7 @@ pmemlog_close(PMEMlogpool *plp)
 	Free((void *)plp->rwlockp);
 
 	VALGRIND_REMOVE_PMEM_MAPPING(plp->addr, plp->size);
+	pmem_ranges_delete(plp->addr, plp->size);
 	util_unmap(plp->addr, plp->size);
 }
 
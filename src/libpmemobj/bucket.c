@@ -38,6 +38,7 @@
  */
 
 #include <errno.h>
+#include <string.h>
 
 #include "libpmem.h"
 #include "libpmemobj.h"
@@ -78,6 +79,50 @@ struct block_container_ctree {
 	struct ctree *tree;
 };
 
+/*
+ * Every block size below SEGLISTS_NEXACT units has its own list, each power
+ * of two size range above that is split into SEGLISTS_NSUB lists of equal
+ * width, up to the biggest possible size of a memory block.
+ */
+#define	SEGLISTS_NEXACT_SHIFT 6
+#define	SEGLISTS_NEXACT (1U << SEGLISTS_NEXACT_SHIFT)
+#define	SEGLISTS_NSUB_SHIFT 3
+#define	SEGLISTS_NSUB (1U << SEGLISTS_NSUB_SHIFT)
+#define	SEGLISTS_NCLASSES (SEGLISTS_NEXACT - 1 +\
+	(16 - SEGLISTS_NEXACT_SHIFT) * SEGLISTS_NSUB)
+#define	SEGLISTS_NWORDS ((SEGLISTS_NCLASSES + 63) / 64)
+
+/*
+ * Number of blocks of the list of the requested size range which are checked
+ * for the best fit before a block of the next non-empty range is taken.
+ */
+#define	SEGLISTS_SCAN_MAX 8
+
+/*
+ * The container holds whole chunks, so there's at most one block starting in
+ * each chunk. Its list node is the one of that chunk, the nodes are allocated
+ * for all chunks of a zone at once, when the first block of the zone is
+ * inserted.
+ */
+struct seglists_node {
+	struct memory_block m; /* size_idx is 0 if the chunk is not inserted */
+	struct seglists_node *prev;
+	struct seglists_node *next;
+};
+
+struct block_container_seglists {
+	struct block_container super;
+	pthread_mutex_t lock;
+
+	/* bit n is set if lists[n] is not empty */
+	uint64_t nonempty[SEGLISTS_NWORDS];
+	struct seglists_node *lists[SEGLISTS_NCLASSES];
+
+	/* nodes of the chunks, indexed by the zone id */
+	struct seglists_node **zones;
+	uint32_t nzones;
+};
+
 #ifdef USE_VG_MEMCHECK
 /*
  * bucket_vg_mark_noaccess -- (internal) marks memory block as no access for vg
@@ -184,12 +229,29 @@ bucket_tree_is_empty(struct block_container *bc)
 	return ctree_is_empty(c->tree);
 }
 
+/*
+ * bucket_tree_get_largest -- (internal) returns the size index of the biggest
+ *	memory block, 0 if the container is empty
+ */
+static uint32_t
+bucket_tree_get_largest(struct block_container *bc)
+{
+	struct block_container_ctree *c = (struct block_container_ctree *)bc;
+
+	/* the size index is stored in the most significant bits of the key */
+	uint64_t key = UINT64_MAX;
+	ctree_find_le(c->tree, &key);
+
+	return CHUNK_KEY_GET_SIZE_IDX(key);
+}
+
 static struct block_container_ops container_ctree_ops = {
 	.insert = bucket_tree_insert_block,
 	.get_rm_exact = bucket_tree_get_rm_block_exact,
 	.get_rm_bestfit = bucket_tree_get_rm_block_bestfit,
 	.get_exact = bucket_tree_get_block_exact,
-	.is_empty = bucket_tree_is_empty
+	.is_empty = bucket_tree_is_empty,
+	.get_largest = bucket_tree_get_largest
 };
 
 /*
@@ -229,6 +291,418 @@ bucket_tree_delete(struct block_container *bc)
 	Free(bc);
 }
 
+/*
+ * bucket_seglists_class -- (internal) returns the list index for block size
+ */
+static unsigned
+bucket_seglists_class(uint32_t size_idx)
+{
+	ASSERTne(size_idx, 0);
+
+	if (size_idx < SEGLISTS_NEXACT)
+		return size_idx - 1;
+
+	unsigned log2 = 31 - (unsigned)__builtin_clz(size_idx);
+	unsigned sub = (size_idx >> (log2 - SEGLISTS_NSUB_SHIFT)) &
+		(SEGLISTS_NSUB - 1);
+	unsigned cls = SEGLISTS_NEXACT - 1 +
+		(log2 - SEGLISTS_NEXACT_SHIFT) * SEGLISTS_NSUB + sub;
+
+	return cls < SEGLISTS_NCLASSES ? cls : SEGLISTS_NCLASSES - 1;
+}
+
+/*
+ * bucket_seglists_next_nonempty -- (internal) returns the index of the first
+ *	non-empty list starting from cls, SEGLISTS_NCLASSES if there's none
+ */
+static unsigned
+bucket_seglists_next_nonempty(struct block_container_seglists *c,
+	unsigned cls)
+{
+	for (unsigned w = cls / 64; w < SEGLISTS_NWORDS; ++w) {
+		uint64_t bits = c->nonempty[w];
+		if (w == cls / 64)
+			bits &= ~(uint64_t)0 << (cls % 64);
+
+		if (bits != 0)
+			return w * 64 + (unsigned)__builtin_ctzll(bits);
+	}
+
+	return SEGLISTS_NCLASSES;
+}
+
+/*
+ * bucket_seglists_node -- (internal) returns the node of the chunk, NULL if
+ *	the nodes of the zone don't exist and alloc is not set
+ */
+static struct seglists_node *
+bucket_seglists_node(struct block_container_seglists *c, uint32_t zone_id,
+	uint32_t chunk_id, int alloc)
+{
+	ASSERT(chunk_id < MAX_CHUNK);
+
+	if (zone_id >= c->nzones) {
+		if (!alloc)
+			return NULL;
+
+		struct seglists_node **zones = Realloc(c->zones,
+			sizeof (*zones) * (zone_id + 1));
+		if (zones == NULL)
+			return NULL;
+
+		memset(&zones[c->nzones], 0,
+			sizeof (*zones) * (zone_id + 1 - c->nzones));
+		c->zones = zones;
+		c->nzones = zone_id + 1;
+	}
+
+	if (c->zones[zone_id] == NULL) {
+		if (!alloc)
+			return NULL;
+
+		size_t size = sizeof (struct seglists_node) * MAX_CHUNK;
+		if ((c->zones[zone_id] = Malloc(size)) == NULL)
+			return NULL;
+
+		memset(c->zones[zone_id], 0, size);
+	}
+
+	return &c->zones[zone_id][chunk_id];
+}
+
+/*
+ * bucket_seglists_find -- (internal) returns the node of the memory block if
+ *	it's in the container, NULL otherwise
+ */
+static struct seglists_node *
+bucket_seglists_find(struct block_container_seglists *c,
+	struct memory_block m)
+{
+	if (m.block_off != 0)
+		return NULL;
+
+	struct seglists_node *n = bucket_seglists_node(c, m.zone_id,
+		m.chunk_id, 0);
+
+	return n != NULL && n->m.size_idx != 0 &&
+		n->m.size_idx == m.size_idx ? n : NULL;
+}
+
+/*
+ * bucket_seglists_link -- (internal) puts the node at the head of its list
+ */
+static void
+bucket_seglists_link(struct block_container_seglists *c,
+	struct seglists_node *n)
+{
+	unsigned cls = bucket_seglists_class(n->m.size_idx);
+
+	n->prev = NULL;
+	n->next = c->lists[cls];
+	if (n->next != NULL)
+		n->next->prev = n;
+
+	c->lists[cls] = n;
+	c->nonempty[cls / 64] |= 1ULL << (cls % 64);
+}
+
+/*
+ * bucket_seglists_unlink -- (internal) removes the node from its list
+ */
+static void
+bucket_seglists_unlink(struct block_container_seglists *c,
+	struct seglists_node *n)
+{
+	unsigned cls = bucket_seglists_class(n->m.size_idx);
+
+	if (n->prev != NULL)
+		n->prev->next = n->next;
+	else
+		c->lists[cls] = n->next;
+
+	if (n->next != NULL)
+		n->next->prev = n->prev;
+
+	if (c->lists[cls] == NULL)
+		c->nonempty[cls / 64] &= ~(1ULL << (cls % 64));
+
+	n->m.size_idx = 0;
+}
+
+/*
+ * bucket_seglists_insert_block -- (internal) inserts a new memory block
+ *	into the container
+ */
+static int
+bucket_seglists_insert_block(struct block_container *bc, PMEMobjpool *pop,
+	struct memory_block m)
+{
+	ASSERT(m.chunk_id < MAX_CHUNK);
+	ASSERT(m.zone_id < UINT16_MAX);
+	ASSERTeq(m.block_off, 0);
+	ASSERTne(m.size_idx, 0);
+
+	struct block_container_seglists *c =
+		(struct block_container_seglists *)bc;
+
+#ifdef USE_VG_MEMCHECK
+	bucket_vg_mark_noaccess(pop, bc, m);
+#endif
+
+	int ret = 0;
+
+	util_mutex_lock(&c->lock);
+
+	struct seglists_node *n = bucket_seglists_node(c, m.zone_id,
+		m.chunk_id, 1);
+	if (n == NULL) {
+		ret = ENOMEM;
+		goto out;
+	}
+
+	if (n->m.size_idx != 0) {
+		ret = EEXIST;
+		goto out;
+	}
+
+	n->m = m;
+	bucket_seglists_link(c, n);
+
+out:
+	util_mutex_unlock(&c->lock);
+
+	return ret;
+}
+
+/*
+ * bucket_seglists_list_bestfit -- (internal) returns the smallest block, not
+ *	smaller than size_idx, among the first max blocks of the list
+ */
+static struct seglists_node *
+bucket_seglists_list_bestfit(struct block_container_seglists *c,
+	unsigned cls, uint32_t size_idx, unsigned max)
+{
+	struct seglists_node *best = NULL;
+	struct seglists_node *n = c->lists[cls];
+	for (unsigned i = 0; n != NULL && i < max; n = n->next, ++i) {
+		if (n->m.size_idx < size_idx)
+			continue;
+
+		if (best == NULL || n->m.size_idx < best->m.size_idx)
+			best = n;
+
+		if (best->m.size_idx == size_idx)
+			break;
+	}
+
+	return best;
+}
+
+/*
+ * bucket_seglists_get_rm_block_bestfit -- (internal) removes and returns
+ *	a good fit memory block for size
+ *
+ * All blocks of the lists above the one of the requested size are big enough,
+ * the first of them is found with a bit scan. The list of the requested size
+ * range may also hold smaller blocks, up to SEGLISTS_SCAN_MAX of its blocks
+ * are checked before that. The returned block is the best fit for sizes
+ * below SEGLISTS_NEXACT, otherwise it's at most one range width,
+ * 1/SEGLISTS_NSUB of the power of two, away from it.
+ *
+ * The rest of the list is searched only if there's no bigger block at all.
+ */
+static int
+bucket_seglists_get_rm_block_bestfit(struct block_container *bc,
+	struct memory_block *m)
+{
+	struct block_container_seglists *c =
+		(struct block_container_seglists *)bc;
+
+	int ret = 0;
+
+	util_mutex_lock(&c->lock);
+
+	struct seglists_node *best = NULL;
+
+	unsigned cls = bucket_seglists_class(m->size_idx);
+	if (cls >= SEGLISTS_NEXACT - 1) {
+		best = bucket_seglists_list_bestfit(c, cls, m->size_idx,
+			SEGLISTS_SCAN_MAX);
+		cls++;
+	}
+
+	if (best == NULL) {
+		unsigned next = bucket_seglists_next_nonempty(c, cls);
+		if (next != SEGLISTS_NCLASSES)
+			best = c->lists[next];
+		else if (cls > SEGLISTS_NEXACT - 1)
+			best = bucket_seglists_list_bestfit(c, cls - 1,
+				m->size_idx, UINT32_MAX);
+	}
+
+	if (best == NULL) {
+		ret = ENOMEM;
+		goto out;
+	}
+
+	*m = best->m;
+	bucket_seglists_unlink(c, best);
+
+out:
+	util_mutex_unlock(&c->lock);
+
+	return ret;
+}
+
+/*
+ * bucket_seglists_get_rm_block_exact -- (internal) removes exact match memory
+ *	block
+ */
+static int
+bucket_seglists_get_rm_block_exact(struct block_container *bc,
+	struct memory_block m)
+{
+	struct block_container_seglists *c =
+		(struct block_container_seglists *)bc;
+
+	int ret = 0;
+
+	util_mutex_lock(&c->lock);
+
+	struct seglists_node *n = bucket_seglists_find(c, m);
+	if (n == NULL)
+		ret = ENOMEM;
+	else
+		bucket_seglists_unlink(c, n);
+
+	util_mutex_unlock(&c->lock);
+
+	return ret;
+}
+
+/*
+ * bucket_seglists_get_block_exact -- (internal) finds exact match memory block
+ */
+static int
+bucket_seglists_get_block_exact(struct block_container *bc,
+	struct memory_block m)
+{
+	struct block_container_seglists *c =
+		(struct block_container_seglists *)bc;
+
+	util_mutex_lock(&c->lock);
+
+	int ret = bucket_seglists_find(c, m) != NULL ? 0 : ENOMEM;
+
+	util_mutex_unlock(&c->lock);
+
+	return ret;
+}
+
+/*
+ * bucket_seglists_is_empty -- (internal) checks whether the bucket is empty
+ */
+static int
+bucket_seglists_is_empty(struct block_container *bc)
+{
+	struct block_container_seglists *c =
+		(struct block_container_seglists *)bc;
+
+	util_mutex_lock(&c->lock);
+
+	int ret = bucket_seglists_next_nonempty(c, 0) == SEGLISTS_NCLASSES;
+
+	util_mutex_unlock(&c->lock);
+
+	return ret;
+}
+
+/*
+ * bucket_seglists_get_largest -- (internal) returns the size index of the
+ *	biggest memory block, 0 if the container is empty
+ *
+ * Only the highest non-empty list has to be searched. This is used for the
+ * statistics only, so the size is not kept up to date on every change.
+ */
+static uint32_t
+bucket_seglists_get_largest(struct block_container *bc)
+{
+	struct block_container_seglists *c =
+		(struct block_container_seglists *)bc;
+
+	uint32_t ret = 0;
+
+	util_mutex_lock(&c->lock);
+
+	unsigned w = SEGLISTS_NWORDS;
+	while (w > 0 && c->nonempty[w - 1] == 0)
+		--w;
+
+	if (w != 0) {
+		unsigned cls = (w - 1) * 64 + 63 -
+			(unsigned)__builtin_clzll(c->nonempty[w - 1]);
+		for (struct seglists_node *n = c->lists[cls]; n != NULL;
+				n = n->next) {
+			if (n->m.size_idx > ret)
+				ret = n->m.size_idx;
+		}
+	}
+
+	util_mutex_unlock(&c->lock);
+
+	return ret;
+}
+
+static struct block_container_ops container_seglists_ops = {
+	.insert = bucket_seglists_insert_block,
+	.get_rm_exact = bucket_seglists_get_rm_block_exact,
+	.get_rm_bestfit = bucket_seglists_get_rm_block_bestfit,
+	.get_exact = bucket_seglists_get_block_exact,
+	.is_empty = bucket_seglists_is_empty,
+	.get_largest = bucket_seglists_get_largest
+};
+
+/*
+ * bucket_seglists_create -- (internal) creates a new segregated lists
+ *	container
+ */
+static struct block_container *
+bucket_seglists_create(size_t unit_size)
+{
+	COMPILE_ERROR_ON(MAX_CHUNK > UINT16_MAX);
+
+	struct block_container_seglists *bc = Malloc(sizeof (*bc));
+	if (bc == NULL)
+		return NULL;
+
+	memset(bc, 0, sizeof (*bc));
+
+	bc->super.type = CONTAINER_SEGLISTS;
+	bc->super.unit_size = unit_size;
+
+	util_mutex_init(&bc->lock, NULL);
+
+	return &bc->super;
+}
+
+/*
+ * bucket_seglists_delete -- (internal) deletes a segregated lists container
+ */
+static void
+bucket_seglists_delete(struct block_container *bc)
+{
+	struct block_container_seglists *c =
+		(struct block_container_seglists *)bc;
+
+	for (uint32_t i = 0; i < c->nzones; ++i)
+		Free(c->zones[i]);
+
+	Free(c->zones);
+
+	util_mutex_destroy(&c->lock);
+	Free(bc);
+}
+
 static struct {
 	struct block_container_ops *ops;
 	struct block_container *(*create)(size_t unit_size);
@@ -236,6 +710,8 @@ static struct {
 } block_containers[MAX_CONTAINER_TYPE] = {
 	{NULL, NULL, NULL},
 	{&container_ctree_ops, bucket_tree_create, bucket_tree_delete},
+	{&container_seglists_ops, bucket_seglists_create,
+		bucket_seglists_delete},
 };
 
 /*
@@ -330,6 +806,7 @@ bucket_new(uint8_t id, enum bucket_type type, enum block_container_type ctype,
 		goto error_bucket_malloc;
 
 	b->id = id;
+	b->user_defined = 0;
 	b->calc_units = bucket_calc_units;
 
 	b->container = block_containers[ctype].create(unit_size);
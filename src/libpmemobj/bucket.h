@@ -43,6 +43,7 @@
 enum block_container_type {
 	CONTAINER_UNKNOWN,
 	CONTAINER_CTREE,
+	CONTAINER_SEGLISTS,
 
 	MAX_CONTAINER_TYPE
 };
@@ -60,6 +61,7 @@ struct block_container_ops {
 		struct memory_block *m);
 	int (*get_exact)(struct block_container *c, struct memory_block m);
 	int (*is_empty)(struct block_container *c);
+	uint32_t (*get_largest)(struct block_container *c);
 };
 
 #define	CNT_OP(_b, _op, ...)\
@@ -86,6 +88,12 @@ struct bucket {
 	 */
 	size_t unit_size;
 
+	/*
+	 * Set for the allocation classes created at runtime, their blocks
+	 * are not necessarily cache line aligned.
+	 */
+	int user_defined;
+
 	uint32_t (*calc_units)(struct bucket *b, size_t size);
 
 	pthread_mutex_t lock;
@@ -35,6 +35,7 @@
  */
 
 #include <errno.h>
+#include <stdlib.h>
 #include <sys/queue.h>
 #include <unistd.h>
 
@@ -62,6 +63,13 @@
 
 #define	NCACHES_PER_CPU	2
 
+/*
+ * Number of threads that populate the zones in background, 0 means that each
+ * zone is populated lazily, once the previous ones run out of free chunks.
+ */
+#define	HEAP_POPULATE_THREADS_VAR "PMEMOBJ_HEAP_POPULATE_THREADS"
+#define	HEAP_POPULATE_THREADS_MAX 64
+
 /*
  * Percentage of memory block units from a single run that can be migrated
  * from a cache bucket to auxiliary bucket in a single drain call.
@@ -74,8 +82,6 @@
  */
 #define	MAX_UNITS_PCT_DRAINED_TOTAL 2 /* 200% */
 
-#define	BIT_IS_CLR(a, i)	(!((a) & (1ULL << (i))))
-
 /*
  * The last size that is handled by runs.
  */
@@ -106,10 +112,44 @@ struct active_run {
 	SLIST_ENTRY(active_run) run;
 };
 
+enum zone_state {
+	ZONE_STATE_NONE,	/* volatile state not created yet */
+	ZONE_STATE_BUSY,	/* being populated */
+	ZONE_STATE_READY,	/* all free memory blocks are in the buckets */
+};
+
 struct bucket_cache {
 	struct bucket *buckets[MAX_BUCKETS]; /* no default bucket */
 };
 
+/*
+ * Statistics of an allocation class, updated atomically along with the
+ * persistent state of its runs.
+ */
+struct heap_class_stats {
+	uint64_t nruns;
+	uint64_t used_units;
+};
+
+/*
+ * State of the defragmentation, at most one run is evacuated at a time.
+ *
+ * Memory blocks of the evacuated run that are taken out of the buckets are
+ * withheld instead of being handed out, so that the relocated objects cannot
+ * land back in the run.
+ */
+struct heap_defrag {
+	pthread_mutex_t lock;
+	int active;
+	struct memory_block run; /* size_idx is the number of units */
+	struct memory_block *withheld;
+	unsigned nwithheld;
+
+	/* position of the scan for sparse runs */
+	uint32_t zone_id;
+	uint32_t chunk_id;
+};
+
 struct pmalloc_heap {
 	struct heap_layout *layout;
 	struct bucket *default_bucket;
@@ -117,15 +157,34 @@ struct pmalloc_heap {
 	/* runs are lazy-loaded, removed from this list on-demand */
 	SLIST_HEAD(arun, active_run) active_runs[MAX_BUCKETS];
 	pthread_mutex_t active_run_lock;
+	pthread_mutex_t class_lock; /* creation of allocation classes */
 	uint8_t *bucket_map;
 	pthread_mutex_t run_locks[MAX_RUN_LOCKS];
 	unsigned max_zone;
-	unsigned zones_exhausted;
+	unsigned zones_exhausted; /* first zone that might not be claimed */
+	unsigned zones_ready;
+	uint8_t *zone_state;
+	/* bitmaps of the runs claimed before their zone got populated */
+	uint64_t **cold_runs;
+	pthread_mutex_t zone_lock;
+	pthread_cond_t zone_cond;
+
+	pthread_t *populate_threads;
+	unsigned npopulate_threads;
+	int populate_stop;
 	size_t last_run_max_size;
 
 	struct bucket_cache *caches;
 	unsigned ncaches;
 	uint32_t last_drained[MAX_BUCKETS];
+
+	/* statistics, the free chunks are whatever is left of the total */
+	uint64_t chunks_total;
+	uint64_t chunks_huge; /* used by the huge allocations */
+	uint64_t chunks_run;
+	struct heap_class_stats class_stats[MAX_BUCKETS];
+
+	struct heap_defrag defrag;
 };
 
 /*
@@ -215,7 +274,7 @@ heap_chunk_write_footer(PMEMobjpool *pop, struct chunk_header *hdr,
 	f.type = CHUNK_TYPE_FOOTER;
 	f.size_idx = size_idx;
 	*(hdr + size_idx - 1) = f;
-	/* no need to persist, footers are recreated in heap_populate_buckets */
+	/* no need to persist, footers are recreated in heap_zone_populate */
 	VALGRIND_SET_CLEAN(hdr + size_idx - 1, sizeof (f));
 }
 
@@ -272,7 +331,6 @@ heap_init_run(PMEMobjpool *pop, struct bucket *b, struct chunk_header *hdr,
 	/* add/remove chunk_run and chunk_header to valgrind transaction */
 	VALGRIND_ADD_TO_TX(run, sizeof (*run));
 	run->block_size = b->unit_size;
-	pop->persist(pop, &run->block_size, sizeof (run->block_size));
 
 	ASSERT(hdr->type == CHUNK_TYPE_FREE);
 
@@ -286,7 +344,12 @@ heap_init_run(PMEMobjpool *pop, struct bucket *b, struct chunk_header *hdr,
 	run->bitmap[nval - 1] = r->bitmap_lastval;
 	VALGRIND_REMOVE_FROM_TX(run, sizeof (*run));
 
-	pop->persist(pop, run->bitmap, sizeof (run->bitmap));
+	/* block size and bitmap only have to be persistent before the header */
+	struct pmem_vec vec[2] = {
+		{ .addr = &run->block_size, .len = sizeof (run->block_size) },
+		{ .addr = run->bitmap, .len = sizeof (run->bitmap) },
+	};
+	pop->persistv(pop, vec, 2);
 
 	VALGRIND_ADD_TO_TX(hdr, sizeof (*hdr));
 	hdr->type = CHUNK_TYPE_RUN;
@@ -334,8 +397,23 @@ heap_get_run_lock(PMEMobjpool *pop, uint32_t chunk_id)
 	return &pop->heap->run_locks[chunk_id % MAX_RUN_LOCKS];
 }
 
+/*
+ * heap_bits_below -- (internal) returns a mask of n least significant bits
+ */
+static inline uint64_t
+heap_bits_below(unsigned n)
+{
+	ASSERT(n <= BITS_PER_VALUE);
+
+	return n == 0 ? 0 : (~(uint64_t)0 >> (BITS_PER_VALUE - n));
+}
+
 /*
  * heap_process_run_metadata -- (internal) parses the run bitmap
+ *
+ * Each bitmap value is processed as a whole, the stretches of free units are
+ * located with count trailing zeros on the value and on its negation instead
+ * of testing the bits one by one.
  */
 static void
 heap_process_run_metadata(PMEMobjpool *pop, struct bucket *b,
@@ -350,12 +428,18 @@ heap_process_run_metadata(PMEMobjpool *pop, struct bucket *b,
 	uint16_t run_bits = (uint16_t)(RUNSIZE / run->block_size);
 	ASSERT(run_bits < (MAX_BITMAP_VALUES * BITS_PER_VALUE));
 	uint16_t block_off = 0;
-	uint16_t block_size_idx = 0;
 
 	for (unsigned i = 0; i < r->bitmap_nval; ++i) {
 		uint64_t v = run->bitmap[i];
 		ASSERT(BITS_PER_VALUE * i <= UINT16_MAX);
 		block_off = (uint16_t)(BITS_PER_VALUE * i);
+
+		/* units past the end of the run are never free */
+		if (block_off >= run_bits)
+			break;
+		else if (block_off + BITS_PER_VALUE > run_bits)
+			v |= ~heap_bits_below(run_bits - block_off);
+
 		if (v == 0) {
 			heap_run_insert(pop, b, chunk_id, zone_id,
 				BITS_PER_VALUE, block_off);
@@ -364,31 +448,18 @@ heap_process_run_metadata(PMEMobjpool *pop, struct bucket *b,
 			continue;
 		}
 
-		for (unsigned j = 0; j < BITS_PER_VALUE; ++j) {
-			if (BIT_IS_CLR(v, j)) {
-				block_size_idx++;
-			} else if (block_size_idx != 0) {
-				ASSERT(block_off >= block_size_idx);
-
-				heap_run_insert(pop, b, chunk_id, zone_id,
-					block_size_idx,
-					(uint16_t)(block_off - block_size_idx));
-				block_size_idx = 0;
-			}
-
-			if ((block_off++) == run_bits) {
-				i = MAX_BITMAP_VALUES;
-				break;
-			}
-		}
+		uint64_t free = ~v;
+		while (free != 0) {
+			unsigned start = (unsigned)__builtin_ctzll(free);
+			/* v != 0, so the shifted value can't be all ones */
+			unsigned len = (unsigned)__builtin_ctzll(
+				~(free >> start));
+			ASSERT(start + len <= BITS_PER_VALUE);
 
-		if (block_size_idx != 0) {
-			ASSERT(block_off >= block_size_idx);
+			heap_run_insert(pop, b, chunk_id, zone_id, len,
+				(uint16_t)(block_off + start));
 
-			heap_run_insert(pop, b, chunk_id, zone_id,
-					block_size_idx,
-					(uint16_t)(block_off - block_size_idx));
-			block_size_idx = 0;
+			free &= ~heap_bits_below(start + len);
 		}
 	}
 }
@@ -424,6 +495,10 @@ heap_create_run(PMEMobjpool *pop, struct bucket *b,
 	VALGRIND_DO_MAKE_MEM_UNDEFINED(pop, run, sizeof (*run));
 	heap_set_run_bucket(run, b);
 	heap_init_run(pop, b, hdr, run);
+
+	__sync_fetch_and_add(&h->chunks_run, 1);
+	__sync_fetch_and_add(&h->class_stats[b->id].nruns, 1);
+
 	heap_process_run_metadata(pop, b, run, chunk_id, zone_id);
 }
 
@@ -468,11 +543,140 @@ out:
 static int
 heap_run_is_empty(struct chunk_run *run)
 {
+	/* branchless reduction, easily vectorized by the compiler */
+	uint64_t used = ~(uint64_t)0;
 	for (int i = 0; i < MAX_BITMAP_VALUES; ++i)
-		if (run->bitmap[i] != ~(uint64_t)0)
-			return 0;
+		used &= run->bitmap[i];
 
-	return 1;
+	return used == ~(uint64_t)0;
+}
+
+/*
+ * heap_run_is_free -- (internal) checks whether none of the units of the run
+ *	is allocated
+ */
+static int
+heap_run_is_free(struct bucket_run *r, struct chunk_run *run)
+{
+	unsigned i;
+	unsigned nval = r->bitmap_nval;
+	uint64_t used = 0;
+	for (i = 0; nval > 0 && i < nval - 1; ++i)
+		used |= run->bitmap[i];
+
+	return used == 0 && run->bitmap[i] == r->bitmap_lastval;
+}
+
+/*
+ * heap_find_first_free_bucket_slot -- (internal) searches for the first
+ *	available bucket slot
+ */
+static uint8_t
+heap_find_first_free_bucket_slot(struct pmalloc_heap *h)
+{
+	uint8_t n;
+	for (n = 0; n < MAX_BUCKETS; ++n)
+		if (h->buckets[n] == NULL)
+			return n;
+
+	return MAX_BUCKETS;
+}
+
+/*
+ * heap_create_alloc_class_buckets -- (internal) allocates both auxiliary and
+ *	cache bucket instances of the specified type
+ *
+ * The auxiliary bucket is published last, once the allocation class is
+ * usable from every lane.
+ */
+static uint8_t
+heap_create_alloc_class_buckets(struct pmalloc_heap *h,
+	size_t unit_size, unsigned int unit_max, int user_defined)
+{
+	uint8_t slot = heap_find_first_free_bucket_slot(h);
+	if (slot == MAX_BUCKETS)
+		goto out;
+
+	struct bucket *b = bucket_new(slot, BUCKET_RUN, CONTAINER_CTREE,
+			unit_size, unit_max);
+
+	if (b == NULL)
+		goto error_bucket_new;
+
+	b->user_defined = user_defined;
+
+	int i;
+	for (i = 0; i < (int)h->ncaches; ++i) {
+		h->caches[i].buckets[slot] =
+			bucket_new(slot, BUCKET_RUN, CONTAINER_CTREE,
+				unit_size, unit_max);
+		if (h->caches[i].buckets[slot] == NULL)
+			goto error_cache_bucket_new;
+
+		h->caches[i].buckets[slot]->user_defined = user_defined;
+	}
+
+	__sync_synchronize();
+	h->buckets[slot] = b;
+
+out:
+	return slot;
+
+error_cache_bucket_new:
+	bucket_delete(b);
+
+	for (i -= 1; i >= 0; --i) {
+		bucket_delete(h->caches[i].buckets[slot]);
+		h->caches[i].buckets[slot] = NULL;
+	}
+
+error_bucket_new:
+	return MAX_BUCKETS;
+}
+
+/*
+ * heap_find_alloc_class -- (internal) searches for the allocation class with
+ *	exactly the given unit size
+ */
+static uint8_t
+heap_find_alloc_class(struct pmalloc_heap *h, size_t unit_size)
+{
+	for (uint8_t i = 0; i < MAX_BUCKETS; ++i) {
+		if (h->buckets[i] != NULL &&
+			h->buckets[i]->unit_size == unit_size)
+			return i;
+	}
+
+	return MAX_BUCKETS;
+}
+
+/*
+ * heap_get_run_class -- (internal) returns the allocation class of runs with
+ *	the given block size, creates one if it doesn't exist
+ *
+ * Runs of the classes registered at runtime outlive the registration, on
+ * the next open their block size doesn't have to match any of the classes.
+ * The class created for them here takes the next free id, so the ids of
+ * the registered classes are not stable across opens, which is documented
+ * in pmemobj_alloc_class_register(3).
+ */
+static uint8_t
+heap_get_run_class(struct pmalloc_heap *h, size_t block_size)
+{
+	uint8_t id = SIZE_TO_BID(h, block_size);
+	if (h->buckets[id]->unit_size == block_size)
+		return id;
+
+	util_mutex_lock(&h->class_lock);
+
+	id = heap_find_alloc_class(h, block_size);
+	if (id == MAX_BUCKETS)
+		id = heap_create_alloc_class_buckets(h, block_size,
+			RUN_UNIT_MAX, 1);
+
+	util_mutex_unlock(&h->class_lock);
+
+	return id;
 }
 
 /*
@@ -480,7 +684,7 @@ heap_run_is_empty(struct chunk_run *run)
  */
 static void
 heap_register_active_run(struct pmalloc_heap *h, struct chunk_run *run,
-	uint32_t chunk_id, uint32_t zone_id)
+	uint8_t bucket_idx, uint32_t chunk_id, uint32_t zone_id)
 {
 	/* reset the volatile state of the run */
 	run->bucket_vptr = 0;
@@ -498,24 +702,56 @@ heap_register_active_run(struct pmalloc_heap *h, struct chunk_run *run,
 	arun->chunk_id = chunk_id;
 	arun->zone_id = zone_id;
 
-	int bucket_idx = SIZE_TO_BID(h, run->block_size);
+	util_mutex_lock(&h->active_run_lock);
 	SLIST_INSERT_HEAD(&h->active_runs[bucket_idx], arun, run);
+	util_mutex_unlock(&h->active_run_lock);
 }
 
 /*
- * heap_populate_buckets -- (internal) creates volatile state of memory blocks
+ * heap_stats_add_run -- (internal) accounts a run found in the heap layout
  */
-static int
-heap_populate_buckets(PMEMobjpool *pop)
+static void
+heap_stats_add_run(struct pmalloc_heap *h, struct chunk_run *run,
+	uint8_t bucket_idx)
 {
-	struct pmalloc_heap *h = pop->heap;
+	struct bucket_run *r = (struct bucket_run *)h->buckets[bucket_idx];
 
-	if (h->zones_exhausted == h->max_zone)
-		return ENOMEM;
+	/* the bits past the end of the run are always set */
+	int used = -__builtin_popcountll(r->bitmap_lastval);
+	for (unsigned i = 0; i < r->bitmap_nval; ++i)
+		used += __builtin_popcountll(run->bitmap[i]);
+
+	ASSERT(used >= 0);
+
+	__sync_fetch_and_add(&h->chunks_run, 1);
+	__sync_fetch_and_add(&h->class_stats[bucket_idx].nruns, 1);
+	__sync_fetch_and_add(&h->class_stats[bucket_idx].used_units,
+		(uint64_t)used);
+}
 
-	uint32_t zone_id = h->zones_exhausted++;
+/*
+ * heap_zone_is_ready -- (internal) checks without the zone lock whether all of
+ *	the free memory blocks of the zone are in the buckets
+ */
+static inline int
+heap_zone_is_ready(struct pmalloc_heap *h, uint32_t zone_id)
+{
+	return __atomic_load_n(&h->zone_state[zone_id], __ATOMIC_ACQUIRE) ==
+		ZONE_STATE_READY;
+}
+
+/*
+ * heap_zone_populate -- (internal) creates volatile state of memory blocks
+ *	of a zone claimed by the calling thread
+ */
+static void
+heap_zone_populate(PMEMobjpool *pop, uint32_t zone_id)
+{
+	struct pmalloc_heap *h = pop->heap;
 	struct zone *z = &h->layout->zones[zone_id];
 
+	ASSERTeq(h->zone_state[zone_id], ZONE_STATE_BUSY);
+
 	/* ignore zone and chunk headers */
 	VALGRIND_ADD_TO_GLOBAL_TX_IGNORE(z, sizeof (z->header) +
 		sizeof (z->chunk_headers));
@@ -525,35 +761,266 @@ heap_populate_buckets(PMEMobjpool *pop)
 
 	struct bucket *def_bucket = h->default_bucket;
 
+	/* no more runs can be claimed once the zone is busy */
+	uint64_t *cold = h->cold_runs[zone_id];
+
 	struct chunk_run *run = NULL;
+	uint8_t bucket_idx;
 	struct memory_block m = {0, zone_id, 0, 0};
 	for (uint32_t i = 0; i < z->header.size_idx; ) {
 		struct chunk_header *hdr = &z->chunk_headers[i];
 		ASSERT(hdr->size_idx != 0);
 		heap_chunk_write_footer(pop, hdr, hdr->size_idx);
 
+		/*
+		 * Once inserted, the chunk can be split by a concurrent
+		 * allocation, so its header must not be read afterwards.
+		 */
+		uint32_t size_idx = hdr->size_idx;
+
 		switch (hdr->type) {
 			case CHUNK_TYPE_RUN:
 				run = (struct chunk_run *)&z->chunks[i];
-				heap_register_active_run(h, run, i, zone_id);
+				bucket_idx = heap_get_run_class(h,
+					run->block_size);
+				if (bucket_idx == MAX_BUCKETS) {
+					ERR("no allocation class for runs of "
+						"%ju byte blocks",
+						run->block_size);
+					break;
+				}
+
+				/* claimed by heap_claim_cold_run */
+				if (cold != NULL && (cold[i / BITS_PER_VALUE] >>
+						(i % BITS_PER_VALUE)) & 1)
+					break;
+
+				heap_stats_add_run(h, run, bucket_idx);
+				heap_register_active_run(h, run, bucket_idx,
+					i, zone_id);
 				break;
 			case CHUNK_TYPE_FREE:
 				m.chunk_id = i;
-				m.size_idx = hdr->size_idx;
+				m.size_idx = size_idx;
 				CNT_OP(def_bucket, insert, pop, m);
 				break;
 			case CHUNK_TYPE_USED:
+				__sync_fetch_and_add(&h->chunks_huge,
+					size_idx);
 				break;
 			default:
 				ASSERT(0);
 		}
 
-		i += hdr->size_idx;
+		i += size_idx;
+	}
+
+	h->cold_runs[zone_id] = NULL;
+	Free(cold);
+
+	util_mutex_lock(&h->zone_lock);
+	/* pairs with the lock-free check in heap_ensure_zone_ready */
+	__atomic_store_n(&h->zone_state[zone_id], ZONE_STATE_READY,
+		__ATOMIC_RELEASE);
+	h->zones_ready++;
+	util_cond_broadcast(&h->zone_cond);
+	util_mutex_unlock(&h->zone_lock);
+}
+
+/*
+ * heap_zone_claim_next -- (internal) claims the first zone that no one has
+ *	started to populate, returns max_zone if there's none left
+ *
+ * Must be called with the zone lock held.
+ */
+static unsigned
+heap_zone_claim_next(struct pmalloc_heap *h)
+{
+	while (h->zones_exhausted < h->max_zone) {
+		unsigned zone_id = h->zones_exhausted++;
+		if (h->zone_state[zone_id] == ZONE_STATE_NONE) {
+			h->zone_state[zone_id] = ZONE_STATE_BUSY;
+			return zone_id;
+		}
+	}
+
+	return h->max_zone;
+}
+
+/*
+ * heap_populate_buckets -- (internal) creates volatile state of the next zone
+ *
+ * If all of the zones are already claimed, but some of them are still being
+ * populated by other threads, waits for one of them to finish instead.
+ */
+static int
+heap_populate_buckets(PMEMobjpool *pop)
+{
+	struct pmalloc_heap *h = pop->heap;
+
+	util_mutex_lock(&h->zone_lock);
+
+	unsigned zone_id = heap_zone_claim_next(h);
+	if (zone_id == h->max_zone) {
+		int ret = 0;
+		if (h->zones_ready == h->max_zone) {
+			ret = ENOMEM;
+		} else {
+			unsigned ready = h->zones_ready;
+			while (h->zones_ready == ready)
+				util_cond_wait(&h->zone_cond, &h->zone_lock);
+		}
+
+		util_mutex_unlock(&h->zone_lock);
+
+		return ret;
 	}
 
+	util_mutex_unlock(&h->zone_lock);
+
+	heap_zone_populate(pop, zone_id);
+
 	return 0;
 }
 
+/*
+ * heap_ensure_zone_ready -- (internal) makes sure that the volatile state of
+ *	the zone exists, populates the zone right away if no one did that yet
+ */
+static void
+heap_ensure_zone_ready(PMEMobjpool *pop, uint32_t zone_id)
+{
+	struct pmalloc_heap *h = pop->heap;
+
+	if (heap_zone_is_ready(h, zone_id))
+		return;
+
+	util_mutex_lock(&h->zone_lock);
+
+	if (h->zone_state[zone_id] == ZONE_STATE_NONE) {
+		h->zone_state[zone_id] = ZONE_STATE_BUSY;
+		util_mutex_unlock(&h->zone_lock);
+
+		heap_zone_populate(pop, zone_id);
+
+		return;
+	}
+
+	while (h->zone_state[zone_id] != ZONE_STATE_READY)
+		util_cond_wait(&h->zone_cond, &h->zone_lock);
+
+	util_mutex_unlock(&h->zone_lock);
+}
+
+/*
+ * heap_populate_wait -- waits until the volatile state of all zones exists,
+ *	populates the zones no one claimed yet in the calling thread
+ */
+void
+heap_populate_wait(PMEMobjpool *pop)
+{
+	for (uint32_t i = 0; i < pop->heap->max_zone; ++i)
+		heap_ensure_zone_ready(pop, i);
+}
+
+/*
+ * heap_populate_worker -- (internal) background zone population thread
+ */
+static void *
+heap_populate_worker(void *arg)
+{
+	PMEMobjpool *pop = arg;
+	struct pmalloc_heap *h = pop->heap;
+
+	for (;;) {
+		util_mutex_lock(&h->zone_lock);
+		unsigned zone_id = h->populate_stop ?
+			h->max_zone : heap_zone_claim_next(h);
+		util_mutex_unlock(&h->zone_lock);
+
+		if (zone_id == h->max_zone)
+			break;
+
+		heap_zone_populate(pop, zone_id);
+	}
+
+	return NULL;
+}
+
+/*
+ * heap_populate_start -- starts the background population of zones if
+ *	requested by the user
+ *
+ * Called once all of the lane sections are recovered, so that the zones are
+ * not populated while the allocator redo logs are still being applied.
+ */
+void
+heap_populate_start(PMEMobjpool *pop)
+{
+	struct pmalloc_heap *h = pop->heap;
+
+	char *env = getenv(HEAP_POPULATE_THREADS_VAR);
+	if (env == NULL)
+		return;
+
+	long nthreads = atol(env);
+	if (nthreads <= 0)
+		return;
+
+	if (nthreads > HEAP_POPULATE_THREADS_MAX)
+		nthreads = HEAP_POPULATE_THREADS_MAX;
+
+	/* no point in having more threads than there are zones to populate */
+	if ((unsigned long)nthreads > h->max_zone - h->zones_ready)
+		nthreads = h->max_zone - h->zones_ready;
+
+	if (nthreads == 0)
+		return;
+
+	h->populate_threads = Malloc(sizeof (pthread_t) * (size_t)nthreads);
+	if (h->populate_threads == NULL) {
+		LOG(2, "!Malloc, zones will be populated on demand");
+		return;
+	}
+
+	for (long i = 0; i < nthreads; ++i) {
+		int err = pthread_create(&h->populate_threads[i], NULL,
+			heap_populate_worker, pop);
+		if (err) {
+			errno = err;
+			LOG(2, "!pthread_create");
+			break;
+		}
+
+		h->npopulate_threads++;
+	}
+
+	LOG(3, "populating zones using %u threads", h->npopulate_threads);
+}
+
+/*
+ * heap_populate_stop -- (internal) stops and joins the zone population threads
+ */
+static void
+heap_populate_stop(PMEMobjpool *pop)
+{
+	struct pmalloc_heap *h = pop->heap;
+
+	util_mutex_lock(&h->zone_lock);
+	h->populate_stop = 1;
+	util_mutex_unlock(&h->zone_lock);
+
+	for (unsigned i = 0; i < h->npopulate_threads; ++i) {
+		int err = pthread_join(h->populate_threads[i], NULL);
+		if (err) {
+			errno = err;
+			ERR("!pthread_join");
+		}
+	}
+
+	Free(h->populate_threads);
+}
+
 /*
  * heap_get_active_run -- (internal) searches for an existing, unused, run
  */
@@ -637,23 +1104,85 @@ heap_get_cache_bucket(struct pmalloc_heap *heap, int bucket_id)
 }
 
 /*
- * heap_get_best_bucket -- returns the bucket that best fits the requested size
+ * heap_get_slot_bucket -- (internal) returns the bucket of an allocation class
+ *	to be used by the calling thread
  */
-struct bucket *
-heap_get_best_bucket(PMEMobjpool *pop, size_t size)
+static struct bucket *
+heap_get_slot_bucket(struct pmalloc_heap *heap, uint8_t slot)
 {
-	if (size <= pop->heap->last_run_max_size) {
 #ifdef USE_PER_LANE_BUCKETS
-		return heap_get_cache_bucket(pop->heap,
-			SIZE_TO_BID(pop->heap, size));
+	return heap_get_cache_bucket(heap, slot);
 #else
-		return pop->heap->buckets[SIZE_TO_BID(pop->heap, size)];
+	return heap->buckets[slot];
 #endif
-	} else {
+}
+
+/*
+ * heap_get_best_bucket -- returns the bucket that best fits the requested size
+ */
+struct bucket *
+heap_get_best_bucket(PMEMobjpool *pop, size_t size)
+{
+	if (size <= pop->heap->last_run_max_size) {
+		return heap_get_slot_bucket(pop->heap,
+			SIZE_TO_BID(pop->heap, size));
+	} else {
 		return pop->heap->default_bucket;
 	}
 }
 
+/*
+ * heap_get_class_bucket -- returns the bucket of the allocation class with
+ *	the given id, or NULL if there's no such class
+ */
+struct bucket *
+heap_get_class_bucket(PMEMobjpool *pop, uint8_t class_id)
+{
+	if (class_id == 0)
+		return NULL;
+
+	uint8_t slot = (uint8_t)(class_id - 1);
+	if (slot >= MAX_BUCKETS || pop->heap->buckets[slot] == NULL)
+		return NULL;
+
+	return heap_get_slot_bucket(pop->heap, slot);
+}
+
+/*
+ * heap_alloc_class_register -- creates an allocation class with the given
+ *	unit size, or finds an existing one
+ *
+ * Runs always span a single chunk, units_per_run is the minimum number of
+ * units that must fit into one.
+ */
+int
+heap_alloc_class_register(PMEMobjpool *pop, size_t unit_size,
+	unsigned units_per_run, uint8_t *class_id)
+{
+	struct pmalloc_heap *h = pop->heap;
+
+	if (unit_size == 0 || unit_size > MAX_RUN_SIZE ||
+		RUN_NALLOCS(unit_size) > RUN_BITMAP_SIZE ||
+		units_per_run > RUN_NALLOCS(unit_size))
+		return EINVAL;
+
+	util_mutex_lock(&h->class_lock);
+
+	uint8_t slot = heap_find_alloc_class(h, unit_size);
+	if (slot == MAX_BUCKETS)
+		slot = heap_create_alloc_class_buckets(h, unit_size,
+			RUN_UNIT_MAX, 1);
+
+	util_mutex_unlock(&h->class_lock);
+
+	if (slot == MAX_BUCKETS)
+		return ENOMEM;
+
+	*class_id = (uint8_t)(slot + 1);
+
+	return 0;
+}
+
 /*
  * heap_get_run_bucket -- (internal) returns run bucket
  */
@@ -676,7 +1205,11 @@ static struct bucket *
 heap_assign_run_bucket(PMEMobjpool *pop, struct chunk_run *run,
 	uint32_t chunk_id, uint32_t zone_id)
 {
-	struct bucket *b = heap_get_best_bucket(pop, run->block_size);
+	uint8_t slot = heap_get_run_class(pop->heap, run->block_size);
+	if (slot == MAX_BUCKETS)
+		return NULL;
+
+	struct bucket *b = heap_get_slot_bucket(pop->heap, slot);
 
 	heap_reuse_run(pop, b, chunk_id, zone_id);
 
@@ -684,23 +1217,91 @@ heap_assign_run_bucket(PMEMobjpool *pop, struct chunk_run *run,
 	return heap_get_run_bucket(run);
 }
 
+/*
+ * heap_claim_cold_run -- (internal) takes over a single run of a zone that no
+ *	one started to populate yet
+ *
+ * The run is marked in the bitmap of the zone, so that the population of the
+ * zone later on neither resets its bucket nor accounts it for the second time.
+ * Returns 0 if the zone is already being populated, or on failure to allocate
+ * the bitmap, in which case the caller has to wait for the whole zone.
+ */
+static int
+heap_claim_cold_run(PMEMobjpool *pop, uint32_t chunk_id, uint32_t zone_id)
+{
+	struct pmalloc_heap *h = pop->heap;
+	struct zone *z = &h->layout->zones[zone_id];
+	struct chunk_run *run = (struct chunk_run *)&z->chunks[chunk_id];
+	uint64_t bit = (uint64_t)1 << (chunk_id % BITS_PER_VALUE);
+	uint64_t *cold;
+	uint8_t bucket_idx;
+	int ret = 0;
+
+	util_mutex_lock(&h->zone_lock);
+
+	if (h->zone_state[zone_id] != ZONE_STATE_NONE)
+		goto out;
+
+	if ((cold = h->cold_runs[zone_id]) == NULL) {
+		size_t size = sizeof (uint64_t) *
+			((MAX_CHUNK + BITS_PER_VALUE - 1) / BITS_PER_VALUE);
+		if ((cold = Malloc(size)) == NULL)
+			goto out;
+
+		memset(cold, 0, size);
+
+		h->cold_runs[zone_id] = cold;
+	}
+
+	if ((cold[chunk_id / BITS_PER_VALUE] & bit) == 0) {
+		bucket_idx = heap_get_run_class(h, run->block_size);
+		if (bucket_idx == MAX_BUCKETS) {
+			ERR("no allocation class for runs of %ju byte blocks",
+				run->block_size);
+			goto out;
+		}
+
+		cold[chunk_id / BITS_PER_VALUE] |= bit;
+
+		/* the bucket pointer comes from the previous use of the pool */
+		run->bucket_vptr = 0;
+		VALGRIND_SET_CLEAN(&run->bucket_vptr,
+			sizeof (run->bucket_vptr));
+
+		heap_stats_add_run(h, run, bucket_idx);
+	}
+
+	ret = 1;
+
+out:
+	util_mutex_unlock(&h->zone_lock);
+
+	return ret;
+}
+
 /*
  * heap_get_chunk_bucket -- returns the bucket that fits to chunk's unit size
+ *
+ * A memory block freed in a zone which is not populated yet doesn't require
+ * the entire zone, only the run the block belongs to is processed. Huge
+ * chunks are coalesced with their neighbours, so those still have to wait for
+ * the free chunks of the zone to be in the default bucket.
  */
 struct bucket *
 heap_get_chunk_bucket(PMEMobjpool *pop, uint32_t chunk_id, uint32_t zone_id)
 {
 	ASSERT(zone_id < pop->heap->max_zone);
 
-	/* This zone wasn't processed yet, so no associated bucket */
-	if (zone_id >= pop->heap->zones_exhausted)
-		return NULL;
-
 	struct zone *z = &pop->heap->layout->zones[zone_id];
 
 	ASSERT(chunk_id < z->header.size_idx);
 	struct chunk_header *hdr = &z->chunk_headers[chunk_id];
 
+	if (!heap_zone_is_ready(pop->heap, zone_id) &&
+		(hdr->type != CHUNK_TYPE_RUN ||
+		!heap_claim_cold_run(pop, chunk_id, zone_id)))
+		heap_ensure_zone_ready(pop, zone_id);
+
 	if (hdr->type == CHUNK_TYPE_RUN) {
 		struct chunk_run *run =
 			(struct chunk_run *)&z->chunks[chunk_id];
@@ -719,11 +1320,11 @@ heap_get_chunk_bucket(PMEMobjpool *pop, uint32_t chunk_id, uint32_t zone_id)
  * heap_get_auxiliary_bucket -- returns bucket common for all threads
  */
 struct bucket *
-heap_get_auxiliary_bucket(PMEMobjpool *pop, size_t size)
+heap_get_auxiliary_bucket(PMEMobjpool *pop, struct bucket *b)
 {
-	ASSERT(size <= pop->heap->last_run_max_size);
+	ASSERTeq(b->type, BUCKET_RUN);
 
-	return pop->heap->buckets[SIZE_TO_BID(pop->heap, size)];
+	return pop->heap->buckets[b->id];
 }
 
 /*
@@ -800,62 +1401,6 @@ heap_drain_to_auxiliary(PMEMobjpool *pop, struct bucket *auxb,
 	}
 }
 
-/*
- * heap_find_first_free_bucket_slot -- (internal) searches for the first
- *	available bucket slot
- */
-static uint8_t
-heap_find_first_free_bucket_slot(struct pmalloc_heap *h)
-{
-	uint8_t n;
-	for (n = 0; n < MAX_BUCKETS; ++n)
-		if (h->buckets[n] == NULL)
-			return n;
-
-	return MAX_BUCKETS;
-}
-
-/*
- * heap_create_alloc_class_buckets -- (internal) allocates both auxiliary and
- *	cache bucket instances of the specified type
- */
-static uint8_t
-heap_create_alloc_class_buckets(struct pmalloc_heap *h,
-	size_t unit_size, unsigned int unit_max)
-{
-	uint8_t slot = heap_find_first_free_bucket_slot(h);
-	if (slot == MAX_BUCKETS)
-		goto out;
-
-	h->buckets[slot] = bucket_new(slot, BUCKET_RUN, CONTAINER_CTREE,
-			unit_size, unit_max);
-
-	if (h->buckets[slot] == NULL)
-		goto error_bucket_new;
-
-	int i;
-	for (i = 0; i < (int)h->ncaches; ++i) {
-		h->caches[i].buckets[slot] =
-			bucket_new(slot, BUCKET_RUN, CONTAINER_CTREE,
-				unit_size, unit_max);
-		if (h->caches[i].buckets[slot] == NULL)
-			goto error_cache_bucket_new;
-	}
-
-out:
-	return slot;
-
-error_cache_bucket_new:
-	bucket_delete(h->buckets[slot]);
-
-	for (i -= 1; i >= 0; --i) {
-		bucket_delete(h->caches[i].buckets[slot]);
-	}
-
-error_bucket_new:
-	return MAX_BUCKETS;
-}
-
 /*
  * heap_register_bucket_range -- (internal) assigns given range of memory to the
  *	bucket allocation class
@@ -886,7 +1431,7 @@ heap_find_or_create_best_alloc_class(struct pmalloc_heap *h, size_t n)
 			return (uint8_t)i;
 	}
 
-	return heap_create_alloc_class_buckets(h, n, RUN_UNIT_MAX);
+	return heap_create_alloc_class_buckets(h, n, RUN_UNIT_MAX, 0);
 }
 
 /*
@@ -907,7 +1452,7 @@ heap_buckets_init(PMEMobjpool *pop)
 		goto error_bucket_map_malloc;
 
 	h->default_bucket = bucket_new(MAX_BUCKETS, BUCKET_HUGE,
-		CONTAINER_CTREE, CHUNKSIZE, UINT32_MAX);
+		CONTAINER_SEGLISTS, CHUNKSIZE, UINT32_MAX);
 	if (h->default_bucket == NULL)
 		goto error_default_bucket_new;
 
@@ -920,7 +1465,7 @@ heap_buckets_init(PMEMobjpool *pop)
 	 */
 	size_t size = 0;
 	uint8_t slot = heap_create_alloc_class_buckets(h,
-		MIN_RUN_SIZE, RUN_UNIT_MAX);
+		MIN_RUN_SIZE, RUN_UNIT_MAX, 0);
 	if (slot == MAX_BUCKETS)
 		goto error_bucket_create;
 
@@ -1007,6 +1552,34 @@ heap_recycle_block(PMEMobjpool *pop, struct bucket *b, struct memory_block *m,
 	m->size_idx = units;
 }
 
+/*
+ * heap_defrag_withhold -- (internal) keeps the memory block away from the
+ *	allocations if it belongs to the run being evacuated
+ */
+static int
+heap_defrag_withhold(PMEMobjpool *pop, struct bucket *b,
+	struct memory_block m)
+{
+	struct heap_defrag *d = &pop->heap->defrag;
+
+	if (!d->active || b->type != BUCKET_RUN ||
+		m.chunk_id != d->run.chunk_id || m.zone_id != d->run.zone_id)
+		return 0;
+
+	util_mutex_lock(&d->lock);
+
+	int withheld = d->active && m.chunk_id == d->run.chunk_id &&
+		m.zone_id == d->run.zone_id;
+	if (withheld) {
+		ASSERT(d->nwithheld < d->run.size_idx);
+		d->withheld[d->nwithheld++] = m;
+	}
+
+	util_mutex_unlock(&d->lock);
+
+	return withheld;
+}
+
 /*
  * heap_get_bestfit_block --
  *	extracts a memory block of equal size index
@@ -1017,11 +1590,17 @@ heap_get_bestfit_block(PMEMobjpool *pop, struct bucket *b,
 {
 	util_mutex_lock(&b->lock);
 
+	struct memory_block req = *m;
 	uint32_t units = m->size_idx;
 	int ret = 0;
 
-	while (CNT_OP(b, get_rm_bestfit, m) != 0) {
-		if ((ret = heap_ensure_bucket_filled(pop, b)) != 0) {
+	for (;;) {
+		if (CNT_OP(b, get_rm_bestfit, m) == 0) {
+			if (!heap_defrag_withhold(pop, b, *m))
+				break;
+
+			*m = req;
+		} else if ((ret = heap_ensure_bucket_filled(pop, b)) != 0) {
 			goto out;
 		}
 	}
@@ -1037,6 +1616,55 @@ out:
 	return ret;
 }
 
+/*
+ * heap_get_bestfit_blocks --
+ *	extracts up to nblocks single unit memory blocks under one bucket lock
+ *
+ * Returns the number of memory blocks stored in the blocks array.
+ */
+unsigned
+heap_get_bestfit_blocks(PMEMobjpool *pop, struct bucket *b,
+	struct memory_block *blocks, unsigned nblocks)
+{
+	ASSERTeq(b->type, BUCKET_RUN);
+
+	util_mutex_lock(&b->lock);
+
+	unsigned n = 0;
+	struct memory_block m;
+
+	while (n < nblocks) {
+		m = EMPTY_MEMORY_BLOCK;
+		m.size_idx = 1;
+
+		if (CNT_OP(b, get_rm_bestfit, &m) != 0) {
+			/* create a new run only if nothing was found so far */
+			if (n != 0 || heap_ensure_bucket_filled(pop, b) != 0)
+				break;
+
+			continue;
+		}
+
+		if (heap_defrag_withhold(pop, b, m))
+			continue;
+
+		if (m.size_idx > nblocks - n)
+			heap_recycle_block(pop, b, &m, nblocks - n);
+
+		for (uint32_t i = 0; i < m.size_idx; ++i) {
+			ASSERT(m.block_off + i <= UINT16_MAX);
+			blocks[n] = m;
+			blocks[n].size_idx = 1;
+			blocks[n].block_off = (uint16_t)(m.block_off + i);
+			n++;
+		}
+	}
+
+	util_mutex_unlock(&b->lock);
+
+	return n;
+}
+
 /*
  * heap_get_exact_block --
  *	extracts exactly this memory block and cuts it accordingly
@@ -1058,7 +1686,7 @@ heap_get_exact_block(PMEMobjpool *pop, struct bucket *b,
 out:
 	util_mutex_unlock(&b->lock);
 
-	return 0;
+	return ret;
 }
 
 /*
@@ -1161,11 +1789,7 @@ heap_block_is_allocated(PMEMobjpool *pop, struct memory_block m)
 	unsigned b_last = b + m.size_idx;
 	ASSERT(b_last <= BITS_PER_VALUE);
 
-	for (unsigned i = b; i < b_last; ++i)
-		if (!BIT_IS_CLR(bitmap, i))
-			return 1;
-
-	return 0;
+	return ((bitmap >> b) & heap_bits_below(m.size_idx)) != 0;
 }
 #endif /* DEBUG */
 
@@ -1183,26 +1807,40 @@ heap_run_get_block(PMEMobjpool *pop, struct bucket *rb, struct chunk_run *r,
 	ASSERTeq(rb->type, BUCKET_RUN);
 	struct bucket_run *run = (struct bucket_run *)rb;
 
+	uint64_t bitmap = r->bitmap[v];
+	unsigned unit_max = run->unit_max;
+
 	if (prev) {
-		unsigned i;
-		for (i = b;
-			i % run->unit_max && BIT_IS_CLR(r->bitmap[v], i - 1);
-			--i)
-			;
+		/* the memory block cannot span beyond its unit_max group */
+		unsigned lo = b - b % unit_max;
+		uint64_t used = (bitmap & heap_bits_below(b)) >> lo;
+		unsigned i = used == 0 ? lo :
+			lo + BITS_PER_VALUE - (unsigned)__builtin_clzll(used);
 
 		mblock->block_off = (uint16_t)(v * BITS_PER_VALUE + i);
 		ASSERT(block_off >= mblock->block_off);
 		mblock->size_idx = (uint16_t)(block_off - mblock->block_off);
 	} else { /* next */
-		unsigned i;
-		for (i = b + size_idx;
-			i % run->unit_max && BIT_IS_CLR(r->bitmap[v], i);
-			++i)
-			;
+		unsigned s = b + size_idx;
+		unsigned i = s;
+		/*
+		 * A block that ends at the last bit of the value has no
+		 * neighbour in it, and shifting by the full width is UB.
+		 */
+		if (s < BITS_PER_VALUE && s % unit_max != 0) {
+			unsigned hi = s - s % unit_max + unit_max;
+			if (hi > BITS_PER_VALUE)
+				hi = BITS_PER_VALUE;
+
+			uint64_t used = (bitmap >> s) &
+				heap_bits_below(hi - s);
+			i = used == 0 ? hi :
+				s + (unsigned)__builtin_ctzll(used);
+		}
 
 		ASSERT((uint64_t)block_off + size_idx <= UINT16_MAX);
 		mblock->block_off = (uint16_t)(block_off + size_idx);
-		mblock->size_idx = i - (b + size_idx);
+		mblock->size_idx = i - s;
 	}
 
 	if (mblock->size_idx == 0)
@@ -1296,6 +1934,56 @@ heap_unlock_if_run(PMEMobjpool *pop, struct memory_block m)
 	}
 }
 
+/*
+ * heap_lock_runs -- acquires the locks of the runs the memory blocks belong to
+ *
+ * Every lock is acquired only once and all of them are taken in the address
+ * order, which allows many threads to hold more than one run lock at a time.
+ * Returns the number of locks stored in the locks array.
+ */
+unsigned
+heap_lock_runs(PMEMobjpool *pop, struct memory_block *m, unsigned n,
+	pthread_mutex_t **locks)
+{
+	unsigned nlocks = 0;
+
+	for (unsigned i = 0; i < n; ++i) {
+		struct chunk_header *hdr = &pop->heap->layout->
+			zones[m[i].zone_id].chunk_headers[m[i].chunk_id];
+		if (hdr->type != CHUNK_TYPE_RUN)
+			continue;
+
+		pthread_mutex_t *lock = heap_get_run_lock(pop, m[i].chunk_id);
+
+		unsigned pos = 0;
+		while (pos < nlocks && locks[pos] < lock)
+			pos++;
+
+		if (pos < nlocks && locks[pos] == lock)
+			continue;
+
+		memmove(&locks[pos + 1], &locks[pos],
+			(nlocks - pos) * sizeof (locks[0]));
+		locks[pos] = lock;
+		nlocks++;
+	}
+
+	for (unsigned i = 0; i < nlocks; ++i)
+		util_mutex_lock(locks[i]);
+
+	return nlocks;
+}
+
+/*
+ * heap_unlock_runs -- releases the locks acquired by heap_lock_runs
+ */
+void
+heap_unlock_runs(pthread_mutex_t **locks, unsigned nlocks)
+{
+	while (nlocks != 0)
+		util_mutex_unlock(locks[--nlocks]);
+}
+
 /*
  * heap_coalesce -- merges adjacent memory blocks
  */
@@ -1383,6 +2071,43 @@ traverse_bucket_run(struct bucket *b, struct memory_block m,
 	return 0;
 }
 
+/*
+ * heap_run_into_chunk -- (internal) turns a run, whose memory blocks were all
+ *	removed from the buckets, into a free chunk
+ *
+ * Must be called with the bucket and run locks held.
+ */
+static void
+heap_run_into_chunk(PMEMobjpool *pop, struct bucket *b, struct memory_block m)
+{
+	struct zone *z = &pop->heap->layout->zones[m.zone_id];
+	struct chunk_header *hdr = &z->chunk_headers[m.chunk_id];
+
+	struct bucket *defb = heap_get_default_bucket(pop);
+	util_mutex_lock(&defb->lock);
+
+	m.block_off = 0;
+	m.size_idx = 1;
+	heap_chunk_init(pop, hdr, CHUNK_TYPE_FREE, m.size_idx);
+
+	uint64_t *mhdr;
+	uint64_t op_result;
+	struct memory_block fm =
+			heap_free_block(pop, defb, m, &mhdr, &op_result);
+
+	VALGRIND_ADD_TO_TX(mhdr, sizeof (*mhdr));
+	*mhdr = op_result;
+	VALGRIND_REMOVE_FROM_TX(mhdr, sizeof (*mhdr));
+	pop->persist(pop, mhdr, sizeof (*mhdr));
+
+	CNT_OP(defb, insert, pop, fm);
+
+	util_mutex_unlock(&defb->lock);
+
+	__sync_fetch_and_sub(&pop->heap->chunks_run, 1);
+	__sync_fetch_and_sub(&pop->heap->class_stats[b->id].nruns, 1);
+}
+
 /*
  * heap_degrade_run_if_empty -- makes a chunk out of an empty run
  */
@@ -1392,23 +2117,26 @@ heap_degrade_run_if_empty(PMEMobjpool *pop, struct bucket *b,
 {
 	struct zone *z = &pop->heap->layout->zones[m.zone_id];
 	struct chunk_header *hdr = &z->chunk_headers[m.chunk_id];
-	ASSERT(hdr->type == CHUNK_TYPE_RUN);
-
 	struct chunk_run *run = (struct chunk_run *)&z->chunks[m.chunk_id];
 
 	ASSERTeq(b->type, BUCKET_RUN);
 	struct bucket_run *r = (struct bucket_run *)b;
 
+	/*
+	 * The free chunk would be inserted into the default bucket once again
+	 * by the population of the zone.
+	 */
+	if (!heap_zone_is_ready(pop->heap, m.zone_id))
+		return;
+
 	util_mutex_lock(&b->lock);
 	util_mutex_lock(heap_get_run_lock(pop, m.chunk_id));
 
-	unsigned i;
-	unsigned nval = r->bitmap_nval;
-	for (i = 0; nval > 0 && i < nval - 1; ++i)
-		if (run->bitmap[i] != 0)
-			goto out;
+	/* the run might have already been released by the defragmentation */
+	if (hdr->type != CHUNK_TYPE_RUN || run->bucket_vptr != (uint64_t)b)
+		goto out;
 
-	if (run->bitmap[i] != r->bitmap_lastval)
+	if (!heap_run_is_free(r, run))
 		goto out;
 
 	if (traverse_bucket_run(b, m, b->c_ops->get_exact) != 0) {
@@ -1424,30 +2152,603 @@ heap_degrade_run_if_empty(PMEMobjpool *pop, struct bucket *b,
 		FATAL("Persistent/volatile state mismatch");
 	}
 
-	struct bucket *defb = heap_get_default_bucket(pop);
-	util_mutex_lock(&defb->lock);
-
-	m.block_off = 0;
-	m.size_idx = 1;
-	heap_chunk_init(pop, hdr, CHUNK_TYPE_FREE, m.size_idx);
+	heap_run_into_chunk(pop, b, m);
 
-	uint64_t *mhdr;
-	uint64_t op_result;
-	struct memory_block fm =
-			heap_free_block(pop, defb, m, &mhdr, &op_result);
+out:
+	util_mutex_unlock(heap_get_run_lock(pop, m.chunk_id));
+	util_mutex_unlock(&b->lock);
+}
 
-	VALGRIND_ADD_TO_TX(mhdr, sizeof (*mhdr));
-	*mhdr = op_result;
-	VALGRIND_REMOVE_FROM_TX(mhdr, sizeof (*mhdr));
-	pop->persist(pop, mhdr, sizeof (*mhdr));
+/*
+ * heap_stats_used -- accounts a memory block that became allocated or free in
+ *	the persistent state of the heap
+ */
+void
+heap_stats_used(PMEMobjpool *pop, struct bucket *b, uint32_t units,
+	enum heap_op op)
+{
+	struct pmalloc_heap *h = pop->heap;
+	uint64_t *cnt = b->type == BUCKET_HUGE ?
+		&h->chunks_huge : &h->class_stats[b->id].used_units;
 
-	CNT_OP(defb, insert, pop, fm);
+	if (op == HEAP_OP_ALLOC)
+		__sync_fetch_and_add(cnt, units);
+	else
+		__sync_fetch_and_sub(cnt, units);
+}
 
-	util_mutex_unlock(&defb->lock);
+/*
+ * heap_get_stats -- returns the statistics of the heap
+ *
+ * The counters are maintained by the allocator itself. Zones that are still
+ * being loaded are not waited for, only the ready ones are counted in the
+ * total and the rest is reported as pending.
+ */
+void
+heap_get_stats(PMEMobjpool *pop, struct pobj_heap_stats *stats)
+{
+	COMPILE_ERROR_ON(POBJ_MAX_ALLOC_CLASSES < MAX_BUCKETS);
+
+	struct pmalloc_heap *h = pop->heap;
+
+	memset(stats, 0, sizeof (*stats));
+
+	stats->chunk_size = CHUNKSIZE;
+
+	util_mutex_lock(&h->zone_lock);
+
+	stats->zones_pending = h->max_zone - h->zones_ready;
+	if (stats->zones_pending == 0) {
+		stats->chunks_total = h->chunks_total;
+	} else {
+		for (uint32_t i = 0; i < h->max_zone; ++i) {
+			if (h->zone_state[i] == ZONE_STATE_READY)
+				stats->chunks_total += get_zone_size_idx(i,
+					h->max_zone, pop->heap_size);
+		}
+	}
+
+	util_mutex_unlock(&h->zone_lock);
+
+	stats->chunks_huge = h->chunks_huge;
+	stats->chunks_run = h->chunks_run;
+
+	/* the counters are not read atomically as a whole */
+	uint64_t used = stats->chunks_huge + stats->chunks_run;
+	stats->chunks_free = used < stats->chunks_total ?
+		stats->chunks_total - used : 0;
+
+	struct bucket *defb = heap_get_default_bucket(pop);
+	stats->largest_free_extent = (size_t)CNT_OP(defb, get_largest) *
+		CHUNKSIZE;
+
+	uint64_t free_bytes = stats->chunks_free * CHUNKSIZE;
+
+	for (uint8_t i = 0; i < MAX_BUCKETS; ++i) {
+		struct bucket *b = h->buckets[i];
+		if (b == NULL)
+			continue;
+
+		struct bucket_run *r = (struct bucket_run *)b;
+		struct pobj_alloc_class_stats *cs =
+			&stats->classes[stats->nclasses++];
+
+		cs->class_id = (unsigned)i + 1;
+		cs->unit_size = b->unit_size;
+		cs->nruns = h->class_stats[i].nruns;
+		cs->units_used = h->class_stats[i].used_units;
+
+		uint64_t units = cs->nruns * r->bitmap_nallocs;
+		cs->units_free = units > cs->units_used ?
+			units - cs->units_used : 0;
+
+		free_bytes += cs->units_free * cs->unit_size;
+	}
+
+	if (free_bytes > stats->largest_free_extent)
+		stats->fragmentation = 1.0 -
+			(double)stats->largest_free_extent /
+			(double)free_bytes;
+}
+
+/*
+ * heap_run_find_alloc -- (internal) returns the first allocated unit of the
+ *	run at or past unit i, or nallocs if there is none
+ */
+static uint32_t
+heap_run_find_alloc(struct chunk_run *run, uint32_t nallocs, uint32_t i)
+{
+	while (i < nallocs) {
+		uint64_t v = run->bitmap[i / BITS_PER_VALUE] >>
+			(i % BITS_PER_VALUE);
+		if (v != 0) {
+			i += (uint32_t)__builtin_ctzll(v);
+			break;
+		}
+
+		i += BITS_PER_VALUE - i % BITS_PER_VALUE;
+	}
+
+	/* the bits past the end of the run are always set */
+	return i < nallocs ? i : nallocs;
+}
+
+/*
+ * heap_run_get_allocs -- (internal) stores the offsets of all allocations of
+ *	the run in the offs array and returns their number
+ *
+ * The run lock must be held. The header of the allocation a few units ahead
+ * is prefetched, runs of small units span many pages.
+ */
+static unsigned
+heap_run_get_allocs(PMEMobjpool *pop, struct chunk_run *run, uint32_t nallocs,
+	uint64_t *offs)
+{
+	unsigned n = 0;
+	for (uint32_t i = heap_run_find_alloc(run, nallocs, 0); i < nallocs;
+			i = heap_run_find_alloc(run, nallocs, i)) {
+		struct allocation_header *alloc = (void *)((char *)&run->data +
+			run->block_size * i);
+
+		if (i + HEAP_WALK_PREFETCH_UNITS < nallocs)
+			__builtin_prefetch((char *)alloc + run->block_size *
+				HEAP_WALK_PREFETCH_UNITS);
+
+		ASSERT(n < nallocs);
+		offs[n++] = (uint64_t)((char *)(alloc + 1) - (char *)pop);
+
+		uint32_t units = CALC_SIZE_IDX(run->block_size, alloc->size);
+		ASSERTne(units, 0);
+		i += units;
+	}
+
+	return n;
+}
+
+/*
+ * heap_defrag_collect_run -- (internal) checks whether the run is sparse enough
+ *	to be evacuated and stores the offsets of its allocations
+ *
+ * Returns the number of units of the run, or 0 if it is not a candidate.
+ */
+static uint32_t
+heap_defrag_collect_run(PMEMobjpool *pop, uint32_t chunk_id, uint32_t zone_id,
+	unsigned max_occupancy, uint64_t *offs, unsigned *noffs)
+{
+	struct pmalloc_heap *h = pop->heap;
+	struct zone *z = &h->layout->zones[zone_id];
+	struct chunk_header *hdr = &z->chunk_headers[chunk_id];
+	struct chunk_run *run = (struct chunk_run *)&z->chunks[chunk_id];
+
+	/* makes sure the free memory blocks of the run are in a bucket */
+	struct bucket *b = heap_get_chunk_bucket(pop, chunk_id, zone_id);
+	if (b == NULL || b->type != BUCKET_RUN)
+		return 0;
+
+	/*
+	 * The relocated objects are allocated from the predefined classes,
+	 * moving the objects of a class registered by the user would change
+	 * their unit size.
+	 */
+	if (h->buckets[SIZE_TO_BID(h, b->unit_size)]->unit_size !=
+			b->unit_size)
+		return 0;
+
+	struct bucket_run *r = (struct bucket_run *)b;
+	uint32_t nallocs = r->bitmap_nallocs;
+
+	util_mutex_lock(heap_get_run_lock(pop, chunk_id));
+
+	uint32_t ret = 0;
+	if (hdr->type != CHUNK_TYPE_RUN || run->block_size != b->unit_size)
+		goto out;
+
+	/* the bits past the end of the run are always set */
+	int used = -__builtin_popcountll(r->bitmap_lastval);
+	for (unsigned i = 0; i < r->bitmap_nval; ++i)
+		used += __builtin_popcountll(run->bitmap[i]);
+
+	ASSERT(used >= 0);
+	if ((uint64_t)used * 100 > (uint64_t)max_occupancy * nallocs)
+		goto out;
+
+	*noffs = heap_run_get_allocs(pop, run, nallocs, offs);
+	ret = nallocs;
 
 out:
-	util_mutex_unlock(heap_get_run_lock(pop, m.chunk_id));
+	util_mutex_unlock(heap_get_run_lock(pop, chunk_id));
+
+	return ret;
+}
+
+/*
+ * heap_defrag_begin -- finds the next run in which no more than max_occupancy
+ *	percent of units is allocated and starts its evacuation
+ *
+ * The offsets of the allocations in the run are stored in the offs array,
+ * which must be able to hold RUN_BITMAP_SIZE entries. Once the scan reaches
+ * the end of the heap ENOENT is returned and the next call starts over.
+ */
+int
+heap_defrag_begin(PMEMobjpool *pop, unsigned max_occupancy, uint64_t *offs,
+	unsigned *noffs)
+{
+	struct pmalloc_heap *h = pop->heap;
+	struct heap_defrag *d = &h->defrag;
+
+	heap_populate_wait(pop);
+
+	util_mutex_lock(&d->lock);
+
+	int ret = 0;
+	if (d->active) {
+		ret = EBUSY;
+		goto out;
+	}
+
+	for (; d->zone_id < h->max_zone; d->zone_id++, d->chunk_id = 0) {
+		struct zone *z = &h->layout->zones[d->zone_id];
+
+		while (d->chunk_id < z->header.size_idx) {
+			uint32_t chunk_id = d->chunk_id;
+			struct chunk_header *hdr = &z->chunk_headers[chunk_id];
+
+			/* the header can be concurrently split or merged */
+			uint32_t size_idx = hdr->size_idx;
+			d->chunk_id += size_idx == 0 ? 1 : size_idx;
+
+			if (hdr->type != CHUNK_TYPE_RUN)
+				continue;
+
+			uint32_t nallocs = heap_defrag_collect_run(pop,
+				chunk_id, d->zone_id, max_occupancy,
+				offs, noffs);
+			if (nallocs == 0)
+				continue;
+
+			d->withheld = Malloc(sizeof (*d->withheld) * nallocs);
+			if (d->withheld == NULL) {
+				ret = ENOMEM;
+				goto out;
+			}
+
+			d->nwithheld = 0;
+			d->run.chunk_id = chunk_id;
+			d->run.zone_id = d->zone_id;
+			d->run.size_idx = nallocs;
+			d->run.block_off = 0;
+			d->active = 1;
+
+			goto out;
+		}
+	}
+
+	d->zone_id = 0;
+	d->chunk_id = 0;
+	ret = ENOENT;
+
+out:
+	util_mutex_unlock(&d->lock);
+
+	return ret;
+}
+
+/*
+ * heap_defrag_mark -- (internal) marks the units of the memory block as found
+ */
+static void
+heap_defrag_mark(uint64_t *found, struct memory_block m)
+{
+	for (uint32_t u = m.block_off; u < m.block_off + m.size_idx; ++u)
+		found[u / BITS_PER_VALUE] |= 1ULL << (u % BITS_PER_VALUE);
+}
+
+/*
+ * heap_defrag_is_marked -- (internal) checks whether the unit was found
+ */
+static int
+heap_defrag_is_marked(const uint64_t *found, uint32_t u)
+{
+	return (found[u / BITS_PER_VALUE] >> (u % BITS_PER_VALUE)) & 1;
+}
+
+/*
+ * heap_defrag_reclaim_run -- (internal) gathers all of the free memory blocks
+ *	of an empty run and turns it into a free chunk
+ *
+ * The memory blocks are taken from the bucket of the run and from its
+ * auxiliary bucket, in addition to the withheld ones. If any unit is missing,
+ * e.g. because it is in the magazine of another thread, the run cannot be
+ * released and the memory blocks are put back into the bucket.
+ *
+ * Must be called with both bucket locks, the run lock and the defrag lock held.
+ */
+static int
+heap_defrag_reclaim_run(PMEMobjpool *pop, struct bucket *b,
+	struct bucket *auxb)
+{
+	struct heap_defrag *d = &pop->heap->defrag;
+	struct memory_block m = d->run;
+	struct zone *z = &pop->heap->layout->zones[m.zone_id];
+	struct chunk_run *run = (struct chunk_run *)&z->chunks[m.chunk_id];
+
+	struct bucket_run *r = (struct bucket_run *)b;
+	uint32_t nallocs = r->bitmap_nallocs;
+
+	/* a different run might have been created in the same chunk */
+	if (nallocs > m.size_idx || !heap_run_is_free(r, run))
+		return 0;
+
+	uint64_t found[MAX_BITMAP_VALUES];
+	memset(found, 0, sizeof (found));
+
+	uint32_t nfound = 0;
+	for (unsigned i = 0; i < d->nwithheld; ++i) {
+		heap_defrag_mark(found, d->withheld[i]);
+		nfound += d->withheld[i].size_idx;
+	}
+
+	/* the memory blocks never span beyond their unit_max group */
+	for (uint32_t g = 0; g < nallocs; g += r->unit_max) {
+		uint32_t end = g + r->unit_max < nallocs ?
+			g + r->unit_max : nallocs;
+
+		for (uint32_t p = g; p < end; ) {
+			uint32_t s = 0;
+			while (p + s < end &&
+					!heap_defrag_is_marked(found, p + s))
+				s++;
+
+			for (; s > 0; --s) {
+				struct memory_block fm = {m.chunk_id,
+					m.zone_id, s, (uint16_t)p};
+
+				if (CNT_OP(b, get_rm_exact, fm) == 0 ||
+					(auxb != b &&
+					CNT_OP(auxb, get_rm_exact, fm) == 0)) {
+					d->withheld[d->nwithheld++] = fm;
+					heap_defrag_mark(found, fm);
+					break;
+				}
+			}
+
+			if (s == 0) {
+				p++;
+				continue;
+			}
+
+			nfound += s;
+			p += s;
+		}
+	}
+
+	if (nfound != nallocs)
+		return 0;
+
+	d->nwithheld = 0;
+	heap_run_into_chunk(pop, b, m);
+
+	return 1;
+}
+
+/*
+ * heap_defrag_end -- finishes the evacuation of the run, gives it back to the
+ *	heap if none of its units is used anymore
+ *
+ * Returns 1 if the run was turned into a free chunk.
+ */
+int
+heap_defrag_end(PMEMobjpool *pop)
+{
+	struct heap_defrag *d = &pop->heap->defrag;
+	struct memory_block m = d->run;
+	struct zone *z = &pop->heap->layout->zones[m.zone_id];
+	struct chunk_header *hdr = &z->chunk_headers[m.chunk_id];
+	struct chunk_run *run = (struct chunk_run *)&z->chunks[m.chunk_id];
+	pthread_mutex_t *run_lock = heap_get_run_lock(pop, m.chunk_id);
+
+	ASSERT(d->active);
+
+	/* the run might have been degraded in the meantime */
+	util_mutex_lock(run_lock);
+	struct bucket *b = hdr->type == CHUNK_TYPE_RUN ?
+		(struct bucket *)run->bucket_vptr : NULL;
+	util_mutex_unlock(run_lock);
+
+	int released = 0;
+
+	if (b == NULL) {
+		util_mutex_lock(&d->lock);
+		ASSERTeq(d->nwithheld, 0);
+		goto out;
+	}
+
+	struct bucket *auxb = heap_get_auxiliary_bucket(pop, b);
+
+	util_mutex_lock(&b->lock);
+	if (auxb != b)
+		util_mutex_lock(&auxb->lock);
+	util_mutex_lock(run_lock);
+	util_mutex_lock(&d->lock);
+
+	if (hdr->type == CHUNK_TYPE_RUN && run->bucket_vptr == (uint64_t)b)
+		released = heap_defrag_reclaim_run(pop, b, auxb);
+
+	for (unsigned i = 0; i < d->nwithheld; ++i)
+		CNT_OP(b, insert, pop, d->withheld[i]);
+
+	util_mutex_unlock(run_lock);
+	if (auxb != b)
+		util_mutex_unlock(&auxb->lock);
 	util_mutex_unlock(&b->lock);
+
+out:
+	d->active = 0;
+	d->nwithheld = 0;
+	Free(d->withheld);
+	d->withheld = NULL;
+
+	util_mutex_unlock(&d->lock);
+
+	return released;
+}
+
+/*
+ * heap_next_alloc -- returns the offset of the first allocation past the one
+ *	at off, or of the first allocation of the heap if off is 0
+ *
+ * The allocations are visited in address order and the returned offsets are
+ * those of the data that follows the allocation header, 0 is returned past
+ * the last one.
+ */
+uint64_t
+heap_next_alloc(PMEMobjpool *pop, uint64_t off)
+{
+	struct pmalloc_heap *h = pop->heap;
+	uint32_t zone_id = 0;
+	uint32_t chunk_id = 0;
+	uint32_t unit = 0;
+
+	if (off != 0) {
+		struct allocation_header *alloc = (struct allocation_header *)
+			OBJ_OFF_TO_PTR(pop, off) - 1;
+		zone_id = alloc->zone_id;
+		chunk_id = alloc->chunk_id;
+
+		struct zone *z = &h->layout->zones[zone_id];
+		struct chunk_header *hdr = &z->chunk_headers[chunk_id];
+		if (hdr->type == CHUNK_TYPE_RUN) {
+			struct chunk_run *run =
+				(struct chunk_run *)&z->chunks[chunk_id];
+			uintptr_t unit_off = (uintptr_t)alloc -
+				(uintptr_t)&run->data;
+
+			unit = (uint32_t)(unit_off / run->block_size) +
+				CALC_SIZE_IDX(run->block_size, alloc->size);
+		} else {
+			chunk_id += hdr->size_idx;
+		}
+	}
+
+	for (; zone_id < h->max_zone; ++zone_id, chunk_id = 0) {
+		struct zone *z = &h->layout->zones[zone_id];
+		if (z->header.magic != ZONE_HEADER_MAGIC)
+			continue;
+
+		for (; chunk_id < z->header.size_idx; unit = 0) {
+			struct chunk_header *hdr = &z->chunk_headers[chunk_id];
+			void *data = &z->chunks[chunk_id].data;
+
+			if (hdr->type == CHUNK_TYPE_USED)
+				return OBJ_PTR_TO_OFF(pop,
+					(struct allocation_header *)data + 1);
+
+			if (hdr->type == CHUNK_TYPE_RUN) {
+				struct chunk_run *run = data;
+				uint32_t nallocs =
+					(uint32_t)RUN_NALLOCS(run->block_size);
+
+				util_mutex_lock(heap_get_run_lock(pop,
+					chunk_id));
+				unit = heap_run_find_alloc(run, nallocs, unit);
+				util_mutex_unlock(heap_get_run_lock(pop,
+					chunk_id));
+
+				struct allocation_header *alloc =
+					(struct allocation_header *)
+					((char *)&run->data +
+					run->block_size * unit);
+				if (unit < nallocs)
+					return OBJ_PTR_TO_OFF(pop, alloc + 1);
+			}
+
+			chunk_id += hdr->size_idx;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * heap_walk -- calls cb for every allocation whose first chunk lies in the
+ *	part-th of nparts equal ranges of the heap's chunks
+ *
+ * The allocations are visited in address order, the offsets passed to cb are
+ * those of the data that follows the allocation header. No lock is held while
+ * cb runs, so it may allocate and free. Returns ENOMEM, or the first nonzero
+ * value returned by cb, which stops the walk.
+ */
+int
+heap_walk(PMEMobjpool *pop, unsigned part, unsigned nparts,
+	int (*cb)(PMEMobjpool *pop, uint64_t off, void *arg), void *arg)
+{
+	struct pmalloc_heap *h = pop->heap;
+
+	ASSERT(part < nparts);
+
+	/* zones other than the last one have the same number of chunks */
+	uint64_t nchunks = (uint64_t)(h->max_zone - 1) * MAX_CHUNK +
+		get_zone_size_idx(h->max_zone - 1, h->max_zone, pop->heap_size);
+	uint64_t begin = nchunks * part / nparts;
+	uint64_t end = nchunks * (part + 1) / nparts;
+
+	uint64_t *offs = Malloc(sizeof (uint64_t) * RUN_BITMAP_SIZE);
+	if (offs == NULL)
+		return ENOMEM;
+
+	int ret = 0;
+	for (uint32_t zone_id = (uint32_t)(begin / MAX_CHUNK);
+			zone_id < h->max_zone && ret == 0; ++zone_id) {
+		struct zone *z = &h->layout->zones[zone_id];
+		if (z->header.magic != ZONE_HEADER_MAGIC)
+			continue;
+
+		uint64_t zone_start = (uint64_t)zone_id * MAX_CHUNK;
+		if (zone_start >= end)
+			break;
+
+		uint32_t c = 0;
+		while (c < z->header.size_idx && ret == 0) {
+			struct chunk_header *hdr = &z->chunk_headers[c];
+			uint32_t chunk_id = c;
+			c += hdr->size_idx;
+
+			if (zone_start + chunk_id < begin)
+				continue;
+			if (zone_start + chunk_id >= end)
+				break;
+
+			/* the headers of the next chunk are needed soon */
+			__builtin_prefetch(&z->chunk_headers[c]);
+
+			void *data = &z->chunks[chunk_id].data;
+			if (hdr->type == CHUNK_TYPE_USED) {
+				ret = cb(pop, OBJ_PTR_TO_OFF(pop,
+					(struct allocation_header *)data + 1),
+					arg);
+				continue;
+			}
+
+			if (hdr->type != CHUNK_TYPE_RUN)
+				continue;
+
+			struct chunk_run *run = data;
+			unsigned n = 0;
+
+			util_mutex_lock(heap_get_run_lock(pop, chunk_id));
+			if (hdr->type == CHUNK_TYPE_RUN)
+				n = heap_run_get_allocs(pop, run, (uint32_t)
+					RUN_NALLOCS(run->block_size), offs);
+			util_mutex_unlock(heap_get_run_lock(pop, chunk_id));
+
+			for (unsigned i = 0; i < n && ret == 0; ++i)
+				ret = cb(pop, offs[i], arg);
+		}
+	}
+
+	Free(offs);
+
+	return ret;
 }
 
 size_t
@@ -1536,15 +2837,50 @@ heap_boot(PMEMobjpool *pop)
 
 	h->max_zone = heap_max_zone(pop->heap_size);
 	h->zones_exhausted = 0;
+	h->zones_ready = 0;
 	h->layout = heap_get_layout(pop);
 
+	h->zone_state = Malloc(h->max_zone);
+	if (h->zone_state == NULL) {
+		err = ENOMEM;
+		goto error_zone_state_malloc;
+	}
+	memset(h->zone_state, ZONE_STATE_NONE, h->max_zone);
+
+	h->cold_runs = Malloc(sizeof (uint64_t *) * h->max_zone);
+	if (h->cold_runs == NULL) {
+		err = ENOMEM;
+		goto error_cold_runs_malloc;
+	}
+	memset(h->cold_runs, 0, sizeof (uint64_t *) * h->max_zone);
+
+	h->populate_threads = NULL;
+	h->npopulate_threads = 0;
+	h->populate_stop = 0;
+
+	util_mutex_init(&h->zone_lock, NULL);
+	util_cond_init(&h->zone_cond, NULL);
+
 	util_mutex_init(&h->active_run_lock, NULL);
+	util_mutex_init(&h->class_lock, NULL);
 
 	for (int i = 0; i < MAX_RUN_LOCKS; ++i)
 		util_mutex_init(&h->run_locks[i], NULL);
 
 	memset(h->last_drained, 0, sizeof (h->last_drained));
 
+	h->chunks_total = 0;
+	for (unsigned i = 0; i < h->max_zone; ++i)
+		h->chunks_total += get_zone_size_idx(i, h->max_zone,
+			pop->heap_size);
+
+	h->chunks_huge = 0;
+	h->chunks_run = 0;
+	memset(h->class_stats, 0, sizeof (h->class_stats));
+
+	memset(&h->defrag, 0, sizeof (h->defrag));
+	util_mutex_init(&h->defrag.lock, NULL);
+
 	pop->heap = h;
 
 	bucket_group_init(pop, h->buckets);
@@ -1563,6 +2899,10 @@ heap_boot(PMEMobjpool *pop)
 
 error_buckets_init:
 	/* there's really no point in destroying the locks */
+	Free(h->cold_runs);
+error_cold_runs_malloc:
+	Free(h->zone_state);
+error_zone_state_malloc:
 	Free(h->caches);
 error_heap_cache_malloc:
 	Free(h);
@@ -1700,6 +3040,8 @@ heap_init(PMEMobjpool *pop)
 void
 heap_cleanup(PMEMobjpool *pop)
 {
+	heap_populate_stop(pop);
+
 	bucket_delete(pop->heap->default_bucket);
 
 	bucket_group_destroy(pop->heap->buckets);
@@ -1715,6 +3057,16 @@ heap_cleanup(PMEMobjpool *pop)
 	Free(pop->heap->caches);
 
 	util_mutex_destroy(&pop->heap->active_run_lock);
+	util_mutex_destroy(&pop->heap->class_lock);
+	util_mutex_destroy(&pop->heap->defrag.lock);
+
+	util_cond_destroy(&pop->heap->zone_cond);
+	util_mutex_destroy(&pop->heap->zone_lock);
+	Free(pop->heap->zone_state);
+
+	for (unsigned i = 0; i < pop->heap->max_zone; ++i)
+		Free(pop->heap->cold_runs[i]);
+	Free(pop->heap->cold_runs);
 
 	struct active_run *r;
 	for (int i = 0; i < MAX_BUCKETS; ++i) {
@@ -37,6 +37,9 @@
 #define	MAX_BUCKETS UINT8_MAX
 #define	RUN_UNIT_MAX 8U
 
+/* distance, in units, at which the run headers are prefetched by heap walks */
+#define	HEAP_WALK_PREFETCH_UNITS 4
+
 /*
  * Every allocation has to be a multiple of a cacheline because we need to
  * ensure proper alignment of every pmem structure.
@@ -72,7 +75,8 @@ struct bucket_cache;
 struct bucket *heap_get_best_bucket(PMEMobjpool *pop, size_t size);
 struct bucket *heap_get_chunk_bucket(PMEMobjpool *pop,
 		uint32_t chunk_id, uint32_t zone_id);
-struct bucket *heap_get_auxiliary_bucket(PMEMobjpool *pop, size_t size);
+struct bucket *heap_get_class_bucket(PMEMobjpool *pop, uint8_t class_id);
+struct bucket *heap_get_auxiliary_bucket(PMEMobjpool *pop, struct bucket *b);
 void heap_drain_to_auxiliary(PMEMobjpool *pop, struct bucket *auxb,
 	uint32_t size_idx);
 void *heap_get_block_data(PMEMobjpool *pop, struct memory_block m);
@@ -87,9 +91,14 @@ int heap_get_adjacent_free_block(PMEMobjpool *pop, struct bucket *b,
 
 void heap_lock_if_run(PMEMobjpool *pop, struct memory_block m);
 void heap_unlock_if_run(PMEMobjpool *pop, struct memory_block m);
+unsigned heap_lock_runs(PMEMobjpool *pop, struct memory_block *m,
+	unsigned n, pthread_mutex_t **locks);
+void heap_unlock_runs(pthread_mutex_t **locks, unsigned nlocks);
 
 int heap_get_bestfit_block(PMEMobjpool *pop, struct bucket *b,
 	struct memory_block *m);
+unsigned heap_get_bestfit_blocks(PMEMobjpool *pop, struct bucket *b,
+	struct memory_block *blocks, unsigned nblocks);
 int heap_get_exact_block(PMEMobjpool *pop, struct bucket *b,
 	struct memory_block *m, uint32_t new_size_idx);
 void heap_degrade_run_if_empty(PMEMobjpool *pop, struct bucket *b,
@@ -100,6 +109,18 @@ struct memory_block heap_free_block(PMEMobjpool *pop, struct bucket *b,
 
 size_t heap_get_chunk_block_size(PMEMobjpool *pop, struct memory_block m);
 
+void heap_populate_wait(PMEMobjpool *pop);
+
+void heap_stats_used(PMEMobjpool *pop, struct bucket *b, uint32_t units,
+	enum heap_op op);
+
+int heap_alloc_class_register(PMEMobjpool *pop, size_t unit_size,
+	unsigned units_per_run, uint8_t *class_id);
+
+int heap_defrag_begin(PMEMobjpool *pop, unsigned max_occupancy, uint64_t *offs,
+	unsigned *noffs);
+int heap_defrag_end(PMEMobjpool *pop);
+
 #ifdef DEBUG
 int heap_block_is_allocated(PMEMobjpool *pop, struct memory_block m);
 #endif /* DEBUG */
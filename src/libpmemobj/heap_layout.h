@@ -46,7 +46,7 @@
 #define	ZONE_MIN_SIZE (sizeof (struct zone) - (MAX_CHUNK - 1) * CHUNKSIZE)
 #define	ZONE_MAX_SIZE (sizeof (struct zone))
 #define	HEAP_MIN_SIZE (sizeof (struct heap_layout) + ZONE_MIN_SIZE)
-#define	REDO_LOG_SIZE 4
+#define	REDO_LOG_SIZE 64 /* fills the whole allocator lane section */
 #define	BITS_PER_VALUE 64U
 #define	MAX_CACHELINE_ALIGNMENT 40 /* run alignment, 5 cachelines */
 #define	RUN_METASIZE (MAX_CACHELINE_ALIGNMENT * 8)
@@ -39,6 +39,7 @@
 #endif
 
 #include <errno.h>
+#include <stdlib.h>
 
 #include "libpmemobj.h"
 #include "lane.h"
@@ -48,28 +49,327 @@
 #include "list.h"
 #include "sys_util.h"
 #include "obj.h"
+#include "cuckoo.h"
 #include "valgrind_internal.h"
 
+#define	LANE_RECOVERY_THREADS_VAR "PMEMOBJ_RECOVERY_THREADS"
+#define	LANE_RECOVERY_THREADS_MAX 64
+
+/* number of lanes claimed at once by a recovery thread */
+#define	LANE_RECOVERY_RANGE 32
+
+#define	LANE_RECLAIMER_VAR "PMEMOBJ_TX_DEFERRED_FREE"
+
+/* lane most recently acquired by the thread in any pool */
 __thread unsigned Lane_idx = UINT32_MAX;
-static unsigned Next_lane_idx = 0;
+
+/*
+ * lane_info -- lane ownership of a thread in one pool
+ */
+struct lane_info {
+	uint64_t pop_uuid_lo;
+	uint64_t lane_idx;	/* lane held, or the last one held */
+	unsigned long nest_count;
+
+	struct lane_info *next;
+};
+
+static __thread struct cuckoo *Lane_info_ht;
+static __thread struct lane_info *Lane_info_records;
+static __thread struct lane_info *Lane_info_cache;
+
+static pthread_once_t Lane_info_once = PTHREAD_ONCE_INIT;
+static pthread_key_t Lane_info_key;
+static int Lane_info_key_created;
+
+/*
+ * lane_section_job -- recovery or check of one section of all the lanes
+ */
+struct lane_section_job {
+	PMEMobjpool *pop;
+	enum lane_section_type type;
+	section_layout_op op;
+
+	uint64_t next_lane;	/* first lane of the next unclaimed range */
+	int stop;		/* set once the operation failed on any lane */
+
+	int err;		/* error of the first failed lane */
+	uint64_t failed_lane;
+};
+
+/*
+ * lane_reclaimer -- background thread which finishes the work left in the
+ *	lanes after they were released, like the post-commit frees of
+ *	transactions
+ */
+struct lane_reclaimer {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int stop;
+
+	/* ring of the lanes waiting for the reclaimer, each one at most once */
+	uint64_t *queue;
+	uint64_t first;
+	uint64_t count;
+
+	/* lane taken off the queue by the thread, UINT64_MAX if there's none */
+	uint64_t current;
+	pthread_cond_t done;	/* signaled when the current lane is done */
+};
 
 struct section_operations *Section_ops[MAX_LANE_SECTION];
 
 /*
- * lane_get_layout -- (internal) calculates the real pointer of the lane layout
+ * lane_info_ht_destroy -- (internal) frees the lane ownership records of
+ *	the calling thread, called on the thread exit
+ */
+static void
+lane_info_ht_destroy(void *ht)
+{
+	struct lane_info *record = Lane_info_records;
+	while (record != NULL) {
+		struct lane_info *next = record->next;
+		Free(record);
+		record = next;
+	}
+
+	cuckoo_delete(ht);
+
+	Lane_info_ht = NULL;
+	Lane_info_records = NULL;
+	Lane_info_cache = NULL;
+}
+
+/*
+ * lane_info_key_create -- (internal) creates the key which frees the lane
+ *	records of exiting threads
+ */
+static void
+lane_info_key_create(void)
+{
+	int err = pthread_key_create(&Lane_info_key, lane_info_ht_destroy);
+	if (err) {
+		errno = err;
+		FATAL("!pthread_key_create");
+	}
+
+	Lane_info_key_created = 1;
+}
+
+/*
+ * lane_info_create -- (internal) creates the lane records of the calling
+ *	thread
+ */
+static void
+lane_info_create(void)
+{
+	Lane_info_ht = cuckoo_new();
+	if (Lane_info_ht == NULL)
+		FATAL("!cuckoo_new");
+
+	pthread_once(&Lane_info_once, lane_info_key_create);
+
+	int err = pthread_setspecific(Lane_info_key, Lane_info_ht);
+	if (err) {
+		errno = err;
+		FATAL("!pthread_setspecific");
+	}
+}
+
+/*
+ * lane_info_destroy -- frees the lane records of the calling thread
+ */
+void
+lane_info_destroy(void)
+{
+	if (Lane_info_ht != NULL)
+		lane_info_ht_destroy(Lane_info_ht);
+
+	if (Lane_info_key_created)
+		(void) pthread_key_delete(Lane_info_key);
+}
+
+/*
+ * lane_info_get -- (internal) returns the lane record of the calling thread
+ *	in the pool, creates one on first use
+ */
+static struct lane_info *
+lane_info_get(PMEMobjpool *pop)
+{
+	if (Lane_info_cache != NULL &&
+			Lane_info_cache->pop_uuid_lo == pop->uuid_lo)
+		return Lane_info_cache;
+
+	if (Lane_info_ht == NULL)
+		lane_info_create();
+
+	struct lane_info *info = cuckoo_get(Lane_info_ht, pop->uuid_lo);
+	if (info == NULL) {
+		info = Malloc(sizeof (*info));
+		if (info == NULL)
+			FATAL("!Malloc");
+
+		info->pop_uuid_lo = pop->uuid_lo;
+		info->lane_idx = UINT64_MAX;
+		info->nest_count = 0;
+
+		if (cuckoo_insert(Lane_info_ht, pop->uuid_lo, info) != 0)
+			FATAL("!cuckoo_insert");
+
+		info->next = Lane_info_records;
+		Lane_info_records = info;
+	}
+
+	Lane_info_cache = info;
+
+	return info;
+}
+
+/*
+ * lane_info_cleanup -- (internal) drops the lane record of the calling thread
+ *	in the pool
+ *
+ * Records of the other threads are left behind, they are freed on exit of
+ * those threads. A stale lane index is only a hint, so it does no harm when
+ * the same pool is opened again.
+ */
+static void
+lane_info_cleanup(PMEMobjpool *pop)
+{
+	if (Lane_info_ht == NULL)
+		return;
+
+	struct lane_info *info = cuckoo_remove(Lane_info_ht, pop->uuid_lo);
+	if (info == NULL)
+		return;
+
+	struct lane_info **prev = &Lane_info_records;
+	while (*prev != info)
+		prev = &(*prev)->next;
+	*prev = info->next;
+
+	if (Lane_info_cache == info)
+		Lane_info_cache = NULL;
+
+	Free(info);
+}
+
+/*
+ * lane_free_push -- (internal) puts the lane on the stack of idle lanes
+ *
+ * The stack head holds the index of the top lane increased by one (zero
+ * for an empty stack) and a counter of modifications in the upper half,
+ * which protects the pop against the ABA problem. Lanes which are already
+ * on the stack are not pushed again.
+ */
+static void
+lane_free_push(PMEMobjpool *pop, uint64_t idx)
+{
+	struct lane *lane = &pop->lanes[idx];
+
+	if (lane->free_listed ||
+		!__sync_bool_compare_and_swap(&lane->free_listed, 0, 1))
+		return;
+
+	uint64_t head;
+	uint64_t new_head;
+	do {
+		head = pop->lanes_free;
+		lane->next_free = (uint32_t)head;
+		new_head = (((head >> 32) + 1) << 32) | (idx + 1);
+	} while (!__sync_bool_compare_and_swap(&pop->lanes_free,
+			head, new_head));
+}
+
+/*
+ * lane_free_pop -- (internal) takes a lane from the stack of idle lanes,
+ *	returns UINT64_MAX if the stack is empty
+ *
+ * The stack is only a hint, the lane might have been acquired in the
+ * meantime by the thread which used it last.
+ */
+static uint64_t
+lane_free_pop(PMEMobjpool *pop)
+{
+	uint64_t head;
+	uint64_t new_head;
+	uint64_t idx;
+	do {
+		head = pop->lanes_free;
+		if ((uint32_t)head == 0)
+			return UINT64_MAX;
+
+		idx = (uint32_t)head - 1;
+		new_head = (((head >> 32) + 1) << 32) |
+			pop->lanes[idx].next_free;
+	} while (!__sync_bool_compare_and_swap(&pop->lanes_free,
+			head, new_head));
+
+	pop->lanes[idx].free_listed = 0;
+
+	return idx;
+}
+
+/*
+ * lane_free_init -- (internal) puts all of the lanes on the stack of idle
+ *	lanes, with the first lane on top
+ */
+static void
+lane_free_init(PMEMobjpool *pop)
+{
+	for (uint64_t i = 0; i < pop->nlanes; ++i) {
+		pop->lanes[i].next_free = i + 1 < pop->nlanes ?
+			(uint32_t)(i + 2) : 0;
+		pop->lanes[i].free_listed = 1;
+	}
+
+	pop->lanes_free = pop->nlanes != 0 ? 1 : 0;
+}
+
+/*
+ * lane_reclaimer_push -- (internal) queues the lane for the reclaimer
+ */
+static void
+lane_reclaimer_push(PMEMobjpool *pop, uint64_t idx)
+{
+	struct lane_reclaimer *r = pop->reclaimer;
+	struct lane *lane = &pop->lanes[idx];
+
+	util_mutex_lock(&r->lock);
+
+	if (!lane->reclaim_queued) {
+		lane->reclaim_queued = 1;
+		r->queue[(r->first + r->count) % pop->nlanes] = idx;
+		r->count++;
+
+		pthread_cond_signal(&r->cond);
+	}
+
+	util_mutex_unlock(&r->lock);
+}
+
+/*
+ * lane_get_section_layout -- (internal) calculates the real pointer of
+ *	the layout of a lane section
+ *
+ * The size of the sections is chosen when the pool is created, the layouts
+ * of the lanes cannot be indexed as an array of struct lane_layout.
  */
-static struct lane_layout *
-lane_get_layout(PMEMobjpool *pop, uint64_t lane_idx)
+static struct lane_section_layout *
+lane_get_section_layout(PMEMobjpool *pop, uint64_t lane_idx,
+	enum lane_section_type type)
 {
 	return (void *)((char *)pop + pop->lanes_offset +
-		sizeof (struct lane_layout) * lane_idx);
+		OBJ_LANE_SIZE(pop) * lane_idx +
+		OBJ_LANE_SECTION_LEN(pop) * type);
 }
 
 /*
  * lane_init -- (internal) initializes a single lane runtime variables
  */
 static int
-lane_init(PMEMobjpool *pop, struct lane *lane, struct lane_layout *layout,
+lane_init(PMEMobjpool *pop, struct lane *lane, uint64_t lane_idx,
 		pthread_mutex_t *mtx, pthread_mutexattr_t *attr)
 {
 	ASSERTne(lane, NULL);
@@ -81,11 +381,14 @@ lane_init(PMEMobjpool *pop, struct lane *lane, struct lane_layout *layout,
 	util_mutex_init(mtx, attr);
 
 	lane->lock = mtx;
+	lane->deferred = 0;
+	lane->reclaim_queued = 0;
 
 	int i;
 	for (i = 0; i < MAX_LANE_SECTION; ++i) {
 		lane->sections[i].runtime = NULL;
-		lane->sections[i].layout = &layout->sections[i];
+		lane->sections[i].layout = lane_get_section_layout(pop,
+				lane_idx, (enum lane_section_type)i);
 		err = Section_ops[i]->construct(pop, &lane->sections[i]);
 		if (err != 0) {
 			ERR("!lane_construct_ops %d", i);
@@ -137,6 +440,9 @@ lane_boot(PMEMobjpool *pop)
 		goto error_lanes_malloc;
 	}
 
+	/* lane indexes have to fit in the stack of idle lanes */
+	ASSERT(pop->nlanes < UINT32_MAX);
+
 	pop->lanes = Malloc(sizeof (struct lane) * pop->nlanes);
 	if (pop->lanes == NULL) {
 		err = ENOMEM;
@@ -153,19 +459,19 @@ lane_boot(PMEMobjpool *pop)
 
 	/* add lanes to pmemcheck ignored list */
 	VALGRIND_ADD_TO_GLOBAL_TX_IGNORE((char *)pop + pop->lanes_offset,
-		(sizeof (struct lane_layout) * pop->nlanes));
+		OBJ_LANES_SIZE(pop));
 
 	uint64_t i;
 	for (i = 0; i < pop->nlanes; ++i) {
-		struct lane_layout *layout = lane_get_layout(pop, i);
-
-		if ((err = lane_init(pop, &pop->lanes[i], layout,
+		if ((err = lane_init(pop, &pop->lanes[i], i,
 				&pop->lane_locks[i], &lock_attr)) != 0) {
 			ERR("!lane_init");
 			goto error_lane_init;
 		}
 	}
 
+	lane_free_init(pop);
+
 	if (pthread_mutexattr_destroy(&lock_attr) != 0) {
 		ERR("!pthread_mutexattr_destroy");
 		goto error_mutexattr_destroy;
@@ -203,6 +509,9 @@ lane_cleanup(PMEMobjpool *pop)
 	for (uint64_t i = 0; i < pop->nlanes; ++i)
 		lane_destroy(pop, &pop->lanes[i]);
 
+	lane_info_cleanup(pop);
+	pop->lanes_free = 0;
+
 	Free(pop->lane_locks);
 	pop->lane_locks = NULL;
 
@@ -210,28 +519,154 @@ lane_cleanup(PMEMobjpool *pop)
 	pop->lanes = NULL;
 }
 
+/*
+ * lane_section_worker -- (internal) performs the job on ranges of lanes until
+ *	there are no more lanes left
+ */
+static void *
+lane_section_worker(void *arg)
+{
+	struct lane_section_job *job = arg;
+	PMEMobjpool *pop = job->pop;
+
+	while (!job->stop) {
+		uint64_t first = __sync_fetch_and_add(&job->next_lane,
+				LANE_RECOVERY_RANGE);
+		if (first >= pop->nlanes)
+			break;
+
+		uint64_t last = first + LANE_RECOVERY_RANGE;
+		if (last > pop->nlanes)
+			last = pop->nlanes;
+
+		for (uint64_t j = first; j < last; ++j) {
+			int err = job->op(pop,
+				lane_get_section_layout(pop, j, job->type));
+			if (err == 0)
+				continue;
+
+			LOG(2, "section %d lane %ju err %d", job->type, j, err);
+
+			if (__sync_bool_compare_and_swap(&job->err, 0, err))
+				job->failed_lane = j;
+
+			job->stop = 1;
+			__sync_synchronize();
+
+			return NULL;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * lane_section_nthreads -- (internal) returns the number of threads which
+ *	recover or check the lanes
+ *
+ * The lanes are processed by the calling thread alone unless requested
+ * otherwise by the user.
+ */
+static unsigned
+lane_section_nthreads(PMEMobjpool *pop)
+{
+	char *env = getenv(LANE_RECOVERY_THREADS_VAR);
+	if (env == NULL)
+		return 1;
+
+	long nthreads = atol(env);
+	if (nthreads <= 1)
+		return 1;
+
+	if (nthreads > LANE_RECOVERY_THREADS_MAX)
+		nthreads = LANE_RECOVERY_THREADS_MAX;
+
+	/* no point in having more threads than there are lane ranges */
+	uint64_t nranges = (pop->nlanes + LANE_RECOVERY_RANGE - 1) /
+		LANE_RECOVERY_RANGE;
+	if ((uint64_t)nthreads > nranges)
+		nthreads = (long)nranges;
+
+	return (unsigned)nthreads;
+}
+
+/*
+ * lane_section_run -- (internal) performs the operation on one section of
+ *	all the lanes
+ *
+ * The sections of different lanes don't share any state, so the lanes are
+ * split into ranges claimed by nthreads threads, one of them being
+ * the calling thread. The function returns once all of the threads are done.
+ */
+static int
+lane_section_run(PMEMobjpool *pop, enum lane_section_type type,
+	section_layout_op op, unsigned nthreads)
+{
+	struct lane_section_job job = {
+		.pop = pop,
+		.type = type,
+		.op = op,
+		.next_lane = 0,
+		.stop = 0,
+		.err = 0,
+		.failed_lane = 0,
+	};
+
+	pthread_t threads[LANE_RECOVERY_THREADS_MAX];
+	unsigned nstarted = 0;
+
+	for (; nstarted + 1 < nthreads; ++nstarted) {
+		int err = pthread_create(&threads[nstarted], NULL,
+				lane_section_worker, &job);
+		if (err) {
+			errno = err;
+			LOG(2, "!pthread_create");
+			break;
+		}
+	}
+
+	lane_section_worker(&job);
+
+	for (unsigned t = 0; t < nstarted; ++t) {
+		int err = pthread_join(threads[t], NULL);
+		if (err) {
+			errno = err;
+			ERR("!pthread_join");
+		}
+	}
+
+	if (job.err != 0 && nstarted != 0 && op == Section_ops[type]->check) {
+		/*
+		 * The error message was reported by one of the threads,
+		 * check the lane once again to pass it to the caller.
+		 */
+		op(pop, lane_get_section_layout(pop, job.failed_lane, type));
+	}
+
+	return job.err;
+}
+
 /*
  * lane_recover_and_boot -- performs initialization and recovery of all lanes
+ *
+ * All lanes have to be recovered before the section is booted and
+ * the following sections, which may depend on it, are recovered.
  */
 int
 lane_recover_and_section_boot(PMEMobjpool *pop)
 {
 	int err = 0;
 	int i; /* section index */
-	uint64_t j; /* lane index */
-	struct lane_layout *layout;
+	unsigned nthreads = lane_section_nthreads(pop);
+
+	LOG(3, "recovering lanes using %u threads", nthreads);
 
 	for (i = 0; i < MAX_LANE_SECTION; ++i) {
-		for (j = 0; j < pop->nlanes; ++j) {
-			layout = lane_get_layout(pop, j);
-			err = Section_ops[i]->recover(pop,
-				&layout->sections[i]);
-
-			if (err != 0) {
-				LOG(2, "section_ops->recover %d %ju %d",
-					i, j, err);
-				return err;
-			}
+		err = lane_section_run(pop, (enum lane_section_type)i,
+				Section_ops[i]->recover, nthreads);
+		if (err != 0) {
+			LOG(2, "section_ops->recover %d %d", i, err);
+			return err;
 		}
 
 		if ((err = Section_ops[i]->boot(pop)) != 0) {
@@ -251,20 +686,45 @@ lane_check(PMEMobjpool *pop)
 {
 	int err = 0;
 	int i; /* section index */
-	uint64_t j; /* lane index */
-	struct lane_layout *layout;
+	unsigned nthreads = lane_section_nthreads(pop);
+
+	for (i = 0; i < MAX_LANE_SECTION; ++i) {
+		err = lane_section_run(pop, (enum lane_section_type)i,
+				Section_ops[i]->check, nthreads);
+		if (err) {
+			LOG(2, "section_ops->check %d %d", i, err);
+
+			return err;
+		}
+	}
+
+	return err;
+}
+
+/*
+ * lane_check_idle -- checks if none of the lanes holds a pending operation
+ *
+ * Used before the lanes of a pool created by an older version of the library
+ * are taken over. Such a pool can be used as is only if all of its logs are
+ * empty, the library can't recover the logs in the older format.
+ */
+int
+lane_check_idle(PMEMobjpool *pop)
+{
+	int err = 0;
+	int i; /* section index */
+	unsigned nthreads = lane_section_nthreads(pop);
 
 	for (i = 0; i < MAX_LANE_SECTION; ++i) {
-		for (j = 0; j < pop->nlanes; ++j) {
-			layout = lane_get_layout(pop, j);
-			err = Section_ops[i]->check(pop, &layout->sections[i]);
+		if (Section_ops[i]->check_idle == NULL)
+			continue;
 
-			if (err) {
-				LOG(2, "section_ops->check %d %ju %d",
-					i, j, err);
+		err = lane_section_run(pop, (enum lane_section_type)i,
+				Section_ops[i]->check_idle, nthreads);
+		if (err) {
+			LOG(2, "section_ops->check_idle %d %d", i, err);
 
-				return err;
-			}
+			return err;
 		}
 	}
 
@@ -272,7 +732,64 @@ lane_check(PMEMobjpool *pop)
 }
 
 /*
- * lane_hold -- grabs a per-thread lane in a round-robin fashion
+ * lane_attach -- (internal) acquires a lane for the calling thread
+ *
+ * The lane used last time by the thread is preferred, then the idle lanes
+ * from the stack and finally any lane which is not locked. The thread waits
+ * for its lane only if all of the lanes are busy. Lanes with work left for
+ * the reclaimer are skipped unless the thread has to wait anyway, their
+ * owner finishes the work then.
+ */
+static void
+lane_attach(PMEMobjpool *pop, struct lane_info *info)
+{
+	uint64_t idx = info->lane_idx;
+	if (idx < pop->nlanes && !pop->lanes[idx].deferred &&
+		pthread_mutex_trylock(pop->lanes[idx].lock) == 0)
+		goto out;
+
+	while ((idx = lane_free_pop(pop)) != UINT64_MAX) {
+		if (!pop->lanes[idx].deferred &&
+			pthread_mutex_trylock(pop->lanes[idx].lock) == 0)
+			goto out;
+	}
+
+	uint64_t first = info->lane_idx < pop->nlanes ? info->lane_idx : 0;
+	for (uint64_t i = 1; i < pop->nlanes; ++i) {
+		idx = (first + i) % pop->nlanes;
+		if (!pop->lanes[idx].deferred &&
+			pthread_mutex_trylock(pop->lanes[idx].lock) == 0)
+			goto out;
+	}
+
+	idx = first;
+	util_mutex_lock(pop->lanes[idx].lock);
+
+out:
+	info->lane_idx = idx;
+	Lane_idx = (unsigned)idx;
+}
+
+/*
+ * lane_detach -- (internal) releases the lane of the calling thread
+ */
+static void
+lane_detach(PMEMobjpool *pop, struct lane_info *info)
+{
+	int deferred = pop->lanes[info->lane_idx].deferred;
+
+	util_mutex_unlock(pop->lanes[info->lane_idx].lock);
+
+	if (deferred)
+		lane_reclaimer_push(pop, info->lane_idx);
+	else
+		lane_free_push(pop, info->lane_idx);
+}
+
+/*
+ * lane_hold -- grabs a lane of the pool for the calling thread
+ *
+ * Nested holds of the same thread get the same lane.
  */
 void
 lane_hold(PMEMobjpool *pop, struct lane_section **section,
@@ -281,29 +798,317 @@ lane_hold(PMEMobjpool *pop, struct lane_section **section,
 	ASSERTne(section, NULL);
 	ASSERTne(pop->lanes, NULL);
 
-	if (Lane_idx == UINT32_MAX) {
-		do {
-			Lane_idx = __sync_fetch_and_add(&Next_lane_idx, 1);
-		} while (Lane_idx == UINT32_MAX); /* handles wraparound */
-	}
-
-	struct lane *lane = &pop->lanes[Lane_idx % pop->nlanes];
+	struct lane_info *info = lane_info_get(pop);
 
-	util_mutex_lock(lane->lock);
+	if (info->nest_count++ == 0)
+		lane_attach(pop, info);
 
-	*section = &lane->sections[type];
+	*section = &pop->lanes[info->lane_idx].sections[type];
 }
 
 /*
- * lane_release -- drops the per-thread lane
+ * lane_release -- drops the lane of the calling thread
  */
 void
 lane_release(PMEMobjpool *pop)
 {
-	ASSERT(Lane_idx != UINT32_MAX);
 	ASSERTne(pop->lanes, NULL);
 
-	struct lane *lane = &pop->lanes[Lane_idx % pop->nlanes];
+	struct lane_info *info = lane_info_get(pop);
+	ASSERT(info->lane_idx < pop->nlanes);
+
+	if (info->nest_count == 0)
+		FATAL("lane_release without lane_hold");
+
+	if (--info->nest_count == 0)
+		lane_detach(pop, info);
+}
+
+/*
+ * lane_defer -- marks the lane of the calling thread as having work left,
+ *	the lane is handed to the reclaimer once the thread releases it
+ */
+void
+lane_defer(PMEMobjpool *pop)
+{
+	ASSERTne(pop->reclaimer, NULL);
+
+	struct lane_info *info = lane_info_get(pop);
+	ASSERT(info->lane_idx < pop->nlanes);
+
+	pop->lanes[info->lane_idx].deferred = 1;
+}
+
+/*
+ * lane_reclaim_sections -- (internal) runs the reclaim operations of all
+ *	the sections of a lane held by the calling thread
+ */
+static void
+lane_reclaim_sections(PMEMobjpool *pop, uint64_t idx)
+{
+	struct lane *lane = &pop->lanes[idx];
+
+	for (int i = 0; i < MAX_LANE_SECTION; ++i) {
+		if (Section_ops[i]->reclaim == NULL)
+			continue;
+
+		int err = Section_ops[i]->reclaim(pop,
+				lane->sections[i].layout);
+		if (err != 0)
+			LOG(2, "section %d lane %ju err %d", i, idx, err);
+	}
+
+	lane->deferred = 0;
+}
+
+/*
+ * lane_reclaim_held -- finishes the work left in the lane held by the calling
+ *	thread, so that it's not handed to the reclaimer on release
+ */
+void
+lane_reclaim_held(PMEMobjpool *pop)
+{
+	struct lane_info *info = lane_info_get(pop);
+	ASSERTne(info->nest_count, 0);
+
+	if (pop->lanes[info->lane_idx].deferred)
+		lane_reclaim_sections(pop, info->lane_idx);
+}
+
+/*
+ * lane_reclaim -- (internal) finishes the work left in the lane, returns 0
+ *	if the lane is held by another thread
+ *
+ * The reclaimer holds the lane like any other thread, so the sections may
+ * use the nested lane holds of the operations they call. A lane which is
+ * held is never waited for: its owner either finishes the work itself or
+ * queues the lane again when it releases it.
+ */
+static int
+lane_reclaim(PMEMobjpool *pop, uint64_t idx)
+{
+	struct lane *lane = &pop->lanes[idx];
+	struct lane_info *info = lane_info_get(pop);
+
+	if (pthread_mutex_trylock(lane->lock) != 0)
+		return 0;
+
+	info->lane_idx = idx;
+	info->nest_count = 1;
+	Lane_idx = (unsigned)idx;
+
+	lane_reclaim_sections(pop, idx);
+
+	info->nest_count = 0;
 
 	util_mutex_unlock(lane->lock);
+
+	lane_free_push(pop, idx);
+
+	return 1;
+}
+
+/*
+ * lane_reclaimer_flush -- finishes the work of the lanes queued for
+ *	the reclaimer in the calling thread
+ *
+ * Used when the memory they are about to free is needed right away. The lane
+ * processed by the reclaimer thread is waited for, unless it's the one held
+ * by the calling thread. Queued lanes held by other threads are skipped,
+ * waiting for them could deadlock; they are queued again when released.
+ *
+ * The caller may hold its own lane, but no other locks of the heap. That
+ * can't deadlock against the reclaimer thread: it never waits for a lane
+ * (see lane_reclaim), so the wait below lasts only as long as the frees of
+ * a single lane, which take nothing but the locks of the heap.
+ *
+ * Returns the number of the lanes reclaimed or waited for.
+ */
+unsigned
+lane_reclaimer_flush(PMEMobjpool *pop)
+{
+	struct lane_reclaimer *r = pop->reclaimer;
+	if (r == NULL)
+		return 0;
+
+	struct lane_info *info = lane_info_get(pop);
+	uint64_t held = info->nest_count != 0 ? info->lane_idx : UINT64_MAX;
+	uint64_t lane_idx = info->lane_idx;
+	unsigned long nest_count = info->nest_count;
+	unsigned lane_idx_tls = Lane_idx;
+
+	unsigned nreclaimed = 0;
+
+	util_mutex_lock(&r->lock);
+
+	while (r->current != UINT64_MAX && r->current != held) {
+		util_cond_wait(&r->done, &r->lock);
+		nreclaimed++;
+	}
+
+	while (r->count != 0) {
+		uint64_t idx = r->queue[r->first];
+		r->first = (r->first + 1) % pop->nlanes;
+		r->count--;
+		pop->lanes[idx].reclaim_queued = 0;
+
+		/* the lane locks are recursive, trylock succeeds for held */
+		if (idx == held)
+			continue;
+
+		util_mutex_unlock(&r->lock);
+
+		if (lane_reclaim(pop, idx))
+			nreclaimed++;
+
+		util_mutex_lock(&r->lock);
+	}
+
+	util_mutex_unlock(&r->lock);
+
+	info->lane_idx = lane_idx;
+	info->nest_count = nest_count;
+	Lane_idx = lane_idx_tls;
+
+	return nreclaimed;
+}
+
+/*
+ * lane_reclaimer_worker -- (internal) processes the queued lanes until
+ *	the reclaimer is stopped and the queue is empty
+ */
+static void *
+lane_reclaimer_worker(void *arg)
+{
+	PMEMobjpool *pop = arg;
+	struct lane_reclaimer *r = pop->reclaimer;
+
+	util_mutex_lock(&r->lock);
+
+	for (;;) {
+		while (r->count == 0 && !r->stop)
+			util_cond_wait(&r->cond, &r->lock);
+
+		if (r->count == 0)
+			break;
+
+		uint64_t idx = r->queue[r->first];
+		r->first = (r->first + 1) % pop->nlanes;
+		r->count--;
+		pop->lanes[idx].reclaim_queued = 0;
+		r->current = idx;
+
+		util_mutex_unlock(&r->lock);
+		lane_reclaim(pop, idx);
+		util_mutex_lock(&r->lock);
+
+		r->current = UINT64_MAX;
+		util_cond_broadcast(&r->done);
+	}
+
+	util_mutex_unlock(&r->lock);
+
+	return NULL;
+}
+
+/*
+ * lane_reclaimer_start -- starts the background reclaimer of the pool if
+ *	requested by the user
+ */
+int
+lane_reclaimer_start(PMEMobjpool *pop)
+{
+	ASSERTne(pop->lanes, NULL);
+
+	pop->reclaimer = NULL;
+
+	char *env = getenv(LANE_RECLAIMER_VAR);
+	if (env == NULL || atoi(env) == 0)
+		return 0;
+
+	struct lane_reclaimer *r = Malloc(sizeof (*r));
+	if (r == NULL) {
+		ERR("!Malloc of lane reclaimer");
+		return ENOMEM;
+	}
+
+	r->queue = Malloc(sizeof (uint64_t) * pop->nlanes);
+	if (r->queue == NULL) {
+		ERR("!Malloc of lane reclaimer queue");
+		Free(r);
+		return ENOMEM;
+	}
+
+	r->stop = 0;
+	r->first = 0;
+	r->count = 0;
+	r->current = UINT64_MAX;
+	util_mutex_init(&r->lock, NULL);
+
+	int err = pthread_cond_init(&r->cond, NULL);
+	if (err) {
+		errno = err;
+		ERR("!pthread_cond_init");
+		goto err_cond;
+	}
+
+	err = pthread_cond_init(&r->done, NULL);
+	if (err) {
+		errno = err;
+		ERR("!pthread_cond_init");
+		goto err_done;
+	}
+
+	pop->reclaimer = r;
+
+	err = pthread_create(&r->thread, NULL, lane_reclaimer_worker, pop);
+	if (err) {
+		errno = err;
+		ERR("!pthread_create");
+		goto err_thread;
+	}
+
+	return 0;
+
+err_thread:
+	pop->reclaimer = NULL;
+	pthread_cond_destroy(&r->done);
+err_done:
+	pthread_cond_destroy(&r->cond);
+err_cond:
+	util_mutex_destroy(&r->lock);
+	Free(r->queue);
+	Free(r);
+	return err;
+}
+
+/*
+ * lane_reclaimer_stop -- finishes the work of all queued lanes and stops
+ *	the reclaimer
+ */
+void
+lane_reclaimer_stop(PMEMobjpool *pop)
+{
+	struct lane_reclaimer *r = pop->reclaimer;
+	if (r == NULL)
+		return;
+
+	util_mutex_lock(&r->lock);
+	r->stop = 1;
+	pthread_cond_signal(&r->cond);
+	util_mutex_unlock(&r->lock);
+
+	int err = pthread_join(r->thread, NULL);
+	if (err) {
+		errno = err;
+		ERR("!pthread_join");
+	}
+
+	pop->reclaimer = NULL;
+
+	pthread_cond_destroy(&r->done);
+	pthread_cond_destroy(&r->cond);
+	util_mutex_destroy(&r->lock);
+	Free(r->queue);
+	Free(r);
 }
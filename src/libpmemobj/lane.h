@@ -62,6 +62,12 @@ struct lane {
 	/* volatile state */
 	pthread_mutex_t *lock;
 	struct lane_section sections[MAX_LANE_SECTION];
+
+	uint32_t next_free;	/* next lane on the stack of idle lanes */
+	int free_listed;	/* the lane is on the stack of idle lanes */
+
+	int deferred;		/* work is left for the background reclaimer */
+	int reclaim_queued;	/* the lane is queued for the reclaimer */
 };
 
 typedef int (*section_layout_op)(PMEMobjpool *pop,
@@ -76,6 +82,8 @@ struct section_operations {
 	section_layout_op check;
 	section_layout_op recover;
 	section_global_op boot;
+	section_layout_op reclaim;	/* optional, finishes deferred work */
+	section_layout_op check_idle;	/* optional, see lane_check_idle */
 };
 
 extern struct section_operations *Section_ops[MAX_LANE_SECTION];
@@ -85,10 +93,18 @@ int lane_boot(PMEMobjpool *pop);
 void lane_cleanup(PMEMobjpool *pop);
 int lane_recover_and_section_boot(PMEMobjpool *pop);
 int lane_check(PMEMobjpool *pop);
+int lane_check_idle(PMEMobjpool *pop);
+void lane_info_destroy(void);
 
 void lane_hold(PMEMobjpool *pop, struct lane_section **section,
 	enum lane_section_type type);
 void lane_release(PMEMobjpool *pop);
+void lane_defer(PMEMobjpool *pop);
+void lane_reclaim_held(PMEMobjpool *pop);
+
+int lane_reclaimer_start(PMEMobjpool *pop);
+void lane_reclaimer_stop(PMEMobjpool *pop);
+unsigned lane_reclaimer_flush(PMEMobjpool *pop);
 
 #define	SECTION_PARM(n, ops)\
 __attribute__((constructor)) static void _section_parm_##n(void)\
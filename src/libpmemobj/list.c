@@ -52,6 +52,18 @@
 #define	OOB_ENTRY_OFF_REV \
 ((ssize_t)offsetof(struct oob_header, oob) - (ssize_t)OBJ_OOB_SIZE)
 
+/* offset of the oob list entry of the object with the given data offset */
+#define	OOB_ENTRY_OFF_OF(_doff) ((_doff) - OBJ_OOB_SIZE + OOB_ENTRY_OFF)
+
+/* redo log entries linking a chain of new elements into oob list */
+#define	LIST_BATCH_INSERT_ENTRIES 2
+
+/*
+ * Maximum number of redo log entries needed to remove a single element of
+ * a batch: three for the oob list, two for its oid and one for its header.
+ */
+#define	LIST_BATCH_REMOVE_ENTRIES 6
+
 /*
  * list_args_common -- common arguments for operations on list
  *
@@ -395,12 +407,13 @@ list_set_user_field(PMEMobjpool *pop,
 }
 
 /*
- * list_fill_entry_persist -- (internal) fill new entry using persist function
+ * list_fill_entry -- (internal) fill new entry without persisting it
  *
- * Used for newly allocated objects.
+ * Used for newly allocated objects, the caller is responsible for persisting
+ * the entry before the redo log is committed.
  */
 static void
-list_fill_entry_persist(PMEMobjpool *pop, struct list_entry *entry_ptr,
+list_fill_entry(PMEMobjpool *pop, struct list_entry *entry_ptr,
 		uint64_t next_offset, uint64_t prev_offset)
 {
 	LOG(15, NULL);
@@ -412,6 +425,20 @@ list_fill_entry_persist(PMEMobjpool *pop, struct list_entry *entry_ptr,
 	entry_ptr->pe_prev.pool_uuid_lo = pop->uuid_lo;
 	entry_ptr->pe_prev.off = prev_offset;
 	VALGRIND_REMOVE_FROM_TX(entry_ptr, sizeof (*entry_ptr));
+}
+
+/*
+ * list_fill_entry_persist -- (internal) fill new entry using persist function
+ *
+ * Used for newly allocated objects.
+ */
+static void
+list_fill_entry_persist(PMEMobjpool *pop, struct list_entry *entry_ptr,
+		uint64_t next_offset, uint64_t prev_offset)
+{
+	LOG(15, NULL);
+
+	list_fill_entry(pop, entry_ptr, next_offset, prev_offset);
 
 	pop->persist(pop, entry_ptr, sizeof (*entry_ptr));
 }
@@ -731,7 +758,7 @@ list_realloc_replace(PMEMobjpool *pop,
  * list_insert_new -- allocate and insert element to oob and user lists
  *
  * pop         - pmemobj pool handle
- * oob_head    - oob list head
+ * oob_head    - oob list head, NULL if the object is not put on any
  * pe_offset   - offset to list entry on user list relative to user data
  * user_head   - user list head, must be locked if not NULL
  * dest        - destination on user list
@@ -740,15 +767,16 @@ list_realloc_replace(PMEMobjpool *pop,
  * constructor - object's constructor
  * arg         - argument for object's constructor
  * oidp        - pointer to target object ID
+ * class_id    - allocation class of the object, 0 for the best fitting one
  */
 static int
 list_insert_new(PMEMobjpool *pop, struct list_head *oob_head,
 	size_t pe_offset, struct list_head *user_head, PMEMoid dest, int before,
 	size_t size, void (*constructor)(PMEMobjpool *pop, void *ptr,
-	size_t usable_size, void *arg), void *arg, PMEMoid *oidp)
+	size_t usable_size, void *arg), void *arg, PMEMoid *oidp,
+	uint8_t class_id)
 {
 	LOG(3, NULL);
-	ASSERTne(oob_head, NULL);
 
 	int ret;
 
@@ -777,13 +805,14 @@ list_insert_new(PMEMobjpool *pop, struct list_head *oob_head,
 	if (constructor) {
 		if ((ret = pmalloc_construct(pop,
 				&section->obj_offset, size,
-				constructor, arg, OBJ_OOB_SIZE))) {
+				constructor, arg, OBJ_OOB_SIZE, class_id))) {
 			errno = ret;
 			ERR("!pmalloc_construct");
 			ret = -1;
 			goto err_pmalloc;
 		}
 	} else {
+		ASSERTeq(class_id, 0);
 		ret = pmalloc(pop, &section->obj_offset, size, OBJ_OOB_SIZE);
 		if (ret) {
 			errno = ret;
@@ -799,7 +828,8 @@ list_insert_new(PMEMobjpool *pop, struct list_head *oob_head,
 	 *
 	 * XXX performance improvement: initialize oob locks at pool opening
 	 */
-	pmemobj_mutex_lock_nofail(pop, &oob_head->lock);
+	if (oob_head)
+		pmemobj_mutex_lock_nofail(pop, &oob_head->lock);
 
 	uint64_t obj_offset = section->obj_offset;
 	uint64_t obj_doffset = obj_offset + OBJ_OOB_SIZE;
@@ -808,15 +838,22 @@ list_insert_new(PMEMobjpool *pop, struct list_head *oob_head,
 		(struct list_entry *)OBJ_OFF_TO_PTR(pop,
 			obj_offset + OOB_ENTRY_OFF);
 
-	uint64_t oob_next_off;
-	uint64_t oob_prev_off;
+	uint64_t oob_next_off = 0;
+	uint64_t oob_prev_off = 0;
 
 	/* insert element to oob list */
-	redo_index = list_insert_oob(pop, redo, redo_index,
-			oob_head, obj_doffset, &oob_next_off, &oob_prev_off);
+	if (oob_head)
+		redo_index = list_insert_oob(pop, redo, redo_index, oob_head,
+				obj_doffset, &oob_next_off, &oob_prev_off);
 
 	/* don't need to use redo log for filling new element */
-	list_fill_entry_persist(pop, oob_entry_ptr, oob_next_off, oob_prev_off);
+	list_fill_entry(pop, oob_entry_ptr, oob_next_off, oob_prev_off);
+
+	/* both new entries are persisted at once, with a single drain */
+	struct pmem_vec vec[2] = {
+		{ .addr = oob_entry_ptr, .len = sizeof (*oob_entry_ptr) },
+	};
+	size_t nvec = 1;
 
 	if (user_head) {
 		ASSERT((ssize_t)pe_offset >= 0);
@@ -853,10 +890,15 @@ list_insert_new(PMEMobjpool *pop, struct list_head *oob_head,
 			&next_offset, &prev_offset);
 
 		/* don't need to use redo log for filling new element */
-		list_fill_entry_persist(pop, entry_ptr,
-				next_offset, prev_offset);
+		list_fill_entry(pop, entry_ptr, next_offset, prev_offset);
+
+		vec[nvec].addr = entry_ptr;
+		vec[nvec].len = sizeof (*entry_ptr);
+		nvec++;
 	}
 
+	pop->persistv(pop, vec, nvec);
+
 	if (oidp != NULL) {
 		if (OBJ_PTR_IS_VALID(pop, oidp))
 			redo_index = list_set_oid_redo_log(pop, redo,
@@ -874,7 +916,8 @@ list_insert_new(PMEMobjpool *pop, struct list_head *oob_head,
 
 	ret = 0;
 
-	pmemobj_mutex_unlock_nofail(pop, &oob_head->lock);
+	if (oob_head)
+		pmemobj_mutex_unlock_nofail(pop, &oob_head->lock);
 err_pmalloc:
 	lane_release(pop);
 
@@ -890,14 +933,16 @@ err_pmalloc:
  * constructor - object's constructor
  * arg         - argument for object's constructor
  * oidp        - pointer to target object ID
+ * class_id    - allocation class of the object, 0 for the best fitting one
  */
 int
 list_insert_new_oob(PMEMobjpool *pop, struct list_head *oob_head,
 	size_t size, void (*constructor)(PMEMobjpool *pop, void *ptr,
-	size_t usable_size, void *arg), void *arg, PMEMoid *oidp)
+	size_t usable_size, void *arg), void *arg, PMEMoid *oidp,
+	uint8_t class_id)
 {
 	return list_insert_new(pop, oob_head, 0, NULL, OID_NULL,
-			0, size, constructor, arg, oidp);
+			0, size, constructor, arg, oidp, class_id);
 }
 
 /*
@@ -929,7 +974,7 @@ list_insert_new_user(PMEMobjpool *pop, struct list_head *oob_head,
 	}
 
 	ret = list_insert_new(pop, oob_head, pe_offset, user_head,
-			dest, before, size, constructor, arg, oidp);
+			dest, before, size, constructor, arg, oidp, 0);
 
 	if (user_head)
 		pmemobj_mutex_unlock_nofail(pop, &user_head->lock);
@@ -937,6 +982,231 @@ list_insert_new_user(PMEMobjpool *pop, struct list_head *oob_head,
 	return ret;
 }
 
+/*
+ * list_insert_oob_chain -- (internal) links new elements together and
+ *	inserts the whole chain at the last position of oob list
+ *
+ * The entries of new elements are only flushed, they are drained along with
+ * the redo log.
+ */
+static size_t
+list_insert_oob_chain(PMEMobjpool *pop, struct redo_log *redo,
+	size_t redo_index, struct list_head *oob_head, const uint64_t *offs,
+	size_t n)
+{
+	uint64_t first_offset = offs[0] + OBJ_OOB_SIZE;
+	uint64_t last_offset = offs[n - 1] + OBJ_OOB_SIZE;
+	uint64_t chain_next = 0;
+	uint64_t chain_prev = 0;
+
+	if (oob_head == NULL) {
+		/* the elements are not put on any list */
+	} else if (oob_head->pe_first.off == 0) {
+		chain_next = first_offset;
+		chain_prev = last_offset;
+
+		redo_index = list_update_head(pop, redo, redo_index,
+				oob_head, first_offset);
+	} else {
+		struct list_entry *first_ptr =
+			(struct list_entry *)OBJ_OFF_TO_PTR(pop,
+				OOB_ENTRY_OFF_OF(oob_head->pe_first.off));
+
+		chain_next = oob_head->pe_first.off;
+		chain_prev = first_ptr->pe_prev.off;
+
+		/* first->prev = last and first->prev->next = first */
+		redo_log_store(pop, redo, redo_index + 0,
+			OOB_ENTRY_OFF_OF(chain_next) + PREV_OFF, last_offset);
+		redo_log_store(pop, redo, redo_index + 1,
+			OOB_ENTRY_OFF_OF(chain_prev) + NEXT_OFF, first_offset);
+		redo_index += 2;
+	}
+
+	for (size_t i = 0; i < n; ++i) {
+		struct list_entry *entry_ptr =
+			(struct list_entry *)OBJ_OFF_TO_PTR(pop,
+				offs[i] + OOB_ENTRY_OFF);
+
+		uint64_t next_offset = chain_next;
+		uint64_t prev_offset = chain_prev;
+		if (oob_head != NULL && i + 1 < n)
+			next_offset = offs[i + 1] + OBJ_OOB_SIZE;
+		if (oob_head != NULL && i > 0)
+			prev_offset = offs[i - 1] + OBJ_OOB_SIZE;
+
+		list_fill_entry(pop, entry_ptr, next_offset, prev_offset);
+		pop->flush(pop, entry_ptr, sizeof (*entry_ptr));
+	}
+
+	return redo_index;
+}
+
+/*
+ * list_insert_new_batch -- allocate n elements and insert them to oob list
+ *
+ * pop         - pmemobj pool handle
+ * oob_head    - oob list head, NULL if the objects are not put on any
+ * size        - size of allocation, will be increased by OBJ_OOB_SIZE
+ * constructor - objects' constructor
+ * arg         - argument for objects' constructor
+ * oids        - array of n target object IDs
+ * n           - number of objects
+ *
+ * All the memory blocks are reserved up front, so either all the objects
+ * are allocated or none of them. The objects are then made persistent in
+ * groups which fit in the redo log of the lane, with a single redo log
+ * commit per group.
+ */
+int
+list_insert_new_batch(PMEMobjpool *pop, struct list_head *oob_head,
+	size_t size, void (*constructor)(PMEMobjpool *pop, void *ptr,
+	size_t usable_size, void *arg), void *arg, PMEMoid *oids, size_t n)
+{
+	LOG(3, NULL);
+
+	ASSERTne(n, 0);
+
+	uint64_t *offs = Malloc(n * sizeof (*offs));
+	if (offs == NULL) {
+		ERR("!Malloc");
+		return -1;
+	}
+
+	int ret;
+
+	struct lane_section *lane_section;
+
+	lane_hold(pop, &lane_section, LANE_SECTION_LIST);
+
+	ASSERTne(lane_section, NULL);
+	ASSERTne(lane_section->layout, NULL);
+
+	if ((ret = pmalloc_reserve_batch(pop, offs, n, size + OBJ_OOB_SIZE,
+			constructor, arg, OBJ_OOB_SIZE))) {
+		errno = ret;
+		ERR("!pmalloc_reserve_batch");
+		ret = -1;
+		goto out;
+	}
+
+	struct lane_list_section *section =
+		(struct lane_list_section *)lane_section->layout;
+	struct redo_log *redo = section->redo;
+
+	/* every object needs an entry for its header and two for its oid */
+	int oids_in_pool = OBJ_PTR_IS_VALID(pop, oids);
+	size_t max_group = (REDO_LOG_CAPACITY(REDO_NUM_ENTRIES) -
+		LIST_BATCH_INSERT_ENTRIES) / (oids_in_pool ? 3 : 1);
+
+	size_t group;
+	for (size_t i = 0; i < n; i += group) {
+		group = n - i < max_group ? n - i : max_group;
+
+		if (oob_head)
+			pmemobj_mutex_lock_nofail(pop, &oob_head->lock);
+
+		size_t redo_index = list_insert_oob_chain(pop, redo, 0,
+			oob_head, &offs[i], group);
+
+		for (size_t j = i; j < i + group; ++j) {
+			uint64_t obj_doffset = offs[j] + OBJ_OOB_SIZE;
+
+			if (oids_in_pool) {
+				redo_index = list_set_oid_redo_log(pop, redo,
+					redo_index, &oids[j], obj_doffset, 0);
+			} else {
+				oids[j].off = obj_doffset;
+				oids[j].pool_uuid_lo = pop->uuid_lo;
+			}
+		}
+
+		pmalloc_publish_batch(pop, &offs[i], group, redo, redo_index);
+
+		if (oob_head)
+			pmemobj_mutex_unlock_nofail(pop, &oob_head->lock);
+	}
+
+	ret = 0;
+
+out:
+	lane_release(pop);
+	Free(offs);
+
+	return ret;
+}
+
+/*
+ * list_publish -- insert reserved elements to their oob lists and set the
+ *	values of 8-byte fields, all in a single redo log commit
+ *
+ * pop         - pmemobj pool handle
+ * oob_heads   - oob list heads of the elements in address order, NULL for
+ *               elements not put on any list
+ * offs        - offsets of memory blocks reserved by pmalloc_reserve_batch
+ * nelems      - number of elements
+ * value_offs  - offsets of the fields
+ * values      - new values of the fields
+ * nvalues     - number of fields
+ *
+ * The caller is responsible for the redo log to have enough room.
+ */
+void
+list_publish(PMEMobjpool *pop, struct list_head **oob_heads,
+	const uint64_t *offs, size_t nelems, const uint64_t *value_offs,
+	const uint64_t *values, size_t nvalues)
+{
+	LOG(3, NULL);
+
+	struct lane_section *lane_section;
+
+	lane_hold(pop, &lane_section, LANE_SECTION_LIST);
+
+	ASSERTne(lane_section, NULL);
+	ASSERTne(lane_section->layout, NULL);
+
+	struct lane_list_section *section =
+		(struct lane_list_section *)lane_section->layout;
+	struct redo_log *redo = section->redo;
+	size_t redo_index = 0;
+
+	/* the heads are sorted, which gives the order of the locks */
+	for (size_t i = 0; i < nelems; ++i) {
+		if (oob_heads[i] != NULL &&
+				(i == 0 || oob_heads[i] != oob_heads[i - 1]))
+			pmemobj_mutex_lock_nofail(pop, &oob_heads[i]->lock);
+	}
+
+	size_t first = 0;
+	for (size_t i = 1; i <= nelems; ++i) {
+		if (i < nelems && oob_heads[i] == oob_heads[first])
+			continue;
+
+		redo_index = list_insert_oob_chain(pop, redo, redo_index,
+			oob_heads[first], &offs[first], i - first);
+		first = i;
+	}
+
+	for (size_t i = 0; i < nvalues; ++i)
+		redo_log_store(pop, redo, redo_index++, value_offs[i],
+			values[i]);
+
+	if (nelems != 0) {
+		pmalloc_publish_batch(pop, offs, nelems, redo, redo_index);
+	} else if (redo_index != 0) {
+		redo_log_set_last(pop, redo, redo_index - 1);
+		redo_log_process(pop, redo, REDO_NUM_ENTRIES);
+	}
+
+	for (size_t i = nelems; i-- > 0; ) {
+		if (oob_heads[i] != NULL &&
+				(i == 0 || oob_heads[i] != oob_heads[i - 1]))
+			pmemobj_mutex_unlock_nofail(pop, &oob_heads[i]->lock);
+	}
+
+	lane_release(pop);
+}
+
 /*
  * list_insert -- insert object to a single list
  *
@@ -1025,7 +1295,7 @@ err:
  * list_remove_free -- remove from two lists and free an object
  *
  * pop         - pmemobj pool handle
- * oob_head    - oob list head
+ * oob_head    - oob list head, NULL if the object is not on any
  * pe_offset   - offset to list entry on user list relative to user data
  * user_head   - user list head, *must* be locked if not NULL
  * oidp        - pointer to target object ID
@@ -1036,7 +1306,6 @@ list_remove_free(PMEMobjpool *pop, struct list_head *oob_head,
 	PMEMoid *oidp)
 {
 	LOG(3, NULL);
-	ASSERTne(oob_head, NULL);
 
 #ifdef DEBUG
 	if (user_head) {
@@ -1058,7 +1327,8 @@ list_remove_free(PMEMobjpool *pop, struct list_head *oob_head,
 	 *
 	 * XXX performance improvement: initialize oob locks at pool opening
 	 */
-	pmemobj_mutex_lock_nofail(pop, &oob_head->lock);
+	if (oob_head)
+		pmemobj_mutex_lock_nofail(pop, &oob_head->lock);
 
 	struct lane_list_section *section =
 		(struct lane_list_section *)lane_section->layout;
@@ -1081,7 +1351,9 @@ list_remove_free(PMEMobjpool *pop, struct list_head *oob_head,
 	};
 
 	/* remove from oob list */
-	redo_index = list_remove_single(pop, redo, redo_index, &oob_args);
+	if (oob_head)
+		redo_index = list_remove_single(pop, redo, redo_index,
+				&oob_args);
 
 	if (user_head) {
 		ASSERT((ssize_t)pe_offset >= 0);
@@ -1117,7 +1389,8 @@ list_remove_free(PMEMobjpool *pop, struct list_head *oob_head,
 	 * because the element is freed.
 	 */
 	pfree(pop, &section->obj_offset, OBJ_OOB_SIZE);
-	pmemobj_mutex_unlock_nofail(pop, &oob_head->lock);
+	if (oob_head)
+		pmemobj_mutex_unlock_nofail(pop, &oob_head->lock);
 	lane_release(pop);
 }
 
@@ -1167,6 +1440,149 @@ list_remove_free_user(PMEMobjpool *pop, struct list_head *oob_head,
 	return 0;
 }
 
+/*
+ * list_redo_load -- (internal) returns the value a field will have once the
+ *	entries already stored in the redo log are processed
+ */
+static uint64_t
+list_redo_load(PMEMobjpool *pop, struct redo_log *redo, size_t redo_index,
+	uint64_t offset)
+{
+	while (redo_index-- != 0) {
+		if (redo[redo_index].offset == offset)
+			return redo[redo_index].value;
+	}
+
+	return *(uint64_t *)OBJ_OFF_TO_PTR(pop, offset);
+}
+
+/*
+ * list_redo_store -- (internal) stores a new value of a field in the redo
+ *	log, replaces the value of the entry already stored for that field
+ */
+static size_t
+list_redo_store(PMEMobjpool *pop, struct redo_log *redo, size_t redo_index,
+	uint64_t offset, uint64_t value)
+{
+	for (size_t i = 0; i < redo_index; ++i) {
+		if (redo[i].offset == offset) {
+			redo[i].value = value;
+			return redo_index;
+		}
+	}
+
+	redo_log_store(pop, redo, redo_index, offset, value);
+
+	return redo_index + 1;
+}
+
+/*
+ * list_remove_oob_batch -- (internal) removes element from oob list on top
+ *	of the removals already stored in the redo log
+ */
+static size_t
+list_remove_oob_batch(PMEMobjpool *pop, struct redo_log *redo,
+	size_t redo_index, struct list_head *oob_head, uint64_t obj_doffset)
+{
+	uint64_t entry_off = OOB_ENTRY_OFF_OF(obj_doffset);
+	uint64_t head_off = OBJ_PTR_TO_OFF(pop, &oob_head->pe_first.off);
+
+	uint64_t next_off = list_redo_load(pop, redo, redo_index,
+		entry_off + NEXT_OFF);
+	uint64_t prev_off = list_redo_load(pop, redo, redo_index,
+		entry_off + PREV_OFF);
+	uint64_t first_off = list_redo_load(pop, redo, redo_index, head_off);
+
+	if (next_off == obj_doffset) {
+		/* only one element on list */
+		ASSERTeq(first_off, obj_doffset);
+		ASSERTeq(prev_off, obj_doffset);
+
+		return list_redo_store(pop, redo, redo_index, head_off, 0);
+	}
+
+	/* set next->prev = prev and prev->next = next */
+	redo_index = list_redo_store(pop, redo, redo_index,
+		OOB_ENTRY_OFF_OF(next_off) + PREV_OFF, prev_off);
+	redo_index = list_redo_store(pop, redo, redo_index,
+		OOB_ENTRY_OFF_OF(prev_off) + NEXT_OFF, next_off);
+
+	/* removing element is the first one */
+	if (first_off == obj_doffset)
+		redo_index = list_redo_store(pop, redo, redo_index,
+			head_off, next_off);
+
+	return redo_index;
+}
+
+/*
+ * list_remove_free_batch -- remove n elements from oob list and free them
+ *
+ * pop         - pmemobj pool handle
+ * oob_head    - oob list head, NULL if the objects are not on any
+ * oidps       - array of pointers to n target object IDs
+ * n           - number of objects
+ *
+ * The objects are removed in groups which fit in the redo log of the lane,
+ * with a single redo log commit per group.
+ */
+void
+list_remove_free_batch(PMEMobjpool *pop, struct list_head *oob_head,
+	PMEMoid **oidps, size_t n)
+{
+	LOG(3, NULL);
+
+	struct lane_section *lane_section;
+
+	lane_hold(pop, &lane_section, LANE_SECTION_LIST);
+
+	ASSERTne(lane_section, NULL);
+	ASSERTne(lane_section->layout, NULL);
+
+	struct lane_list_section *section =
+		(struct lane_list_section *)lane_section->layout;
+	struct redo_log *redo = section->redo;
+
+	uint64_t offs[REDO_NUM_ENTRIES];
+
+	size_t i = 0;
+	while (i < n) {
+		if (oob_head)
+			pmemobj_mutex_lock_nofail(pop, &oob_head->lock);
+
+		size_t redo_index = 0;
+		size_t nobjs = 0;
+
+		/* the headers are stored after the list and oid entries */
+		while (i < n && redo_index + nobjs +
+				LIST_BATCH_REMOVE_ENTRIES <=
+				REDO_LOG_CAPACITY(REDO_NUM_ENTRIES)) {
+			PMEMoid *oidp = oidps[i++];
+			uint64_t obj_doffset = oidp->off;
+
+			if (oob_head)
+				redo_index = list_remove_oob_batch(pop, redo,
+					redo_index, oob_head, obj_doffset);
+
+			/* clear the oid */
+			if (OBJ_PTR_IS_VALID(pop, oidp))
+				redo_index = list_set_oid_redo_log(pop, redo,
+					redo_index, oidp, 0, 1);
+			else
+				oidp->off = 0;
+
+			offs[nobjs++] = obj_doffset - OBJ_OOB_SIZE;
+		}
+
+		pfree_batch(pop, offs, nobjs, OBJ_OOB_SIZE, redo, redo_index);
+
+		if (oob_head)
+			pmemobj_mutex_unlock_nofail(pop, &oob_head->lock);
+	}
+
+	lane_release(pop);
+}
+
 /*
  * list_remove -- remove object from list
  *
@@ -1243,8 +1659,8 @@ err:
  * list_move_oob -- move element between two oob lists
  *
  * pop      - pmemobj pool handle
- * head_old - old list head
- * head_old - new list head
+ * head_old - old list head, NULL if the element is not on any list yet
+ * head_new - new list head, NULL to only remove the element from head_old
  * oid      - target object ID
  */
 void
@@ -1253,8 +1669,7 @@ list_move_oob(PMEMobjpool *pop,
 	PMEMoid oid)
 {
 	LOG(3, NULL);
-	ASSERTne(head_old, NULL);
-	ASSERTne(head_new, NULL);
+	ASSERT(head_old != NULL || head_new != NULL);
 	ASSERTne(head_old, head_new);
 
 	struct lane_section *lane_section;
@@ -1269,7 +1684,10 @@ list_move_oob(PMEMobjpool *pop,
 	 *
 	 * XXX performance improvement: initialize oob locks at pool opening
 	 */
-	list_mutexes_lock_nofail(pop, head_new, head_old);
+	if (head_new)
+		list_mutexes_lock_nofail(pop, head_new, head_old);
+	else
+		list_mutexes_lock_nofail(pop, head_old, NULL);
 
 	struct lane_list_section *section =
 		(struct lane_list_section *)lane_section->layout;
@@ -1296,25 +1714,35 @@ list_move_oob(PMEMobjpool *pop,
 		.pe_offset = OOB_ENTRY_OFF_REV,
 	};
 
-	uint64_t next_offset;
-	uint64_t prev_offset;
+	uint64_t next_offset = 0;
+	uint64_t prev_offset = 0;
 
 	/* remove element from oob list */
-	redo_index = list_remove_single(pop, redo, redo_index, &args_remove);
+	if (head_old)
+		redo_index = list_remove_single(pop, redo, redo_index,
+				&args_remove);
 
 	/* insert element to new oob list */
-	redo_index = list_insert_oob(pop, redo, redo_index,
+	if (head_new)
+		redo_index = list_insert_oob(pop, redo, redo_index,
 			head_new, obj_doffset, &next_offset, &prev_offset);
 
-	/* change next and prev offsets of moving element using redo log */
+	/*
+	 * Change next and prev offsets of moving element using redo log,
+	 * an element that was on no list might not have the pool uuid set.
+	 */
 	redo_index = list_fill_entry_redo_log(pop, redo, redo_index,
-			&args_common, next_offset, prev_offset, 0);
+			&args_common, next_offset, prev_offset,
+			head_old == NULL);
 
 	redo_log_set_last(pop, redo, redo_index - 1);
 
 	redo_log_process(pop, redo, REDO_NUM_ENTRIES);
 
-	list_mutexes_unlock(pop, head_new, head_old);
+	if (head_new)
+		list_mutexes_unlock(pop, head_new, head_old);
+	else
+		list_mutexes_unlock(pop, head_old, NULL);
 
 	lane_release(pop);
 }
@@ -1462,7 +1890,7 @@ err:
  * list_realloc -- realloc list member
  *
  * pop          - pmemobj pool handle
- * oob_head     - oob list head
+ * oob_head     - oob list head, NULL if the object is not on any
  * pe_offset    - offset to list entry on user list relative to user data
  * user_head    - user list head, *must* be locked if not NULL
  * size         - size of allocation, will be increased by OBJ_OOB_SIZE
@@ -1480,7 +1908,6 @@ list_realloc(PMEMobjpool *pop, struct list_head *oob_head,
 	uint64_t field_value, PMEMoid *oidp)
 {
 	LOG(3, NULL);
-	ASSERTne(oob_head, NULL);
 	ASSERTne(oidp, NULL);
 	ASSERTne(constructor, NULL);
 
@@ -1506,7 +1933,8 @@ list_realloc(PMEMobjpool *pop, struct list_head *oob_head,
 	 *
 	 * XXX performance improvement: initialize oob locks at pool opening
 	 */
-	pmemobj_mutex_lock_nofail(pop, &oob_head->lock);
+	if (oob_head)
+		pmemobj_mutex_lock_nofail(pop, &oob_head->lock);
 
 	/* increase allocation size by oob header size */
 	size += OBJ_OOB_SIZE;
@@ -1624,13 +2052,14 @@ list_realloc(PMEMobjpool *pop, struct list_head *oob_head,
 			.pe_offset = OOB_ENTRY_OFF_REV,
 		};
 
-		uint64_t next_offset;
-		uint64_t prev_offset;
+		uint64_t next_offset = 0;
+		uint64_t prev_offset = 0;
 
 		/* replace new item in first list */
-		redo_index = list_replace_single(pop, redo, redo_index,
-				&oob_args_reinsert, &oob_args_common,
-				&next_offset, &prev_offset);
+		if (oob_head)
+			redo_index = list_replace_single(pop, redo, redo_index,
+					&oob_args_reinsert, &oob_args_common,
+					&next_offset, &prev_offset);
 
 		/* fill next and prev offsets of new entry without redo log */
 		list_fill_entry_persist(pop, oob_new_entry_ptr,
@@ -1655,7 +2084,8 @@ list_realloc(PMEMobjpool *pop, struct list_head *oob_head,
 	ret = 0;
 
 err_unlock:
-	pmemobj_mutex_unlock_nofail(pop, &oob_head->lock);
+	if (oob_head)
+		pmemobj_mutex_unlock_nofail(pop, &oob_head->lock);
 	lane_release(pop);
 
 	return ret;
@@ -2104,6 +2534,28 @@ lane_list_check(PMEMobjpool *pop, struct lane_section_layout *section_layout)
 	return 0;
 }
 
+/*
+ * lane_list_check_idle -- (internal) checks if the list lane section of a pool
+ *	in the older format holds no pending operation
+ */
+static int
+lane_list_check_idle(PMEMobjpool *pop,
+	struct lane_section_layout *section_layout)
+{
+	LOG(3, "list lane %p", section_layout);
+
+	struct lane_list_section *section =
+		(struct lane_list_section *)section_layout;
+
+	if (section->obj_offset != 0 ||
+		redo_log_pending(section->redo, REDO_NUM_ENTRIES)) {
+		LOG(2, "list lane: pending operation");
+		return EINVAL;
+	}
+
+	return 0;
+}
+
 /*
  * lane_list_construct -- (internal) create list lane section
  */
@@ -2138,7 +2590,8 @@ static struct section_operations list_ops = {
 	.destruct = lane_list_destruct,
 	.recover = lane_list_recovery,
 	.check = lane_list_check,
-	.boot = lane_list_boot
+	.boot = lane_list_boot,
+	.check_idle = lane_list_check_idle
 };
 
 SECTION_PARM(LANE_SECTION_LIST, &list_ops);
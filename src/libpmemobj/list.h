@@ -62,7 +62,8 @@ struct list_head {
 
 int list_insert_new_oob(PMEMobjpool *pop, struct list_head *oob_head,
 	size_t size, void (*constructor)(PMEMobjpool *pop, void *ptr,
-	size_t usable_size, void *arg), void *arg, PMEMoid *oidp);
+	size_t usable_size, void *arg), void *arg, PMEMoid *oidp,
+	uint8_t class_id);
 
 int list_insert_new_user(PMEMobjpool *pop, struct list_head *oob_head,
 	size_t pe_offset, struct list_head *user_head, PMEMoid dest, int before,
@@ -93,6 +94,14 @@ int list_realloc_move_user(PMEMobjpool *pop, struct list_head *oob_head_old,
 	void *arg), void *arg, uint64_t field_offset, uint64_t field_value,
 	PMEMoid *oidp);
 
+int list_insert_new_batch(PMEMobjpool *pop, struct list_head *oob_head,
+	size_t size, void (*constructor)(PMEMobjpool *pop, void *ptr,
+	size_t usable_size, void *arg), void *arg, PMEMoid *oids, size_t n);
+
+void list_publish(PMEMobjpool *pop, struct list_head **oob_heads,
+	const uint64_t *offs, size_t nelems, const uint64_t *value_offs,
+	const uint64_t *values, size_t nvalues);
+
 int list_insert(PMEMobjpool *pop,
 	size_t pe_offset, struct list_head *head, PMEMoid dest, int before,
 	PMEMoid oid);
@@ -100,6 +109,9 @@ int list_insert(PMEMobjpool *pop,
 void list_remove_free_oob(PMEMobjpool *pop, struct list_head *oob_head,
 	PMEMoid *oidp);
 
+void list_remove_free_batch(PMEMobjpool *pop, struct list_head *oob_head,
+	PMEMoid **oidps, size_t n);
+
 int list_remove_free_user(PMEMobjpool *pop, struct list_head *oob_head,
 	size_t pe_offset, struct list_head *user_head,
 	PMEMoid *oidp);
@@ -104,6 +104,8 @@ obj_fini(void)
 	LOG(3, NULL);
 	cuckoo_delete(pools_ht);
 	ctree_delete(pools_tree);
+	lane_info_destroy();
+	pmalloc_cache_fini();
 }
 
 /*
@@ -141,6 +143,18 @@ nopmem_memset_persist(void *dest, int c, size_t len)
 	return dest;
 }
 
+/*
+ * nopmem_persistv -- (internal) msync each range separately
+ */
+static void
+nopmem_persistv(const struct pmem_vec *vec, size_t cnt)
+{
+	LOG(15, "vec %p cnt %zu", vec, cnt);
+
+	for (size_t i = 0; i < cnt; ++i)
+		pmem_msync(vec[i].addr, vec[i].len);
+}
+
 /*
  * XXX - Consider removing obj_norep_*() wrappers to call *_local()
  * functions directly.  Alternatively, always use obj_rep_*(), even
@@ -203,6 +217,28 @@ obj_norep_drain(PMEMobjpool *pop)
 	pop->drain_local();
 }
 
+/*
+ * obj_norep_persistv -- (internal) vectored persist w/o replication
+ */
+static void
+obj_norep_persistv(PMEMobjpool *pop, const struct pmem_vec *vec, size_t cnt)
+{
+	LOG(15, "pop %p vec %p cnt %zu", pop, vec, cnt);
+
+	pop->persistv_local(vec, cnt);
+}
+
+/*
+ * obj_norep_flushv -- (internal) vectored flush w/o replication
+ */
+static void
+obj_norep_flushv(PMEMobjpool *pop, const struct pmem_vec *vec, size_t cnt)
+{
+	LOG(15, "pop %p vec %p cnt %zu", pop, vec, cnt);
+
+	pop->flushv_local(vec, cnt);
+}
+
 /*
  * obj_rep_memcpy_persist -- (internal) memcpy with replication
  */
@@ -289,6 +325,48 @@ obj_rep_drain(PMEMobjpool *pop)
 	pop->drain_local();
 }
 
+/*
+ * obj_rep_persistv -- (internal) vectored persist with replication
+ */
+static void
+obj_rep_persistv(PMEMobjpool *pop, const struct pmem_vec *vec, size_t cnt)
+{
+	LOG(15, "pop %p vec %p cnt %zu", pop, vec, cnt);
+
+	PMEMobjpool *rep = pop->replica;
+	while (rep) {
+		for (size_t i = 0; i < cnt; ++i) {
+			void *raddr = (char *)rep +
+				(uintptr_t)vec[i].addr - (uintptr_t)pop;
+			rep->memcpy_persist_local(raddr, vec[i].addr,
+				vec[i].len);
+		}
+		rep = rep->replica;
+	}
+	pop->persistv_local(vec, cnt);
+}
+
+/*
+ * obj_rep_flushv -- (internal) vectored flush with replication
+ */
+static void
+obj_rep_flushv(PMEMobjpool *pop, const struct pmem_vec *vec, size_t cnt)
+{
+	LOG(15, "pop %p vec %p cnt %zu", pop, vec, cnt);
+
+	PMEMobjpool *rep = pop->replica;
+	while (rep) {
+		for (size_t i = 0; i < cnt; ++i) {
+			void *raddr = (char *)rep +
+				(uintptr_t)vec[i].addr - (uintptr_t)pop;
+			memcpy(raddr, vec[i].addr, vec[i].len);
+			rep->flush_local(raddr, vec[i].len);
+		}
+		rep = rep->replica;
+	}
+	pop->flushv_local(vec, cnt);
+}
+
 #ifdef USE_VG_MEMCHECK
 /*
  * pmemobj_vg_register_object -- (internal) notify Valgrind about object
@@ -466,6 +544,85 @@ pmemobj_boot(PMEMobjpool *pop)
 		return errno;
 	}
 
+	heap_populate_start(pop);
+
+	return 0;
+}
+
+/*
+ * pmemobj_lanes_config -- (internal) returns the number of lanes and the size
+ *	of lane sections of a pool to be created, the environment variables
+ *	only change the defaults of the attributes
+ */
+static int
+pmemobj_lanes_config(const struct pobj_create_attr *attr, uint64_t *nlanes,
+	uint64_t *section_len)
+{
+	*nlanes = OBJ_NLANES;
+	*section_len = LANE_SECTION_LEN;
+
+	char *env = getenv(OBJ_NLANES_VAR);
+	if (env) {
+		char *end;
+		errno = 0;
+		unsigned long long val = strtoull(env, &end, 0);
+		if (errno || *end != '\0' || val == 0 ||
+				val > OBJ_NLANES_MAX) {
+			ERR("invalid %s value \"%s\", must be between 1 and %d",
+				OBJ_NLANES_VAR, env, OBJ_NLANES_MAX);
+			errno = EINVAL;
+			return -1;
+		}
+		*nlanes = val;
+	}
+
+	env = getenv(OBJ_LANE_SECTION_LEN_VAR);
+	if (env) {
+		char *end;
+		errno = 0;
+		unsigned long long val = strtoull(env, &end, 0);
+		if (errno || *end != '\0' || val < LANE_SECTION_LEN ||
+				val > OBJ_LANE_SECTION_LEN_MAX ||
+				val % OBJ_LANE_SECTION_ALIGN) {
+			ERR("invalid %s value \"%s\", must be a multiple of %d "
+				"between %d and %d", OBJ_LANE_SECTION_LEN_VAR,
+				env, OBJ_LANE_SECTION_ALIGN, LANE_SECTION_LEN,
+				OBJ_LANE_SECTION_LEN_MAX);
+			errno = EINVAL;
+			return -1;
+		}
+		*section_len = val;
+	}
+
+	if (attr == NULL)
+		return 0;
+
+	if (attr->nlanes != 0) {
+		if (attr->nlanes > OBJ_NLANES_MAX) {
+			ERR("invalid number of lanes %ju, must be between 1 "
+				"and %d", attr->nlanes, OBJ_NLANES_MAX);
+			errno = EINVAL;
+			return -1;
+		}
+		*nlanes = attr->nlanes;
+	}
+
+	if (attr->lane_section_size != 0) {
+		if (attr->lane_section_size < LANE_SECTION_LEN ||
+				attr->lane_section_size >
+				OBJ_LANE_SECTION_LEN_MAX ||
+				attr->lane_section_size %
+				OBJ_LANE_SECTION_ALIGN) {
+			ERR("invalid lane section size %ju, must be a multiple "
+				"of %d between %d and %d",
+				attr->lane_section_size, OBJ_LANE_SECTION_ALIGN,
+				LANE_SECTION_LEN, OBJ_LANE_SECTION_LEN_MAX);
+			errno = EINVAL;
+			return -1;
+		}
+		*section_len = attr->lane_section_size;
+	}
+
 	return 0;
 }
 
@@ -473,9 +630,11 @@ pmemobj_boot(PMEMobjpool *pop)
  * pmemobj_descr_create -- (internal) create obj pool descriptor
  */
 static int
-pmemobj_descr_create(PMEMobjpool *pop, const char *layout, size_t poolsize)
+pmemobj_descr_create(PMEMobjpool *pop, const char *layout, size_t poolsize,
+	uint64_t nlanes, uint64_t section_len)
 {
-	LOG(3, "pop %p layout %s poolsize %zu", pop, layout, poolsize);
+	LOG(3, "pop %p layout %s poolsize %zu nlanes %ju section_len %ju",
+		pop, layout, poolsize, nlanes, section_len);
 
 	ASSERTeq(poolsize % Pagesize, 0);
 
@@ -493,20 +652,25 @@ pmemobj_descr_create(PMEMobjpool *pop, const char *layout, size_t poolsize)
 	pmem_msync(&pop->run_id, sizeof (pop->run_id));
 
 	pop->lanes_offset = OBJ_LANES_OFFSET;
-	pop->nlanes = OBJ_NLANES;
+	pop->nlanes = nlanes;
+	pop->lane_section_len = section_len;
+
+	if (pop->lanes_offset + OBJ_LANES_SIZE(pop) >= poolsize) {
+		ERR("pool size %zu too small for %ju lanes of %ju bytes",
+			poolsize, nlanes, OBJ_LANE_SIZE(pop));
+		errno = EINVAL;
+		return -1;
+	}
 
 	/* zero all lanes */
 	void *lanes_layout = (void *)((uintptr_t)pop +
 						pop->lanes_offset);
 
-	memset(lanes_layout, 0,
-		pop->nlanes * sizeof (struct lane_layout));
-	pmem_msync(lanes_layout, pop->nlanes *
-		sizeof (struct lane_layout));
+	memset(lanes_layout, 0, OBJ_LANES_SIZE(pop));
+	pmem_msync(lanes_layout, OBJ_LANES_SIZE(pop));
 
 	/* initialization of the obj_store */
-	pop->obj_store_offset = pop->lanes_offset +
-		pop->nlanes * sizeof (struct lane_layout);
+	pop->obj_store_offset = pop->lanes_offset + OBJ_LANES_SIZE(pop);
 	pop->obj_store_size = (PMEMOBJ_NUM_OID_TYPES + 1) *
 		sizeof (struct object_store_item);
 		/* + 1 - for root object */
@@ -516,6 +680,12 @@ pmemobj_descr_create(PMEMobjpool *pop, const char *layout, size_t poolsize)
 
 	pop->heap_offset = pop->obj_store_offset + pop->obj_store_size;
 	pop->heap_offset = (pop->heap_offset + Pagesize - 1) & ~(Pagesize - 1);
+	if (pop->heap_offset >= poolsize) {
+		ERR("pool size %zu too small for %ju lanes of %ju bytes",
+			poolsize, nlanes, OBJ_LANE_SIZE(pop));
+		errno = EINVAL;
+		return -1;
+	}
 	pop->heap_size = poolsize - pop->heap_offset;
 
 	/* initialize heap prior to storing the checksum */
@@ -558,6 +728,28 @@ pmemobj_descr_check(PMEMobjpool *pop, const char *layout, size_t poolsize)
 		return -1;
 	}
 
+	if (pop->nlanes == 0 || pop->nlanes > OBJ_NLANES_MAX) {
+		ERR("invalid number of lanes %ju", pop->nlanes);
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (OBJ_LANE_SECTION_LEN(pop) < LANE_SECTION_LEN ||
+	    OBJ_LANE_SECTION_LEN(pop) > OBJ_LANE_SECTION_LEN_MAX ||
+	    OBJ_LANE_SECTION_LEN(pop) % OBJ_LANE_SECTION_ALIGN) {
+		ERR("invalid lane section size %ju", pop->lane_section_len);
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (pop->lanes_offset + OBJ_LANES_SIZE(pop) > pop->obj_store_offset) {
+		ERR("lanes overlap the object store: %ju > %ju",
+			pop->lanes_offset + OBJ_LANES_SIZE(pop),
+			pop->obj_store_offset);
+		errno = EINVAL;
+		return -1;
+	}
+
 	if (pop->size < poolsize) {
 		ERR("replica size smaller than pool size: %zu < %zu",
 			pop->size, poolsize);
@@ -603,12 +795,16 @@ pmemobj_replica_init(PMEMobjpool *pop, int is_pmem)
 		pop->persist_local = pmem_persist;
 		pop->flush_local = pmem_flush;
 		pop->drain_local = pmem_drain;
+		pop->persistv_local = pmem_persistv;
+		pop->flushv_local = pmem_flushv;
 		pop->memcpy_persist_local = pmem_memcpy_persist;
 		pop->memset_persist_local = pmem_memset_persist;
 	} else {
 		pop->persist_local = (persist_local_fn)pmem_msync;
 		pop->flush_local = (flush_local_fn)pmem_msync;
 		pop->drain_local = drain_empty;
+		pop->persistv_local = nopmem_persistv;
+		pop->flushv_local = nopmem_persistv;
 		pop->memcpy_persist_local = nopmem_memcpy_persist;
 		pop->memset_persist_local = nopmem_memset_persist;
 	}
@@ -617,6 +813,8 @@ pmemobj_replica_init(PMEMobjpool *pop, int is_pmem)
 	pop->persist = obj_norep_persist;
 	pop->flush = obj_norep_flush;
 	pop->drain = obj_norep_drain;
+	pop->persistv = obj_norep_persistv;
+	pop->flushv = obj_norep_flushv;
 	pop->memcpy_persist = obj_norep_memcpy_persist;
 	pop->memset_persist = obj_norep_memset_persist;
 
@@ -636,6 +834,8 @@ pmemobj_runtime_init(PMEMobjpool *pop, int rdonly, int boot)
 		pop->persist = obj_rep_persist;
 		pop->flush = obj_rep_flush;
 		pop->drain = obj_rep_drain;
+		pop->persistv = obj_rep_persistv;
+		pop->flushv = obj_rep_flushv;
 		pop->memcpy_persist = obj_rep_memcpy_persist;
 		pop->memset_persist = obj_rep_memset_persist;
 	}
@@ -653,10 +853,13 @@ pmemobj_runtime_init(PMEMobjpool *pop, int rdonly, int boot)
 	 */
 	pop->rdonly = rdonly;
 	pop->lanes = NULL;
+	pop->reclaimer = NULL;
 
 	pop->uuid_lo = pmemobj_get_uuid_lo(pop);
 	pop->store = (struct object_store *)
 			((uintptr_t)pop + pop->obj_store_offset);
+	pop->no_type_lists = (le32toh(pop->hdr.incompat_features) &
+			OBJ_INCOMPAT_NO_TYPE_LISTS) != 0;
 
 	if (boot) {
 		if ((errno = pmemobj_boot(pop)) != 0)
@@ -672,6 +875,9 @@ pmemobj_runtime_init(PMEMobjpool *pop, int rdonly, int boot)
 			ERR("!ctree_insert");
 			return -1;
 		}
+
+		if ((errno = lane_reclaimer_start(pop)) != 0)
+			return -1;
 	}
 
 	/*
@@ -686,14 +892,16 @@ pmemobj_runtime_init(PMEMobjpool *pop, int rdonly, int boot)
 }
 
 /*
- * pmemobj_create -- create a transactional memory pool (set)
+ * pmemobj_create_common -- (internal) create a transactional memory pool (set)
+ *	with the given incompat features and attributes
  */
-PMEMobjpool *
-pmemobj_create(const char *path, const char *layout, size_t poolsize,
-		mode_t mode)
+static PMEMobjpool *
+pmemobj_create_common(const char *path, const char *layout, size_t poolsize,
+		mode_t mode, uint32_t incompat,
+		const struct pobj_create_attr *attr)
 {
-	LOG(3, "path %s layout %s poolsize %zu mode %o",
-			path, layout, poolsize, mode);
+	LOG(3, "path %s layout %s poolsize %zu mode %o incompat %#x",
+			path, layout, poolsize, mode, incompat);
 
 	/* check length of layout */
 	if (layout && (strlen(layout) >= PMEMOBJ_MAX_LAYOUT)) {
@@ -702,11 +910,19 @@ pmemobj_create(const char *path, const char *layout, size_t poolsize,
 		return NULL;
 	}
 
+	uint64_t nlanes;
+	uint64_t section_len;
+	if (pmemobj_lanes_config(attr, &nlanes, &section_len) != 0)
+		return NULL;
+
+	if (section_len != LANE_SECTION_LEN)
+		incompat |= OBJ_INCOMPAT_LANE_SECTION_LEN;
+
 	struct pool_set *set;
 
 	if (util_pool_create(&set, path, poolsize, PMEMOBJ_MIN_POOL,
 			OBJ_HDR_SIG, OBJ_FORMAT_MAJOR,
-			OBJ_FORMAT_COMPAT, OBJ_FORMAT_INCOMPAT,
+			OBJ_FORMAT_COMPAT, incompat,
 			OBJ_FORMAT_RO_COMPAT) != 0) {
 		LOG(2, "cannot create pool or pool set");
 		return NULL;
@@ -727,7 +943,8 @@ pmemobj_create(const char *path, const char *layout, size_t poolsize,
 		pop->size = rep->repsize;
 
 		/* create pool descriptor */
-		if (pmemobj_descr_create(pop, layout, set->poolsize) != 0) {
+		if (pmemobj_descr_create(pop, layout, set->poolsize,
+				nlanes, section_len) != 0) {
 			LOG(2, "descriptor creation failed");
 			goto err;
 		}
@@ -778,6 +995,46 @@ err:
 	return NULL;
 }
 
+/*
+ * pmemobj_create -- create a transactional memory pool (set)
+ */
+PMEMobjpool *
+pmemobj_create(const char *path, const char *layout, size_t poolsize,
+		mode_t mode)
+{
+	LOG(3, "path %s layout %s poolsize %zu mode %o",
+			path, layout, poolsize, mode);
+
+	return pmemobj_create_common(path, layout, poolsize, mode,
+			OBJ_FORMAT_INCOMPAT, NULL);
+}
+
+/*
+ * pmemobj_xcreate -- create a transactional memory pool (set) with extra flags
+ *	and attributes
+ */
+PMEMobjpool *
+pmemobj_xcreate(const char *path, const char *layout, size_t poolsize,
+		mode_t mode, uint64_t flags,
+		const struct pobj_create_attr *attr)
+{
+	LOG(3, "path %s layout %s poolsize %zu mode %o flags 0x%jx attr %p",
+			path, layout, poolsize, mode, flags, attr);
+
+	if (flags & ~POBJ_XCREATE_VALID_FLAGS) {
+		ERR("unknown flags 0x%jx", flags & ~POBJ_XCREATE_VALID_FLAGS);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	uint32_t incompat = OBJ_FORMAT_INCOMPAT;
+	if (flags & POBJ_XCREATE_NO_TYPE_LISTS)
+		incompat |= OBJ_INCOMPAT_NO_TYPE_LISTS;
+
+	return pmemobj_create_common(path, layout, poolsize, mode, incompat,
+			attr);
+}
+
 /*
  * pmemobj_check_basic -- (internal) basic pool consistency check
  *
@@ -808,6 +1065,41 @@ pmemobj_check_basic(PMEMobjpool *pop)
 	return consistent;
 }
 
+/*
+ * pmemobj_upgrade -- (internal) takes over a pool created by an older version
+ *	of the library
+ *
+ * Such a pool differs only in the format of the logs kept in the lanes.
+ * If all of them are empty, the mandatory features are set in the headers of
+ * all the parts and the pool is used as is. Otherwise it has to be recovered
+ * by the older version of the library first. A copy-on-write mapping is only
+ * checked, the pool file is left intact.
+ */
+static int
+pmemobj_upgrade(struct pool_set *set, int cow)
+{
+	PMEMobjpool *pop = set->replica[0]->part[0].addr;
+
+	LOG(3, "pop %p cow %d", pop, cow);
+
+	if (lane_check_idle(pop) != 0) {
+		ERR("pool created by an older version of the library "
+			"has to be recovered by it first");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (cow)
+		return 0;
+
+	if (util_poolset_set_incompat(set, OBJ_FORMAT_INCOMPAT) != 0) {
+		ERR("cannot update pool headers");
+		return -1;
+	}
+
+	return 0;
+}
+
 /*
  * pmemobj_open_common -- open a transactional memory pool (set)
  *
@@ -823,7 +1115,7 @@ pmemobj_open_common(const char *path, const char *layout, int cow, int boot)
 
 	if (util_pool_open(&set, path, cow, PMEMOBJ_MIN_POOL,
 			OBJ_HDR_SIG, OBJ_FORMAT_MAJOR,
-			OBJ_FORMAT_COMPAT, OBJ_FORMAT_INCOMPAT,
+			OBJ_FORMAT_COMPAT, OBJ_FORMAT_INCOMPAT_SUPPORTED,
 			OBJ_FORMAT_RO_COMPAT) != 0) {
 		LOG(2, "cannot open pool or pool set");
 		return NULL;
@@ -884,7 +1176,7 @@ pmemobj_open_common(const char *path, const char *layout, int cow, int boot)
 		/* copy lanes */
 		pop = set->replica[0]->part[0].addr;
 		void *src = (void *)((uintptr_t)pop + pop->lanes_offset);
-		size_t len = pop->nlanes * sizeof (struct lane_layout);
+		size_t len = OBJ_LANES_SIZE(pop);
 
 		for (unsigned r = 1; r < set->nreplicas; r++) {
 			pop = set->replica[r]->part[0].addr;
@@ -895,6 +1187,13 @@ pmemobj_open_common(const char *path, const char *layout, int cow, int boot)
 	}
 
 	pop = set->replica[0]->part[0].addr;
+
+	if ((le32toh(pop->hdr.incompat_features) & OBJ_FORMAT_INCOMPAT) !=
+			OBJ_FORMAT_INCOMPAT && pmemobj_upgrade(set, cow) != 0) {
+		LOG(2, "cannot upgrade pool");
+		goto err;
+	}
+
 	pop->is_master_replica = 1;
 
 	for (unsigned r = 1; r < set->nreplicas; r++) {
@@ -953,6 +1252,11 @@ pmemobj_cleanup(PMEMobjpool *pop)
 {
 	LOG(3, "pop %p", pop);
 
+	/* the reclaimer needs the heap to finish the work of queued lanes */
+	lane_reclaimer_stop(pop);
+
+	pmalloc_cache_cleanup(pop);
+
 	heap_cleanup(pop);
 
 	lane_cleanup(pop);
@@ -964,6 +1268,7 @@ pmemobj_cleanup(PMEMobjpool *pop)
 	do {
 		rep = pop->replica;
 		VALGRIND_REMOVE_PMEM_MAPPING(pop->addr, pop->size);
+		pmem_ranges_delete(pop->addr, pop->size);
 		util_unmap(pop->addr, pop->size);
 		pop = rep;
 	} while (pop);
@@ -1029,6 +1334,7 @@ pmemobj_check(const char *path, const char *layout)
 		do {
 			rep = pop->replica;
 			VALGRIND_REMOVE_PMEM_MAPPING(pop->addr, pop->size);
+			pmem_ranges_delete(pop->addr, pop->size);
 			util_unmap(pop->addr, pop->size);
 			pop = rep;
 		} while (pop);
@@ -1104,10 +1410,12 @@ constructor_alloc_bytype(PMEMobjpool *pop, void *ptr,
 		sizeof (pobj->data.internal_type) +
 		sizeof (pobj->data.user_type));
 
+	/*
+	 * The header is drained by the redo log commit which makes the object
+	 * persistently allocated.
+	 */
 	if (carg->zero_init)
 		pop->memset_persist(pop, ptr, 0, usable_size);
-	else
-		pop->drain(pop);
 
 	VALGRIND_DO_MAKE_MEM_NOACCESS(pop, &pobj->data.padding,
 			sizeof (pobj->data.padding));
@@ -1123,7 +1431,7 @@ static int
 obj_alloc_construct(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 	type_num_t type_num, int zero_init,
 	void (*constructor)(PMEMobjpool *pop, void *ptr, void *arg),
-	void *arg)
+	void *arg, uint8_t class_id)
 {
 	/* callers should have checked this */
 	ASSERT(type_num < PMEMOBJ_NUM_OID_TYPES);
@@ -1134,7 +1442,7 @@ obj_alloc_construct(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 		return -1;
 	}
 
-	struct list_head *lhead = &pop->store->bytype[type_num].head;
+	struct list_head *lhead = OBJ_TYPE_LIST(pop, type_num);
 	struct carg_bytype carg;
 
 	carg.user_type = type_num;
@@ -1143,7 +1451,7 @@ obj_alloc_construct(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 	carg.arg = arg;
 
 	return list_insert_new_oob(pop, lhead, size, constructor_alloc_bytype,
-			&carg, oidp);
+			&carg, oidp, class_id);
 }
 
 /*
@@ -1173,29 +1481,19 @@ pmemobj_alloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 	}
 
 	return obj_alloc_construct(pop, oidp, size, (type_num_t)type_num,
-			0, constructor, arg);
+			0, constructor, arg, 0);
 }
 
-/* arguments for constructor_realloc and constructor_zrealloc */
-struct carg_realloc {
-	void *ptr;
-	size_t old_size;
-	size_t new_size;
-	int zero_init;
-	type_num_t user_type;
-	void (*constructor)(PMEMobjpool *pop, void *ptr, void *arg);
-	void *arg;
-};
-
 /*
- * pmemobj_zalloc -- allocates a new zeroed object
+ * pmemobj_xalloc -- allocates a new object with extra flags
  */
 int
-pmemobj_zalloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
-		unsigned int type_num)
+pmemobj_xalloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
+	unsigned int type_num, uint64_t flags,
+	void (*constructor)(PMEMobjpool *pop, void *ptr, void *arg), void *arg)
 {
-	LOG(3, "pop %p oidp %p size %zu type_num %u",
-			pop, oidp, size, type_num);
+	LOG(3, "pop %p oidp %p size %zu type_num %u flags 0x%jx constructor %p "
+		"arg %p", pop, oidp, size, type_num, flags, constructor, arg);
 
 	/* log notice message if used inside a transaction */
 	_POBJ_DEBUG_NOTICE_IN_TX();
@@ -1212,90 +1510,397 @@ pmemobj_zalloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 		return -1;
 	}
 
-	return obj_alloc_construct(pop, oidp, size, (type_num_t)type_num,
-					1, NULL, NULL);
-}
-
-/*
- * obj_free -- (internal) free an object
- */
-static void
-obj_free(PMEMobjpool *pop, PMEMoid *oidp)
-{
-	struct oob_header *pobj = OOB_HEADER_FROM_OID(pop, *oidp);
+	if (flags & ~POBJ_XALLOC_VALID_FLAGS) {
+		errno = EINVAL;
+		ERR("unknown flags 0x%jx", flags & ~POBJ_XALLOC_VALID_FLAGS);
+		return -1;
+	}
 
-	ASSERT(pobj->data.user_type < PMEMOBJ_NUM_OID_TYPES);
+	uint64_t class_id = (flags & POBJ_XALLOC_CLASS_MASK) >>
+		POBJ_XALLOC_CLASS_SHIFT;
+	if (class_id > UINT8_MAX) {
+		errno = EINVAL;
+		ERR("invalid allocation class %ju", class_id);
+		return -1;
+	}
 
-	void *lhead = &pop->store->bytype[pobj->data.user_type].head;
-	list_remove_free_oob(pop, lhead, oidp);
+	return obj_alloc_construct(pop, oidp, size, (type_num_t)type_num,
+			(flags & POBJ_XALLOC_ZERO) != 0, constructor, arg,
+			(uint8_t)class_id);
 }
 
 /*
- * constructor_realloc -- (internal) constructor for pmemobj_realloc
+ * pmemobj_alloc_batch -- allocates n objects of the same size and type
  */
-static void
-constructor_realloc(PMEMobjpool *pop, void *ptr, size_t usable_size, void *arg)
+int
+pmemobj_alloc_batch(PMEMobjpool *pop, PMEMoid oids[], size_t n, size_t size,
+	unsigned int type_num, void (*constructor)(PMEMobjpool *pop, void *ptr,
+	void *arg), void *arg)
 {
-	LOG(3, "pop %p ptr %p arg %p", pop, ptr, arg);
+	LOG(3, "pop %p oids %p n %zu size %zu type_num %u constructor %p "
+		"arg %p", pop, oids, n, size, type_num, constructor, arg);
 
-	ASSERTne(ptr, NULL);
-	ASSERTne(arg, NULL);
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
 
-	struct carg_realloc *carg = arg;
-	struct oob_header *pobj = OOB_HEADER_FROM_PTR(ptr);
+	if (n == 0)
+		return 0;
 
-	if (ptr != carg->ptr) {
-		size_t cpy_size = carg->new_size > carg->old_size ?
-			carg->old_size : carg->new_size;
+	if (oids == NULL) {
+		ERR("NULL object ids array");
+		errno = EINVAL;
+		return -1;
+	}
 
-		pobj->data.internal_type = TYPE_ALLOCATED;
-		pobj->data.user_type = carg->user_type;
+	if (size == 0) {
+		ERR("allocation with size 0");
+		errno = EINVAL;
+		return -1;
+	}
 
-		pop->flush(pop, &pobj->data.internal_type,
-		/* there's no padding between these, so we can add sizes */
-			sizeof (pobj->data.internal_type) +
-			sizeof (pobj->data.user_type));
+	if (type_num >= PMEMOBJ_NUM_OID_TYPES) {
+		errno = EINVAL;
+		ERR("invalid type_num %u", type_num);
+		return -1;
+	}
 
-		pop->memcpy_persist(pop, ptr, carg->ptr, cpy_size);
+	if (size > PMEMOBJ_MAX_ALLOC_SIZE) {
+		ERR("requested size too large");
+		errno = ENOMEM;
+		return -1;
 	}
 
-	if (!carg->zero_init)
-		return;
+	struct carg_bytype carg;
 
-	if (usable_size > carg->old_size) {
-		size_t grow_len = usable_size - carg->old_size;
-		void *new_data_ptr = (void *)((uintptr_t)ptr + carg->old_size);
+	carg.user_type = (type_num_t)type_num;
+	carg.zero_init = 0;
+	carg.constructor = constructor;
+	carg.arg = arg;
 
-		pop->memset_persist(pop, new_data_ptr, 0, grow_len);
-	}
+	return list_insert_new_batch(pop, OBJ_TYPE_LIST(pop, type_num), size,
+			constructor_alloc_bytype, &carg, oids, n);
 }
 
 /*
- * obj_realloc_common -- (internal) common routine for resizing
- *                          existing objects
+ * pmemobj_alloc_class_register -- registers an allocation class for objects
+ *	of the given usable size
  */
-static int
-obj_realloc_common(PMEMobjpool *pop, struct object_store *store,
-	PMEMoid *oidp, size_t size, type_num_t type_num, int zero_init)
+int
+pmemobj_alloc_class_register(PMEMobjpool *pop, size_t unit_size,
+	unsigned units_per_run)
 {
+	LOG(3, "pop %p unit_size %zu units_per_run %u",
+		pop, unit_size, units_per_run);
 
-	/* if OID is NULL just allocate memory */
-	if (OBJ_OID_IS_NULL(*oidp)) {
-		/* if size is 0 - do nothing */
-		if (size == 0)
-			return 0;
-
-		return obj_alloc_construct(pop, oidp, size, type_num,
-				zero_init, NULL, NULL);
+	if (unit_size == 0 || unit_size % sizeof (uint64_t) != 0) {
+		errno = EINVAL;
+		ERR("invalid unit size %zu", unit_size);
+		return -1;
 	}
 
-	if (size > PMEMOBJ_MAX_ALLOC_SIZE) {
-		ERR("requested size too large");
-		errno = ENOMEM;
+	uint8_t class_id;
+	int ret = pmalloc_class_register(pop, unit_size + OBJ_OOB_SIZE,
+		units_per_run, &class_id);
+	if (ret != 0) {
+		errno = ret;
+		ERR("!cannot register allocation class");
 		return -1;
 	}
 
-	/* if size is 0 just free */
+	return class_id;
+}
+
+/*
+ * pmemobj_heap_stats -- returns the statistics of the pool heap
+ */
+int
+pmemobj_heap_stats(PMEMobjpool *pop, struct pobj_heap_stats *stats)
+{
+	LOG(3, "pop %p stats %p", pop, stats);
+
+	heap_get_stats(pop, stats);
+
+	return 0;
+}
+
+/*
+ * obj_defrag_tx -- (internal) moves the objects to new locations and
+ *	lets the application update the references, all in one transaction
+ *
+ * If successful function returns zero. Otherwise an error number is returned.
+ */
+static int
+obj_defrag_tx(PMEMobjpool *pop, struct pobj_remap *remap, size_t nremap,
+	pmemobj_relocate_fn relocate, void *arg)
+{
+	if (pmemobj_tx_begin(pop, NULL, TX_LOCK_NONE) != 0)
+		return pmemobj_tx_end();
+
+	for (size_t i = 0; i < nremap; ++i) {
+		PMEMoid old = remap[i].old_oid;
+		size_t size = pmemobj_alloc_usable_size(old);
+
+		remap[i].new_oid = pmemobj_tx_alloc(size,
+			(unsigned)pmemobj_type_num(old));
+		if (OBJ_OID_IS_NULL(remap[i].new_oid))
+			goto out;
+
+		pop->memcpy_persist(pop, pmemobj_direct(remap[i].new_oid),
+			pmemobj_direct(old), size);
+	}
+
+	if (relocate(pop, remap, nremap, arg) != 0) {
+		if (pmemobj_tx_stage() == TX_STAGE_WORK)
+			pmemobj_tx_abort(ECANCELED);
+		goto out;
+	}
+
+	for (size_t i = 0; i < nremap; ++i) {
+		if (pmemobj_tx_free(remap[i].old_oid) != 0)
+			goto out;
+	}
+
+	pmemobj_tx_commit();
+
+out:
+	return pmemobj_tx_end();
+}
+
+/*
+ * obj_defrag_relocate -- (internal) relocates the objects of a run
+ *
+ * The old objects are freed before returning, even if the background
+ * reclaimer would take care of them, otherwise the run couldn't be released.
+ *
+ * If successful function returns zero. Otherwise an error number is returned.
+ */
+static int
+obj_defrag_relocate(PMEMobjpool *pop, struct pobj_remap *remap, size_t nremap,
+	pmemobj_relocate_fn relocate, void *arg)
+{
+	struct lane_section *section;
+	lane_hold(pop, &section, LANE_SECTION_TRANSACTION);
+
+	int err = obj_defrag_tx(pop, remap, nremap, relocate, arg);
+
+	lane_reclaim_held(pop);
+	lane_release(pop);
+
+	return err;
+}
+
+/*
+ * pmemobj_defrag -- moves the objects out of the sparsely used runs, so that
+ *	the runs can be given back to the heap
+ *
+ * Every call evacuates at most max_runs runs and carries on where the
+ * previous one stopped.
+ */
+int
+pmemobj_defrag(PMEMobjpool *pop, unsigned max_occupancy, size_t max_runs,
+	pmemobj_relocate_fn relocate, void *arg,
+	struct pobj_defrag_result *result)
+{
+	LOG(3, "pop %p max_occupancy %u max_runs %zu", pop, max_occupancy,
+		max_runs);
+
+	if (max_occupancy >= 100 || relocate == NULL) {
+		errno = EINVAL;
+		ERR("invalid defragmentation parameters");
+		return -1;
+	}
+
+	if (pmemobj_tx_stage() != TX_STAGE_NONE) {
+		errno = EINVAL;
+		ERR("cannot defragment the heap inside a transaction");
+		return -1;
+	}
+
+	struct pobj_defrag_result res = {0, 0, 0};
+
+	uint64_t *offs = Malloc(sizeof (*offs) * RUN_BITMAP_SIZE);
+	struct pobj_remap *remap = Malloc(sizeof (*remap) * RUN_BITMAP_SIZE);
+	if (offs == NULL || remap == NULL) {
+		ERR("!Malloc");
+		Free(offs);
+		Free(remap);
+		return -1;
+	}
+
+	int err = 0;
+	for (size_t nruns = 0; nruns < max_runs && err == 0; ++nruns) {
+		unsigned n;
+		if ((err = pmalloc_defrag_begin(pop, max_occupancy,
+				offs, &n)) != 0) {
+			if (err == ENOENT) {
+				res.complete = 1;
+				err = 0;
+			}
+			break;
+		}
+
+		/*
+		 * Only the objects on the type lists are relocated, the root
+		 * object and the undo logs of transactions stay where they are.
+		 */
+		size_t nremap = 0;
+		for (unsigned i = 0; i < n; ++i) {
+			struct oob_header *oobh = OBJ_OFF_TO_PTR(pop, offs[i]);
+			if (oobh->data.internal_type != TYPE_ALLOCATED ||
+				oobh->data.user_type >= PMEMOBJ_NUM_OID_TYPES) {
+				nremap = 0;
+				break;
+			}
+
+			remap[nremap].old_oid.pool_uuid_lo = pop->uuid_lo;
+			remap[nremap].old_oid.off = offs[i] + OBJ_OOB_SIZE;
+			remap[nremap].new_oid = OID_NULL;
+			nremap++;
+		}
+
+		if (nremap == n && n != 0 && (err = obj_defrag_relocate(pop,
+				remap, nremap, relocate, arg)) == 0)
+			res.relocated += nremap;
+
+		if (pmalloc_defrag_release(pop))
+			res.runs_released++;
+	}
+
+	Free(offs);
+	Free(remap);
+
+	if (result != NULL)
+		*result = res;
+
+	if (err != 0) {
+		errno = err;
+		ERR("!defragmentation stopped");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* arguments for constructor_realloc and constructor_zrealloc */
+struct carg_realloc {
+	void *ptr;
+	size_t old_size;
+	size_t new_size;
+	int zero_init;
+	type_num_t user_type;
+	void (*constructor)(PMEMobjpool *pop, void *ptr, void *arg);
+	void *arg;
+};
+
+/*
+ * pmemobj_zalloc -- allocates a new zeroed object
+ */
+int
+pmemobj_zalloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
+		unsigned int type_num)
+{
+	LOG(3, "pop %p oidp %p size %zu type_num %u",
+			pop, oidp, size, type_num);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	if (size == 0) {
+		ERR("allocation with size 0");
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (type_num >= PMEMOBJ_NUM_OID_TYPES) {
+		errno = EINVAL;
+		ERR("invalid type_num %u", type_num);
+		return -1;
+	}
+
+	return obj_alloc_construct(pop, oidp, size, (type_num_t)type_num,
+					1, NULL, NULL, 0);
+}
+
+/*
+ * obj_free -- (internal) free an object
+ */
+static void
+obj_free(PMEMobjpool *pop, PMEMoid *oidp)
+{
+	struct oob_header *pobj = OOB_HEADER_FROM_OID(pop, *oidp);
+
+	ASSERT(pobj->data.user_type < PMEMOBJ_NUM_OID_TYPES);
+
+	void *lhead = OBJ_TYPE_LIST(pop, pobj->data.user_type);
+	list_remove_free_oob(pop, lhead, oidp);
+}
+
+/*
+ * constructor_realloc -- (internal) constructor for pmemobj_realloc
+ */
+static void
+constructor_realloc(PMEMobjpool *pop, void *ptr, size_t usable_size, void *arg)
+{
+	LOG(3, "pop %p ptr %p arg %p", pop, ptr, arg);
+
+	ASSERTne(ptr, NULL);
+	ASSERTne(arg, NULL);
+
+	struct carg_realloc *carg = arg;
+	struct oob_header *pobj = OOB_HEADER_FROM_PTR(ptr);
+
+	if (ptr != carg->ptr) {
+		size_t cpy_size = carg->new_size > carg->old_size ?
+			carg->old_size : carg->new_size;
+
+		pobj->data.internal_type = TYPE_ALLOCATED;
+		pobj->data.user_type = carg->user_type;
+
+		pop->flush(pop, &pobj->data.internal_type,
+		/* there's no padding between these, so we can add sizes */
+			sizeof (pobj->data.internal_type) +
+			sizeof (pobj->data.user_type));
+
+		pop->memcpy_persist(pop, ptr, carg->ptr, cpy_size);
+	}
+
+	if (!carg->zero_init)
+		return;
+
+	if (usable_size > carg->old_size) {
+		size_t grow_len = usable_size - carg->old_size;
+		void *new_data_ptr = (void *)((uintptr_t)ptr + carg->old_size);
+
+		pop->memset_persist(pop, new_data_ptr, 0, grow_len);
+	}
+}
+
+/*
+ * obj_realloc_common -- (internal) common routine for resizing
+ *                          existing objects
+ */
+static int
+obj_realloc_common(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
+	type_num_t type_num, int zero_init)
+{
+
+	/* if OID is NULL just allocate memory */
+	if (OBJ_OID_IS_NULL(*oidp)) {
+		/* if size is 0 - do nothing */
+		if (size == 0)
+			return 0;
+
+		return obj_alloc_construct(pop, oidp, size, type_num,
+				zero_init, NULL, NULL, 0);
+	}
+
+	if (size > PMEMOBJ_MAX_ALLOC_SIZE) {
+		ERR("requested size too large");
+		errno = ENOMEM;
+		return -1;
+	}
+
+	/* if size is 0 just free */
 	if (size == 0) {
 		obj_free(pop, oidp);
 		return 0;
@@ -1317,7 +1922,7 @@ obj_realloc_common(PMEMobjpool *pop, struct object_store *store,
 	ASSERT(type_num < PMEMOBJ_NUM_OID_TYPES);
 	ASSERT(user_type_old < PMEMOBJ_NUM_OID_TYPES);
 
-	struct list_head *lhead_old = &store->bytype[user_type_old].head;
+	struct list_head *lhead_old = OBJ_TYPE_LIST(pop, user_type_old);
 	if (type_num == user_type_old) {
 		int ret = list_realloc_oob(pop, lhead_old, size,
 				constructor_realloc, &carg, 0, 0, oidp);
@@ -1331,7 +1936,7 @@ obj_realloc_common(PMEMobjpool *pop, struct object_store *store,
 
 		return ret;
 	} else {
-		struct list_head *lhead_new = &store->bytype[type_num].head;
+		struct list_head *lhead_new = OBJ_TYPE_LIST(pop, type_num);
 
 		/*
 		 * Header padding doubles as a red zone to check for header
@@ -1352,7 +1957,14 @@ obj_realloc_common(PMEMobjpool *pop, struct object_store *store,
 
 		uint64_t data_offset = OOB_OFFSET_OF(*oidp, data);
 
-		int ret = list_realloc_move_oob(pop, lhead_old, lhead_new,
+		int ret;
+		if (lhead_new == NULL)
+			/* without type lists only the header has to change */
+			ret = list_realloc_oob(pop, NULL, size,
+				constructor_realloc, &carg,
+				data_offset, *((uint64_t *)&d), oidp);
+		else
+			ret = list_realloc_move_oob(pop, lhead_old, lhead_new,
 				size, constructor_realloc, &carg,
 				data_offset, *((uint64_t *)&d), oidp);
 		if (ret)
@@ -1420,7 +2032,7 @@ pmemobj_realloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 		return -1;
 	}
 
-	return obj_realloc_common(pop, pop->store, oidp, size,
+	return obj_realloc_common(pop, oidp, size,
 			(type_num_t)type_num, 0);
 }
 
@@ -1446,7 +2058,7 @@ pmemobj_zrealloc(PMEMobjpool *pop, PMEMoid *oidp, size_t size,
 		return -1;
 	}
 
-	return obj_realloc_common(pop, pop->store, oidp, size,
+	return obj_realloc_common(pop, oidp, size,
 			(type_num_t)type_num, 1);
 }
 
@@ -1501,7 +2113,7 @@ pmemobj_strdup(PMEMobjpool *pop, PMEMoid *oidp, const char *s,
 	carg.s = s;
 
 	return obj_alloc_construct(pop, oidp, carg.size,
-		(type_num_t)type_num, 0, constructor_strdup, &carg);
+		(type_num_t)type_num, 0, constructor_strdup, &carg, 0);
 }
 
 /*
@@ -1528,6 +2140,297 @@ pmemobj_free(PMEMoid *oidp)
 	obj_free(pop, oidp);
 }
 
+/* object to be freed by pmemobj_free_batch */
+struct obj_free_item {
+	type_num_t type_num;
+	PMEMoid *oidp;
+};
+
+/*
+ * obj_free_item_cmp -- (internal) orders objects by type and address
+ */
+static int
+obj_free_item_cmp(const void *lhs, const void *rhs)
+{
+	const struct obj_free_item *l = lhs;
+	const struct obj_free_item *r = rhs;
+
+	if (l->type_num != r->type_num)
+		return l->type_num < r->type_num ? -1 : 1;
+
+	return l->oidp->off < r->oidp->off ? -1 :
+		l->oidp->off > r->oidp->off ? 1 : 0;
+}
+
+/*
+ * pmemobj_free_batch -- frees n existing objects of the same pool
+ */
+int
+pmemobj_free_batch(PMEMoid oids[], size_t n)
+{
+	LOG(3, "oids %p n %zu", oids, n);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	PMEMobjpool *pop = NULL;
+	size_t nitems = 0;
+	for (size_t i = 0; i < n; ++i) {
+		if (oids[i].off == 0)
+			continue;
+
+		if (pop == NULL)
+			pop = pmemobj_pool_by_oid(oids[i]);
+
+		ASSERTne(pop, NULL);
+		ASSERTeq(oids[i].pool_uuid_lo, pop->uuid_lo);
+		ASSERT(OBJ_OID_IS_VALID(pop, oids[i]));
+		nitems++;
+	}
+
+	if (nitems == 0)
+		return 0;
+
+	struct obj_free_item *items = Malloc(nitems * sizeof (*items));
+	PMEMoid **oidps = Malloc(nitems * sizeof (*oidps));
+	if (items == NULL || oidps == NULL) {
+		ERR("!Malloc");
+		Free(items);
+		Free(oidps);
+		return -1;
+	}
+
+	nitems = 0;
+	for (size_t i = 0; i < n; ++i) {
+		if (oids[i].off == 0)
+			continue;
+
+		struct oob_header *pobj = OOB_HEADER_FROM_OID(pop, oids[i]);
+		ASSERT(pobj->data.user_type < PMEMOBJ_NUM_OID_TYPES);
+
+		items[nitems].type_num = pobj->data.user_type;
+		items[nitems].oidp = &oids[i];
+		nitems++;
+	}
+
+	/*
+	 * Objects of the same type share the oob list, neighbouring ones
+	 * are likely to share the list entries and the bitmap words.
+	 */
+	qsort(items, nitems, sizeof (*items), obj_free_item_cmp);
+
+	for (size_t i = 0; i < nitems; ++i)
+		oidps[i] = items[i].oidp;
+
+	size_t first = 0;
+	for (size_t i = 1; i <= nitems; ++i) {
+		if (i < nitems && items[i].type_num == items[first].type_num)
+			continue;
+
+		list_remove_free_batch(pop,
+			OBJ_TYPE_LIST(pop, items[first].type_num),
+			&oidps[first], i - first);
+		first = i;
+	}
+
+	Free(items);
+	Free(oidps);
+
+	return 0;
+}
+
+/*
+ * Types of actions, stored in the type field of struct pobj_action.
+ */
+enum obj_action_type {
+	OBJ_ACTION_RESERVE = 1,	/* data[0] - offset of the memory block */
+	OBJ_ACTION_SET_VALUE,	/* data[0] - offset, data[1] - value */
+};
+
+/*
+ * pmemobj_reserve -- reserves memory for an object without allocating it
+ */
+PMEMoid
+pmemobj_reserve(PMEMobjpool *pop, struct pobj_action *act, size_t size,
+	unsigned int type_num)
+{
+	LOG(3, "pop %p act %p size %zu type_num %u", pop, act, size, type_num);
+
+	if (size == 0) {
+		ERR("allocation with size 0");
+		errno = EINVAL;
+		return OID_NULL;
+	}
+
+	if (type_num >= PMEMOBJ_NUM_OID_TYPES) {
+		errno = EINVAL;
+		ERR("invalid type_num %u", type_num);
+		return OID_NULL;
+	}
+
+	if (size > PMEMOBJ_MAX_ALLOC_SIZE) {
+		ERR("requested size too large");
+		errno = ENOMEM;
+		return OID_NULL;
+	}
+
+	struct carg_bytype carg;
+
+	carg.user_type = (type_num_t)type_num;
+	carg.zero_init = 0;
+	carg.constructor = NULL;
+	carg.arg = NULL;
+
+	uint64_t off;
+	int ret = pmalloc_reserve_batch(pop, &off, 1, size + OBJ_OOB_SIZE,
+		constructor_alloc_bytype, &carg, OBJ_OOB_SIZE);
+	if (ret != 0) {
+		errno = ret;
+		ERR("!pmalloc_reserve_batch");
+		return OID_NULL;
+	}
+
+	act->type = OBJ_ACTION_RESERVE;
+	act->data[0] = off;
+
+	PMEMoid oid = {pop->uuid_lo, off + OBJ_OOB_SIZE};
+
+	return oid;
+}
+
+/*
+ * pmemobj_set_value -- prepares setting of an 8-byte value in the pool
+ */
+void
+pmemobj_set_value(PMEMobjpool *pop, struct pobj_action *act,
+	uint64_t *ptr, uint64_t value)
+{
+	LOG(3, "pop %p act %p ptr %p value %ju", pop, act, ptr, value);
+
+	act->type = OBJ_ACTION_SET_VALUE;
+	act->data[0] = OBJ_PTR_TO_OFF(pop, ptr);
+	act->data[1] = value;
+}
+
+/* reserved object to be published */
+struct obj_publish_item {
+	type_num_t type_num;
+	uint64_t off;
+};
+
+/*
+ * obj_publish_item_cmp -- (internal) orders reserved objects by type
+ */
+static int
+obj_publish_item_cmp(const void *lhs, const void *rhs)
+{
+	const struct obj_publish_item *l = lhs;
+	const struct obj_publish_item *r = rhs;
+
+	if (l->type_num != r->type_num)
+		return l->type_num < r->type_num ? -1 : 1;
+
+	return l->off < r->off ? -1 : l->off > r->off ? 1 : 0;
+}
+
+/*
+ * pmemobj_publish -- allocates the reserved objects and sets the values
+ *	atomically
+ */
+int
+pmemobj_publish(PMEMobjpool *pop, struct pobj_action *actv, size_t actvcnt)
+{
+	LOG(3, "pop %p actv %p actvcnt %zu", pop, actv, actvcnt);
+
+	/* log notice message if used inside a transaction */
+	_POBJ_DEBUG_NOTICE_IN_TX();
+
+	COMPILE_ERROR_ON(POBJ_MAX_ACTIONS + 2 !=
+		REDO_LOG_CAPACITY(REDO_NUM_ENTRIES));
+
+	if (actvcnt > POBJ_MAX_ACTIONS) {
+		ERR("too many actions %zu", actvcnt);
+		errno = EINVAL;
+		return -1;
+	}
+
+	struct obj_publish_item items[POBJ_MAX_ACTIONS];
+	uint64_t value_offs[POBJ_MAX_ACTIONS];
+	uint64_t values[POBJ_MAX_ACTIONS];
+	size_t nitems = 0;
+	size_t nvalues = 0;
+
+	for (size_t i = 0; i < actvcnt; ++i) {
+		struct pobj_action *act = &actv[i];
+
+		switch (act->type) {
+		case OBJ_ACTION_RESERVE:
+			items[nitems].off = act->data[0];
+			items[nitems].type_num = ((struct oob_header *)
+				OBJ_OFF_TO_PTR(pop, act->data[0]))->
+				data.user_type;
+			nitems++;
+			break;
+		case OBJ_ACTION_SET_VALUE:
+			if (act->data[0] % sizeof (uint64_t) != 0 ||
+				!OBJ_OFF_IS_VALID(pop, act->data[0])) {
+				ERR("invalid value offset 0x%jx", act->data[0]);
+				errno = EINVAL;
+				return -1;
+			}
+
+			value_offs[nvalues] = act->data[0];
+			values[nvalues] = act->data[1];
+			nvalues++;
+			break;
+		default:
+			ERR("invalid action type %ju", act->type);
+			errno = EINVAL;
+			return -1;
+		}
+	}
+
+	qsort(items, nitems, sizeof (items[0]), obj_publish_item_cmp);
+
+	struct list_head *heads[POBJ_MAX_ACTIONS];
+	uint64_t offs[POBJ_MAX_ACTIONS];
+
+	/* the objects of every type are linked in with up to two entries */
+	size_t nentries = nitems + nvalues;
+	for (size_t i = 0; i < nitems; ++i) {
+		heads[i] = OBJ_TYPE_LIST(pop, items[i].type_num);
+		offs[i] = items[i].off;
+
+		if (heads[i] != NULL && (i == 0 || heads[i] != heads[i - 1]))
+			nentries += 2;
+	}
+
+	if (nentries > REDO_LOG_CAPACITY(REDO_NUM_ENTRIES)) {
+		ERR("too many actions %zu", actvcnt);
+		errno = EINVAL;
+		return -1;
+	}
+
+	list_publish(pop, heads, offs, nitems, value_offs, values, nvalues);
+
+	return 0;
+}
+
+/*
+ * pmemobj_cancel -- returns the memory of the reserved objects
+ */
+void
+pmemobj_cancel(PMEMobjpool *pop, struct pobj_action *actv, size_t actvcnt)
+{
+	LOG(3, "pop %p actv %p actvcnt %zu", pop, actv, actvcnt);
+
+	for (size_t i = 0; i < actvcnt; ++i) {
+		if (actv[i].type == OBJ_ACTION_RESERVE)
+			pmalloc_cancel_batch(pop, &actv[i].data[0], 1,
+				OBJ_OOB_SIZE);
+	}
+}
+
 /*
  * pmemobj_alloc_usable_size -- returns usable size of object
  */
@@ -1683,7 +2586,7 @@ obj_alloc_root(PMEMobjpool *pop, struct object_store *store, size_t size,
 	carg.arg = arg;
 
 	return list_insert_new_oob(pop, lhead, size, constructor_alloc_root,
-			&carg, NULL);
+			&carg, NULL, 0);
 }
 
 /*
@@ -1777,6 +2680,120 @@ pmemobj_root(PMEMobjpool *pop, size_t size)
 	return pmemobj_root_construct(pop, size, NULL, NULL);
 }
 
+/*
+ * obj_walk_match -- (internal) checks whether the allocation found by walking
+ *	the heap is an object of specified type, or of any type
+ */
+static int
+obj_walk_match(PMEMobjpool *pop, struct oob_header *pobj, unsigned type_num)
+{
+	if (pobj->data.internal_type != TYPE_ALLOCATED ||
+	    pobj->data.user_type >= PMEMOBJ_NUM_OID_TYPES)
+		return 0;
+
+	if (type_num != POBJ_WALK_ANY_TYPE && pobj->data.user_type != type_num)
+		return 0;
+
+	/*
+	 * Objects of a pool without type lists are on an oob list only
+	 * while a transaction is allocating or freeing them.
+	 */
+	return !pop->no_type_lists || pobj->oob.pe_next.off == 0;
+}
+
+/*
+ * obj_walk_next -- (internal) returns the first object of specified type that
+ *	follows the allocation at off in the heap
+ */
+static PMEMoid
+obj_walk_next(PMEMobjpool *pop, uint64_t off, type_num_t type_num)
+{
+	while ((off = heap_next_alloc(pop, off)) != 0) {
+		if (obj_walk_match(pop, OBJ_OFF_TO_PTR(pop, off), type_num)) {
+			PMEMoid oid = { pop->uuid_lo, off + OBJ_OOB_SIZE };
+			return oid;
+		}
+	}
+
+	return OID_NULL;
+}
+
+/* arguments for obj_walk_cb */
+struct obj_walk_args {
+	unsigned type_num;
+	pmemobj_walk_fn cb;
+	void *arg;
+	int ret;
+};
+
+/*
+ * obj_walk_cb -- (internal) heap_walk callback of pmemobj_walk
+ */
+static int
+obj_walk_cb(PMEMobjpool *pop, uint64_t off, void *arg)
+{
+	struct obj_walk_args *args = arg;
+
+	if (!obj_walk_match(pop, OBJ_OFF_TO_PTR(pop, off), args->type_num))
+		return 0;
+
+	PMEMoid oid = { pop->uuid_lo, off + OBJ_OOB_SIZE };
+
+	/* the first cache line of the data is likely read by the callback */
+	__builtin_prefetch(OBJ_OFF_TO_PTR(pop, oid.off));
+
+	args->ret = args->cb(pop, oid, args->arg);
+
+	return args->ret != 0;
+}
+
+/*
+ * pmemobj_walk -- calls cb for the objects of specified type in the part-th
+ *	of nparts ranges of the heap
+ */
+int
+pmemobj_walk(PMEMobjpool *pop, unsigned type_num, unsigned part,
+	unsigned nparts, pmemobj_walk_fn cb, void *arg)
+{
+	LOG(3, "pop %p type_num %u part %u nparts %u cb %p arg %p",
+		pop, type_num, part, nparts, cb, arg);
+
+	if (type_num >= PMEMOBJ_NUM_OID_TYPES &&
+	    type_num != POBJ_WALK_ANY_TYPE) {
+		ERR("invalid type_num %u", type_num);
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (part >= nparts) {
+		ERR("invalid part %u of %u", part, nparts);
+		errno = EINVAL;
+		return -1;
+	}
+
+	if (cb == NULL) {
+		ERR("no callback");
+		errno = EINVAL;
+		return -1;
+	}
+
+	struct obj_walk_args args = {
+		.type_num = type_num,
+		.cb = cb,
+		.arg = arg,
+		.ret = 0,
+	};
+
+	int err = heap_walk(pop, part, nparts, obj_walk_cb, &args);
+	if (err == ENOMEM) {
+		ERR("!heap_walk");
+		errno = ENOMEM;
+		return -1;
+	}
+
+	return args.ret;
+}
+
 /*
  * pmemobj_first - returns first object of specified type
  */
@@ -1793,6 +2810,9 @@ pmemobj_first(PMEMobjpool *pop, unsigned int type_num)
 		return OID_NULL;
 	}
 
+	if (pop->no_type_lists)
+		return obj_walk_next(pop, 0, (type_num_t)type_num);
+
 	return pop->store->bytype[type_num].head.pe_first;
 }
 
@@ -1817,6 +2837,9 @@ pmemobj_next(PMEMoid oid)
 
 	ASSERT(user_type < PMEMOBJ_NUM_OID_TYPES);
 
+	if (pop->no_type_lists)
+		return obj_walk_next(pop, oid.off - OBJ_OOB_SIZE, user_type);
+
 	if (pobj->oob.pe_next.off !=
 			pop->store->bytype[user_type].head.pe_first.off)
 		return pobj->oob.pe_next;
@@ -1887,7 +2910,7 @@ pmemobj_list_insert_new(PMEMobjpool *pop, size_t pe_offset, void *head,
 		return OID_NULL;
 	}
 
-	struct list_head *lhead = &pop->store->bytype[type_num].head;
+	struct list_head *lhead = OBJ_TYPE_LIST(pop, type_num);
 	struct carg_bytype carg;
 
 	carg.user_type = (type_num_t)type_num;
@@ -1926,7 +2949,7 @@ pmemobj_list_remove(PMEMobjpool *pop, size_t pe_offset, void *head,
 
 		ASSERT(pobj->data.user_type < PMEMOBJ_NUM_OID_TYPES);
 
-		void *lhead = &pop->store->bytype[pobj->data.user_type].head;
+		void *lhead = OBJ_TYPE_LIST(pop, pobj->data.user_type);
 		return list_remove_free_user(pop, lhead, pe_offset, head, &oid);
 	} else
 		return list_remove(pop, pe_offset, head, oid);
@@ -36,6 +36,8 @@
 
 #include <stddef.h>
 
+#include "libpmem.h"
+
 #define	PMEMOBJ_LOG_PREFIX "libpmemobj"
 #define	PMEMOBJ_LOG_LEVEL_VAR "PMEMOBJ_LOG_LEVEL"
 #define	PMEMOBJ_LOG_FILE_VAR "PMEMOBJ_LOG_FILE"
@@ -44,19 +46,46 @@
 #define	OBJ_HDR_SIG "PMEMOBJ"	/* must be 8 bytes including '\0' */
 #define	OBJ_FORMAT_MAJOR 1
 #define	OBJ_FORMAT_COMPAT 0x0000
-#define	OBJ_FORMAT_INCOMPAT 0x0000
+#define	OBJ_FORMAT_INCOMPAT OBJ_INCOMPAT_CSUM_LOGS
 #define	OBJ_FORMAT_RO_COMPAT 0x0000
 
+/*
+ * Mandatory incompat features, set in every pool created by the library.
+ * The pools created by the older versions lack them and their logs can't be
+ * recovered, so such a pool is upgraded on open only if its logs are empty:
+ * - redo logs terminated by a finish entry and protected by a checksum
+ * - transaction snapshots stored in the undo log arena, which spans the rest
+ *   of the transaction lane section and the chunks on undo_set_cache
+ * - undo log entries tagged with the arena generation and a checksum
+ * - redo entries of the transactions begun with TX_PARAM_REDO, marked with
+ *   TX_RANGE_REDO, applied by the recovery of a committed transaction
+ */
+#define	OBJ_INCOMPAT_CSUM_LOGS 0x0002
+
+/* optional incompat features, selected when the pool is created */
+#define	OBJ_INCOMPAT_NO_TYPE_LISTS 0x0001 /* no per-type object lists */
+#define	OBJ_INCOMPAT_LANE_SECTION_LEN 0x0004 /* non-default lane sections */
+#define	OBJ_FORMAT_INCOMPAT_SUPPORTED\
+	(OBJ_FORMAT_INCOMPAT | OBJ_INCOMPAT_NO_TYPE_LISTS |\
+	OBJ_INCOMPAT_LANE_SECTION_LEN)
+
 /* size of the persistent part of PMEMOBJ pool descriptor (2kB) */
 #define	OBJ_DSC_P_SIZE		2048
 /* size of unused part of the persistent part of PMEMOBJ pool descriptor */
-#define	OBJ_DSC_P_UNUSED	(OBJ_DSC_P_SIZE - PMEMOBJ_MAX_LAYOUT - 56)
+#define	OBJ_DSC_P_UNUSED	(OBJ_DSC_P_SIZE - PMEMOBJ_MAX_LAYOUT - 64)
 
 #define	OBJ_LANES_OFFSET	8192	/* lanes offset (8kB) */
-#define	OBJ_NLANES		1024	/* number of lanes */
+#define	OBJ_NLANES		1024	/* default number of lanes */
+#define	OBJ_NLANES_MAX		65536	/* maximum number of lanes */
+/* maximum lane section size */
+#define	OBJ_LANE_SECTION_LEN_MAX	(1 << 20)
+#define	OBJ_LANE_SECTION_ALIGN	64	/* alignment of lane section size */
 
-#define	MAX_CACHED_RANGE_SIZE 32
-#define	MAX_CACHED_RANGES 127 /* calculated to be exactly 8192 bytes */
+#define	OBJ_NLANES_VAR "PMEMOBJ_NLANES"
+#define	OBJ_LANE_SECTION_LEN_VAR "PMEMOBJ_LANE_SECTION_SIZE"
+
+#define	TX_UNDO_CHUNK_SIZE 16384 /* size of undo log arena overflow chunk */
+#define	TX_UNDO_CHUNKS_RETAINED 2 /* chunks kept in the lane after commit */
 
 #define	OBJ_OOB_SIZE		(sizeof (struct oob_header))
 #define	OBJ_OFF_TO_PTR(pop, off) ((void *)((uintptr_t)(pop) + (off)))
@@ -66,10 +95,17 @@
 #define	OBJ_OFF_FROM_HEAP(pop, off)\
 	((off) >= (pop)->heap_offset &&\
 	(off) < (pop)->heap_offset + (pop)->heap_size)
+/* pools created before the lane section size was recorded have zero there */
+#define	OBJ_LANE_SECTION_LEN(pop)\
+	((pop)->lane_section_len != 0 ?\
+	(pop)->lane_section_len : LANE_SECTION_LEN)
+#define	OBJ_LANE_SIZE(pop)\
+	(OBJ_LANE_SECTION_LEN(pop) * MAX_LANE_SECTION)
+#define	OBJ_LANES_SIZE(pop)\
+	((pop)->nlanes * OBJ_LANE_SIZE(pop))
 #define	OBJ_OFF_FROM_LANES(pop, off)\
 	((off) >= (pop)->lanes_offset &&\
-	(off) < (pop)->lanes_offset +\
-	(pop)->nlanes * sizeof (struct lane_layout))
+	(off) < (pop)->lanes_offset + OBJ_LANES_SIZE(pop))
 #define	OBJ_OFF_FROM_OBJ_STORE(pop, off)\
 	((off) >= (pop)->obj_store_offset &&\
 	(off) < (pop)->obj_store_offset + (pop)->obj_store_size)
@@ -99,18 +135,29 @@
 #define	OOB_OFFSET_OF(oid, field)\
 	((oid).off - OBJ_OOB_SIZE + offsetof(struct oob_header, field))
 
+/*
+ * Returns the object store list of the given type, or NULL if the pool
+ * keeps no per-type lists.
+ */
+#define	OBJ_TYPE_LIST(pop, type_num)\
+	((pop)->no_type_lists ? NULL : &(pop)->store->bytype[(type_num)].head)
+
 #define	OBJ_STORE_ITEM_PADDING\
 	(_POBJ_CL_ALIGNMENT - (sizeof (struct list_head) % _POBJ_CL_ALIGNMENT))
 
 typedef void (*persist_local_fn)(const void *, size_t);
 typedef void (*flush_local_fn)(const void *, size_t);
 typedef void (*drain_local_fn)(void);
+typedef void (*persistv_local_fn)(const struct pmem_vec *, size_t);
+typedef void (*flushv_local_fn)(const struct pmem_vec *, size_t);
 typedef void *(*memcpy_local_fn)(void *dest, const void *src, size_t len);
 typedef void *(*memset_local_fn)(void *dest, int c, size_t len);
 
 typedef void (*persist_fn)(PMEMobjpool *pop, const void *, size_t);
 typedef void (*flush_fn)(PMEMobjpool *pop, const void *, size_t);
 typedef void (*drain_fn)(PMEMobjpool *pop);
+typedef void (*persistv_fn)(PMEMobjpool *pop, const struct pmem_vec *, size_t);
+typedef void (*flushv_fn)(PMEMobjpool *pop, const struct pmem_vec *, size_t);
 typedef void *(*memcpy_fn)(PMEMobjpool *pop, void *dest, const void *src,
 					size_t len);
 typedef void *(*memset_fn)(PMEMobjpool *pop, void *dest, int c, size_t len);
@@ -129,6 +176,7 @@ struct pmemobjpool {
 	uint64_t obj_store_size;
 	uint64_t heap_offset;
 	uint64_t heap_size;
+	uint64_t lane_section_len;
 	unsigned char unused[OBJ_DSC_P_UNUSED]; /* must be zero */
 	uint64_t checksum;	/* checksum of above fields */
 
@@ -143,6 +191,8 @@ struct pmemobjpool {
 	struct pmalloc_heap *heap; /* allocator heap */
 	struct lane *lanes;
 	pthread_mutex_t *lane_locks;
+	uint64_t lanes_free;	/* head of the stack of idle lanes */
+	struct lane_reclaimer *reclaimer; /* background post-commit cleanup */
 	struct object_store *store; /* object store */
 	uint64_t uuid_lo;
 
@@ -152,6 +202,8 @@ struct pmemobjpool {
 	persist_local_fn persist_local;	/* persist function */
 	flush_local_fn flush_local;	/* flush function */
 	drain_local_fn drain_local;	/* drain function */
+	persistv_local_fn persistv_local; /* vectored persist function */
+	flushv_local_fn flushv_local;	/* vectored flush function */
 	memcpy_local_fn memcpy_persist_local; /* persistent memcpy function */
 	memset_local_fn memset_persist_local; /* persistent memset function */
 
@@ -159,12 +211,15 @@ struct pmemobjpool {
 	persist_fn persist;	/* persist function */
 	flush_fn flush;		/* flush function */
 	drain_fn drain;		/* drain function */
+	persistv_fn persistv;	/* vectored persist function */
+	flushv_fn flushv;	/* vectored flush function */
 	memcpy_fn memcpy_persist; /* persistent memcpy function */
 	memset_fn memset_persist; /* persistent memset function */
 
 	PMEMmutex rootlock;	/* root object lock */
 	int is_master_replica;
-	char unused2[1816];
+	int no_type_lists;	/* objects are found by walking the heap */
+	char unused2[1764];
 };
 
 struct oob_header_data {
@@ -212,20 +267,49 @@ struct tx_range {
 	uint8_t data[];
 };
 
-struct tx_range_cache {
-	struct { /* compatible with struct tx_range */
-		uint64_t offset;
-		uint64_t size;
-		uint8_t data[MAX_CACHED_RANGE_SIZE];
-	} range[MAX_CACHED_RANGES];
+/*
+ * The range holds new data written in redo mode, applied on commit. Older
+ * libraries would restore such a range as a snapshot, that's why it's a part
+ * of the OBJ_INCOMPAT_CSUM_LOGS format.
+ */
+#define	TX_RANGE_REDO (1ULL << 63)
+
+/* length of the range in the undo log arena, the data is 8-byte aligned */
+#define	TX_RANGE_LEN(size)\
+	(sizeof (struct tx_range) + (((size) + 7) & ~((size_t)7)))
+
+/*
+ * Every range in the undo log arena is preceded by this header. The entry is
+ * valid only if it belongs to the current generation of the arena and
+ * the checksum matches. A part of the OBJ_INCOMPAT_CSUM_LOGS format.
+ */
+struct tx_undo_entry {
+	uint64_t gen;
+	uint64_t checksum;
 };
 
+#define	TX_UNDO_ENTRY_LEN(size)\
+	(sizeof (struct tx_undo_entry) + TX_RANGE_LEN(size))
+
+/*
+ * The checksum of small snapshots covers the data as well, bigger snapshots
+ * are stored in order - the data is durable before the header is written.
+ * The data of redo log entries is made durable before the commit point.
+ */
+#define	TX_UNDO_SMALL_SIZE 512
+#define	TX_UNDO_CHECKSUM_LEN(offset, size)\
+	TX_UNDO_ENTRY_LEN((size) <= TX_UNDO_SMALL_SIZE &&\
+	!((offset) & TX_RANGE_REDO) ? (size) : 0)
+
+/* the undo log arena is a part of the OBJ_INCOMPAT_CSUM_LOGS format */
 struct lane_tx_layout {
 	uint64_t state;
 	struct list_head undo_alloc;
 	struct list_head undo_free;
 	struct list_head undo_set;
 	struct list_head undo_set_cache;
+	uint64_t undo_gen; /* generation of the undo log arena */
+	uint8_t undo_arena[]; /* rest of the lane section */
 };
 
 static inline PMEMoid
@@ -35,6 +35,8 @@
  */
 
 #include <errno.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "libpmemobj.h"
 #include "util.h"
@@ -47,6 +49,7 @@
 #include "heap.h"
 #include "bucket.h"
 #include "heap_layout.h"
+#include "sys_util.h"
 #include "valgrind_internal.h"
 
 enum alloc_op_redo {
@@ -56,8 +59,59 @@ enum alloc_op_redo {
 	MAX_ALLOC_OP_REDO
 };
 
+/*
+ * Maximum number of memory blocks kept in a single allocation class magazine
+ * and the maximum amount of memory one magazine is allowed to withhold from
+ * the shared buckets.
+ */
+#define	ALLOC_MAGAZINE_SIZE 32
+#define	ALLOC_MAGAZINE_MAX_BYTES (1 << 16)
+
+/*
+ * Per-thread stack of single unit memory blocks of one allocation class.
+ *
+ * Blocks in the magazine are free in the persistent state of the heap but
+ * are not present in any bucket, which makes them private to the thread and
+ * allows them to be handed out without touching the bucket locks.
+ */
+struct alloc_magazine {
+	unsigned nblocks;
+	unsigned capacity;
+	struct memory_block blocks[ALLOC_MAGAZINE_SIZE];
+};
+
+/*
+ * Magazines of one thread in one pool.
+ *
+ * Only the owner thread takes the memory blocks out of the magazines and puts
+ * them back, without any locks. All of the caches are also on a global list,
+ * so that the pool can disown them when it's closed and ask the other threads
+ * for their memory blocks when it runs out of memory.
+ */
+struct alloc_cache {
+	PMEMobjpool *pop;	/* NULL once the pool is closed */
+	int reclaim;		/* the owner is asked to drain the magazines */
+	struct alloc_magazine *mags[MAX_BUCKETS];
+
+	struct alloc_cache *next;	/* on the global list */
+	struct alloc_cache *next_thread; /* on the list of the owner thread */
+};
+
+static pthread_once_t Alloc_cache_once = PTHREAD_ONCE_INIT;
+static pthread_key_t Alloc_cache_key;
+static int Alloc_cache_key_created;
+
+/* protects the global list and the pool pointers of the caches */
+static pthread_mutex_t Alloc_caches_lock;
+static struct alloc_cache *Alloc_caches;
+
+static __thread struct alloc_cache *Alloc_thread_caches;
+
 /*
  * alloc_write_header -- (internal) creates allocation header
+ *
+ * The header is only flushed, it's drained along with the redo log entries
+ * which make the allocation persistent.
  */
 static void
 alloc_write_header(PMEMobjpool *pop, struct allocation_header *alloc,
@@ -68,7 +122,7 @@ alloc_write_header(PMEMobjpool *pop, struct allocation_header *alloc,
 	alloc->size = size;
 	alloc->zone_id = zone_id;
 	VALGRIND_REMOVE_FROM_TX(alloc, sizeof (*alloc));
-	pop->persist(pop, alloc, sizeof (*alloc));
+	pop->flush(pop, alloc, sizeof (*alloc));
 }
 
 /*
@@ -135,14 +189,17 @@ get_mblock_from_alloc(PMEMobjpool *pop, struct allocation_header *alloc)
 }
 
 /*
- * persist_alloc -- (internal) performs a persistent allocation of the
- *	memory block previously reserved by volatile bucket
+ * alloc_construct_block -- (internal) writes the allocation header and runs
+ *	the constructor of the memory block previously reserved by volatile
+ *	bucket
+ *
+ * Returns the offset of the block data.
  */
-static void
-persist_alloc(PMEMobjpool *pop, struct lane_section *lane,
-	struct memory_block m, uint64_t real_size, uint64_t *off,
-	void (*constructor)(PMEMobjpool *pop, void *ptr, size_t usable_size,
-	void *arg), void *arg, uint64_t data_off)
+static uint64_t
+alloc_construct_block(PMEMobjpool *pop, struct bucket *b,
+	struct memory_block m, uint64_t real_size,
+	void (*constructor)(PMEMobjpool *pop, void *ptr,
+	size_t usable_size, void *arg), void *arg, uint64_t data_off)
 {
 #ifdef DEBUG
 	if (heap_block_is_allocated(pop, m)) {
@@ -151,13 +208,13 @@ persist_alloc(PMEMobjpool *pop, struct lane_section *lane,
 	}
 #endif /* DEBUG */
 
-	uint64_t op_result = 0;
-
 	void *block_data = heap_get_block_data(pop, m);
 	void *datap = (char *)block_data + sizeof (struct allocation_header);
 	void *userdatap = (char *)datap + data_off;
 
-	ASSERT((uint64_t)block_data % _POBJ_CL_ALIGNMENT == 0);
+	/* blocks of user-defined classes are only 8-byte aligned */
+	ASSERT((uint64_t)block_data % (b->user_defined ?
+		sizeof (uint64_t) : _POBJ_CL_ALIGNMENT) == 0);
 
 	/* mark everything (including headers) as accessible */
 	VALGRIND_DO_MAKE_MEM_UNDEFINED(pop, block_data, real_size);
@@ -173,6 +230,25 @@ persist_alloc(PMEMobjpool *pop, struct lane_section *lane,
 			real_size - sizeof (struct allocation_header) -
 			data_off, arg);
 
+	return pop_offset(pop, datap);
+}
+
+/*
+ * persist_alloc -- (internal) performs a persistent allocation of the
+ *	memory block previously reserved by volatile bucket
+ */
+static void
+persist_alloc(PMEMobjpool *pop, struct lane_section *lane,
+	struct bucket *b, struct memory_block m, uint64_t real_size,
+	uint64_t *off,
+	void (*constructor)(PMEMobjpool *pop, void *ptr, size_t usable_size,
+	void *arg), void *arg, uint64_t data_off)
+{
+	uint64_t op_result = 0;
+
+	uint64_t data = alloc_construct_block(pop, b, m, real_size,
+		constructor, arg, data_off);
+
 	heap_lock_if_run(pop, m);
 
 	void *hdr = heap_get_block_header(pop, m, HEAP_OP_ALLOC, &op_result);
@@ -181,15 +257,488 @@ persist_alloc(PMEMobjpool *pop, struct lane_section *lane,
 		(struct allocator_lane_section *)lane->layout;
 
 	redo_log_store(pop, sec->redo, ALLOC_OP_REDO_PTR_OFFSET,
-		pop_offset(pop, off), pop_offset(pop, datap));
+		pop_offset(pop, off), data);
 	redo_log_store_last(pop, sec->redo, ALLOC_OP_REDO_HEADER,
 		pop_offset(pop, hdr), op_result);
 
-	redo_log_process(pop, sec->redo, MAX_ALLOC_OP_REDO);
+	redo_log_process(pop, sec->redo, REDO_LOG_SIZE);
 
 	heap_unlock_if_run(pop, m);
 }
 
+/*
+ * alloc_magazine_block_cmp -- (internal) compares memory blocks by address
+ */
+static int
+alloc_magazine_block_cmp(const void *lhs, const void *rhs)
+{
+	const struct memory_block *l = lhs;
+	const struct memory_block *r = rhs;
+
+	if (l->zone_id != r->zone_id)
+		return l->zone_id < r->zone_id ? -1 : 1;
+
+	if (l->chunk_id != r->chunk_id)
+		return l->chunk_id < r->chunk_id ? -1 : 1;
+
+	return l->block_off < r->block_off ? -1 :
+		l->block_off > r->block_off ? 1 : 0;
+}
+
+/*
+ * alloc_magazine_drain -- (internal) returns the oldest memory blocks from
+ *	the magazine back to the buckets of their runs
+ */
+static void
+alloc_magazine_drain(PMEMobjpool *pop, struct alloc_magazine *mag,
+	unsigned nblocks)
+{
+	ASSERT(nblocks <= mag->nblocks);
+
+	uint64_t op_result;
+	void *hdr;
+
+	/*
+	 * Neighbouring blocks can only be coalesced with the ones already
+	 * present in the bucket, freeing them in address order allows the
+	 * runs to be put back together.
+	 */
+	qsort(mag->blocks, nblocks, sizeof (mag->blocks[0]),
+		alloc_magazine_block_cmp);
+
+	for (unsigned i = 0; i < nblocks; ++i) {
+		struct memory_block m = mag->blocks[i];
+		struct bucket *b = heap_get_chunk_bucket(pop,
+			m.chunk_id, m.zone_id);
+		ASSERTne(b, NULL);
+
+		/* coalescing of the blocks is deferred until now */
+		heap_lock_if_run(pop, m);
+		struct memory_block res = heap_free_block(pop, b, m,
+			&hdr, &op_result);
+		heap_unlock_if_run(pop, m);
+
+		CNT_OP(b, insert, pop, res);
+		heap_degrade_run_if_empty(pop, b, res);
+	}
+
+	mag->nblocks -= nblocks;
+	memmove(&mag->blocks[0], &mag->blocks[nblocks],
+		mag->nblocks * sizeof (mag->blocks[0]));
+}
+
+/*
+ * alloc_magazine_pop -- (internal) takes a memory block from the magazine,
+ *	refills it in a single batch from the bucket if empty
+ */
+static int
+alloc_magazine_pop(PMEMobjpool *pop, struct alloc_magazine *mag,
+	struct bucket *b, struct memory_block *m)
+{
+	if (mag->nblocks == 0) {
+		unsigned n = heap_get_bestfit_blocks(pop, b,
+			mag->blocks, mag->capacity / 2);
+		if (n == 0)
+			return ENOMEM;
+
+		/* hand out the blocks in address order */
+		for (unsigned i = 0; i < n / 2; ++i) {
+			struct memory_block tmp = mag->blocks[i];
+			mag->blocks[i] = mag->blocks[n - i - 1];
+			mag->blocks[n - i - 1] = tmp;
+		}
+
+		mag->nblocks = n;
+	}
+
+	*m = mag->blocks[--mag->nblocks];
+
+	return 0;
+}
+
+/*
+ * alloc_magazine_push -- (internal) puts a freed memory block into the
+ *	magazine, drains half of it first if it is full
+ */
+static void
+alloc_magazine_push(PMEMobjpool *pop, struct alloc_magazine *mag,
+	struct memory_block m)
+{
+	if (mag->nblocks == mag->capacity)
+		alloc_magazine_drain(pop, mag, mag->capacity / 2);
+
+	mag->blocks[mag->nblocks++] = m;
+}
+
+/*
+ * alloc_cache_drain -- (internal) returns all of the memory blocks of
+ *	the magazines to the buckets
+ */
+static void
+alloc_cache_drain(PMEMobjpool *pop, struct alloc_cache *cache)
+{
+	for (int i = 0; i < MAX_BUCKETS; ++i) {
+		struct alloc_magazine *mag = cache->mags[i];
+		if (mag != NULL && mag->nblocks != 0)
+			alloc_magazine_drain(pop, mag, mag->nblocks);
+	}
+}
+
+/*
+ * alloc_cache_free -- (internal) frees the magazines, the memory blocks still
+ *	in them are free in the persistent heap anyway
+ */
+static void
+alloc_cache_free(struct alloc_cache *cache)
+{
+	for (int i = 0; i < MAX_BUCKETS; ++i)
+		Free(cache->mags[i]);
+
+	Free(cache);
+}
+
+/*
+ * alloc_cache_unlink -- (internal) removes the cache from the global list
+ *
+ * Must be called with the caches lock held.
+ */
+static void
+alloc_cache_unlink(struct alloc_cache *cache)
+{
+	struct alloc_cache **prev = &Alloc_caches;
+	while (*prev != cache)
+		prev = &(*prev)->next;
+	*prev = cache->next;
+}
+
+/*
+ * alloc_cache_thread_exit -- (internal) gives the memory blocks of the exiting
+ *	thread back to the pools and frees its caches
+ *
+ * The pools cannot be closed in the meantime, disowning the caches requires
+ * the caches lock.
+ */
+static void
+alloc_cache_thread_exit(void *arg)
+{
+	util_mutex_lock(&Alloc_caches_lock);
+
+	struct alloc_cache *cache;
+	while ((cache = Alloc_thread_caches) != NULL) {
+		Alloc_thread_caches = cache->next_thread;
+
+		if (cache->pop != NULL) {
+			alloc_cache_drain(cache->pop, cache);
+			alloc_cache_unlink(cache);
+		}
+
+		alloc_cache_free(cache);
+	}
+
+	util_mutex_unlock(&Alloc_caches_lock);
+}
+
+/*
+ * alloc_cache_key_create -- (internal) creates the key which drains
+ *	the caches of exiting threads
+ */
+static void
+alloc_cache_key_create(void)
+{
+	util_mutex_init(&Alloc_caches_lock, NULL);
+
+	int err = pthread_key_create(&Alloc_cache_key, alloc_cache_thread_exit);
+	if (err) {
+		errno = err;
+		FATAL("!pthread_key_create");
+	}
+
+	Alloc_cache_key_created = 1;
+}
+
+/*
+ * alloc_cache_find -- (internal) returns the cache of the calling thread in
+ *	the pool, NULL if there's none
+ *
+ * The caches of the pools closed in the meantime are freed on the way.
+ */
+static struct alloc_cache *
+alloc_cache_find(PMEMobjpool *pop)
+{
+	struct alloc_cache **prev = &Alloc_thread_caches;
+	struct alloc_cache *cache;
+	while ((cache = *prev) != NULL) {
+		PMEMobjpool *cpop = __atomic_load_n(&cache->pop,
+			__ATOMIC_ACQUIRE);
+		if (cpop == pop)
+			break;
+
+		if (cpop == NULL) {
+			*prev = cache->next_thread;
+			alloc_cache_free(cache);
+		} else {
+			prev = &cache->next_thread;
+		}
+	}
+
+	/* most threads use a single pool, keep its cache in front */
+	if (cache != NULL && prev != &Alloc_thread_caches) {
+		*prev = cache->next_thread;
+		cache->next_thread = Alloc_thread_caches;
+		Alloc_thread_caches = cache;
+	}
+
+	return cache;
+}
+
+/*
+ * alloc_cache_get -- (internal) returns the cache of the calling thread in
+ *	the pool, creates one on first use
+ */
+static struct alloc_cache *
+alloc_cache_get(PMEMobjpool *pop)
+{
+	struct alloc_cache *cache = alloc_cache_find(pop);
+	if (cache != NULL) {
+		if (__atomic_load_n(&cache->reclaim, __ATOMIC_RELAXED)) {
+			__atomic_store_n(&cache->reclaim, 0, __ATOMIC_RELAXED);
+			alloc_cache_drain(pop, cache);
+		}
+
+		return cache;
+	}
+
+	pthread_once(&Alloc_cache_once, alloc_cache_key_create);
+
+	if ((cache = Malloc(sizeof (*cache))) == NULL)
+		return NULL;
+
+	memset(cache, 0, sizeof (*cache));
+	cache->pop = pop;
+
+	util_mutex_lock(&Alloc_caches_lock);
+	cache->next = Alloc_caches;
+	Alloc_caches = cache;
+	util_mutex_unlock(&Alloc_caches_lock);
+
+	/* the value only has to be non-NULL for the destructor to be called */
+	if (Alloc_thread_caches == NULL) {
+		int err = pthread_setspecific(Alloc_cache_key, cache);
+		if (err) {
+			errno = err;
+			FATAL("!pthread_setspecific");
+		}
+	}
+
+	cache->next_thread = Alloc_thread_caches;
+	Alloc_thread_caches = cache;
+
+	return cache;
+}
+
+/*
+ * alloc_magazine_get -- (internal) returns the magazine of the calling thread
+ *	for the allocation class of the bucket, NULL if the class is not
+ *	cached
+ */
+static struct alloc_magazine *
+alloc_magazine_get(PMEMobjpool *pop, struct bucket *b)
+{
+	if (b->type != BUCKET_RUN)
+		return NULL;
+
+	size_t capacity = ALLOC_MAGAZINE_MAX_BYTES / b->unit_size;
+	if (capacity > ALLOC_MAGAZINE_SIZE)
+		capacity = ALLOC_MAGAZINE_SIZE;
+
+	/* there's no point in caching a handful of big blocks */
+	if (capacity < 2)
+		return NULL;
+
+	struct alloc_cache *cache = alloc_cache_get(pop);
+	if (cache == NULL)
+		return NULL;
+
+	ASSERT(b->id < MAX_BUCKETS);
+	struct alloc_magazine *mag = cache->mags[b->id];
+	if (mag == NULL) {
+		if ((mag = Malloc(sizeof (*mag))) == NULL)
+			return NULL;
+
+		mag->nblocks = 0;
+		mag->capacity = (unsigned)capacity;
+		cache->mags[b->id] = mag;
+	}
+
+	return mag;
+}
+
+/*
+ * alloc_cache_reclaim -- (internal) returns memory blocks withheld by the
+ *	magazines of the calling thread, asks the other threads to do the same
+ *
+ * The magazines of the other threads can't be touched while they are in use,
+ * those threads drain them on their next allocation or free in the pool, or
+ * once they exit. Each thread withholds at most ALLOC_MAGAZINE_MAX_BYTES per
+ * allocation class until then.
+ */
+static void
+alloc_cache_reclaim(PMEMobjpool *pop)
+{
+	struct alloc_cache *own = alloc_cache_find(pop);
+	if (own != NULL)
+		alloc_cache_drain(pop, own);
+
+	pthread_once(&Alloc_cache_once, alloc_cache_key_create);
+
+	util_mutex_lock(&Alloc_caches_lock);
+
+	for (struct alloc_cache *c = Alloc_caches; c != NULL; c = c->next) {
+		if (c != own && c->pop == pop)
+			__atomic_store_n(&c->reclaim, 1, __ATOMIC_RELAXED);
+	}
+
+	util_mutex_unlock(&Alloc_caches_lock);
+}
+
+/*
+ * pmalloc_cache_cleanup -- disowns the caches of all threads in the pool
+ *
+ * The memory blocks in the magazines are free in the persistent heap, the
+ * caches themselves are freed by their owners.
+ */
+void
+pmalloc_cache_cleanup(PMEMobjpool *pop)
+{
+	pthread_once(&Alloc_cache_once, alloc_cache_key_create);
+
+	util_mutex_lock(&Alloc_caches_lock);
+
+	struct alloc_cache **prev = &Alloc_caches;
+	struct alloc_cache *cache;
+	while ((cache = *prev) != NULL) {
+		if (cache->pop == pop) {
+			*prev = cache->next;
+			__atomic_store_n(&cache->pop, NULL, __ATOMIC_RELEASE);
+		} else {
+			prev = &cache->next;
+		}
+	}
+
+	util_mutex_unlock(&Alloc_caches_lock);
+}
+
+/*
+ * pmalloc_cache_fini -- frees the caches of the calling thread
+ */
+void
+pmalloc_cache_fini(void)
+{
+	if (!Alloc_cache_key_created)
+		return;
+
+	util_mutex_lock(&Alloc_caches_lock);
+
+	struct alloc_cache *cache;
+	while ((cache = Alloc_thread_caches) != NULL) {
+		Alloc_thread_caches = cache->next_thread;
+
+		if (cache->pop != NULL)
+			alloc_cache_unlink(cache);
+
+		alloc_cache_free(cache);
+	}
+
+	util_mutex_unlock(&Alloc_caches_lock);
+
+	(void) pthread_key_delete(Alloc_cache_key);
+}
+
+/*
+ * alloc_find_block -- (internal) reserves a memory block in the bucket,
+ *	borrows it from the other caches if the bucket is exhausted
+ *
+ * The bucket the block was taken from is returned in the b variable.
+ */
+static int
+alloc_find_block(PMEMobjpool *pop, struct lane_section *lane,
+	struct bucket **bp, struct memory_block *m)
+{
+	struct bucket *b = *bp;
+
+	/*
+	 * Single unit requests are first served from the magazine of
+	 * the calling thread.
+	 */
+	struct alloc_magazine *mag = m->size_idx == 1 ?
+		alloc_magazine_get(pop, b) : NULL;
+
+	int err = mag != NULL ? alloc_magazine_pop(pop, mag, b, m) : ENOMEM;
+
+	if (err == ENOMEM)
+		err = heap_get_bestfit_block(pop, b, m);
+
+	if (err == ENOMEM && b->type == BUCKET_HUGE) {
+		/*
+		 * Empty runs cannot be turned back into chunks while some of
+		 * their blocks are withheld by the magazines.
+		 */
+		alloc_cache_reclaim(pop);
+		err = heap_get_bestfit_block(pop, b, m);
+	}
+
+	if (err == ENOMEM && b->type == BUCKET_HUGE)
+		return err; /* there's only one huge bucket */
+
+	if (err == ENOMEM) {
+		/*
+		 * There's no more available memory in the common heap and in
+		 * this lane cache, fallback to the auxiliary (shared) bucket.
+		 */
+		b = heap_get_auxiliary_bucket(pop, b);
+		err = heap_get_bestfit_block(pop, b, m);
+	}
+
+	if (err == ENOMEM) {
+		/*
+		 * The auxiliary bucket cannot satisfy our request, borrow
+		 * memory from other caches.
+		 */
+		alloc_cache_reclaim(pop);
+		heap_drain_to_auxiliary(pop, b, m->size_idx);
+		err = heap_get_bestfit_block(pop, b, m);
+	}
+
+	*bp = b;
+
+	return err;
+}
+
+/*
+ * alloc_reserve_block -- (internal) reserves a memory block in the bucket
+ *
+ * The frees of committed transactions may still wait for the background
+ * reclaimer, so before giving up they are finished in the calling thread
+ * and the search is repeated. The lane stays held meanwhile, see
+ * lane_reclaimer_flush for why that's safe.
+ */
+static int
+alloc_reserve_block(PMEMobjpool *pop, struct lane_section *lane,
+	struct bucket **bp, struct memory_block *m)
+{
+	struct bucket *b = *bp;
+	struct memory_block mreq = *m;
+
+	int err = alloc_find_block(pop, lane, bp, m);
+	if (err == ENOMEM && lane_reclaimer_flush(pop) != 0) {
+		*bp = b;
+		*m = mreq;
+		err = alloc_find_block(pop, lane, bp, m);
+	}
+
+	return err;
+}
+
 /*
  * pmalloc -- allocates a new block of memory
  *
@@ -200,7 +749,7 @@ persist_alloc(PMEMobjpool *pop, struct lane_section *lane,
 int
 pmalloc(PMEMobjpool *pop, uint64_t *off, size_t size, uint64_t data_off)
 {
-	return pmalloc_construct(pop, off, size, NULL, NULL, data_off);
+	return pmalloc_construct(pop, off, size, NULL, NULL, data_off, 0);
 }
 
 /*
@@ -214,7 +763,8 @@ pmalloc(PMEMobjpool *pop, uint64_t *off, size_t size, uint64_t data_off)
 int
 pmalloc_construct(PMEMobjpool *pop, uint64_t *off, size_t size,
 	void (*constructor)(PMEMobjpool *pop, void *ptr,
-	size_t usable_size, void *arg), void *arg, uint64_t data_off)
+	size_t usable_size, void *arg), void *arg, uint64_t data_off,
+	uint8_t class_id)
 {
 	int err;
 
@@ -223,36 +773,23 @@ pmalloc_construct(PMEMobjpool *pop, uint64_t *off, size_t size,
 
 	size_t sizeh = size + sizeof (struct allocation_header);
 
-	struct bucket *b = heap_get_best_bucket(pop, sizeh);
+	struct bucket *b;
+	if (class_id != 0) {
+		b = heap_get_class_bucket(pop, class_id);
+		if (b == NULL || b->calc_units(b, sizeh) >
+				((struct bucket_run *)b)->unit_max) {
+			err = EINVAL;
+			goto out;
+		}
+	} else {
+		b = heap_get_best_bucket(pop, sizeh);
+	}
 
 	struct memory_block m = {0, 0, 0, 0};
 
 	m.size_idx = b->calc_units(b, sizeh);
 
-	err = heap_get_bestfit_block(pop, b, &m);
-
-	if (err == ENOMEM && b->type == BUCKET_HUGE)
-		goto out; /* there's only one huge bucket */
-
-	if (err == ENOMEM) {
-		/*
-		 * There's no more available memory in the common heap and in
-		 * this lane cache, fallback to the auxiliary (shared) bucket.
-		 */
-		b = heap_get_auxiliary_bucket(pop, sizeh);
-		err = heap_get_bestfit_block(pop, b, &m);
-	}
-
-	if (err == ENOMEM) {
-		/*
-		 * The auxiliary bucket cannot satisfy our request, borrow
-		 * memory from other caches.
-		 */
-		heap_drain_to_auxiliary(pop, b, m.size_idx);
-		err = heap_get_bestfit_block(pop, b, &m);
-	}
-
-	if (err == ENOMEM) {
+	if ((err = alloc_reserve_block(pop, lane, &b, &m)) != 0) {
 		/* we are completely out of memory */
 		goto out;
 	}
@@ -262,7 +799,9 @@ pmalloc_construct(PMEMobjpool *pop, uint64_t *off, size_t size,
 	 * allocation persistent.
 	 */
 	uint64_t real_size = b->unit_size * m.size_idx;
-	persist_alloc(pop, lane, m, real_size, off, constructor, arg, data_off);
+	persist_alloc(pop, lane, b, m, real_size, off,
+		constructor, arg, data_off);
+	heap_stats_used(pop, b, m.size_idx, HEAP_OP_ALLOC);
 	err = 0;
 out:
 	lane_release(pop);
@@ -270,6 +809,156 @@ out:
 	return err;
 }
 
+/*
+ * alloc_redo_store_header -- (internal) stores the new value of a block
+ *	header in the redo log
+ *
+ * Blocks of a run often share a bitmap word, the new value is then merged
+ * into the entry already stored for that word.
+ */
+static size_t
+alloc_redo_store_header(PMEMobjpool *pop, struct redo_log *redo,
+	size_t first, size_t index, void *hdr, uint64_t value, enum heap_op op)
+{
+	uint64_t hdr_off = pop_offset(pop, hdr);
+
+	for (size_t i = first; i < index; ++i) {
+		if (redo[i].offset != hdr_off)
+			continue;
+
+		if (op == HEAP_OP_ALLOC)
+			redo[i].value |= value;
+		else
+			redo[i].value &= value;
+
+		return index;
+	}
+
+	redo_log_store(pop, redo, index, hdr_off, value);
+
+	return index + 1;
+}
+
+/*
+ * pmalloc_reserve_batch -- reserves and constructs n memory blocks of the
+ *	same size without making them persistently allocated
+ *
+ * Offsets of the blocks are stored in the offs array, the blocks have to be
+ * either published with pmalloc_publish_batch or returned with
+ * pmalloc_cancel_batch. Nothing is reserved if the function fails.
+ *
+ * If successful function returns zero. Otherwise an error number is returned.
+ */
+int
+pmalloc_reserve_batch(PMEMobjpool *pop, uint64_t *offs, size_t n,
+	size_t size, void (*constructor)(PMEMobjpool *pop, void *ptr,
+	size_t usable_size, void *arg), void *arg, uint64_t data_off)
+{
+	int err = 0;
+
+	struct lane_section *lane;
+	lane_hold(pop, &lane, LANE_SECTION_ALLOCATOR);
+
+	size_t sizeh = size + sizeof (struct allocation_header);
+	struct bucket *best = heap_get_best_bucket(pop, sizeh);
+	uint32_t units = best->calc_units(best, sizeh);
+
+	size_t i;
+	for (i = 0; i < n; ++i) {
+		struct bucket *b = best;
+		struct memory_block m = {0, 0, units, 0};
+
+		if ((err = alloc_reserve_block(pop, lane, &b, &m)) != 0)
+			break;
+
+		offs[i] = alloc_construct_block(pop, b, m,
+			b->unit_size * m.size_idx, constructor, arg, data_off);
+	}
+
+	if (err != 0)
+		pmalloc_cancel_batch(pop, offs, i, data_off);
+
+	lane_release(pop);
+
+	return err;
+}
+
+/*
+ * pmalloc_cancel_batch -- returns memory blocks reserved by
+ *	pmalloc_reserve_batch
+ */
+void
+pmalloc_cancel_batch(PMEMobjpool *pop, const uint64_t *offs, size_t n,
+	uint64_t data_off)
+{
+	for (size_t i = 0; i < n; ++i) {
+		struct allocation_header *alloc =
+			alloc_get_header(pop, offs[i]);
+		struct memory_block m = get_mblock_from_alloc(pop, alloc);
+		struct bucket *b = heap_get_chunk_bucket(pop,
+			m.chunk_id, m.zone_id);
+		ASSERTne(b, NULL);
+
+		VALGRIND_DO_MEMPOOL_FREE(pop,
+			(char *)alloc + sizeof (*alloc) + data_off);
+
+		CNT_OP(b, insert, pop, m);
+	}
+}
+
+/*
+ * pmalloc_publish_batch -- makes memory blocks reserved by
+ *	pmalloc_reserve_batch persistently allocated
+ *
+ * The header updates of all the blocks are appended to the redo log, which
+ * may already contain redo_index entries of the caller, and the whole log is
+ * committed at once. The log must have room for n more entries.
+ */
+void
+pmalloc_publish_batch(PMEMobjpool *pop, const uint64_t *offs, size_t n,
+	struct redo_log *redo, size_t redo_index)
+{
+	ASSERTne(n, 0);
+	ASSERT(redo_index + n <= REDO_LOG_CAPACITY(REDO_NUM_ENTRIES));
+
+	struct memory_block m[REDO_NUM_ENTRIES];
+	pthread_mutex_t *locks[REDO_NUM_ENTRIES];
+
+	for (size_t i = 0; i < n; ++i)
+		m[i] = get_mblock_from_alloc(pop,
+			alloc_get_header(pop, offs[i]));
+
+	unsigned nlocks = heap_lock_runs(pop, m, (unsigned)n, locks);
+
+	size_t first = redo_index;
+	for (size_t i = 0; i < n; ++i) {
+#ifdef DEBUG
+		if (heap_block_is_allocated(pop, m[i])) {
+			ERR("heap corruption");
+			ASSERT(0);
+		}
+#endif /* DEBUG */
+
+		uint64_t op_result;
+		void *hdr = heap_get_block_header(pop, m[i], HEAP_OP_ALLOC,
+			&op_result);
+
+		redo_index = alloc_redo_store_header(pop, redo, first,
+			redo_index, hdr, op_result, HEAP_OP_ALLOC);
+	}
+
+	redo_log_set_last(pop, redo, redo_index - 1);
+	redo_log_process(pop, redo, REDO_NUM_ENTRIES);
+
+	heap_unlock_runs(locks, nlocks);
+
+	for (size_t i = 0; i < n; ++i) {
+		struct bucket *b = heap_get_chunk_bucket(pop,
+			m[i].chunk_id, m[i].zone_id);
+		heap_stats_used(pop, b, m[i].size_idx, HEAP_OP_ALLOC);
+	}
+}
+
 /*
  * prealloc -- resizes in-place a previously allocated memory block
  *
@@ -308,7 +997,12 @@ prealloc_construct(PMEMobjpool *pop, uint64_t *off, size_t size,
 	struct lane_section *lane;
 	lane_hold(pop, &lane, LANE_SECTION_ALLOCATOR);
 
-	struct bucket *b = heap_get_best_bucket(pop, alloc->size);
+	struct bucket *b = heap_get_chunk_bucket(pop,
+		alloc->chunk_id, alloc->zone_id);
+	if (b == NULL) {
+		lane_release(pop);
+		return ENOMEM;
+	}
 
 	uint32_t add_size_idx = b->calc_units(b, sizeh - alloc->size);
 	uint32_t new_size_idx = b->calc_units(b, sizeh);
@@ -360,7 +1054,9 @@ prealloc_construct(PMEMobjpool *pop, uint64_t *off, size_t size,
 	redo_log_store_last(pop, sec->redo, ALLOC_OP_REDO_HEADER,
 		pop_offset(pop, hdr), op_result);
 
-	redo_log_process(pop, sec->redo, MAX_ALLOC_OP_REDO);
+	redo_log_process(pop, sec->redo, REDO_LOG_SIZE);
+
+	heap_stats_used(pop, b, next.size_idx, HEAP_OP_ALLOC);
 
 out:
 	heap_unlock_if_run(pop, cnt);
@@ -369,6 +1065,19 @@ out:
 	return err;
 }
 
+/*
+ * pmalloc_class_register -- registers an allocation class for pmalloc
+ *	requests of the given size
+ */
+int
+pmalloc_class_register(PMEMobjpool *pop, size_t size,
+	unsigned units_per_run, uint8_t *class_id)
+{
+	return heap_alloc_class_register(pop,
+		size + sizeof (struct allocation_header),
+		units_per_run, class_id);
+}
+
 /*
  * pmalloc_usable_size -- returns the number of bytes in the memory block
  */
@@ -406,11 +1115,21 @@ pfree(PMEMobjpool *pop, uint64_t *off, uint64_t data_off)
 	}
 #endif /* DEBUG */
 
+	struct alloc_magazine *mag = b != NULL && m.size_idx == 1 ?
+		alloc_magazine_get(pop, b) : NULL;
+
 	heap_lock_if_run(pop, m);
 
 	uint64_t op_result;
 	void *hdr;
-	struct memory_block res = heap_free_block(pop, b, m, &hdr, &op_result);
+	struct memory_block res;
+	if (mag != NULL) {
+		/* the block is coalesced once it leaves the magazine */
+		res = m;
+		hdr = heap_get_block_header(pop, m, HEAP_OP_FREE, &op_result);
+	} else {
+		res = heap_free_block(pop, b, m, &hdr, &op_result);
+	}
 
 	struct allocator_lane_section *sec =
 		(struct allocator_lane_section *)lane->layout;
@@ -420,15 +1139,20 @@ pfree(PMEMobjpool *pop, uint64_t *off, uint64_t data_off)
 	redo_log_store_last(pop, sec->redo, ALLOC_OP_REDO_HEADER,
 		pop_offset(pop, hdr), op_result);
 
-	redo_log_process(pop, sec->redo, MAX_ALLOC_OP_REDO);
+	redo_log_process(pop, sec->redo, REDO_LOG_SIZE);
 
 	heap_unlock_if_run(pop, m);
 
+	if (b != NULL)
+		heap_stats_used(pop, b, m.size_idx, HEAP_OP_FREE);
+
 	VALGRIND_DO_MEMPOOL_FREE(pop,
 			(char *)alloc + sizeof (*alloc) + data_off);
 
-	/* we might have been operating on inactive run */
-	if (b != NULL) {
+	if (mag != NULL) {
+		alloc_magazine_push(pop, mag, res);
+	} else if (b != NULL) {
+		/* we might have been operating on inactive run */
 		CNT_OP(b, insert, pop, res);
 
 		if (b->type == BUCKET_RUN)
@@ -438,6 +1162,117 @@ pfree(PMEMobjpool *pop, uint64_t *off, uint64_t data_off)
 	lane_release(pop);
 }
 
+/*
+ * pfree_batch -- deallocates n memory blocks previously allocated by pmalloc
+ *
+ * The header updates of all the blocks are appended to the redo log, which
+ * may already contain redo_index entries of the caller, and the whole log is
+ * committed at once. The log must have room for n more entries.
+ */
+void
+pfree_batch(PMEMobjpool *pop, const uint64_t *offs, size_t n,
+	uint64_t data_off, struct redo_log *redo, size_t redo_index)
+{
+	ASSERTne(n, 0);
+	ASSERT(redo_index + n <= REDO_LOG_CAPACITY(REDO_NUM_ENTRIES));
+
+	struct memory_block m[REDO_NUM_ENTRIES];
+	struct memory_block res[REDO_NUM_ENTRIES];
+	struct bucket *b[REDO_NUM_ENTRIES];
+	pthread_mutex_t *locks[REDO_NUM_ENTRIES];
+
+	for (size_t i = 0; i < n; ++i) {
+		m[i] = get_mblock_from_alloc(pop,
+			alloc_get_header(pop, offs[i]));
+		b[i] = heap_get_chunk_bucket(pop, m[i].chunk_id,
+			m[i].zone_id);
+	}
+
+	unsigned nlocks = heap_lock_runs(pop, m, (unsigned)n, locks);
+
+	size_t first = redo_index;
+	for (size_t i = 0; i < n; ++i) {
+#ifdef DEBUG
+		if (!heap_block_is_allocated(pop, m[i])) {
+			ERR("Double free or heap corruption");
+			ASSERT(0);
+		}
+#endif /* DEBUG */
+
+		uint64_t op_result;
+		void *hdr;
+
+		/*
+		 * The blocks are not coalesced with each other, only with
+		 * the free blocks already present in the buckets.
+		 */
+		if (b[i] != NULL) {
+			res[i] = heap_free_block(pop, b[i], m[i],
+				&hdr, &op_result);
+		} else {
+			res[i] = m[i];
+			hdr = heap_get_block_header(pop, m[i], HEAP_OP_FREE,
+				&op_result);
+		}
+
+		redo_index = alloc_redo_store_header(pop, redo, first,
+			redo_index, hdr, op_result, HEAP_OP_FREE);
+	}
+
+	redo_log_set_last(pop, redo, redo_index - 1);
+	redo_log_process(pop, redo, REDO_NUM_ENTRIES);
+
+	heap_unlock_runs(locks, nlocks);
+
+	for (size_t i = 0; i < n; ++i) {
+		VALGRIND_DO_MEMPOOL_FREE(pop, (char *)pop + offs[i] + data_off);
+
+		if (b[i] == NULL)
+			continue;
+
+		heap_stats_used(pop, b[i], m[i].size_idx, HEAP_OP_FREE);
+
+		CNT_OP(b[i], insert, pop, res[i]);
+
+		if (b[i]->type == BUCKET_RUN)
+			heap_degrade_run_if_empty(pop, b[i], res[i]);
+	}
+}
+
+/*
+ * pmalloc_defrag_begin -- starts the evacuation of the next sparse run
+ *
+ * Memory blocks of the run that are already in the magazines would still be
+ * handed out, they are returned to the buckets, where they are withheld.
+ */
+int
+pmalloc_defrag_begin(PMEMobjpool *pop, unsigned max_occupancy,
+	uint64_t *offs, unsigned *noffs)
+{
+	int ret = heap_defrag_begin(pop, max_occupancy, offs, noffs);
+	if (ret == 0)
+		alloc_cache_reclaim(pop);
+
+	return ret;
+}
+
+/*
+ * pmalloc_defrag_release -- finishes the evacuation of a run started by
+ *	heap_defrag_begin
+ *
+ * The freed memory blocks of the run are likely to be in the magazines, those
+ * have to be returned to the buckets for the run to be released.
+ *
+ * Returns 1 if the run was turned into a free chunk.
+ */
+int
+pmalloc_defrag_release(PMEMobjpool *pop)
+{
+	alloc_cache_reclaim(pop);
+
+	return heap_defrag_end(pop);
+}
+
 /*
  * lane_allocator_construct -- create allocator lane section
  */
@@ -465,7 +1300,7 @@ lane_allocator_recovery(PMEMobjpool *pop, struct lane_section_layout *section)
 	struct allocator_lane_section *sec =
 		(struct allocator_lane_section *)section;
 
-	redo_log_recover(pop, sec->redo, MAX_ALLOC_OP_REDO);
+	redo_log_recover(pop, sec->redo, REDO_LOG_SIZE);
 
 	return 0;
 }
@@ -482,18 +1317,44 @@ lane_allocator_check(PMEMobjpool *pop, struct lane_section_layout *section)
 		(struct allocator_lane_section *)section;
 
 	int ret;
-	if ((ret = redo_log_check(pop, sec->redo, MAX_ALLOC_OP_REDO)) != 0)
+	if ((ret = redo_log_check(pop, sec->redo, REDO_LOG_SIZE)) != 0)
 		ERR("allocator lane: redo log check failed");
 
 	return ret;
 }
 
+/*
+ * lane_allocator_check_idle -- checks if the allocator lane section of a pool
+ *	in the older format holds no pending redo log
+ */
+static int
+lane_allocator_check_idle(PMEMobjpool *pop,
+	struct lane_section_layout *section)
+{
+	LOG(3, "allocator lane %p", section);
+
+	struct allocator_lane_section *sec =
+		(struct allocator_lane_section *)section;
+
+	/* the older redo log is shorter, the rest of the section is zeroed */
+	if (redo_log_pending(sec->redo, REDO_LOG_SIZE)) {
+		LOG(2, "allocator lane: pending redo log");
+		return EINVAL;
+	}
+
+	return 0;
+}
+
 /*
  * lane_allocator_init -- initializes allocator section
  */
 static int
 lane_allocator_boot(PMEMobjpool *pop)
 {
+	COMPILE_ERROR_ON(sizeof (struct allocator_lane_section) >
+		LANE_SECTION_LEN);
+	COMPILE_ERROR_ON(MAX_ALLOC_OP_REDO > REDO_LOG_CAPACITY(REDO_LOG_SIZE));
+
 	return heap_boot(pop);
 }
 
@@ -502,7 +1363,8 @@ static struct section_operations allocator_ops = {
 	.destruct = lane_allocator_destruct,
 	.recover = lane_allocator_recovery,
 	.check = lane_allocator_check,
-	.boot = lane_allocator_boot
+	.boot = lane_allocator_boot,
+	.check_idle = lane_allocator_check_idle
 };
 
 SECTION_PARM(LANE_SECTION_ALLOCATOR, &allocator_ops);
@@ -34,16 +34,33 @@
  * pmalloc.h -- internal definitions for persistent malloc
  */
 
+struct redo_log;
+
 int heap_boot(PMEMobjpool *pop);
+void heap_populate_start(PMEMobjpool *pop);
 int heap_init(PMEMobjpool *pop);
 void heap_vg_open(PMEMobjpool *pop);
 void heap_cleanup(PMEMobjpool *pop);
+void pmalloc_cache_cleanup(PMEMobjpool *pop);
+void pmalloc_cache_fini(void);
 int heap_check(PMEMobjpool *pop);
+void heap_get_stats(PMEMobjpool *pop, struct pobj_heap_stats *stats);
+uint64_t heap_next_alloc(PMEMobjpool *pop, uint64_t off);
+int heap_walk(PMEMobjpool *pop, unsigned part, unsigned nparts,
+	int (*cb)(PMEMobjpool *pop, uint64_t off, void *arg), void *arg);
 
 int pmalloc(PMEMobjpool *pop, uint64_t *off, size_t size, uint64_t data_off);
 int pmalloc_construct(PMEMobjpool *pop, uint64_t *off, size_t size,
 	void (*constructor)(PMEMobjpool *pop, void *ptr, size_t usable_size,
-	void *arg), void *arg, uint64_t data_off);
+	void *arg), void *arg, uint64_t data_off, uint8_t class_id);
+
+int pmalloc_reserve_batch(PMEMobjpool *pop, uint64_t *offs, size_t n,
+	size_t size, void (*constructor)(PMEMobjpool *pop, void *ptr,
+	size_t usable_size, void *arg), void *arg, uint64_t data_off);
+void pmalloc_cancel_batch(PMEMobjpool *pop, const uint64_t *offs, size_t n,
+	uint64_t data_off);
+void pmalloc_publish_batch(PMEMobjpool *pop, const uint64_t *offs, size_t n,
+	struct redo_log *redo, size_t redo_index);
 
 int prealloc(PMEMobjpool *pop, uint64_t *off, size_t size, uint64_t data_off);
 int prealloc_construct(PMEMobjpool *pop, uint64_t *off, size_t size,
@@ -51,4 +68,11 @@ int prealloc_construct(PMEMobjpool *pop, uint64_t *off, size_t size,
 	void *arg), void *arg, uint64_t data_off);
 
 size_t pmalloc_usable_size(PMEMobjpool *pop, uint64_t off);
+int pmalloc_class_register(PMEMobjpool *pop, size_t size,
+	unsigned units_per_run, uint8_t *class_id);
 void pfree(PMEMobjpool *pop, uint64_t *off, uint64_t data_off);
+void pfree_batch(PMEMobjpool *pop, const uint64_t *offs, size_t n,
+	uint64_t data_off, struct redo_log *redo, size_t redo_index);
+int pmalloc_defrag_begin(PMEMobjpool *pop, unsigned max_occupancy,
+	uint64_t *offs, unsigned *noffs);
+int pmalloc_defrag_release(PMEMobjpool *pop);
@@ -44,6 +44,9 @@
 #include "out.h"
 #include "valgrind_internal.h"
 
+/* number of modified values flushed by a single flushv call */
+#define	REDO_FLUSH_BATCH 16
+
 /*
  * redo_log_check_offset -- (internal) check if offset is valid
  */
@@ -74,6 +77,39 @@ redo_log_nflags(struct redo_log *redo, size_t nentries)
 	return ret;
 }
 
+/*
+ * redo_log_committed -- (internal) check if the checksum stored in the commit
+ *	entry matches the redo log entries
+ */
+static int
+redo_log_committed(struct redo_log *redo, size_t nentries)
+{
+	for (size_t i = 0; i < nentries; i++) {
+		if (redo[i].offset & REDO_FINISH_FLAG)
+			return util_checksum(redo, (i + 1) * sizeof (*redo),
+					&redo[i].value, 0);
+	}
+
+	return 0;
+}
+
+/*
+ * redo_log_commit -- (internal) commit the redo log after specified index
+ *
+ * All the entries and the commit entry are flushed together and made durable
+ * by a single drain. If the log is torn by a failure, the checksum of
+ * the commit entry does not match and the recovery discards the log.
+ */
+static void
+redo_log_commit(PMEMobjpool *pop, struct redo_log *redo, size_t index)
+{
+	struct redo_log *commit = &redo[index + 1];
+	commit->offset = REDO_FINISH_FLAG;
+	util_checksum(redo, (index + 2) * sizeof (*redo), &commit->value, 1);
+
+	pop->persist(pop, redo, (index + 2) * sizeof (*redo));
+}
+
 /*
  * redo_log_store -- (internal) store redo log entry at specified index
  */
@@ -102,35 +138,26 @@ redo_log_store_last(PMEMobjpool *pop, struct redo_log *redo, size_t index,
 			redo, index, offset, value);
 
 	ASSERTeq(offset & REDO_FINISH_FLAG, 0);
-	ASSERT(index < REDO_NUM_ENTRIES);
+	ASSERT(index < REDO_LOG_CAPACITY(REDO_NUM_ENTRIES));
 
-	/* store value of last entry */
+	redo[index].offset = offset;
 	redo[index].value = value;
 
-	/* persist all redo log entries */
-	pop->persist(pop, redo, (index + 1) * sizeof (struct redo_log));
-
-	/* store and persist offset of last entry */
-	redo[index].offset = offset | REDO_FINISH_FLAG;
-	pop->persist(pop, &redo[index].offset, sizeof (redo[index].offset));
+	redo_log_commit(pop, redo, index);
 }
 
 /*
- * redo_log_set_last -- (internal) set finish flag in specified entry
+ * redo_log_set_last -- (internal) commit the log with specified entry as
+ *	the last one
  */
 void
 redo_log_set_last(PMEMobjpool *pop, struct redo_log *redo, size_t index)
 {
 	LOG(15, "redo %p index %zu", redo, index);
 
-	ASSERT(index < REDO_NUM_ENTRIES);
-
-	/* persist all redo log entries */
-	pop->persist(pop, redo, (index + 1) * sizeof (struct redo_log));
+	ASSERT(index < REDO_LOG_CAPACITY(REDO_NUM_ENTRIES));
 
-	/* set finish flag of last entry and persist */
-	redo[index].offset |= REDO_FINISH_FLAG;
-	pop->persist(pop, &redo[index].offset, sizeof (redo[index].offset));
+	redo_log_commit(pop, redo, index);
 }
 
 /*
@@ -143,9 +170,19 @@ redo_log_process(PMEMobjpool *pop, struct redo_log *redo,
 	LOG(15, "redo %p nentries %zu", redo, nentries);
 
 #ifdef	DEBUG
+	ASSERT(redo_log_committed(redo, nentries));
 	ASSERTeq(redo_log_check(pop, redo, nentries), 0);
 #endif
 
+	/*
+	 * Entries often modify neighbouring fields, so the modified values
+	 * are flushed in batches which let libpmem flush every cache line
+	 * only once. The last batch is followed by a single drain, after which
+	 * the commit entry can be invalidated.
+	 */
+	struct pmem_vec vec[REDO_FLUSH_BATCH];
+	size_t nvec = 0;
+
 	uint64_t *val;
 	while ((redo->offset & REDO_FINISH_FLAG) == 0) {
 		val = (uint64_t *)((uintptr_t)pop->addr + redo->offset);
@@ -153,18 +190,19 @@ redo_log_process(PMEMobjpool *pop, struct redo_log *redo,
 		*val = redo->value;
 		VALGRIND_REMOVE_FROM_TX(val, sizeof (*val));
 
-		pop->flush(pop, val, sizeof (uint64_t));
+		if (nvec == REDO_FLUSH_BATCH) {
+			pop->flushv(pop, vec, nvec);
+			nvec = 0;
+		}
+
+		vec[nvec].addr = val;
+		vec[nvec].len = sizeof (uint64_t);
+		nvec++;
 
 		redo++;
 	}
 
-	uint64_t offset = redo->offset & REDO_FLAG_MASK;
-	val = (uint64_t *)((uintptr_t)pop->addr + offset);
-	VALGRIND_ADD_TO_TX(val, sizeof (*val));
-	*val = redo->value;
-	VALGRIND_REMOVE_FROM_TX(val, sizeof (*val));
-
-	pop->persist(pop, val, sizeof (uint64_t));
+	pop->persistv(pop, vec, nvec);
 
 	redo->offset = 0;
 
@@ -185,8 +223,22 @@ redo_log_recover(PMEMobjpool *pop, struct redo_log *redo,
 	size_t nflags = redo_log_nflags(redo, nentries);
 	ASSERT(nflags < 2);
 
-	if (nflags == 1)
+	if (nflags == 0)
+		return;
+
+	if (redo_log_committed(redo, nentries)) {
 		redo_log_process(pop, redo, nentries);
+		return;
+	}
+
+	/* the log was torn before being committed, discard it */
+	LOG(15, "redo %p checksum mismatch", redo);
+
+	while ((redo->offset & REDO_FINISH_FLAG) == 0)
+		redo++;
+
+	redo->offset = 0;
+	pop->persist(pop, &redo->offset, sizeof (redo->offset));
 }
 
 /*
@@ -204,7 +256,8 @@ redo_log_check(PMEMobjpool *pop, struct redo_log *redo, size_t nentries)
 		return -1;
 	}
 
-	if (nflags == 1) {
+	/* a torn log is consistent, it's discarded by the recovery */
+	if (nflags == 1 && redo_log_committed(redo, nentries)) {
 		while ((redo->offset & REDO_FINISH_FLAG) == 0) {
 			if (!redo_log_check_offset(pop, redo->offset)) {
 				LOG(15, "redo %p invalid offset %ju",
@@ -213,13 +266,19 @@ redo_log_check(PMEMobjpool *pop, struct redo_log *redo, size_t nentries)
 			}
 			redo++;
 		}
-
-		uint64_t offset = redo->offset & REDO_FLAG_MASK;
-		if (!redo_log_check_offset(pop, offset)) {
-			LOG(15, "redo %p invalid offset %ju", redo, offset);
-			return -1;
-		}
 	}
 
 	return 0;
 }
+
+/*
+ * redo_log_pending -- (internal) check if the redo log has the finish flag set
+ *	in any of its entries, which means it's not processed yet
+ */
+int
+redo_log_pending(struct redo_log *redo, size_t nentries)
+{
+	LOG(15, "redo %p nentries %zu", redo, nentries);
+
+	return redo_log_nflags(redo, nentries) != 0;
+}
@@ -40,8 +40,18 @@
 #define	REDO_FINISH_FLAG	((uint64_t)1<<0)
 #define	REDO_FLAG_MASK		(~REDO_FINISH_FLAG)
 
+/*
+ * Number of modifications which fit in a redo log of nentries entries,
+ * the entry following the last modification commits the log
+ */
+#define	REDO_LOG_CAPACITY(nentries)	((nentries) - 1)
+
 /*
  * redo_log -- redo log entry
+ *
+ * The log is variable-length and is terminated by a commit entry, which has
+ * the finish flag set in the offset field and the checksum of the whole log
+ * (up to and including its own offset field) in the value field.
  */
 struct redo_log {
 	uint64_t offset;	/* offset with finish flag */
@@ -58,3 +68,4 @@ void redo_log_process(PMEMobjpool *pop, struct redo_log *redo,
 void redo_log_recover(PMEMobjpool *pop, struct redo_log *redo,
 		size_t nentries);
 int redo_log_check(PMEMobjpool *pop, struct redo_log *redo, size_t nentries);
+int redo_log_pending(struct redo_log *redo, size_t nentries);
@@ -70,10 +70,77 @@ struct tx_lock_data {
 	SLIST_ENTRY(tx_lock_data) tx_lock;
 };
 
+/* ranges are indexed with cache line granularity */
+#define	TX_RANGE_LINE_SHIFT 6
+#define	TX_RANGE_LINE_SIZE (1ULL << TX_RANGE_LINE_SHIFT)
+#define	TX_RANGE_INDEX_MAX_SIZE 512 /* bigger ranges are kept in ctree */
+#define	TX_RANGE_INDEX_MIN_CAPACITY 256
+#define	TX_RANGE_INDEX_MAX_RETAINED 16384 /* entries kept after tx end */
+
+/* mask of bytes from lo to hi (exclusive) of a line */
+#define	TX_RANGE_LINE_MASK(lo, hi)\
+	((hi) - (lo) == TX_RANGE_LINE_SIZE ? ~0ULL :\
+	((1ULL << ((hi) - (lo))) - 1) << (lo))
+
+struct tx_range_line {
+	uint64_t gen; /* the entry is valid only in its own generation */
+	uint64_t line;
+	uint64_t mask; /* bytes of the line which are in the undo log */
+	uint64_t link; /* newest redo write to the line, 0 if none */
+};
+
+/*
+ * Open addressing hash set of cache lines touched by the transaction.
+ * The entries are kept between transactions and invalidated all at
+ * once by bumping the generation.
+ */
+struct tx_range_index {
+	struct tx_range_line *lines;
+	size_t capacity; /* power of two */
+	size_t count;
+	uint64_t gen;
+	uint64_t min_line;
+	uint64_t max_line;
+};
+
+/*
+ * Range written in redo mode, the data lives in the undo log arena until
+ * the transaction commits.
+ */
+struct tx_redo_write {
+	uint64_t offset;
+	uint64_t size;
+	struct tx_undo_entry *entry;
+};
+
+/*
+ * Element of the per line lists of redo writes, newest first, links are
+ * numbered from 1.
+ */
+struct tx_redo_link {
+	size_t write; /* slot in the array of redo writes */
+	uint64_t next; /* older write to the same line, 0 if none */
+};
+
 struct lane_tx_runtime {
 	PMEMobjpool *pop;
-	struct ctree *ranges;
-	int cache_slot;
+	struct tx_range_index index;
+	struct ctree *ranges; /* ranges too big for the index, or NULL */
+	uint8_t *undo_buf; /* current undo log arena buffer */
+	size_t undo_capacity; /* size of the current buffer */
+	size_t undo_pos; /* first free byte of the current buffer */
+	PMEMoid undo_chunk; /* current arena chunk, OID_NULL for in-lane part */
+	int undo_flushed; /* snapshots waiting for a drain */
+	int dirty; /* the undo logs have been written to */
+	int deferred; /* post commit frees are left to the reclaimer */
+	int redo; /* writes are kept in the redo log until commit */
+	struct tx_range_index redo_index; /* bytes written in redo mode */
+	struct tx_redo_write *redo_writes;
+	size_t redo_nwrites;
+	size_t redo_capacity;
+	struct tx_redo_link *redo_links;
+	size_t redo_nlinks;
+	size_t redo_links_capacity;
 	SLIST_HEAD(txd, tx_data) tx_entries;
 	SLIST_HEAD(txl, tx_lock_data) tx_locks;
 };
@@ -129,6 +196,199 @@ pmemobj_tx_abort_null(int errnum)
 		FATAL("%s called in invalid stage %d", __func__, tx.stage);\
 } while (0)
 
+/*
+ * tx_range_index_reset -- (internal) removes all lines from the index
+ */
+static void
+tx_range_index_reset(struct tx_range_index *idx)
+{
+	idx->gen++;
+	idx->count = 0;
+	idx->min_line = UINT64_MAX;
+	idx->max_line = 0;
+
+	/* don't hold on to the memory after an unusually big transaction */
+	if (idx->capacity > TX_RANGE_INDEX_MAX_RETAINED) {
+		Free(idx->lines);
+		idx->lines = NULL;
+		idx->capacity = 0;
+	}
+}
+
+/*
+ * tx_range_index_slot -- (internal) returns the entry of the line or an
+ *	empty slot where it should be inserted
+ */
+static inline struct tx_range_line *
+tx_range_index_slot(struct tx_range_index *idx, uint64_t line)
+{
+	size_t mask = idx->capacity - 1;
+	size_t i = (size_t)((line * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+
+	for (;;) {
+		struct tx_range_line *l = &idx->lines[i];
+		if (l->gen != idx->gen || l->line == line)
+			return l;
+
+		i = (i + 1) & mask;
+	}
+}
+
+/*
+ * tx_range_index_grow -- (internal) doubles the capacity of the index
+ */
+static int
+tx_range_index_grow(struct tx_range_index *idx)
+{
+	size_t capacity = idx->capacity ?
+		idx->capacity * 2 : TX_RANGE_INDEX_MIN_CAPACITY;
+
+	struct tx_range_line *lines = Malloc(capacity * sizeof (*lines));
+	if (lines == NULL) {
+		ERR("!Malloc");
+		return -1;
+	}
+
+	/* generation 0 is never used */
+	memset(lines, 0, capacity * sizeof (*lines));
+
+	struct tx_range_line *old = idx->lines;
+	size_t old_capacity = idx->capacity;
+
+	idx->lines = lines;
+	idx->capacity = capacity;
+
+	for (size_t i = 0; i < old_capacity; ++i) {
+		if (old[i].gen == idx->gen)
+			*tx_range_index_slot(idx, old[i].line) = old[i];
+	}
+
+	Free(old);
+
+	return 0;
+}
+
+/*
+ * tx_range_index_get -- (internal) returns the entry of the line, inserts
+ *	an empty one if the line isn't in the index yet
+ */
+static struct tx_range_line *
+tx_range_index_get(struct tx_range_index *idx, uint64_t line)
+{
+	/* keep the load factor under 1/2 */
+	if ((idx->count + 1) * 2 > idx->capacity &&
+			tx_range_index_grow(idx) != 0)
+		return NULL;
+
+	struct tx_range_line *l = tx_range_index_slot(idx, line);
+	if (l->gen != idx->gen) {
+		l->gen = idx->gen;
+		l->line = line;
+		l->mask = 0;
+		l->link = 0;
+		idx->count++;
+
+		if (line < idx->min_line)
+			idx->min_line = line;
+		if (line > idx->max_line)
+			idx->max_line = line;
+	}
+
+	return l;
+}
+
+/*
+ * tx_range_index_find -- (internal) returns the bytes of the line which are
+ *	in the index
+ */
+static inline uint64_t
+tx_range_index_find(struct tx_range_index *idx, uint64_t line)
+{
+	if (idx->count == 0)
+		return 0;
+
+	struct tx_range_line *l = tx_range_index_slot(idx, line);
+
+	return l->gen == idx->gen ? l->mask : 0;
+}
+
+/*
+ * tx_range_index_mark -- (internal) adds all bytes of the range to the index
+ */
+static int
+tx_range_index_mark(struct tx_range_index *idx, uint64_t offset,
+	uint64_t size)
+{
+	uint64_t end = offset + size;
+	for (uint64_t line = offset >> TX_RANGE_LINE_SHIFT;
+		(line << TX_RANGE_LINE_SHIFT) < end; ++line) {
+		uint64_t lbeg = line << TX_RANGE_LINE_SHIFT;
+		uint64_t lo = (offset > lbeg ? offset : lbeg) - lbeg;
+		uint64_t hi = (end < lbeg + TX_RANGE_LINE_SIZE ?
+			end : lbeg + TX_RANGE_LINE_SIZE) - lbeg;
+
+		struct tx_range_line *l = tx_range_index_get(idx, line);
+		if (l == NULL)
+			return -1;
+
+		l->mask |= TX_RANGE_LINE_MASK(lo, hi);
+	}
+
+	return 0;
+}
+
+/*
+ * tx_ranges_insert -- (internal) marks the range as not requiring a snapshot
+ */
+static int
+tx_ranges_insert(struct lane_tx_runtime *runtime, uint64_t offset,
+	uint64_t size)
+{
+	if (size > TX_RANGE_INDEX_MAX_SIZE) {
+		if (runtime->ranges == NULL &&
+				(runtime->ranges = ctree_new()) == NULL)
+			return -1;
+
+		return ctree_insert(runtime->ranges, offset, size);
+	}
+
+	return tx_range_index_mark(&runtime->index, offset, size);
+}
+
+/*
+ * tx_ranges_remove -- (internal) forgets the object allocated within the
+ *	transaction, size is the usable size of the object
+ */
+static int
+tx_ranges_remove(struct lane_tx_runtime *runtime, uint64_t offset,
+	uint64_t size)
+{
+	if (runtime->ranges != NULL &&
+			ctree_remove(runtime->ranges, offset, 1) == offset)
+		return 0;
+
+	struct tx_range_index *idx = &runtime->index;
+	uint64_t first = offset >> TX_RANGE_LINE_SHIFT;
+	uint64_t bit = 1ULL << (offset & (TX_RANGE_LINE_SIZE - 1));
+	if ((tx_range_index_find(idx, first) & bit) == 0)
+		return -1;
+
+	uint64_t end = offset + size;
+	for (uint64_t line = first;
+		(line << TX_RANGE_LINE_SHIFT) < end; ++line) {
+		uint64_t lbeg = line << TX_RANGE_LINE_SHIFT;
+		uint64_t lo = (offset > lbeg ? offset : lbeg) - lbeg;
+		uint64_t hi = (end < lbeg + TX_RANGE_LINE_SIZE ?
+			end : lbeg + TX_RANGE_LINE_SIZE) - lbeg;
+
+		struct tx_range_line *l = tx_range_index_slot(idx, line);
+		if (l->gen == idx->gen)
+			l->mask &= ~TX_RANGE_LINE_MASK(lo, hi);
+	}
+
+	return 0;
+}
+
 /*
  * constructor_tx_alloc -- (internal) constructor for normal alloc
  */
@@ -406,14 +666,199 @@ tx_abort_free(PMEMobjpool *pop, struct lane_tx_layout *layout)
 		VALGRIND_REMOVE_FROM_TX(OBJ_OFF_TO_PTR(pop, obj.off), size);
 #endif
 
-		struct object_store_item *obj_list =
-			&pop->store->bytype[oobh->data.user_type];
+		struct list_head *obj_list =
+			OBJ_TYPE_LIST(pop, oobh->data.user_type);
 
 		/* move all objects back to object store */
-		list_move_oob(pop, &layout->undo_free, &obj_list->head, obj);
+		list_move_oob(pop, &layout->undo_free, obj_list, obj);
+	}
+}
+
+/*
+ * tx_undo_lane_buf -- (internal) returns the in-lane part of undo log arena
+ */
+static uint8_t *
+tx_undo_lane_buf(PMEMobjpool *pop, struct lane_tx_layout *layout,
+	size_t *capacity)
+{
+	*capacity = OBJ_LANE_SECTION_LEN(pop) - sizeof (struct lane_tx_layout);
+	return layout->undo_arena;
+}
+
+/*
+ * tx_undo_drain -- (internal) makes the flushed undo log entries durable
+ */
+static inline void
+tx_undo_drain(PMEMobjpool *pop, struct lane_tx_runtime *runtime)
+{
+	if (runtime->undo_flushed) {
+		pop->drain(pop);
+		runtime->undo_flushed = 0;
+	}
+}
+
+/*
+ * tx_undo_chunk_buf -- (internal) returns the buffer of undo log arena chunk
+ */
+static uint8_t *
+tx_undo_chunk_buf(PMEMobjpool *pop, PMEMoid chunk, size_t *capacity)
+{
+	/*
+	 * This function can be called from transaction recovery,
+	 * so use pmalloc version of the usable size.
+	 */
+	*capacity = pmalloc_usable_size(pop, chunk.off - OBJ_OOB_SIZE) -
+			OBJ_OOB_SIZE;
+	return OBJ_OFF_TO_PTR(pop, chunk.off);
+}
+
+/*
+ * tx_undo_buf_range -- (internal) returns the range stored at given position
+ *	of undo log buffer or NULL if the log ends there
+ */
+static struct tx_range *
+tx_undo_buf_range(uint8_t *buf, size_t capacity, size_t pos, uint64_t gen)
+{
+	if (capacity < pos + TX_UNDO_ENTRY_LEN(0))
+		return NULL;
+
+	struct tx_undo_entry *entry = (struct tx_undo_entry *)(buf + pos);
+	struct tx_range *range = (struct tx_range *)(entry + 1);
+
+	/* entries left by previous transactions have an older generation */
+	if (entry->gen != gen || range->offset == 0 || range->size == 0 ||
+		range->size > capacity - pos ||
+		TX_UNDO_ENTRY_LEN(range->size) > capacity - pos)
+		return NULL;
+
+	/* the last entry may be torn by a failure */
+	size_t cslen = TX_UNDO_CHECKSUM_LEN(range->offset, range->size);
+	if (!util_checksum(entry, cslen, &entry->checksum, 0))
+		return NULL;
+
+	return range;
+}
+
+/*
+ * tx_undo_buf_foreach -- (internal) iterates over either snapshots or redo
+ *	ranges in undo log buffer, returns the number of visited ranges
+ */
+static size_t
+tx_undo_buf_foreach(PMEMobjpool *pop, uint8_t *buf, size_t capacity,
+	uint64_t gen, uint64_t redo,
+	void (*cb)(PMEMobjpool *pop, struct tx_range *range))
+{
+	struct tx_range *range;
+	size_t pos = 0;
+	size_t n = 0;
+
+	while ((range = tx_undo_buf_range(buf, capacity, pos, gen)) != NULL) {
+		pos += TX_UNDO_ENTRY_LEN(range->size);
+		if ((range->offset & TX_RANGE_REDO) == redo) {
+			cb(pop, range);
+			n++;
+		}
+	}
+
+	return n;
+}
+
+/*
+ * tx_undo_buf_used -- (internal) checks if the first entry of undo log buffer
+ *	was written in the current generation, even partially
+ */
+static int
+tx_undo_buf_used(uint8_t *buf, size_t capacity, uint64_t gen)
+{
+	if (capacity < TX_UNDO_ENTRY_LEN(0))
+		return 0;
+
+	struct tx_undo_entry *entry = (struct tx_undo_entry *)buf;
+	struct tx_range *range = (struct tx_range *)(entry + 1);
+
+	/* a zeroed buffer matches the initial generation */
+	return entry->gen == gen && (range->offset != 0 || range->size != 0);
+}
+
+/*
+ * tx_undo_arena_invalidate -- (internal) invalidates all the entries of
+ *	the undo log arena
+ */
+static void
+tx_undo_arena_invalidate(PMEMobjpool *pop, struct lane_tx_layout *layout)
+{
+	LOG(3, NULL);
+
+	struct list_head *head = &layout->undo_set_cache;
+	size_t capacity;
+	uint8_t *buf = tx_undo_lane_buf(pop, layout, &capacity);
+	int used = tx_undo_buf_used(buf, capacity, layout->undo_gen);
+
+	/*
+	 * The ranges are stored in the in-lane part first, unless the first
+	 * one doesn't fit there, so it's enough to look at the first chunk.
+	 */
+	if (!used && !OBJ_OID_IS_NULL(head->pe_first)) {
+		buf = tx_undo_chunk_buf(pop, head->pe_first, &capacity);
+		used = tx_undo_buf_used(buf, capacity, layout->undo_gen);
+	}
+
+	/* all the entries of the current generation become invalid at once */
+	if (used) {
+		layout->undo_gen++;
+		pop->persist(pop, &layout->undo_gen, sizeof (layout->undo_gen));
 	}
 }
 
+/*
+ * tx_undo_arena_nth_chunk -- (internal) returns the n-th chunk of the undo
+ *	log arena, OID_NULL if there are fewer chunks
+ */
+static PMEMoid
+tx_undo_arena_nth_chunk(PMEMobjpool *pop, struct lane_tx_layout *layout,
+	int n)
+{
+	struct list_head *head = &layout->undo_set_cache;
+	PMEMoid chunk = head->pe_first;
+
+	while (n-- > 0 && !OBJ_OID_IS_NULL(chunk))
+		chunk = oob_list_next(pop, head, chunk);
+
+	return chunk;
+}
+
+/*
+ * tx_undo_arena_trim -- (internal) frees the chunks of the undo log arena
+ *	above the retained limit
+ */
+static void
+tx_undo_arena_trim(PMEMobjpool *pop, struct lane_tx_layout *layout)
+{
+	LOG(3, NULL);
+
+	struct list_head *head = &layout->undo_set_cache;
+	PMEMoid chunk = tx_undo_arena_nth_chunk(pop, layout,
+			TX_UNDO_CHUNKS_RETAINED);
+	PMEMoid next;
+
+	while (!OBJ_OID_IS_NULL(chunk)) {
+		next = oob_list_next(pop, head, chunk);
+		list_remove_free_oob(pop, head, &chunk);
+		chunk = next;
+	}
+}
+
+/*
+ * tx_undo_arena_reset -- (internal) invalidates the undo log arena and frees
+ *	the chunks above the retained limit
+ */
+static void
+tx_undo_arena_reset(PMEMobjpool *pop, struct lane_tx_layout *layout)
+{
+	tx_undo_arena_invalidate(pop, layout);
+	tx_undo_arena_trim(pop, layout);
+}
+
 struct tx_range_data {
 	void *begin;
 	void *end;
@@ -547,19 +992,46 @@ tx_foreach_set(PMEMobjpool *pop, struct lane_tx_layout *layout,
 		cb(pop, range);
 	}
 
-	/* cached objects */
+	/* undo log arena, the in-lane part first */
+	size_t capacity;
+	uint8_t *buf = tx_undo_lane_buf(pop, layout, &capacity);
+	tx_undo_buf_foreach(pop, buf, capacity, layout->undo_gen, 0, cb);
+
 	for (iter = layout->undo_set_cache.pe_first; !OBJ_OID_IS_NULL(iter);
 		iter = oob_list_next(pop, &layout->undo_set_cache, iter)) {
 
-		struct tx_range_cache *cache = OBJ_OFF_TO_PTR(pop, iter.off);
-		for (int i = 0; i < MAX_CACHED_RANGES; ++i) {
-			range = (struct tx_range *)&cache->range[i];
-			if (range->offset == 0 || range->size == 0)
-				break;
+		buf = tx_undo_chunk_buf(pop, iter, &capacity);
+		tx_undo_buf_foreach(pop, buf, capacity, layout->undo_gen, 0,
+			cb);
+	}
+}
 
-			cb(pop, range);
-		}
+/*
+ * tx_foreach_redo -- (internal) iterates over ranges written in redo mode,
+ *	returns the number of ranges
+ */
+static size_t
+tx_foreach_redo(PMEMobjpool *pop, struct lane_tx_layout *layout,
+	void (*cb)(PMEMobjpool *pop, struct tx_range *range))
+{
+	LOG(3, NULL);
+
+	/* redo ranges are always stored in the undo log arena */
+	size_t capacity;
+	uint8_t *buf = tx_undo_lane_buf(pop, layout, &capacity);
+	size_t n = tx_undo_buf_foreach(pop, buf, capacity, layout->undo_gen,
+			TX_RANGE_REDO, cb);
+
+	PMEMoid iter;
+	for (iter = layout->undo_set_cache.pe_first; !OBJ_OID_IS_NULL(iter);
+		iter = oob_list_next(pop, &layout->undo_set_cache, iter)) {
+
+		buf = tx_undo_chunk_buf(pop, iter, &capacity);
+		n += tx_undo_buf_foreach(pop, buf, capacity, layout->undo_gen,
+				TX_RANGE_REDO, cb);
 	}
+
+	return n;
 }
 
 /*
@@ -596,7 +1068,7 @@ tx_abort_set(PMEMobjpool *pop, struct lane_tx_layout *layout, int recovery)
 	else
 		tx_foreach_set(pop, layout, tx_abort_restore_range);
 
-	tx_clear_undo_log(pop, &layout->undo_set_cache, 0, 0);
+	tx_undo_arena_reset(pop, layout);
 	tx_clear_undo_log(pop, &layout->undo_set, 0, 0);
 }
 
@@ -681,14 +1153,22 @@ tx_post_commit_alloc(PMEMobjpool *pop, struct lane_tx_layout *layout)
 		struct oob_header *oobh = OOB_HEADER_FROM_OID(pop, obj);
 		ASSERT(oobh->data.user_type < PMEMOBJ_NUM_OID_TYPES);
 
-		VALGRIND_REMOVE_FROM_TX(OBJ_OFF_TO_PTR(pop, obj.off),
-					pmemobj_alloc_usable_size(obj));
+#ifdef	USE_VG_PMEMCHECK
+		/*
+		 * This function can be called from transaction
+		 * recovery, so in such case pmemobj_alloc_usable_size
+		 * is not yet available. Use pmalloc version.
+		 */
+		size_t size = pmalloc_usable_size(pop,
+				obj.off - OBJ_OOB_SIZE) - OBJ_OOB_SIZE;
+		VALGRIND_REMOVE_FROM_TX(OBJ_OFF_TO_PTR(pop, obj.off), size);
+#endif
 
-		struct object_store_item *obj_list =
-			&pop->store->bytype[oobh->data.user_type];
+		struct list_head *obj_list =
+			OBJ_TYPE_LIST(pop, oobh->data.user_type);
 
 		/* move object to object store */
-		list_move_oob(pop, &layout->undo_alloc, &obj_list->head, obj);
+		list_move_oob(pop, &layout->undo_alloc, obj_list, obj);
 	}
 }
 
@@ -717,40 +1197,83 @@ tx_post_commit_range_vg_tx_remove(PMEMobjpool *pop, struct tx_range *range)
 }
 #endif
 
+/*
+ * tx_redo_apply_range -- (internal) writes range from the redo log in place
+ */
+static void
+tx_redo_apply_range(PMEMobjpool *pop, struct tx_range *range)
+{
+	void *ptr = OBJ_OFF_TO_PTR(pop, range->offset & ~TX_RANGE_REDO);
+
+	VALGRIND_ADD_TO_TX(ptr, range->size);
+
+	memcpy(ptr, range->data, range->size);
+	pop->flush(pop, ptr, range->size);
+
+	VALGRIND_REMOVE_FROM_TX(ptr, range->size);
+}
+
 /*
  * tx_post_commit_set -- (internal) do post commit operations for
- * add range
+ * add range, the snapshots are freed in tx_post_commit_reclaim
  */
 static void
 tx_post_commit_set(PMEMobjpool *pop, struct lane_tx_layout *layout)
 {
 	LOG(3, NULL);
 
+	/* the whole redo log is made durable in place with a single drain */
+	if (tx_foreach_redo(pop, layout, tx_redo_apply_range) != 0)
+		pop->drain(pop);
+
 #ifdef	USE_VG_PMEMCHECK
 	tx_foreach_set(pop, layout, tx_post_commit_range_vg_tx_remove);
 #endif
 
-	struct list_head *head = &layout->undo_set_cache;
-	PMEMoid obj = head->pe_first; /* first cache object */
+	tx_undo_arena_invalidate(pop, layout);
+}
 
-	/* clear all the undo log caches except for the last one */
-	while (head->pe_first.off != oob_list_last(pop, head).off) {
-		obj = head->pe_first;
+/*
+ * tx_post_commit_reclaim -- (internal) frees the snapshots and the objects
+ *	freed by the transaction
+ *
+ * Unlike the rest of the post commit phase it may be left to the reclaimer,
+ * the objects are not reachable by the application anymore.
+ */
+static void
+tx_post_commit_reclaim(PMEMobjpool *pop, struct lane_tx_layout *layout)
+{
+	LOG(3, NULL);
 
-		list_remove_free_oob(pop, head, &obj);
-	}
+	tx_undo_arena_trim(pop, layout);
+	tx_clear_undo_log(pop, &layout->undo_set, 0, 0);
+	tx_post_commit_free(pop, layout);
+}
 
-	if (!OID_IS_NULL(obj)) {
-		/* zero the cache, will be useful later on */
-		struct tx_range_cache *cache = OBJ_OFF_TO_PTR(pop, obj.off);
+/*
+ * tx_post_commit_pending -- (internal) checks if tx_post_commit_reclaim has
+ *	anything to free
+ */
+static int
+tx_post_commit_pending(PMEMobjpool *pop, struct lane_tx_layout *layout)
+{
+	return !OBJ_LIST_EMPTY(&layout->undo_set) ||
+		!OBJ_LIST_EMPTY(&layout->undo_free) ||
+		!OBJ_OID_IS_NULL(tx_undo_arena_nth_chunk(pop, layout,
+			TX_UNDO_CHUNKS_RETAINED));
+}
 
-		VALGRIND_ADD_TO_TX(cache, sizeof (struct tx_range_cache));
-		pop->memset_persist(pop, cache, 0,
-			sizeof (struct tx_range_cache));
-		VALGRIND_REMOVE_FROM_TX(cache, sizeof (struct tx_range_cache));
-	}
+/*
+ * tx_post_commit_finish -- (internal) finishes the post commit phase and
+ *	clears the transaction state
+ */
+static void
+tx_post_commit_finish(PMEMobjpool *pop, struct lane_tx_layout *layout)
+{
+	LOG(3, NULL);
 
-	tx_clear_undo_log(pop, &layout->undo_set, 0, 0);
+	tx_post_commit_reclaim(pop, layout);
+	tx_set_state(pop, layout, TX_STATE_NONE);
 }
 
 /*
@@ -775,7 +1298,7 @@ tx_post_commit(PMEMobjpool *pop, struct lane_tx_layout *layout)
 
 	tx_post_commit_set(pop, layout);
 	tx_post_commit_alloc(pop, layout);
-	tx_post_commit_free(pop, layout);
+	tx_post_commit_reclaim(pop, layout);
 }
 
 /*
@@ -892,13 +1415,15 @@ tx_alloc_common(size_t size, type_num_t type_num,
 		.type_num = type_num,
 	};
 
+	lane->dirty = 1;
+
 	/* allocate object to undo log */
 	PMEMoid retoid = OID_NULL;
 	list_insert_new_oob(lane->pop, &layout->undo_alloc, size, constructor,
-			&args, &retoid);
+			&args, &retoid, 0);
 
 	if (OBJ_OID_IS_NULL(retoid) ||
-		ctree_insert(lane->ranges, retoid.off, size) != 0)
+		tx_ranges_insert(lane, retoid.off, size) != 0)
 		goto err_oom;
 
 	return retoid;
@@ -939,13 +1464,15 @@ tx_alloc_copy_common(size_t size, type_num_t type_num, const void *ptr,
 		.copy_size = copy_size,
 	};
 
+	lane->dirty = 1;
+
 	/* allocate object to undo log */
 	PMEMoid retoid;
 	int ret = list_insert_new_oob(lane->pop, &layout->undo_alloc,
-			size, constructor, &args, &retoid);
+			size, constructor, &args, &retoid, 0);
 
 	if (ret || OBJ_OID_IS_NULL(retoid) ||
-		ctree_insert(lane->ranges, retoid.off, size) != 0)
+		tx_ranges_insert(lane, retoid.off, size) != 0)
 		goto err_oom;
 
 	return retoid;
@@ -1046,10 +1573,25 @@ pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
 		lane = tx.section->runtime;
 		SLIST_INIT(&lane->tx_entries);
 		SLIST_INIT(&lane->tx_locks);
-		lane->ranges = ctree_new();
-		lane->cache_slot = 0;
+		lane->undo_buf = tx_undo_lane_buf(pop,
+			(struct lane_tx_layout *)tx.section->layout,
+			&lane->undo_capacity);
+		lane->undo_pos = 0;
+		lane->undo_chunk = OID_NULL;
+		lane->undo_flushed = 0;
+		lane->dirty = 0;
+		lane->deferred = 0;
+		lane->redo = 0;
+		lane->redo_nwrites = 0;
+		lane->redo_nlinks = 0;
 
 		lane->pop = pop;
+
+		/* the lane might have been taken before the reclaimer got it */
+		struct lane_tx_layout *layout =
+			(struct lane_tx_layout *)tx.section->layout;
+		if (layout->state == TX_STATE_COMMITTED)
+			tx_post_commit_finish(pop, layout);
 	} else {
 		FATAL("Invalid stage %d to begin new transaction", tx.stage);
 	}
@@ -1070,13 +1612,21 @@ pmemobj_tx_begin(PMEMobjpool *pop, jmp_buf env, ...)
 
 	tx.stage = TX_STAGE_WORK;
 
-	/* handle locks */
+	/* handle locks and parameters */
 	va_list argp;
 	va_start(argp, env);
-	enum pobj_tx_lock lock_type;
+	int type;
+
+	while ((type = va_arg(argp, int)) != TX_LOCK_NONE) {
+		/* the mode is chosen by the outermost transaction */
+		if (type == TX_PARAM_REDO) {
+			if (SLIST_NEXT(txd, tx_entry) == NULL)
+				lane->redo = 1;
+			continue;
+		}
 
-	while ((lock_type = va_arg(argp, enum pobj_tx_lock)) != TX_LOCK_NONE) {
-		err = add_to_tx_and_lock(lane, lock_type, va_arg(argp, void *));
+		err = add_to_tx_and_lock(lane, (enum pobj_tx_lock)type,
+			va_arg(argp, void *));
 		if (err) {
 			va_end(argp);
 			goto err_abort;
@@ -1123,7 +1673,7 @@ pmemobj_tx_abort(int errnum)
 	struct lane_tx_runtime *lane = tx.section->runtime;
 	struct tx_data *txd = SLIST_FIRST(&lane->tx_entries);
 
-	if (SLIST_NEXT(txd, tx_entry) == NULL) {
+	if (SLIST_NEXT(txd, tx_entry) == NULL && lane->dirty) {
 		/* this is the outermost transaction */
 
 		struct lane_tx_layout *layout =
@@ -1176,7 +1726,11 @@ pmemobj_tx_commit()
 		(struct lane_tx_runtime *)tx.section->runtime;
 	struct tx_data *txd = SLIST_FIRST(&lane->tx_entries);
 
-	if (SLIST_NEXT(txd, tx_entry) == NULL) {
+	/*
+	 * The lane is left untouched until the transaction logs something,
+	 * so there is nothing to commit in a transaction which only reads.
+	 */
+	if (SLIST_NEXT(txd, tx_entry) == NULL && lane->dirty) {
 		/* this is the outermost transaction */
 
 		struct lane_tx_layout *layout =
@@ -1185,14 +1739,26 @@ pmemobj_tx_commit()
 		/* pre-commit phase */
 		tx_pre_commit(lane->pop, layout);
 
+		/* the redo log must be durable before the commit point */
+		tx_undo_drain(lane->pop, lane);
+
 		/* set transaction state as committed */
 		tx_set_state(lane->pop, layout, TX_STATE_COMMITTED);
 
 		/* post commit phase */
-		tx_post_commit(lane->pop, layout);
+		tx_post_commit_set(lane->pop, layout);
+		tx_post_commit_alloc(lane->pop, layout);
 
-		/* clear transaction state */
-		tx_set_state(lane->pop, layout, TX_STATE_NONE);
+		/*
+		 * The frees are left to the reclaimer if there is one. Until
+		 * it's done the lane stays in the committed state, so after
+		 * a crash the recovery finishes them.
+		 */
+		if (lane->pop->reclaimer != NULL &&
+				tx_post_commit_pending(lane->pop, layout))
+			lane->deferred = 1;
+		else
+			tx_post_commit_finish(lane->pop, layout);
 	}
 
 	tx.stage = TX_STAGE_ONCOMMIT;
@@ -1227,18 +1793,27 @@ pmemobj_tx_end()
 			(struct lane_tx_layout *)tx.section->layout;
 
 		/* cleanup cache */
-		ctree_delete(lane->ranges);
-		lane->cache_slot = 0;
+		tx_range_index_reset(&lane->index);
+		tx_range_index_reset(&lane->redo_index);
+		if (lane->ranges != NULL) {
+			ctree_delete(lane->ranges);
+			lane->ranges = NULL;
+		}
 
 		/* the transaction state and undo log should be clear */
-		ASSERTeq(layout->state, TX_STATE_NONE);
-		if (layout->state != TX_STATE_NONE)
+		ASSERT(layout->state == TX_STATE_NONE || lane->deferred);
+		if (layout->state != TX_STATE_NONE && !lane->deferred)
 			LOG(2, "invalid transaction state");
 
 		ASSERT(OBJ_LIST_EMPTY(&layout->undo_alloc));
 		if (!OBJ_LIST_EMPTY(&layout->undo_alloc))
 			LOG(2, "allocations undo log is not empty");
 
+		if (lane->deferred) {
+			lane->deferred = 0;
+			lane_defer(lane->pop);
+		}
+
 		tx.stage = TX_STAGE_NONE;
 		release_and_free_tx_locks(lane);
 		lane_release(lane->pop);
@@ -1295,109 +1870,326 @@ pmemobj_tx_add_large(struct lane_tx_layout *layout,
 	PMEMoid snapshot;
 	int ret = list_insert_new_oob(args->pop, &layout->undo_set,
 			args->size + sizeof (struct tx_range),
-			constructor_tx_add_range, args, &snapshot);
+			constructor_tx_add_range, args, &snapshot, 0);
 
 	return ret;
 }
 
 /*
- * constructor_tx_range_cache -- (internal) cache constructor
+ * constructor_tx_undo_chunk -- (internal) undo log arena chunk constructor
  */
 static void
-constructor_tx_range_cache(PMEMobjpool *pop, void *ptr,
+constructor_tx_undo_chunk(PMEMobjpool *pop, void *ptr,
 	size_t usable_size, void *arg)
 {
 	LOG(3, NULL);
 
 	ASSERTne(ptr, NULL);
 
-	/* temporarily add the object copy to the transaction */
-	VALGRIND_ADD_TO_TX(ptr, sizeof (struct tx_range_cache));
+	/*
+	 * The memory could have been an arena chunk of another lane, whose
+	 * entries may match the generation of this one.
+	 */
+	VALGRIND_ADD_TO_TX(ptr, usable_size);
+
+	pop->memset_persist(pop, ptr, 0, usable_size);
+
+	VALGRIND_REMOVE_FROM_TX(ptr, usable_size);
+}
+
+/*
+ * tx_undo_next_chunk -- (internal) switches the undo log arena to the next
+ *	chunk that can hold a range of given length, allocates a new one if
+ *	there is none
+ */
+static int
+tx_undo_next_chunk(PMEMobjpool *pop, struct lane_tx_layout *layout,
+	struct lane_tx_runtime *runtime, size_t len)
+{
+	struct list_head *head = &layout->undo_set_cache;
+	PMEMoid chunk = runtime->undo_chunk;
+	size_t capacity;
+	uint8_t *buf;
+
+	for (;;) {
+		chunk = OBJ_OID_IS_NULL(chunk) ? head->pe_first :
+			oob_list_next(pop, head, chunk);
+		if (OBJ_OID_IS_NULL(chunk))
+			break;
+
+		/* chunks are empty until the transaction gets to them */
+		buf = tx_undo_chunk_buf(pop, chunk, &capacity);
+		if (len <= capacity)
+			goto out;
+	}
+
+	if (list_insert_new_oob(pop, head, TX_UNDO_CHUNK_SIZE,
+			constructor_tx_undo_chunk, NULL, &chunk, 0) != 0)
+		return -1;
 
-	pop->memset_persist(pop, ptr, 0, sizeof (struct tx_range_cache));
+	buf = tx_undo_chunk_buf(pop, chunk, &capacity);
 
-	VALGRIND_REMOVE_FROM_TX(ptr, sizeof (struct tx_range_cache));
+out:
+	runtime->undo_buf = buf;
+	runtime->undo_capacity = capacity;
+	runtime->undo_pos = 0;
+	runtime->undo_chunk = chunk;
+
+	return 0;
 }
 
 /*
- * pmemobj_tx_get_range_cache -- (internal) returns first available cache
+ * tx_undo_buf_append -- (internal) stores the range in the current undo log
+ *	arena buffer, returns the stored entry
+ *
+ * A small entry is only flushed, the checksum makes a torn entry invalid so
+ * there is no need to order the range header after the data. All the
+ * entries stored by one add range call are made durable by a single drain
+ * in tx_undo_drain.
  */
-static struct tx_range_cache *
-pmemobj_tx_get_range_cache(PMEMobjpool *pop, struct lane_tx_layout *layout)
+static struct tx_undo_entry *
+tx_undo_buf_append(struct lane_tx_layout *layout,
+	struct lane_tx_runtime *runtime, struct tx_add_range_args *args,
+	const void *src)
 {
-	PMEMoid last_cache = oob_list_last(pop, &layout->undo_set_cache);
-	struct tx_range_cache *cache = NULL;
-	/* get the last element from the caches list */
-	if (!OBJ_OID_IS_NULL(last_cache))
-		cache = OBJ_OFF_TO_PTR(pop, last_cache.off);
+	PMEMobjpool *pop = args->pop;
+	size_t len = TX_UNDO_ENTRY_LEN(args->size);
+	size_t cslen = TX_UNDO_CHECKSUM_LEN(args->offset, args->size);
+
+	ASSERT(runtime->undo_pos + len <= runtime->undo_capacity);
+
+	struct tx_undo_entry *entry = (struct tx_undo_entry *)
+		(runtime->undo_buf + runtime->undo_pos);
+	struct tx_range *range = (struct tx_range *)(entry + 1);
+	runtime->undo_pos += len;
+
+	VALGRIND_ADD_TO_TX(entry, len);
 
-	/* verify if the cache exists and has at least one free slot */
-	if (cache == NULL || cache->range[MAX_CACHED_RANGES - 1].offset != 0) {
-		/* no existing cache, allocate a new one */
-		PMEMoid ncache_oid;
-		if (list_insert_new_oob(pop, &layout->undo_set_cache,
-			sizeof (struct tx_range_cache),
-			constructor_tx_range_cache, NULL, &ncache_oid) != 0)
-			return NULL;
+	memcpy(range->data, src, args->size);
 
-		cache = OBJ_OFF_TO_PTR(pop, ncache_oid.off);
+	/* the padding is covered by the checksum as well */
+	memset(range->data + args->size, 0,
+		len - TX_UNDO_ENTRY_LEN(0) - args->size);
 
-		/* since the cache is new, we start the count from 0 */
-		struct lane_tx_runtime *runtime = tx.section->runtime;
-		runtime->cache_slot = 0;
+	/*
+	 * Checksum of the whole entry would cost more than a drain. The redo
+	 * log data is only needed after the commit, which drains it anyway.
+	 */
+	int redo = (args->offset & TX_RANGE_REDO) != 0;
+	if (!redo && cslen != len)
+		pop->persist(pop, range->data, len - TX_UNDO_ENTRY_LEN(0));
+
+	entry->gen = layout->undo_gen;
+	range->offset = args->offset;
+	range->size = args->size;
+	util_checksum(entry, cslen, &entry->checksum, 1);
+
+	pop->flush(pop, entry, redo ? len : cslen);
+	runtime->undo_flushed = 1;
+
+	VALGRIND_REMOVE_FROM_TX(entry, len);
+
+	return entry;
+}
+
+/*
+ * tx_undo_reserve -- (internal) makes sure the current undo log arena buffer
+ *	can hold an entry of given length
+ */
+static int
+tx_undo_reserve(PMEMobjpool *pop, struct lane_tx_layout *layout,
+	struct lane_tx_runtime *runtime, size_t len)
+{
+	if (runtime->undo_capacity - runtime->undo_pos >= len)
+		return 0;
+
+	ASSERT(len <= TX_UNDO_CHUNK_SIZE);
+
+	if (tx_undo_next_chunk(pop, layout, runtime, len) != 0) {
+		ERR("Failed to allocate undo log chunk");
+		return -1;
 	}
 
-	return cache;
+	return 0;
 }
 
 /*
- * pmemobj_tx_add_small -- (internal) adds small memory range to undo log cache
+ * pmemobj_tx_add_snapshot -- (internal) saves memory range in the undo log
+ *	arena, ranges too big for an arena chunk get a separate object
  */
 static int
-pmemobj_tx_add_small(struct lane_tx_layout *layout,
+pmemobj_tx_add_snapshot(struct lane_tx_layout *layout,
 	struct tx_add_range_args *args)
 {
-	PMEMobjpool *pop = args->pop;
+	struct lane_tx_runtime *runtime = tx.section->runtime;
+	size_t len = TX_UNDO_ENTRY_LEN(args->size);
 
-	struct tx_range_cache *cache = pmemobj_tx_get_range_cache(pop, layout);
+	if (runtime->undo_capacity - runtime->undo_pos < len &&
+			len > TX_UNDO_CHUNK_SIZE)
+		return pmemobj_tx_add_large(layout, args);
 
-	if (cache == NULL) {
-		ERR("Failed to create range cache");
+	if (tx_undo_reserve(args->pop, layout, runtime, len) != 0)
 		return 1;
+
+	void *src = OBJ_OFF_TO_PTR(args->pop, args->offset);
+	VALGRIND_ADD_TO_TX(src, args->size);
+
+	tx_undo_buf_append(layout, runtime, args, src);
+
+	return 0;
+}
+
+/*
+ * tx_add_run -- (internal) extends the pending run of bytes which need a
+ *	snapshot, saves the run if the new one isn't adjacent
+ */
+static int
+tx_add_run(struct lane_tx_layout *layout, struct tx_add_range_args *run,
+	uint64_t offset, uint64_t size)
+{
+	if (run->offset + run->size == offset) {
+		run->size += size;
+		return 0;
 	}
 
-	struct lane_tx_runtime *runtime = tx.section->runtime;
+	if (run->size != 0 && pmemobj_tx_add_snapshot(layout, run) != 0)
+		return -1;
 
-	int n = runtime->cache_slot++; /* first free cache slot */
+	run->offset = offset;
+	run->size = size;
 
-	ASSERT(n != MAX_CACHED_RANGES);
+	return 0;
+}
 
-	/* those structures are binary compatible */
-	struct tx_range *range = (struct tx_range *)&cache->range[n];
-	VALGRIND_ADD_TO_TX(range,
-		sizeof (struct tx_range) + MAX_CACHED_RANGE_SIZE);
+/*
+ * tx_add_uncovered -- (internal) saves the bytes of the range which aren't in
+ *	the range index, adjacent bytes share a snapshot
+ *
+ * With mark set the range is also added to the index, otherwise the lookups
+ * are limited to the lines which the index may contain.
+ */
+static int
+tx_add_uncovered(struct lane_tx_layout *layout,
+	struct lane_tx_runtime *runtime, struct tx_add_range_args *args,
+	int mark)
+{
+	struct tx_range_index *idx = &runtime->index;
+	uint64_t offset = args->offset;
+	uint64_t end = args->offset + args->size;
+	uint64_t first = offset >> TX_RANGE_LINE_SHIFT;
+	uint64_t last = (end - 1) >> TX_RANGE_LINE_SHIFT;
+
+	struct tx_add_range_args run = {
+		.pop = args->pop,
+		.offset = 0,
+		.size = 0,
+	};
 
-	/* this isn't transactional so we have to keep the order */
-	void *src = OBJ_OFF_TO_PTR(pop, args->offset);
-	VALGRIND_ADD_TO_TX(src, args->size);
+	if (!mark) {
+		if (idx->count == 0 || last < idx->min_line ||
+				first > idx->max_line)
+			return pmemobj_tx_add_snapshot(layout, args);
 
-	pop->memcpy_persist(pop, range->data, src, args->size);
+		if (first < idx->min_line) {
+			first = idx->min_line;
+			run.offset = offset;
+			run.size = (first << TX_RANGE_LINE_SHIFT) - offset;
+		}
 
-	/* the range is only valid if both size and offset are != 0 */
-	range->size = args->size;
-	range->offset = args->offset;
-	pop->persist(pop, range,
-		sizeof (range->offset) + sizeof (range->size));
+		if (last > idx->max_line)
+			last = idx->max_line;
+	}
 
-	VALGRIND_REMOVE_FROM_TX(range,
-		sizeof (struct tx_range) + MAX_CACHED_RANGE_SIZE);
+	for (uint64_t line = first; line <= last; ++line) {
+		uint64_t lbeg = line << TX_RANGE_LINE_SHIFT;
+		uint64_t lo = (offset > lbeg ? offset : lbeg) - lbeg;
+		uint64_t hi = (end < lbeg + TX_RANGE_LINE_SIZE ?
+			end : lbeg + TX_RANGE_LINE_SIZE) - lbeg;
+		uint64_t mask = TX_RANGE_LINE_MASK(lo, hi);
+		uint64_t covered;
+
+		if (mark) {
+			struct tx_range_line *l = tx_range_index_get(idx, line);
+			if (l == NULL)
+				return -1;
+
+			covered = l->mask;
+			l->mask |= mask;
+		} else {
+			covered = tx_range_index_find(idx, line);
+		}
+
+		uint64_t missing = mask & ~covered;
+		while (missing != 0) {
+			unsigned b = (unsigned)__builtin_ctzll(missing);
+			uint64_t x = missing >> b;
+			unsigned len = ~x == 0 ? 64 :
+				(unsigned)__builtin_ctzll(~x);
+
+			if (tx_add_run(layout, &run, lbeg + b, len) != 0)
+				return -1;
+
+			missing &= ~TX_RANGE_LINE_MASK(b, b + len);
+		}
+	}
+
+	/* the rest of the range is past the last line in the index */
+	uint64_t lend = (last + 1) << TX_RANGE_LINE_SHIFT;
+	if (end > lend && tx_add_run(layout, &run, lend, end - lend) != 0)
+		return -1;
+
+	if (run.size != 0 && pmemobj_tx_add_snapshot(layout, &run) != 0)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * tx_add_piece -- (internal) adds range which doesn't overlap with the large
+ *	ranges to the transaction
+ */
+static int
+tx_add_piece(struct lane_tx_layout *layout, struct lane_tx_runtime *runtime,
+	struct tx_add_range_args *args, int large)
+{
+	if (tx_add_uncovered(layout, runtime, args, !large) != 0)
+		return -1;
+
+	if (large && tx_ranges_insert(runtime, args->offset, args->size) != 0)
+		return -1;
 
 	return 0;
 }
 
+/*
+ * tx_add_covered -- (internal) checks if the range is already in the index
+ */
+static int
+tx_add_covered(struct tx_range_index *idx, uint64_t offset, uint64_t size)
+{
+	uint64_t end = offset + size;
+	for (uint64_t line = offset >> TX_RANGE_LINE_SHIFT;
+		(line << TX_RANGE_LINE_SHIFT) < end; ++line) {
+		uint64_t lbeg = line << TX_RANGE_LINE_SHIFT;
+		uint64_t lo = (offset > lbeg ? offset : lbeg) - lbeg;
+		uint64_t hi = (end < lbeg + TX_RANGE_LINE_SIZE ?
+			end : lbeg + TX_RANGE_LINE_SIZE) - lbeg;
+		uint64_t mask = TX_RANGE_LINE_MASK(lo, hi);
+
+		if ((tx_range_index_find(idx, line) & mask) != mask)
+			return 0;
+	}
+
+	return 1;
+}
+
 /*
  * pmemobj_tx_add_common -- (internal) common code for adding persistent memory
  *				into the transaction
+ *
+ * Ranges up to TX_RANGE_INDEX_MAX_SIZE are tracked with byte granularity in
+ * the cache line index, so adding a line which is already in the undo log
+ * takes a single lookup. Larger ranges are kept in the ctree.
  */
 static int
 pmemobj_tx_add_common(struct tx_add_range_args *args)
@@ -1414,12 +2206,27 @@ pmemobj_tx_add_common(struct tx_add_range_args *args)
 		return pmemobj_tx_abort_err(EINVAL);
 	}
 
+	if (args->size == 0)
+		return 0;
+
 	struct lane_tx_runtime *runtime = tx.section->runtime;
+	int large = args->size > TX_RANGE_INDEX_MAX_SIZE;
+	int ret = 0;
+
+	runtime->dirty = 1;
 
-	/* starting from the end, search for all overlapping ranges */
+	if (runtime->ranges == NULL) {
+		ret = tx_add_piece(layout, runtime, args, large);
+		goto out;
+	}
+
+	if (!large && tx_add_covered(&runtime->index, args->offset,
+			args->size))
+		return 0;
+
+	/* starting from the end, search for all overlapping large ranges */
 	uint64_t spoint = args->offset + args->size - 1; /* start point */
 	uint64_t apoint = 0; /* add point */
-	int ret = 0;
 
 	while (spoint >= args->offset) {
 		apoint = spoint + 1;
@@ -1440,9 +2247,6 @@ pmemobj_tx_add_common(struct tx_add_range_args *args)
 				nargs.offset = args->offset;
 			}
 
-			if (args->size == 0)
-				break;
-
 			spoint = 0; /* this is the end of our search */
 		} else { /* found offset is equal or greater than offset */
 			nargs.offset = spoint + range;
@@ -1453,23 +2257,15 @@ pmemobj_tx_add_common(struct tx_add_range_args *args)
 			nargs.size = apoint - nargs.offset;
 		}
 
-		/*
-		 * Depending on the size of the block, either allocate an
-		 * entire new object or use cache.
-		 */
-		ret = nargs.size > MAX_CACHED_RANGE_SIZE ?
-			pmemobj_tx_add_large(layout, &nargs) :
-			pmemobj_tx_add_small(layout, &nargs);
-
+		ret = tx_add_piece(layout, runtime, &nargs, large);
 		if (ret != 0)
 			break;
-
-
-		if (ctree_insert(runtime->ranges,
-			nargs.offset, nargs.size) != 0)
-			break;
 	}
 
+out:
+	/* the snapshots must be durable before the range is modified */
+	tx_undo_drain(args->pop, runtime);
+
 	if (ret != 0) {
 		ERR("out of memory");
 		return pmemobj_tx_abort_err(ENOMEM);
@@ -1547,6 +2343,279 @@ pmemobj_tx_add_range(PMEMoid oid, uint64_t hoff, size_t size)
 	return 0;
 }
 
+/*
+ * TX_REDO_PIECE_MAX -- largest part of a write stored in a single redo
+ *	log entry, so that every entry fits in an undo log arena chunk
+ */
+#define	TX_REDO_PIECE_MAX (TX_UNDO_CHUNK_SIZE - TX_UNDO_ENTRY_LEN(0))
+
+/*
+ * tx_redo_update -- (internal) overwrites the data of the last write if it
+ *	contains the whole range, returns 0 on success
+ */
+static int
+tx_redo_update(PMEMobjpool *pop, struct lane_tx_runtime *runtime,
+	uint64_t offset, const void *src, size_t size)
+{
+	if (runtime->redo_nwrites == 0)
+		return -1;
+
+	struct tx_redo_write *w =
+		&runtime->redo_writes[runtime->redo_nwrites - 1];
+	if (offset < w->offset || offset + size > w->offset + w->size)
+		return -1;
+
+	struct tx_range *range = (struct tx_range *)(w->entry + 1);
+	uint8_t *data = range->data + (offset - w->offset);
+
+	/* the checksum of a redo log entry doesn't cover the data */
+	VALGRIND_ADD_TO_TX(data, size);
+
+	memcpy(data, src, size);
+	pop->flush(pop, data, size);
+	runtime->undo_flushed = 1;
+
+	VALGRIND_REMOVE_FROM_TX(data, size);
+
+	return 0;
+}
+
+/*
+ * tx_redo_index -- (internal) adds the write in the slot to the lists of all
+ *	lines it touches
+ */
+static int
+tx_redo_index(struct lane_tx_runtime *runtime, size_t slot, uint64_t offset,
+	uint64_t size)
+{
+	uint64_t end = offset + size;
+	uint64_t first = offset >> TX_RANGE_LINE_SHIFT;
+	uint64_t last = (end - 1) >> TX_RANGE_LINE_SHIFT;
+	size_t nlinks = runtime->redo_nlinks + (size_t)(last - first + 1);
+
+	if (nlinks > runtime->redo_links_capacity) {
+		size_t capacity = runtime->redo_links_capacity ?
+			runtime->redo_links_capacity : 256;
+		while (capacity < nlinks)
+			capacity *= 2;
+
+		struct tx_redo_link *links = Realloc(runtime->redo_links,
+			capacity * sizeof (*links));
+		if (links == NULL)
+			return -1;
+
+		runtime->redo_links = links;
+		runtime->redo_links_capacity = capacity;
+	}
+
+	for (uint64_t line = first; line <= last; ++line) {
+		uint64_t lbeg = line << TX_RANGE_LINE_SHIFT;
+		uint64_t lo = (offset > lbeg ? offset : lbeg) - lbeg;
+		uint64_t hi = (end < lbeg + TX_RANGE_LINE_SIZE ?
+			end : lbeg + TX_RANGE_LINE_SIZE) - lbeg;
+
+		struct tx_range_line *l =
+			tx_range_index_get(&runtime->redo_index, line);
+		if (l == NULL)
+			return -1;
+
+		struct tx_redo_link *link =
+			&runtime->redo_links[runtime->redo_nlinks++];
+		link->write = slot;
+		link->next = l->link;
+
+		l->mask |= TX_RANGE_LINE_MASK(lo, hi);
+		l->link = runtime->redo_nlinks;
+	}
+
+	return 0;
+}
+
+/*
+ * tx_redo_append -- (internal) stores the piece of write in the redo log
+ */
+static int
+tx_redo_append(struct lane_tx_layout *layout,
+	struct lane_tx_runtime *runtime, uint64_t offset, const void *src,
+	size_t size)
+{
+	PMEMobjpool *pop = runtime->pop;
+
+	if (runtime->redo_nwrites == runtime->redo_capacity) {
+		size_t capacity = runtime->redo_capacity ?
+			runtime->redo_capacity * 2 : 64;
+		struct tx_redo_write *writes = Realloc(runtime->redo_writes,
+			capacity * sizeof (*writes));
+		if (writes == NULL)
+			return -1;
+
+		runtime->redo_writes = writes;
+		runtime->redo_capacity = capacity;
+	}
+
+	if (tx_undo_reserve(pop, layout, runtime, TX_UNDO_ENTRY_LEN(size)))
+		return -1;
+
+	if (tx_redo_index(runtime, runtime->redo_nwrites, offset, size) != 0)
+		return -1;
+
+	struct tx_add_range_args args = {
+		.pop = pop,
+		.offset = offset | TX_RANGE_REDO,
+		.size = size
+	};
+
+	struct tx_redo_write *w =
+		&runtime->redo_writes[runtime->redo_nwrites++];
+	w->offset = offset;
+	w->size = size;
+	w->entry = tx_undo_buf_append(layout, runtime, &args, src);
+
+	return 0;
+}
+
+/*
+ * pmemobj_tx_write -- writes data to persistent memory in the transaction
+ *
+ * In the redo mode the data is only stored in the redo log and is written in
+ * place when the transaction commits. Otherwise the range is added to the
+ * transaction and modified directly.
+ */
+int
+pmemobj_tx_write(void *dest, const void *src, size_t size)
+{
+	LOG(3, "dest %p src %p size %zu", dest, src, size);
+
+	ASSERT_IN_TX();
+	ASSERT_TX_STAGE_WORK();
+
+	struct lane_tx_runtime *lane =
+		(struct lane_tx_runtime *)tx.section->runtime;
+
+	if (!lane->redo) {
+		int ret = pmemobj_tx_add_range_direct(dest, size);
+		if (ret == 0)
+			memcpy(dest, src, size);
+
+		return ret;
+	}
+
+	PMEMobjpool *pop = lane->pop;
+	uint64_t offset = (uint64_t)((char *)dest - (char *)pop);
+
+	if ((char *)dest < (char *)pop || offset < pop->heap_offset ||
+		offset + size > pop->heap_offset + pop->heap_size) {
+		ERR("object outside of heap");
+		return pmemobj_tx_abort_err(EINVAL);
+	}
+
+	if (size == 0)
+		return 0;
+
+	if (tx_redo_update(pop, lane, offset, src, size) == 0)
+		return 0;
+
+	lane->dirty = 1;
+
+	struct lane_tx_layout *layout =
+			(struct lane_tx_layout *)tx.section->layout;
+	const char *data = src;
+
+	while (size != 0) {
+		size_t piece = size < TX_REDO_PIECE_MAX ?
+				size : TX_REDO_PIECE_MAX;
+
+		if (tx_redo_append(layout, lane, offset, data, piece) != 0) {
+			ERR("out of memory");
+			return pmemobj_tx_abort_err(ENOMEM);
+		}
+
+		offset += piece;
+		data += piece;
+		size -= piece;
+	}
+
+	return 0;
+}
+
+/*
+ * pmemobj_tx_read -- reads data from persistent memory in the transaction,
+ *	including the writes not yet applied in the redo mode
+ */
+int
+pmemobj_tx_read(void *dest, const void *src, size_t size)
+{
+	LOG(3, "dest %p src %p size %zu", dest, src, size);
+
+	ASSERT_IN_TX();
+	ASSERT_TX_STAGE_WORK();
+
+	struct lane_tx_runtime *lane =
+		(struct lane_tx_runtime *)tx.section->runtime;
+
+	memcpy(dest, src, size);
+
+	PMEMobjpool *pop = lane->pop;
+	uint64_t offset = (uint64_t)((char *)src - (char *)pop);
+
+	if (!lane->redo || size == 0 || (char *)src < (char *)pop ||
+		offset < pop->heap_offset ||
+		offset + size > pop->heap_offset + pop->heap_size)
+		return 0;
+
+	struct tx_range_index *idx = &lane->redo_index;
+	uint64_t end = offset + size;
+	uint64_t first = offset >> TX_RANGE_LINE_SHIFT;
+	uint64_t last = (end - 1) >> TX_RANGE_LINE_SHIFT;
+
+	if (idx->count == 0 || last < idx->min_line || first > idx->max_line)
+		return 0;
+
+	for (uint64_t line = first; line <= last; ++line) {
+		uint64_t lbeg = line << TX_RANGE_LINE_SHIFT;
+		uint64_t lo = (offset > lbeg ? offset : lbeg) - lbeg;
+		uint64_t hi = (end < lbeg + TX_RANGE_LINE_SIZE ?
+			end : lbeg + TX_RANGE_LINE_SIZE) - lbeg;
+
+		struct tx_range_line *l = tx_range_index_slot(idx, line);
+		if (l->gen != idx->gen)
+			continue;
+
+		/* newer writes take precedence, so the list is newest first */
+		uint64_t need = l->mask & TX_RANGE_LINE_MASK(lo, hi);
+		for (uint64_t n = l->link; n != 0 && need != 0;
+				n = lane->redo_links[n - 1].next) {
+			uint64_t wi = lane->redo_links[n - 1].write;
+			struct tx_redo_write *w = &lane->redo_writes[wi];
+			uint64_t wlo = (w->offset > lbeg ? w->offset : lbeg) -
+				lbeg;
+			uint64_t wend = w->offset + w->size;
+			uint64_t whi = (wend < lbeg + TX_RANGE_LINE_SIZE ?
+				wend : lbeg + TX_RANGE_LINE_SIZE) - lbeg;
+
+			uint64_t copy = need & TX_RANGE_LINE_MASK(wlo, whi);
+			need &= ~copy;
+
+			struct tx_range *range =
+				(struct tx_range *)(w->entry + 1);
+			while (copy != 0) {
+				uint64_t b = (uint64_t)__builtin_ctzll(copy);
+				uint64_t rest = ~(copy >> b);
+				uint64_t e = rest ?
+					b + (uint64_t)__builtin_ctzll(rest) :
+					TX_RANGE_LINE_SIZE;
+
+				memcpy((char *)dest + (lbeg + b - offset),
+					range->data + (lbeg + b - w->offset),
+					e - b);
+				copy &= ~TX_RANGE_LINE_MASK(b, e);
+			}
+		}
+	}
+
+	return 0;
+}
+
 /*
  * pmemobj_tx_alloc -- allocates a new object
  */
@@ -1690,13 +2759,14 @@ pmemobj_tx_free(PMEMoid oid)
 	struct oob_header *oobh = OOB_HEADER_FROM_OID(lane->pop, oid);
 	ASSERT(oobh->data.user_type < PMEMOBJ_NUM_OID_TYPES);
 
+	lane->dirty = 1;
+
 	if (oobh->data.internal_type == TYPE_ALLOCATED) {
 		/* the object is in object store */
-		struct object_store_item *obj_list =
-			&lane->pop->store->bytype[oobh->data.user_type];
+		struct list_head *obj_list =
+			OBJ_TYPE_LIST(lane->pop, oobh->data.user_type);
 
-		list_move_oob(lane->pop, &obj_list->head,
-				&layout->undo_free, oid);
+		list_move_oob(lane->pop, obj_list, &layout->undo_free, oid);
 	} else {
 		ASSERTeq(oobh->data.internal_type, TYPE_NONE);
 #ifdef USE_VG_PMEMCHECK
@@ -1708,7 +2778,9 @@ pmemobj_tx_free(PMEMoid oid)
 		VALGRIND_REMOVE_FROM_TX(oobh, pmalloc_usable_size(lane->pop,
 				oid.off - OBJ_OOB_SIZE));
 
-		if (ctree_remove(lane->ranges, oid.off, 1) != oid.off)
+		if (tx_ranges_remove(lane, oid.off, pmalloc_usable_size(
+				lane->pop, oid.off - OBJ_OOB_SIZE) -
+				OBJ_OOB_SIZE) != 0)
 			FATAL("TX undo state mismatch");
 
 		/*
@@ -1732,6 +2804,10 @@ lane_transaction_construct(PMEMobjpool *pop, struct lane_section *section)
 		return ENOMEM;
 	memset(section->runtime, 0, sizeof (struct lane_tx_runtime));
 
+	struct lane_tx_runtime *runtime = section->runtime;
+	tx_range_index_reset(&runtime->index);
+	tx_range_index_reset(&runtime->redo_index);
+
 	return 0;
 }
 
@@ -1741,6 +2817,12 @@ lane_transaction_construct(PMEMobjpool *pop, struct lane_section *section)
 static void
 lane_transaction_destruct(PMEMobjpool *pop, struct lane_section *section)
 {
+	struct lane_tx_runtime *runtime = section->runtime;
+
+	Free(runtime->index.lines);
+	Free(runtime->redo_index.lines);
+	Free(runtime->redo_writes);
+	Free(runtime->redo_links);
 	Free(section->runtime);
 }
 
@@ -1805,6 +2887,46 @@ lane_transaction_recovery(PMEMobjpool *pop,
 	return ret;
 }
 
+/*
+ * lane_transaction_reclaim -- finishes the post commit phase left to
+ *	the reclaimer
+ */
+static int
+lane_transaction_reclaim(PMEMobjpool *pop,
+	struct lane_section_layout *section)
+{
+	struct lane_tx_layout *layout = (struct lane_tx_layout *)section;
+
+	if (layout->state == TX_STATE_COMMITTED)
+		tx_post_commit_finish(pop, layout);
+
+	return 0;
+}
+
+/*
+ * tx_undo_buf_check -- (internal) consistency check of undo log buffer
+ */
+static int
+tx_undo_buf_check(PMEMobjpool *pop, uint8_t *buf, size_t capacity,
+	uint64_t gen)
+{
+	struct tx_range *range;
+	size_t pos = 0;
+
+	while ((range = tx_undo_buf_range(buf, capacity, pos, gen)) != NULL) {
+		uint64_t offset = range->offset & ~TX_RANGE_REDO;
+		if (!OBJ_OFF_FROM_HEAP(pop, offset) ||
+			!OBJ_OFF_FROM_HEAP(pop, offset + range->size)) {
+			ERR("tx_lane: invalid offset in undo log arena");
+			return -1;
+		}
+
+		pos += TX_UNDO_ENTRY_LEN(range->size);
+	}
+
+	return 0;
+}
+
 /*
  * lane_transaction_check -- consistency check of transaction lane section
  */
@@ -1836,6 +2958,22 @@ lane_transaction_check(PMEMobjpool *pop,
 		}
 	}
 
+	/* check undo log arena */
+	size_t capacity;
+	uint8_t *buf = tx_undo_lane_buf(pop, tx_sec, &capacity);
+	if (tx_undo_buf_check(pop, buf, capacity,
+			tx_sec->undo_gen) != 0)
+		return -1;
+
+	for (iter = tx_sec->undo_set_cache.pe_first; !OBJ_OID_IS_NULL(iter);
+		iter = oob_list_next(pop, &tx_sec->undo_set_cache, iter)) {
+
+		buf = tx_undo_chunk_buf(pop, iter, &capacity);
+		if (tx_undo_buf_check(pop, buf, capacity,
+				tx_sec->undo_gen) != 0)
+			return -1;
+	}
+
 	/* check undo log for allocations */
 	for (iter = tx_sec->undo_alloc.pe_first; !OBJ_OID_IS_NULL(iter);
 		iter = oob_list_next(pop, &tx_sec->undo_alloc, iter)) {
@@ -1871,13 +3009,41 @@ lane_transaction_check(PMEMobjpool *pop,
 	return 0;
 }
 
+/*
+ * lane_transaction_check_idle -- checks if the transaction lane section of
+ *	a pool in the older format holds no unfinished transaction
+ *
+ * The cached snapshot objects on undo_set_cache are taken over as chunks of
+ * the undo log arena, their old content never matches the entry checksum.
+ */
+static int
+lane_transaction_check_idle(PMEMobjpool *pop,
+	struct lane_section_layout *section)
+{
+	LOG(3, "tx lane %p", section);
+
+	struct lane_tx_layout *tx_sec = (struct lane_tx_layout *)section;
+
+	if (tx_sec->state != TX_STATE_NONE ||
+		!OBJ_LIST_EMPTY(&tx_sec->undo_alloc) ||
+		!OBJ_LIST_EMPTY(&tx_sec->undo_free) ||
+		!OBJ_LIST_EMPTY(&tx_sec->undo_set)) {
+		LOG(2, "tx lane: unfinished transaction");
+		return EINVAL;
+	}
+
+	return 0;
+}
+
 /*
  * lane_transaction_init -- initializes transaction section
  */
 static int
 lane_transaction_boot(PMEMobjpool *pop)
 {
-	/* nop */
+	/* the rest of the section is the in-lane part of undo log arena */
+	COMPILE_ERROR_ON(sizeof (struct lane_tx_layout) >= LANE_SECTION_LEN);
+
 	return 0;
 }
 
@@ -1886,7 +3052,9 @@ static struct section_operations transaction_ops = {
 	.destruct = lane_transaction_destruct,
 	.recover = lane_transaction_recovery,
 	.check = lane_transaction_check,
-	.boot = lane_transaction_boot
+	.boot = lane_transaction_boot,
+	.reclaim = lane_transaction_reclaim,
+	.check_idle = lane_transaction_check_idle
 };
 
 SECTION_PARM(LANE_SECTION_TRANSACTION, &transaction_ops);
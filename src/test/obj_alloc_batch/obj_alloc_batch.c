@@ -0,0 +1,274 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * obj_alloc_batch.c -- unit test for pmemobj_alloc_batch and
+ *	pmemobj_free_batch
+ *
+ * usage: obj_alloc_batch file l|n
+ *
+ * l - pool with the per-type lists, n - pool created without them
+ */
+
+#include "unittest.h"
+
+#define	LAYOUT_NAME "alloc_batch"
+
+#define	TYPE_SMALL 1
+#define	TYPE_MEDIUM 2
+#define	TYPE_HUGE 3
+
+#define	NSMALL 500
+#define	NMEDIUM 200
+#define	NHUGE 4
+
+#define	SMALL_SIZE 128
+#define	MEDIUM_SIZE 1000
+#define	HUGE_SIZE (300 * 1024)
+
+#define	PATTERN 0xC5
+
+struct root {
+	PMEMoid medium[NMEDIUM];
+};
+
+/*
+ * construct -- fills the object and counts the calls
+ */
+static void
+construct(PMEMobjpool *pop, void *ptr, void *arg)
+{
+	unsigned *ncalls = arg;
+	(*ncalls)++;
+
+	pmemobj_memset_persist(pop, ptr, PATTERN, SMALL_SIZE);
+}
+
+/*
+ * count_objs -- (internal) counts the objects of a type
+ */
+static size_t
+count_objs(PMEMobjpool *pop, unsigned type_num)
+{
+	size_t n = 0;
+	for (PMEMoid oid = pmemobj_first(pop, type_num); !OID_IS_NULL(oid);
+		oid = pmemobj_next(oid))
+		n++;
+
+	return n;
+}
+
+/*
+ * oid_cmp -- (internal) compares object ids by offset
+ */
+static int
+oid_cmp(const void *lhs, const void *rhs)
+{
+	const PMEMoid *l = lhs;
+	const PMEMoid *r = rhs;
+
+	return l->off < r->off ? -1 : l->off > r->off ? 1 : 0;
+}
+
+/*
+ * check_objs -- (internal) checks the allocated objects
+ */
+static void
+check_objs(PMEMobjpool *pop, PMEMoid *oids, size_t n, size_t size,
+	unsigned type_num)
+{
+	PMEMoid *sorted = MALLOC(n * sizeof (*sorted));
+	memcpy(sorted, oids, n * sizeof (*sorted));
+	qsort(sorted, n, sizeof (*sorted), oid_cmp);
+
+	for (size_t i = 0; i < n; ++i) {
+		ASSERT(!OID_IS_NULL(sorted[i]));
+		ASSERTeq(pmemobj_type_num(sorted[i]), (int)type_num);
+		ASSERT(pmemobj_alloc_usable_size(sorted[i]) >= size);
+
+		/* no object was handed out twice */
+		if (i > 0)
+			ASSERT(sorted[i].off >= sorted[i - 1].off + size);
+	}
+
+	FREE(sorted);
+}
+
+/*
+ * test_invalid -- (internal) checks the arguments validation
+ */
+static void
+test_invalid(PMEMobjpool *pop)
+{
+	PMEMoid oid = OID_NULL;
+
+	ASSERTeq(pmemobj_alloc_batch(pop, &oid, 0, SMALL_SIZE, TYPE_SMALL,
+		NULL, NULL), 0);
+	ASSERT(OID_IS_NULL(oid));
+
+	errno = 0;
+	ASSERTeq(pmemobj_alloc_batch(pop, &oid, 1, 0, TYPE_SMALL,
+		NULL, NULL), -1);
+	ASSERTeq(errno, EINVAL);
+
+	errno = 0;
+	ASSERTeq(pmemobj_alloc_batch(pop, &oid, 1, SMALL_SIZE,
+		PMEMOBJ_NUM_OID_TYPES, NULL, NULL), -1);
+	ASSERTeq(errno, EINVAL);
+
+	errno = 0;
+	ASSERTeq(pmemobj_alloc_batch(pop, NULL, 1, SMALL_SIZE, TYPE_SMALL,
+		NULL, NULL), -1);
+	ASSERTeq(errno, EINVAL);
+
+	ASSERTeq(pmemobj_free_batch(&oid, 1), 0);
+	ASSERTeq(pmemobj_free_batch(NULL, 0), 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_alloc_batch");
+
+	if (argc != 3 || (argv[2][0] != 'l' && argv[2][0] != 'n'))
+		FATAL("usage: %s file l|n", argv[0]);
+
+	const char *path = argv[1];
+	uint64_t flags = argv[2][0] == 'n' ? POBJ_XCREATE_NO_TYPE_LISTS : 0;
+
+	PMEMobjpool *pop = pmemobj_xcreate(path, LAYOUT_NAME, 0,
+		S_IWUSR | S_IRUSR, flags, NULL);
+	if (pop == NULL)
+		FATAL("!pmemobj_xcreate: %s", path);
+
+	struct root *r = pmemobj_direct(pmemobj_root(pop,
+		sizeof (struct root)));
+
+	test_invalid(pop);
+
+	/* object ids in volatile memory, with a constructor */
+	static PMEMoid small[NSMALL];
+	unsigned ncalls = 0;
+	ASSERTeq(pmemobj_alloc_batch(pop, small, NSMALL, SMALL_SIZE,
+		TYPE_SMALL, construct, &ncalls), 0);
+	ASSERTeq(ncalls, NSMALL);
+	check_objs(pop, small, NSMALL, SMALL_SIZE, TYPE_SMALL);
+	for (unsigned i = 0; i < NSMALL; ++i) {
+		unsigned char *p = pmemobj_direct(small[i]);
+		ASSERTeq(p[0], PATTERN);
+		ASSERTeq(p[SMALL_SIZE - 1], PATTERN);
+	}
+
+	/* object ids in the pool */
+	ASSERTeq(pmemobj_alloc_batch(pop, r->medium, NMEDIUM, MEDIUM_SIZE,
+		TYPE_MEDIUM, NULL, NULL), 0);
+	check_objs(pop, r->medium, NMEDIUM, MEDIUM_SIZE, TYPE_MEDIUM);
+
+	/* objects taking whole chunks */
+	PMEMoid huge[NHUGE];
+	ASSERTeq(pmemobj_alloc_batch(pop, huge, NHUGE, HUGE_SIZE,
+		TYPE_HUGE, NULL, NULL), 0);
+	check_objs(pop, huge, NHUGE, HUGE_SIZE, TYPE_HUGE);
+
+	ASSERTeq(count_objs(pop, TYPE_SMALL), NSMALL);
+	ASSERTeq(count_objs(pop, TYPE_MEDIUM), NMEDIUM);
+	ASSERTeq(count_objs(pop, TYPE_HUGE), NHUGE);
+
+	/* either all the objects are allocated or none */
+	static PMEMoid toomany[1024];
+	errno = 0;
+	ASSERTeq(pmemobj_alloc_batch(pop, toomany, 1024, HUGE_SIZE,
+		TYPE_HUGE, NULL, NULL), -1);
+	ASSERTeq(errno, ENOMEM);
+	ASSERTeq(count_objs(pop, TYPE_HUGE), NHUGE);
+
+	/* the reserved memory was given back */
+	ASSERTeq(pmemobj_alloc_batch(pop, toomany, 16, HUGE_SIZE,
+		TYPE_HUGE, NULL, NULL), 0);
+	ASSERTeq(pmemobj_free_batch(toomany, 16), 0);
+	for (unsigned i = 0; i < 16; ++i)
+		ASSERT(OID_IS_NULL(toomany[i]));
+	ASSERTeq(count_objs(pop, TYPE_HUGE), NHUGE);
+
+	/* half of the persistent ones */
+	ASSERTeq(pmemobj_free_batch(r->medium, NMEDIUM / 2), 0);
+	for (unsigned i = 0; i < NMEDIUM / 2; ++i)
+		ASSERT(OID_IS_NULL(r->medium[i]));
+	ASSERTeq(count_objs(pop, TYPE_MEDIUM), NMEDIUM - NMEDIUM / 2);
+
+	/* every other small one, mixed with other types and null ids */
+	static PMEMoid mixed[NSMALL / 2 + NHUGE + 2];
+	unsigned nmixed = 0;
+	for (unsigned i = 0; i < NSMALL; i += 2) {
+		mixed[nmixed++] = small[i];
+		small[i] = OID_NULL;
+	}
+	for (unsigned i = 0; i < NHUGE; ++i)
+		mixed[nmixed++] = huge[i];
+	mixed[nmixed++] = OID_NULL;
+	mixed[nmixed++] = OID_NULL;
+
+	ASSERTeq(pmemobj_free_batch(mixed, nmixed), 0);
+	for (unsigned i = 0; i < nmixed; ++i)
+		ASSERT(OID_IS_NULL(mixed[i]));
+
+	ASSERTeq(count_objs(pop, TYPE_SMALL), NSMALL / 2);
+	ASSERTeq(count_objs(pop, TYPE_HUGE), 0);
+
+	/* the lists are still consistent for a regular free */
+	pmemobj_free(&small[1]);
+	ASSERTeq(count_objs(pop, TYPE_SMALL), NSMALL / 2 - 1);
+
+	pmemobj_close(pop);
+
+	ASSERTeq(pmemobj_check(path, LAYOUT_NAME), 1);
+
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		FATAL("!pmemobj_open: %s", path);
+
+	r = pmemobj_direct(pmemobj_root(pop, sizeof (struct root)));
+
+	ASSERTeq(count_objs(pop, TYPE_SMALL), NSMALL / 2 - 1);
+	ASSERTeq(count_objs(pop, TYPE_MEDIUM), NMEDIUM - NMEDIUM / 2);
+
+	ASSERTeq(pmemobj_free_batch(r->medium, NMEDIUM), 0);
+	ASSERTeq(pmemobj_free_batch(small, NSMALL), 0);
+
+	ASSERTeq(count_objs(pop, TYPE_SMALL), 0);
+	ASSERTeq(count_objs(pop, TYPE_MEDIUM), 0);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
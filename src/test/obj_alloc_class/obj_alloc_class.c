@@ -0,0 +1,226 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_alloc_class.c -- unit test for user-defined allocation classes
+ *
+ * usage: obj_alloc_class file
+ */
+
+#include "unittest.h"
+
+#define	LAYOUT_NAME "alloc_class"
+
+#define	RECORD_SIZE 72
+#define	NRECORDS 1000
+#define	FILL_BYTE 0xc5
+
+/*
+ * fill_constructor -- fills the whole object with FILL_BYTE
+ */
+static void
+fill_constructor(PMEMobjpool *pop, void *ptr, void *arg)
+{
+	size_t size = *(size_t *)arg;
+	pmemobj_memset_persist(pop, ptr, FILL_BYTE, size);
+}
+
+/*
+ * test_register -- checks validation of the class parameters
+ */
+static int
+test_register(PMEMobjpool *pop)
+{
+	int id = pmemobj_alloc_class_register(pop, RECORD_SIZE, 0);
+	ASSERT(id > 0);
+
+	/* the same unit size maps to the same class */
+	ASSERTeq(pmemobj_alloc_class_register(pop, RECORD_SIZE, 100), id);
+
+	ASSERTeq(pmemobj_alloc_class_register(pop, 0, 0), -1);
+	ASSERTeq(errno, EINVAL);
+
+	ASSERTeq(pmemobj_alloc_class_register(pop, RECORD_SIZE + 1, 0), -1);
+	ASSERTeq(errno, EINVAL);
+
+	/* way larger than a single run */
+	ASSERTeq(pmemobj_alloc_class_register(pop, 1 << 20, 0), -1);
+	ASSERTeq(errno, EINVAL);
+
+	/* that many units do not fit in a run */
+	ASSERTeq(pmemobj_alloc_class_register(pop, RECORD_SIZE, 1 << 20), -1);
+	ASSERTeq(errno, EINVAL);
+
+	return id;
+}
+
+/*
+ * test_xalloc_invalid -- checks validation of the pmemobj_xalloc arguments
+ */
+static void
+test_xalloc_invalid(PMEMobjpool *pop, int id)
+{
+	PMEMoid oid = OID_NULL;
+
+	/* unknown flag */
+	ASSERTeq(pmemobj_xalloc(pop, &oid, RECORD_SIZE, 0, 1 << 1,
+		NULL, NULL), -1);
+	ASSERTeq(errno, EINVAL);
+
+	/* class id out of range */
+	ASSERTeq(pmemobj_xalloc(pop, &oid, RECORD_SIZE, 0,
+		POBJ_CLASS_ID(UINT8_MAX + 1), NULL, NULL), -1);
+	ASSERTeq(errno, EINVAL);
+
+	/* not registered class */
+	ASSERTeq(pmemobj_xalloc(pop, &oid, RECORD_SIZE, 0,
+		POBJ_CLASS_ID(UINT8_MAX), NULL, NULL), -1);
+	ASSERTeq(errno, EINVAL);
+
+	/* too big for the class */
+	ASSERTeq(pmemobj_xalloc(pop, &oid, 64 * RECORD_SIZE, 0,
+		POBJ_CLASS_ID(id), NULL, NULL), -1);
+	ASSERTeq(errno, EINVAL);
+
+	ASSERT(OID_IS_NULL(oid));
+}
+
+/*
+ * test_xalloc -- allocates records from the custom class
+ */
+static void
+test_xalloc(PMEMobjpool *pop, int id, PMEMoid *oids)
+{
+	size_t size = RECORD_SIZE;
+	for (int i = 0; i < NRECORDS; ++i) {
+		int ret = pmemobj_xalloc(pop, &oids[i], RECORD_SIZE, 1,
+			POBJ_CLASS_ID(id), fill_constructor, &size);
+		ASSERTeq(ret, 0);
+
+		/* no space is wasted on rounding up */
+		ASSERTeq(pmemobj_alloc_usable_size(oids[i]), RECORD_SIZE);
+
+		unsigned char *rec = pmemobj_direct(oids[i]);
+		ASSERTeq(rec[0], FILL_BYTE);
+		ASSERTeq(rec[RECORD_SIZE - 1], FILL_BYTE);
+	}
+
+	/* zeroed allocation reuses the memory of a freed record */
+	pmemobj_free(&oids[0]);
+	ASSERTeq(pmemobj_xalloc(pop, &oids[0], RECORD_SIZE, 1,
+		POBJ_CLASS_ID(id) | POBJ_XALLOC_ZERO, NULL, NULL), 0);
+	ASSERTeq(pmemobj_alloc_usable_size(oids[0]), RECORD_SIZE);
+	unsigned char *rec = pmemobj_direct(oids[0]);
+	for (int i = 0; i < RECORD_SIZE; ++i)
+		ASSERTeq(rec[i], 0);
+
+	/* the size is rounded up to a multiple of the unit size */
+	PMEMoid oid;
+	ASSERTeq(pmemobj_xalloc(pop, &oid, RECORD_SIZE + 1, 1,
+		POBJ_CLASS_ID(id), NULL, NULL), 0);
+	ASSERT(pmemobj_alloc_usable_size(oid) > RECORD_SIZE);
+	pmemobj_free(&oid);
+}
+
+/*
+ * count_type -- counts objects of the given type
+ */
+static int
+count_type(PMEMobjpool *pop, unsigned type_num)
+{
+	int n = 0;
+	PMEMoid oid;
+	int type;
+	POBJ_FOREACH(pop, oid, type) {
+		if ((unsigned)type == type_num)
+			n++;
+	}
+
+	return n;
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_alloc_class");
+
+	if (argc != 2)
+		FATAL("usage: %s file", argv[0]);
+
+	const char *path = argv[1];
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT_NAME, 0,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		FATAL("!pmemobj_create: %s", path);
+
+	int id = test_register(pop);
+	test_xalloc_invalid(pop, id);
+
+	PMEMoid *oids = MALLOC(NRECORDS * sizeof (PMEMoid));
+	test_xalloc(pop, id, oids);
+
+	pmemobj_close(pop);
+
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		FATAL("!pmemobj_open: %s", path);
+
+	ASSERTeq(count_type(pop, 1), NRECORDS);
+
+	/* runs of the class are recognized without registering it again */
+	PMEMoid oid, next;
+	int type;
+	POBJ_FOREACH_SAFE(pop, oid, next, type) {
+		ASSERTeq(type, 1);
+		ASSERTeq(pmemobj_alloc_usable_size(oid), RECORD_SIZE);
+		pmemobj_free(&oid);
+	}
+
+	ASSERTeq(count_type(pop, 1), 0);
+
+	id = pmemobj_alloc_class_register(pop, RECORD_SIZE, 0);
+	ASSERT(id > 0);
+	test_xalloc(pop, id, oids);
+
+	/* objects of the custom class can be resized like any other */
+	ASSERTeq(pmemobj_realloc(pop, &oids[1], 4 * RECORD_SIZE, 1), 0);
+	ASSERT(pmemobj_alloc_usable_size(oids[1]) >= 4 * RECORD_SIZE);
+
+	ASSERTeq(count_type(pop, 1), NRECORDS);
+
+	FREE(oids);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
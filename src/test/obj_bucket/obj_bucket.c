@@ -55,6 +55,8 @@
 #define	TEST_SIZE_IDX	30
 #define	TEST_BLOCK_OFF	40
 
+#define	TEST_SEGLISTS_NBLOCKS 1000
+
 FUNC_MOCK(malloc, void *, size_t size)
 	FUNC_MOCK_RUN_RET_DEFAULT_REAL(malloc, size)
 	FUNC_MOCK_RUN(0) { /* b malloc */
@@ -182,6 +184,140 @@ test_bucket_remove()
 	bucket_delete(b);
 }
 
+static void
+test_bucket_seglists()
+{
+	struct bucket *b = bucket_new(1, BUCKET_HUGE, CONTAINER_SEGLISTS,
+		TEST_UNIT_SIZE, TEST_MAX_UNIT);
+	ASSERT(b != NULL);
+
+	struct memory_block m = {0, 0, 1, 0};
+
+	/* get from empty */
+	ASSERT(CNT_OP(b, is_empty));
+	ASSERT(CNT_OP(b, get_rm_bestfit, &m) != 0);
+
+	struct memory_block blocks[] = {
+		{1, 0, 3, 0},
+		{2, 0, 100, 0},
+		{3, 0, 70, 0},
+		{4, 1, 3, 0},
+		{5, 1, 10, 0},
+	};
+
+	for (size_t i = 0; i < sizeof (blocks) / sizeof (blocks[0]); ++i)
+		ASSERT(CNT_OP(b, insert, NULL, blocks[i]) == 0);
+
+	ASSERT(!CNT_OP(b, is_empty));
+	ASSERT(CNT_OP(b, get_largest) == 100);
+
+	/* exact lookups have to match the size as well */
+	ASSERT(CNT_OP(b, get_exact, blocks[1]) == 0);
+	m = blocks[1];
+	m.size_idx = 99;
+	ASSERT(CNT_OP(b, get_exact, m) != 0);
+
+	ASSERT(CNT_OP(b, get_rm_exact, blocks[0]) == 0);
+	ASSERT(CNT_OP(b, get_rm_exact, blocks[0]) != 0);
+
+	/* exact size class */
+	m.size_idx = 3;
+	ASSERT(CNT_OP(b, get_rm_bestfit, &m) == 0);
+	ASSERT(m.chunk_id == 4 && m.zone_id == 1 && m.size_idx == 3);
+
+	/* next non-empty size class */
+	m.size_idx = 4;
+	ASSERT(CNT_OP(b, get_rm_bestfit, &m) == 0);
+	ASSERT(m.chunk_id == 5 && m.size_idx == 10);
+
+	/* best-fit among the big blocks */
+	m.size_idx = 65;
+	ASSERT(CNT_OP(b, get_rm_bestfit, &m) == 0);
+	ASSERT(m.chunk_id == 3 && m.size_idx == 70);
+	ASSERT(CNT_OP(b, get_largest) == 100);
+
+	m.size_idx = 101;
+	ASSERT(CNT_OP(b, get_rm_bestfit, &m) != 0);
+
+	m.size_idx = 1;
+	ASSERT(CNT_OP(b, get_rm_bestfit, &m) == 0);
+	ASSERT(m.chunk_id == 2 && m.size_idx == 100);
+
+	ASSERT(CNT_OP(b, is_empty));
+	ASSERT(CNT_OP(b, get_largest) == 0);
+
+	/* a chunk holds at most one block */
+	ASSERT(CNT_OP(b, insert, NULL, blocks[1]) == 0);
+	ASSERT(CNT_OP(b, insert, NULL, blocks[1]) != 0);
+	ASSERT(CNT_OP(b, get_rm_exact, blocks[1]) == 0);
+
+	/*
+	 * Only the first few blocks of the list of the requested range are
+	 * checked, then a bigger block of the next range is preferred.
+	 */
+	struct memory_block range[] = {
+		{0, 2, 71, 0},
+		{1, 2, 64, 0}, {2, 2, 64, 0}, {3, 2, 64, 0},
+		{4, 2, 64, 0}, {5, 2, 64, 0}, {6, 2, 64, 0},
+		{7, 2, 64, 0}, {8, 2, 64, 0}, {9, 2, 64, 0},
+		{10, 2, 80, 0},
+	};
+
+	for (size_t i = 0; i < sizeof (range) / sizeof (range[0]); ++i)
+		ASSERT(CNT_OP(b, insert, NULL, range[i]) == 0);
+
+	m.size_idx = 70;
+	ASSERT(CNT_OP(b, get_rm_bestfit, &m) == 0);
+	ASSERT(m.chunk_id == 10 && m.size_idx == 80);
+
+	/* the whole list is searched if there's no bigger block */
+	m.size_idx = 70;
+	ASSERT(CNT_OP(b, get_rm_bestfit, &m) == 0);
+	ASSERT(m.chunk_id == 0 && m.size_idx == 71);
+
+	for (uint32_t i = 1; i < 10; ++i) {
+		m.size_idx = 64;
+		ASSERT(CNT_OP(b, get_rm_bestfit, &m) == 0);
+		ASSERT(m.size_idx == 64);
+	}
+
+	ASSERT(CNT_OP(b, is_empty));
+
+	/* blocks of many sizes, most of them in the power of two ranges */
+	unsigned nsize[201] = {0};
+	for (uint32_t i = 0; i < TEST_SEGLISTS_NBLOCKS; ++i) {
+		m.chunk_id = i;
+		m.zone_id = 0;
+		m.size_idx = 1 + (i * 7) % 200;
+		m.block_off = 0;
+		ASSERT(CNT_OP(b, insert, NULL, m) == 0);
+		nsize[m.size_idx]++;
+	}
+
+	ASSERT(CNT_OP(b, get_largest) == 200);
+
+	uint32_t last_size = 0;
+	uint32_t largest = 200;
+	for (uint32_t i = 0; i < TEST_SEGLISTS_NBLOCKS; ++i) {
+		m.size_idx = 1;
+		ASSERT(CNT_OP(b, get_rm_bestfit, &m) == 0);
+
+		/* the blocks of a range are not sorted by size */
+		ASSERT(m.size_idx + last_size / 8 >= last_size);
+		last_size = m.size_idx;
+
+		nsize[m.size_idx]--;
+		while (largest != 0 && nsize[largest] == 0)
+			largest--;
+
+		ASSERTeq(CNT_OP(b, get_largest), largest);
+	}
+
+	ASSERT(CNT_OP(b, is_empty));
+
+	bucket_delete(b);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -192,6 +328,7 @@ main(int argc, char *argv[])
 	test_bucket_insert_get();
 	test_bucket_remove();
 	test_bucket_bitmap_correctness();
+	test_bucket_seglists();
 
 	DONE(NULL);
 }
@@ -0,0 +1,234 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_defrag.c -- unit test for pmemobj_defrag
+ *
+ * usage: obj_defrag file
+ */
+
+#include "unittest.h"
+
+#define	LAYOUT_NAME "defrag"
+
+#define	NOBJS 4000
+#define	OBJ_SIZE 200
+#define	KEEP_EVERY 16
+#define	TYPE_NUM 1
+
+struct object {
+	uint64_t idx;
+	uint8_t payload[OBJ_SIZE - sizeof (uint64_t)];
+};
+
+struct root {
+	PMEMoid objs[NOBJS];
+};
+
+/*
+ * obj_fill -- (internal) constructor of the objects
+ */
+static void
+obj_fill(PMEMobjpool *pop, void *ptr, void *arg)
+{
+	struct object *o = ptr;
+	o->idx = *(uint64_t *)arg;
+	memset(o->payload, (int)(o->idx & 0xFF), sizeof (o->payload));
+	pmemobj_persist(pop, o, sizeof (*o));
+}
+
+/*
+ * relocate -- updates the references in the root object
+ */
+static int
+relocate(PMEMobjpool *pop, const struct pobj_remap *remap, size_t nremap,
+	void *arg)
+{
+	struct root *r = arg;
+
+	for (size_t i = 0; i < nremap; ++i) {
+		struct object *o = pmemobj_direct(remap[i].new_oid);
+		ASSERT(o->idx < NOBJS);
+		ASSERTeq(r->objs[o->idx].off, remap[i].old_oid.off);
+
+		ASSERTeq(pmemobj_tx_add_range_direct(&r->objs[o->idx],
+			sizeof (PMEMoid)), 0);
+		r->objs[o->idx] = remap[i].new_oid;
+	}
+
+	return 0;
+}
+
+/*
+ * relocate_abort -- refuses to update the references
+ */
+static int
+relocate_abort(PMEMobjpool *pop, const struct pobj_remap *remap,
+	size_t nremap, void *arg)
+{
+	return 1;
+}
+
+/*
+ * check_objects -- verifies that every live object is intact and referenced
+ */
+static void
+check_objects(PMEMobjpool *pop, struct root *r)
+{
+	unsigned nlive = 0;
+	for (uint64_t i = 0; i < NOBJS; ++i) {
+		if (OID_IS_NULL(r->objs[i]))
+			continue;
+
+		nlive++;
+		struct object *o = pmemobj_direct(r->objs[i]);
+		ASSERTeq(o->idx, i);
+		ASSERTeq(pmemobj_type_num(r->objs[i]), TYPE_NUM);
+		for (size_t j = 0; j < sizeof (o->payload); ++j)
+			ASSERTeq(o->payload[j], i & 0xFF);
+	}
+
+	unsigned nlisted = 0;
+	PMEMoid oid;
+	int type;
+	POBJ_FOREACH(pop, oid, type) {
+		ASSERTeq(type, TYPE_NUM);
+		ASSERTeq(pmemobj_type_num(oid), TYPE_NUM);
+		struct object *o = pmemobj_direct(oid);
+		ASSERTeq(r->objs[o->idx].off, oid.off);
+		nlisted++;
+	}
+
+	ASSERTeq(nlive, nlisted);
+}
+
+/*
+ * get_nruns -- returns the number of chunks used by the runs
+ */
+static uint64_t
+get_nruns(PMEMobjpool *pop)
+{
+	struct pobj_heap_stats stats;
+	ASSERTeq(pmemobj_heap_stats(pop, &stats), 0);
+
+	return stats.chunks_run;
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_defrag");
+
+	if (argc != 2)
+		FATAL("usage: %s file", argv[0]);
+
+	const char *path = argv[1];
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT_NAME, 0,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		FATAL("!pmemobj_create: %s", path);
+
+	PMEMoid root = pmemobj_root(pop, sizeof (struct root));
+	struct root *r = pmemobj_direct(root);
+
+	for (uint64_t i = 0; i < NOBJS; ++i)
+		ASSERTeq(pmemobj_alloc(pop, &r->objs[i], OBJ_SIZE, TYPE_NUM,
+			obj_fill, &i), 0);
+
+	for (uint64_t i = 0; i < NOBJS; ++i) {
+		if (i % KEEP_EVERY != 0)
+			pmemobj_free(&r->objs[i]);
+	}
+
+	check_objects(pop, r);
+
+	struct pobj_defrag_result res;
+
+	/* invalid arguments */
+	errno = 0;
+	ASSERTeq(pmemobj_defrag(pop, 100, SIZE_MAX, relocate, r, &res), -1);
+	ASSERTeq(errno, EINVAL);
+	errno = 0;
+	ASSERTeq(pmemobj_defrag(pop, 50, SIZE_MAX, NULL, r, &res), -1);
+	ASSERTeq(errno, EINVAL);
+
+	/* the relocation callback aborts the transaction */
+	errno = 0;
+	ASSERTeq(pmemobj_defrag(pop, 50, SIZE_MAX, relocate_abort, r, &res),
+		-1);
+	ASSERTeq(errno, ECANCELED);
+	ASSERTeq(res.relocated, 0);
+	check_objects(pop, r);
+
+	uint64_t nruns = get_nruns(pop);
+	ASSERT(nruns > 1);
+
+	/* a run at a time, until the whole heap is scanned */
+	size_t relocated = 0;
+	size_t released = 0;
+	do {
+		ASSERTeq(pmemobj_defrag(pop, 50, 1, relocate, r, &res), 0);
+		relocated += res.relocated;
+		released += res.runs_released;
+	} while (!res.complete);
+
+	ASSERT(relocated > 0);
+	ASSERT(released > 0);
+	ASSERT(get_nruns(pop) < nruns);
+	check_objects(pop, r);
+
+	nruns = get_nruns(pop);
+
+	pmemobj_close(pop);
+
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		FATAL("!pmemobj_open: %s", path);
+
+	root = pmemobj_root(pop, sizeof (struct root));
+	r = pmemobj_direct(root);
+
+	/* the lane recovery might have freed the undo log caches */
+	check_objects(pop, r);
+	ASSERT(get_nruns(pop) <= nruns);
+
+	/* the surviving objects fit into a single run */
+	ASSERTeq(pmemobj_defrag(pop, 10, SIZE_MAX, relocate, r, &res), 0);
+	ASSERTeq(res.relocated, 0);
+	ASSERTeq(res.complete, 1);
+	check_objects(pop, r);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -61,6 +61,13 @@ obj_heap_persist(PMEMobjpool *pop, const void *ptr, size_t sz)
 	pmem_msync(ptr, sz);
 }
 
+static void
+obj_heap_persistv(PMEMobjpool *pop, const struct pmem_vec *vec, size_t cnt)
+{
+	for (size_t i = 0; i < cnt; ++i)
+		pmem_msync(vec[i].addr, vec[i].len);
+}
+
 static void
 test_heap()
 {
@@ -71,6 +78,7 @@ test_heap()
 	pop->heap_size = MOCK_POOL_SIZE - sizeof (PMEMobjpool);
 	pop->heap_offset = (uint64_t)((uint64_t)&mpop->heap - (uint64_t)mpop);
 	pop->persist = obj_heap_persist;
+	pop->persistv = obj_heap_persistv;
 
 	ASSERT(heap_check(pop) != 0);
 	ASSERT(heap_init(pop) == 0);
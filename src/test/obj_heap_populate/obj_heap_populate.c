@@ -0,0 +1,144 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_heap_populate.c -- unit test for the population of heap zones
+ *
+ * usage: obj_heap_populate file alloc-size [tail-alloc-size]
+ *
+ * Fills the whole pool with objects, reopens it, frees all of them and checks
+ * that exactly the same number of objects fits into the pool again, whether
+ * the zones are populated lazily or by background threads. The space left
+ * over by the first size is filled with objects of the tail size, which makes
+ * the frees reach runs of the zones that are not populated yet.
+ */
+
+#include "unittest.h"
+
+#define	LAYOUT_NAME "heap_populate"
+
+/*
+ * alloc_all -- allocates objects until the pool runs out of memory
+ */
+static unsigned
+alloc_all(PMEMobjpool *pop, size_t size, unsigned type_num)
+{
+	unsigned n = 0;
+	while (pmemobj_alloc(pop, NULL, size, type_num, NULL, NULL) == 0)
+		n++;
+
+	return n;
+}
+
+/*
+ * fill -- allocates objects of the given size, then of the tail size
+ *
+ * The objects of the tail size have the lower type number, so that they are
+ * freed first.
+ */
+static unsigned
+fill(PMEMobjpool *pop, size_t size, size_t tail_size)
+{
+	unsigned n = alloc_all(pop, size, 1);
+	if (tail_size != 0)
+		n += alloc_all(pop, tail_size, 0);
+
+	return n;
+}
+
+/*
+ * free_all -- frees all objects in the pool
+ */
+static unsigned
+free_all(PMEMobjpool *pop)
+{
+	unsigned n = 0;
+	PMEMoid oid, next;
+	int type;
+	POBJ_FOREACH_SAFE(pop, oid, next, type) {
+		pmemobj_free(&oid);
+		n++;
+	}
+
+	return n;
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_heap_populate");
+
+	if (argc < 3 || argc > 4)
+		FATAL("usage: %s file alloc-size [tail-alloc-size]", argv[0]);
+
+	const char *path = argv[1];
+	size_t size = strtoul(argv[2], NULL, 0);
+	size_t tail_size = argc == 4 ? strtoul(argv[3], NULL, 0) : 0;
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT_NAME, 0,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		FATAL("!pmemobj_create: %s", path);
+
+	unsigned allocated = fill(pop, size, tail_size);
+	OUT("allocated %u", allocated);
+
+	pmemobj_close(pop);
+
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		FATAL("!pmemobj_open: %s", path);
+
+	/* frees from the zones that might not be populated yet */
+	ASSERTeq(free_all(pop), allocated);
+	ASSERTeq(fill(pop, size, tail_size), allocated);
+	ASSERTeq(free_all(pop), allocated);
+
+	pmemobj_close(pop);
+
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		FATAL("!pmemobj_open: %s", path);
+
+	/* reopen and close without any allocation */
+	pmemobj_close(pop);
+
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		FATAL("!pmemobj_open: %s", path);
+
+	ASSERTeq(fill(pop, size, tail_size), allocated);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * obj_heap_stats.c -- unit test for pmemobj_heap_stats
+ *
+ * usage: obj_heap_stats file
+ */
+
+#include "unittest.h"
+
+#define	LAYOUT_NAME "heap_stats"
+
+#define	RECORD_SIZE 72
+#define	NRECORDS 1000
+#define	HUGE_SIZE (1 << 20)
+#define	MAX_HUGE 64
+
+static struct pobj_heap_stats stats;
+
+/*
+ * get_stats -- retrieves the heap statistics and checks their consistency
+ */
+static void
+get_stats(PMEMobjpool *pop)
+{
+	ASSERTeq(pmemobj_heap_stats(pop, &stats), 0);
+
+	ASSERTne(stats.chunk_size, 0);
+	ASSERTeq(stats.chunks_free + stats.chunks_huge + stats.chunks_run,
+		stats.chunks_total);
+	ASSERT(stats.largest_free_extent <=
+		stats.chunks_free * stats.chunk_size);
+	ASSERT(stats.fragmentation >= 0.0 && stats.fragmentation <= 1.0);
+
+	uint64_t nruns = 0;
+	for (unsigned i = 0; i < stats.nclasses; ++i)
+		nruns += stats.classes[i].nruns;
+
+	ASSERTeq(nruns, stats.chunks_run);
+}
+
+/*
+ * get_class_stats -- returns the statistics of the given allocation class
+ */
+static struct pobj_alloc_class_stats *
+get_class_stats(unsigned class_id)
+{
+	for (unsigned i = 0; i < stats.nclasses; ++i) {
+		if (stats.classes[i].class_id == class_id)
+			return &stats.classes[i];
+	}
+
+	FATAL("no statistics of class %u", class_id);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_heap_stats");
+
+	if (argc != 2)
+		FATAL("usage: %s file", argv[0]);
+
+	const char *path = argv[1];
+
+	PMEMobjpool *pop = pmemobj_create(path, LAYOUT_NAME, 0,
+		S_IWUSR | S_IRUSR);
+	if (pop == NULL)
+		FATAL("!pmemobj_create: %s", path);
+
+	/* empty heap */
+	get_stats(pop);
+	ASSERTne(stats.chunks_total, 0);
+	ASSERTeq(stats.chunks_huge, 0);
+	ASSERTeq(stats.chunks_run, 0);
+	ASSERTeq(stats.largest_free_extent,
+		stats.chunks_total * stats.chunk_size);
+	ASSERTeq(stats.fragmentation, 0.0);
+
+	uint64_t chunks_total = stats.chunks_total;
+
+	int id = pmemobj_alloc_class_register(pop, RECORD_SIZE, 0);
+	ASSERT(id > 0);
+
+	PMEMoid *oids = MALLOC(NRECORDS * sizeof (PMEMoid));
+	for (int i = 0; i < NRECORDS; ++i)
+		ASSERTeq(pmemobj_xalloc(pop, &oids[i], RECORD_SIZE, 0,
+			POBJ_CLASS_ID(id), NULL, NULL), 0);
+
+	get_stats(pop);
+	struct pobj_alloc_class_stats *cs = get_class_stats((unsigned)id);
+	ASSERTeq(cs->unit_size, RECORD_SIZE + 64);
+	ASSERTeq(cs->units_used, NRECORDS);
+	ASSERT(cs->nruns > 0);
+	ASSERT(cs->units_used + cs->units_free <=
+		cs->nruns * (stats.chunk_size / cs->unit_size));
+
+	PMEMoid huge;
+	ASSERTeq(pmemobj_alloc(pop, &huge, HUGE_SIZE, 0, NULL, NULL), 0);
+	get_stats(pop);
+	ASSERTeq(stats.chunks_huge * stats.chunk_size,
+		(HUGE_SIZE / stats.chunk_size + 1) * stats.chunk_size);
+
+	struct pobj_heap_stats prev = stats;
+
+	pmemobj_close(pop);
+
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		FATAL("!pmemobj_open: %s", path);
+
+	/* the statistics are recreated from the heap layout */
+	get_stats(pop);
+
+	/* the only zone of a small pool is loaded while it's being opened */
+	ASSERTeq(stats.zones_pending, 0);
+	ASSERTeq(stats.chunks_total, chunks_total);
+	ASSERTeq(stats.chunks_huge, prev.chunks_huge);
+	ASSERTeq(stats.chunks_run, prev.chunks_run);
+	cs = get_class_stats((unsigned)id);
+	ASSERTeq(cs->unit_size, RECORD_SIZE + 64);
+	ASSERTeq(cs->units_used, NRECORDS);
+
+	for (int i = 0; i < NRECORDS; ++i)
+		pmemobj_free(&oids[i]);
+	pmemobj_free(&huge);
+
+	get_stats(pop);
+	ASSERTeq(stats.chunks_huge, 0);
+	for (unsigned i = 0; i < stats.nclasses; ++i)
+		ASSERTeq(stats.classes[i].units_used, 0);
+
+	/* every other chunk is used */
+	PMEMoid chunks[MAX_HUGE];
+	int nchunks = 0;
+	while (nchunks < MAX_HUGE && pmemobj_alloc(pop, &chunks[nchunks],
+			stats.chunk_size / 2, 0, NULL, NULL) == 0)
+		nchunks++;
+
+	ASSERT(nchunks > 4);
+	get_stats(pop);
+	ASSERTeq(stats.chunks_huge, (uint64_t)nchunks);
+
+	for (int i = 0; i < nchunks; i += 2)
+		pmemobj_free(&chunks[i]);
+
+	get_stats(pop);
+	ASSERTeq(stats.chunks_huge, (uint64_t)nchunks / 2);
+	ASSERT(stats.fragmentation > 0.5);
+
+	for (int i = 1; i < nchunks; i += 2)
+		pmemobj_free(&chunks[i]);
+
+	get_stats(pop);
+	ASSERTeq(stats.chunks_huge, 0);
+	ASSERTeq(stats.largest_free_extent,
+		stats.chunks_free * stats.chunk_size);
+
+	FREE(oids);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -261,6 +261,58 @@ test_lane_hold_release()
 	signal(SIGABRT, old);
 }
 
+static PMEMobjpool *Busy_pop;
+
+static void *
+lane_hold_worker(void *arg)
+{
+	struct lane_section *held = arg;
+	struct lane_section *sec;
+
+	/* must not wait for the lane held by the main thread */
+	lane_hold(Busy_pop, &sec, LANE_SECTION_ALLOCATOR);
+	ASSERTne(sec, held);
+	lane_release(Busy_pop);
+
+	return NULL;
+}
+
+static void
+test_lane_hold_busy(void)
+{
+	struct mock_pop pop = {
+		.p = {
+			.nlanes = MAX_MOCK_LANES,
+			.lanes = NULL
+		}
+	};
+	base_ptr = &pop.p;
+	pop.p.lanes_offset = (uint64_t)&pop.l - (uint64_t)&pop.p;
+
+	ASSERTeq(lane_boot(&pop.p), 0);
+	Busy_pop = &pop.p;
+
+	struct lane_section *sec;
+	struct lane_section *nested;
+	lane_hold(&pop.p, &sec, LANE_SECTION_ALLOCATOR);
+	lane_hold(&pop.p, &nested, LANE_SECTION_ALLOCATOR);
+	ASSERTeq(sec, nested);
+
+	pthread_t t;
+	pthread_create(&t, NULL, lane_hold_worker, sec);
+	pthread_join(t, NULL);
+
+	lane_release(&pop.p);
+	lane_release(&pop.p);
+
+	/* the thread gets the lane it used last time */
+	lane_hold(&pop.p, &nested, LANE_SECTION_ALLOCATOR);
+	ASSERTeq(sec, nested);
+	lane_release(&pop.p);
+
+	lane_cleanup(&pop.p);
+}
+
 static void
 test_lane_sizes(void)
 {
@@ -281,6 +333,7 @@ main(int argc, char *argv[])
 	test_lane_recovery_check_ok();
 	test_lane_recovery_check_fail();
 	test_lane_hold_release();
+	test_lane_hold_busy();
 	test_lane_sizes();
 
 	DONE(NULL);
@@ -169,6 +169,26 @@ obj_drain(PMEMobjpool *pop)
 	pop->drain_local();
 }
 
+/*
+ * obj_persistv -- pmemobj version of pmem_persistv w/o replication
+ */
+static void
+obj_persistv(PMEMobjpool *pop, const struct pmem_vec *vec, size_t cnt)
+{
+	for (size_t i = 0; i < cnt; ++i)
+		pop->persist_local(vec[i].addr, vec[i].len);
+}
+
+/*
+ * obj_flushv -- pmemobj version of pmem_flushv w/o replication
+ */
+static void
+obj_flushv(PMEMobjpool *pop, const struct pmem_vec *vec, size_t cnt)
+{
+	for (size_t i = 0; i < cnt; ++i)
+		pop->flush_local(vec[i].addr, vec[i].len);
+}
+
 /*
  * linear_alloc -- allocates `size` bytes (rounded up to 8 bytes) and returns
  * offset to the allocated object
@@ -230,6 +250,8 @@ FUNC_MOCK_RUN_DEFAULT {
 	Pop->persist = obj_persist;
 	Pop->flush = obj_flush;
 	Pop->drain = obj_drain;
+	Pop->persistv = obj_persistv;
+	Pop->flushv = obj_flushv;
 
 	Pop->heap_offset = HEAP_OFFSET;
 	Pop->heap_size = Pop->size - Pop->heap_offset;
@@ -403,6 +425,36 @@ FUNC_MOCK(pfree, int, PMEMobjpool *pop, uint64_t *ptr, uint64_t data_off)
 	}
 FUNC_MOCK_END
 
+/*
+ * pmalloc_reserve_batch -- pmalloc_reserve_batch mock
+ *
+ * The batch operations are not used by this test.
+ */
+FUNC_MOCK_RET_ALWAYS(pmalloc_reserve_batch, int, -1, PMEMobjpool *pop,
+	uint64_t *offs, size_t n, size_t size,
+	void (*constructor)(PMEMobjpool *pop, void *ptr,
+	size_t usable_size, void *arg), void *arg, uint64_t data_off);
+
+/*
+ * pmalloc_publish_batch -- pmalloc_publish_batch mock
+ */
+FUNC_MOCK(pmalloc_publish_batch, void, PMEMobjpool *pop, const uint64_t *offs,
+	size_t n, struct redo_log *redo, size_t redo_index)
+	FUNC_MOCK_RUN_DEFAULT {
+		FATAL("unexpected pmalloc_publish_batch call");
+	}
+FUNC_MOCK_END
+
+/*
+ * pfree_batch -- pfree_batch mock
+ */
+FUNC_MOCK(pfree_batch, void, PMEMobjpool *pop, const uint64_t *offs, size_t n,
+	uint64_t data_off, struct redo_log *redo, size_t redo_index)
+	FUNC_MOCK_RUN_DEFAULT {
+		FATAL("unexpected pfree_batch call");
+	}
+FUNC_MOCK_END
+
 /*
  * pmalloc_construct -- pmalloc_construct mock
  *
@@ -411,7 +463,8 @@ FUNC_MOCK_END
  */
 FUNC_MOCK(pmalloc_construct, int, PMEMobjpool *pop, uint64_t *off,
 	size_t size, void (*constructor)(PMEMobjpool *pop, void *ptr,
-	size_t usable_size, void *arg), void *arg, uint64_t data_off)
+	size_t usable_size, void *arg), void *arg, uint64_t data_off,
+	uint8_t class_id)
 	FUNC_MOCK_RUN_DEFAULT {
 		size = 2 * (size - OOB_OFF) + OOB_OFF;
 		uint64_t *alloc_size = (uint64_t *)((uintptr_t)Pop +
@@ -0,0 +1,229 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * obj_no_type_lists.c -- unit test for pools without the per-type lists
+ *
+ * usage: obj_no_type_lists file
+ */
+
+#include "unittest.h"
+
+#define	LAYOUT_NAME "no_type_lists"
+
+#define	NOBJS 1000
+#define	FREE_EVERY 3
+#define	TYPE_SMALL 1
+#define	TYPE_HUGE 2
+#define	TYPE_MOVED 3
+#define	HUGE_SIZE (1024 * 1024)
+#define	NHUGE 4
+
+struct root {
+	PMEMoid objs[NOBJS];
+	PMEMoid huge[NHUGE];
+};
+
+/*
+ * obj_fill -- (internal) constructor of the objects
+ */
+static void
+obj_fill(PMEMobjpool *pop, void *ptr, void *arg)
+{
+	*(uint64_t *)ptr = *(uint64_t *)arg;
+	pmemobj_persist(pop, ptr, sizeof (uint64_t));
+}
+
+/*
+ * count_objects -- (internal) iterates over the objects of a type, checks
+ *	that they are visited in address order and returns their number
+ */
+static size_t
+count_objects(PMEMobjpool *pop, unsigned type_num)
+{
+	size_t n = 0;
+	uint64_t prev = 0;
+
+	for (PMEMoid oid = pmemobj_first(pop, type_num); !OID_IS_NULL(oid);
+			oid = pmemobj_next(oid)) {
+		ASSERTeq(pmemobj_type_num(oid), (int)type_num);
+		ASSERT(oid.off > prev);
+		prev = oid.off;
+		n++;
+	}
+
+	return n;
+}
+
+/*
+ * test_alloc_free -- (internal) checks that atomic allocations are found
+ */
+static void
+test_alloc_free(PMEMobjpool *pop, struct root *r)
+{
+	ASSERTeq(count_objects(pop, TYPE_SMALL), 0);
+
+	for (uint64_t i = 0; i < NOBJS; ++i)
+		ASSERTeq(pmemobj_alloc(pop, &r->objs[i], 64 + i % 200,
+			TYPE_SMALL, obj_fill, &i), 0);
+
+	for (uint64_t i = 0; i < NHUGE; ++i)
+		ASSERTeq(pmemobj_alloc(pop, &r->huge[i], HUGE_SIZE,
+			TYPE_HUGE, obj_fill, &i), 0);
+
+	ASSERTeq(count_objects(pop, TYPE_SMALL), NOBJS);
+	ASSERTeq(count_objects(pop, TYPE_HUGE), NHUGE);
+
+	for (uint64_t i = 0; i < NOBJS; i += FREE_EVERY)
+		pmemobj_free(&r->objs[i]);
+	pmemobj_free(&r->huge[0]);
+
+	ASSERTeq(count_objects(pop, TYPE_SMALL),
+		NOBJS - (NOBJS + FREE_EVERY - 1) / FREE_EVERY);
+	ASSERTeq(count_objects(pop, TYPE_HUGE), NHUGE - 1);
+}
+
+/*
+ * test_realloc -- (internal) checks that reallocated objects keep their data
+ *	and change their type
+ */
+static void
+test_realloc(PMEMobjpool *pop, struct root *r)
+{
+	size_t nsmall = count_objects(pop, TYPE_SMALL);
+
+	/* in place or not, the type changes */
+	ASSERTeq(pmemobj_realloc(pop, &r->objs[1], 4096, TYPE_MOVED), 0);
+	ASSERTeq(*(uint64_t *)pmemobj_direct(r->objs[1]), 1);
+	ASSERTeq(pmemobj_realloc(pop, &r->objs[2], 64 + 2 % 200,
+		TYPE_MOVED), 0);
+	ASSERTeq(*(uint64_t *)pmemobj_direct(r->objs[2]), 2);
+
+	/* same type */
+	ASSERTeq(pmemobj_realloc(pop, &r->objs[4], 8192, TYPE_SMALL), 0);
+	ASSERTeq(*(uint64_t *)pmemobj_direct(r->objs[4]), 4);
+
+	ASSERTeq(count_objects(pop, TYPE_SMALL), nsmall - 2);
+	ASSERTeq(count_objects(pop, TYPE_MOVED), 2);
+}
+
+/*
+ * test_tx -- (internal) checks transactional allocations and frees
+ */
+static void
+test_tx(PMEMobjpool *pop, struct root *r)
+{
+	size_t nsmall = count_objects(pop, TYPE_SMALL);
+
+	/* aborted allocation and free */
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range_direct(&r->objs[0], sizeof (PMEMoid));
+		r->objs[0] = pmemobj_tx_alloc(128, TYPE_SMALL);
+		pmemobj_tx_free(r->objs[5]);
+
+		/* an object freed by the transaction is no longer visited */
+		ASSERTeq(count_objects(pop, TYPE_SMALL), nsmall - 1);
+		pmemobj_tx_abort(ECANCELED);
+	} TX_END
+
+	ASSERT(OID_IS_NULL(r->objs[0]));
+	ASSERTeq(count_objects(pop, TYPE_SMALL), nsmall);
+
+	/* committed allocation and free */
+	TX_BEGIN(pop) {
+		pmemobj_tx_add_range_direct(&r->objs[0], sizeof (PMEMoid));
+		r->objs[0] = pmemobj_tx_alloc(128, TYPE_SMALL);
+		pmemobj_tx_free(r->objs[5]);
+		pmemobj_tx_add_range_direct(&r->objs[5], sizeof (PMEMoid));
+		r->objs[5] = OID_NULL;
+	} TX_ONABORT {
+		ASSERT(0);
+	} TX_END
+
+	ASSERT(!OID_IS_NULL(r->objs[0]));
+	ASSERTeq(count_objects(pop, TYPE_SMALL), nsmall);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_no_type_lists");
+
+	if (argc != 2)
+		FATAL("usage: %s file", argv[0]);
+
+	const char *path = argv[1];
+
+	errno = 0;
+	ASSERTeq(pmemobj_xcreate(path, LAYOUT_NAME, 0, S_IWUSR | S_IRUSR,
+		~POBJ_XCREATE_VALID_FLAGS, NULL), NULL);
+	ASSERTeq(errno, EINVAL);
+
+	PMEMobjpool *pop = pmemobj_xcreate(path, LAYOUT_NAME, 0,
+		S_IWUSR | S_IRUSR, POBJ_XCREATE_NO_TYPE_LISTS, NULL);
+	if (pop == NULL)
+		FATAL("!pmemobj_xcreate: %s", path);
+
+	PMEMoid root = pmemobj_root(pop, sizeof (struct root));
+	struct root *r = pmemobj_direct(root);
+
+	test_alloc_free(pop, r);
+	test_realloc(pop, r);
+	test_tx(pop, r);
+
+	size_t nsmall = count_objects(pop, TYPE_SMALL);
+
+	pmemobj_close(pop);
+
+	ASSERTeq(pmemobj_check(path, LAYOUT_NAME), 1);
+
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		FATAL("!pmemobj_open: %s", path);
+
+	r = pmemobj_direct(pmemobj_root(pop, sizeof (struct root)));
+
+	ASSERTeq(count_objects(pop, TYPE_SMALL), nsmall);
+	ASSERTeq(count_objects(pop, TYPE_HUGE), NHUGE - 1);
+	ASSERTeq(count_objects(pop, TYPE_MOVED), 2);
+
+	for (size_t i = 0; i < NOBJS; ++i)
+		pmemobj_free(&r->objs[i]);
+
+	ASSERTeq(count_objects(pop, TYPE_SMALL), 0);
+	ASSERTeq(count_objects(pop, TYPE_MOVED), 0);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
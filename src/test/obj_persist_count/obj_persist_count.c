@@ -64,6 +64,20 @@ FUNC_MOCK(pmem_flush, void, void *addr, size_t len)
 	}
 FUNC_MOCK_END
 
+FUNC_MOCK(pmem_persistv, void, const struct pmem_vec *vec, size_t cnt)
+	FUNC_MOCK_RUN_DEFAULT {
+		ops_counter.n_persist++;
+		_FUNC_REAL(pmem_persistv)(vec, cnt);
+	}
+FUNC_MOCK_END
+
+FUNC_MOCK(pmem_flushv, void, const struct pmem_vec *vec, size_t cnt)
+	FUNC_MOCK_RUN_DEFAULT {
+		ops_counter.n_flush++;
+		_FUNC_REAL(pmem_flushv)(vec, cnt);
+	}
+FUNC_MOCK_END
+
 FUNC_MOCK(pmem_drain, void, void)
 	FUNC_MOCK_RUN_DEFAULT {
 		ops_counter.n_drain++;
@@ -153,6 +167,11 @@ main(int argc, char *argv[])
 	} TX_END
 	print_reset_counters("tx_add");
 
+	TX_BEGIN(pop) {
+		ASSERTeq(f->val, 0);
+	} TX_END
+	print_reset_counters("tx_read");
+
 	pmalloc(pop, &f->dest, sizeof (f->val), 0);
 	print_reset_counters("pmalloc");
 
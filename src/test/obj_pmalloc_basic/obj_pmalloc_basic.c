@@ -102,6 +102,26 @@ obj_drain(PMEMobjpool *pop)
 	pop->drain_local();
 }
 
+/*
+ * obj_persistv -- pmemobj version of pmem_persistv w/o replication
+ */
+static void
+obj_persistv(PMEMobjpool *pop, const struct pmem_vec *vec, size_t cnt)
+{
+	for (size_t i = 0; i < cnt; ++i)
+		pop->persist_local(vec[i].addr, vec[i].len);
+}
+
+/*
+ * obj_flushv -- pmemobj version of pmem_flushv w/o replication
+ */
+static void
+obj_flushv(PMEMobjpool *pop, const struct pmem_vec *vec, size_t cnt)
+{
+	for (size_t i = 0; i < cnt; ++i)
+		pop->flush_local(vec[i].addr, vec[i].len);
+}
+
 static void
 test_oom_allocs(size_t size)
 {
@@ -173,6 +193,8 @@ test_mock_pool_allocs()
 	mock_pop->persist = obj_persist;
 	mock_pop->flush = obj_flush;
 	mock_pop->drain = obj_drain;
+	mock_pop->persistv = obj_persistv;
+	mock_pop->flushv = obj_flushv;
 
 	heap_init(mock_pop);
 	heap_boot(mock_pop);
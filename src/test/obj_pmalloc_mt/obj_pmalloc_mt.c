@@ -36,6 +36,11 @@
 #include <stdint.h>
 
 #include "libpmemobj.h"
+#include "util.h"
+#include "redo.h"
+#include "lane.h"
+#include "list.h"
+#include "obj.h"
 #include "pmalloc.h"
 #include "unittest.h"
 
@@ -169,14 +174,38 @@ main(int argc, char *argv[])
 {
 	START(argc, argv, "obj_pmalloc_mt");
 
-	if (argc != 2)
-		FATAL("usage: %s [file]", argv[0]);
+	if (argc < 2 || argc > 3)
+		FATAL("usage: %s file [nlanes]", argv[0]);
 
 	PMEMobjpool *pop;
+	size_t poolsize = THREADS * OPS_PER_THREAD * ALLOC_SIZE * FRAGMENTATION;
 
 	if (access(argv[1], F_OK) != 0) {
-		pop = pmemobj_create(argv[1], "TEST",
-		THREADS * OPS_PER_THREAD * ALLOC_SIZE * FRAGMENTATION, 0666);
+		struct pobj_create_attr attr = { 0, 0 };
+
+		if (argc == 3) {
+			attr.nlanes = UINT64_MAX;
+
+			errno = 0;
+			ASSERTeq(pmemobj_xcreate(argv[1], "TEST", poolsize,
+				0666, 0, &attr), NULL);
+			ASSERTeq(errno, EINVAL);
+
+			attr.nlanes = strtoull(argv[2], NULL, 0);
+			attr.lane_section_size = 1000;
+
+			errno = 0;
+			ASSERTeq(pmemobj_xcreate(argv[1], "TEST", poolsize,
+				0666, 0, &attr), NULL);
+			ASSERTeq(errno, EINVAL);
+
+			attr.lane_section_size = 0;
+		}
+
+		pop = pmemobj_xcreate(argv[1], "TEST", poolsize, 0666, 0,
+			&attr);
+		if (pop != NULL && attr.nlanes != 0)
+			ASSERTeq(pop->nlanes, attr.nlanes);
 	} else {
 		if ((pop = pmemobj_open(argv[1], "TEST")) == NULL) {
 			printf("failed to open pool\n");
@@ -185,7 +214,7 @@ main(int argc, char *argv[])
 	}
 
 	if (pop == NULL)
-		FATAL("!pmemobj_create");
+		FATAL("!pmemobj_xcreate");
 
 	PMEMoid oid = pmemobj_root(pop, sizeof (struct root));
 	struct root *r = pmemobj_direct(oid);
@@ -44,27 +44,57 @@ struct foo {
 	int bar;
 };
 
+#define	MT_NTHREADS 128
+
 struct root {
 	PMEMmutex lock;
 	TOID(struct foo) foo;
+	int bar[MT_NTHREADS];
 };
 
 #define	BAR_VALUE 5
 
+static PMEMobjpool *Pop;
+static pthread_barrier_t Barrier;
+
+/*
+ * tx_crash_worker -- modifies its own part of the root object and allocates
+ *	an object in a transaction, which is interrupted by the crash
+ */
+static void *
+tx_crash_worker(void *arg)
+{
+	int *bar = arg;
+
+	TX_BEGIN(Pop) {
+		pmemobj_tx_add_range_direct(bar, sizeof (*bar));
+		*bar = BAR_VALUE * 2;
+		TOID(struct foo) f = TX_NEW(struct foo);
+		D_RW(f)->bar = BAR_VALUE * 2;
+
+		pthread_barrier_wait(&Barrier);
+		for (;;)
+			pause();
+	} TX_END
+
+	return NULL;
+}
+
 int
 main(int argc, char *argv[])
 {
 	START(argc, argv, "obj_recovery");
 
 	if (argc != 5)
-		FATAL("usage: %s [file] [lock: y/n] [cmd: c/o] [type: n/f/s]",
+		FATAL("usage: %s [file] [lock: y/n] [cmd: c/o] "
+			"[type: n/f/s/m/t]",
 			argv[0]);
 
 	const char *path = argv[1];
 
 	PMEMobjpool *pop = NULL;
 	int exists = argv[3][0] == 'o';
-	enum { TEST_NEW, TEST_FREE, TEST_SET } type;
+	enum { TEST_NEW, TEST_FREE, TEST_SET, TEST_MT, TEST_TORN } type;
 
 	if (argv[4][0] == 'n')
 		type = TEST_NEW;
@@ -72,6 +102,10 @@ main(int argc, char *argv[])
 		type = TEST_FREE;
 	else if (argv[4][0] == 's')
 		type = TEST_SET;
+	else if (argv[4][0] == 'm')
+		type = TEST_MT;
+	else if (argv[4][0] == 't')
+		type = TEST_TORN;
 	else
 		FATAL("invalid type");
 
@@ -128,6 +162,61 @@ main(int argc, char *argv[])
 		} else {
 			ASSERT(TOID_IS_NULL(D_RW(root)->foo));
 		}
+	} else if (type == TEST_MT) {
+		if (!exists) {
+			TX_BEGIN(pop) {
+				TX_ADD(root);
+				for (int i = 0; i < MT_NTHREADS; ++i)
+					D_RW(root)->bar[i] = BAR_VALUE;
+			} TX_END
+
+			/* crash with a transaction in progress in many lanes */
+			Pop = pop;
+			pthread_barrier_init(&Barrier, NULL, MT_NTHREADS + 1);
+
+			pthread_t threads[MT_NTHREADS];
+			for (int i = 0; i < MT_NTHREADS; ++i)
+				PTHREAD_CREATE(&threads[i], NULL,
+					tx_crash_worker, &D_RW(root)->bar[i]);
+
+			pthread_barrier_wait(&Barrier);
+			exit(0); /* simulate a crash */
+		} else {
+			for (int i = 0; i < MT_NTHREADS; ++i)
+				ASSERTeq(D_RO(root)->bar[i], BAR_VALUE);
+
+			ASSERT(TOID_IS_NULL(POBJ_FIRST(pop, struct foo)));
+		}
+	} else if (type == TEST_TORN) {
+		int *first = &D_RW(root)->bar[0];
+		int *last = &D_RW(root)->bar[MT_NTHREADS - 1];
+
+		if (!exists) {
+			TX_BEGIN_LOCK(pop, lock_type, lock) {
+				TX_ADD(root);
+				*first = BAR_VALUE;
+				*last = BAR_VALUE;
+			} TX_END
+
+			/*
+			 * Each of the ranges gets its own undo log entry, the
+			 * second one is then corrupted as if torn by a failure
+			 * while it was being written.
+			 */
+			TX_BEGIN_LOCK(pop, lock_type, lock) {
+				pmemobj_tx_add_range_direct(first,
+					sizeof (*first));
+				*first = BAR_VALUE * 2;
+				pmemobj_tx_add_range_direct(last,
+					sizeof (*last));
+				*last = BAR_VALUE * 2;
+				exit(0); /* simulate a crash */
+			} TX_END
+		} else {
+			/* the log ends at the torn entry */
+			ASSERTeq(*first, BAR_VALUE);
+			ASSERTeq(*last, BAR_VALUE * 2);
+		}
 	} else { /* TEST_FREE */
 		if (!exists) {
 			TX_BEGIN_LOCK(pop, lock_type, lock) {
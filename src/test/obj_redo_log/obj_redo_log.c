@@ -102,6 +102,26 @@ obj_drain(PMEMobjpool *pop)
 	pop->drain_local();
 }
 
+/*
+ * obj_persistv -- pmemobj version of pmem_persistv w/o replication
+ */
+static void
+obj_persistv(PMEMobjpool *pop, const struct pmem_vec *vec, size_t cnt)
+{
+	for (size_t i = 0; i < cnt; ++i)
+		pop->persist_local(vec[i].addr, vec[i].len);
+}
+
+/*
+ * obj_flushv -- pmemobj version of pmem_flushv w/o replication
+ */
+static void
+obj_flushv(PMEMobjpool *pop, const struct pmem_vec *vec, size_t cnt)
+{
+	for (size_t i = 0; i < cnt; ++i)
+		pop->flush_local(vec[i].addr, vec[i].len);
+}
+
 
 static PMEMobjpool *
 pmemobj_open_mock(const char *fname)
@@ -153,6 +173,8 @@ pmemobj_open_mock(const char *fname)
 	pop->persist = obj_persist;
 	pop->flush = obj_flush;
 	pop->drain = obj_drain;
+	pop->persistv = obj_persistv;
+	pop->flushv = obj_flushv;
 
 	return pop;
 }
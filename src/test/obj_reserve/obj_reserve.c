@@ -0,0 +1,270 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * obj_reserve.c -- unit test for pmemobj_reserve, pmemobj_publish and
+ *	pmemobj_cancel
+ *
+ * usage: obj_reserve file l|n
+ *
+ * l - pool with the per-type lists, n - pool created without them
+ */
+
+#include "unittest.h"
+
+#define	LAYOUT_NAME "reserve"
+
+#define	TYPE_NODE 1
+#define	TYPE_DATA 2
+
+#define	NNODES 10
+
+struct node {
+	PMEMoid next;
+	uint64_t value;
+};
+
+struct root {
+	PMEMoid head;
+	uint64_t count;
+	uint64_t generation;
+};
+
+/*
+ * count_objs -- (internal) counts the objects of a type
+ */
+static size_t
+count_objs(PMEMobjpool *pop, unsigned type_num)
+{
+	size_t n = 0;
+	for (PMEMoid oid = pmemobj_first(pop, type_num); !OID_IS_NULL(oid);
+		oid = pmemobj_next(oid))
+		n++;
+
+	return n;
+}
+
+/*
+ * push_node -- (internal) builds a node and links it in at the list head
+ */
+static void
+push_node(PMEMobjpool *pop, struct root *r, uint64_t value)
+{
+	struct pobj_action act[3];
+
+	PMEMoid oid = pmemobj_reserve(pop, &act[0], sizeof (struct node),
+		TYPE_NODE);
+	ASSERT(!OID_IS_NULL(oid));
+
+	struct node *n = pmemobj_direct(oid);
+	n->next = r->head;
+	n->value = value;
+	pmemobj_persist(pop, n, sizeof (*n));
+
+	/* the pool uuid of the head does not change after the first node */
+	pmemobj_set_value(pop, &act[1], &r->head.pool_uuid_lo,
+		oid.pool_uuid_lo);
+	pmemobj_set_value(pop, &act[2], &r->head.off, oid.off);
+
+	ASSERTeq(pmemobj_publish(pop, act, 3), 0);
+}
+
+/*
+ * check_nodes -- (internal) checks the nodes linked from the root
+ */
+static void
+check_nodes(PMEMobjpool *pop, struct root *r, size_t nnodes)
+{
+	size_t n = 0;
+	for (PMEMoid oid = r->head; !OID_IS_NULL(oid);
+		oid = ((struct node *)pmemobj_direct(oid))->next) {
+		struct node *node = pmemobj_direct(oid);
+		ASSERTeq(node->value, nnodes - 1 - n);
+		ASSERTeq(pmemobj_type_num(oid), TYPE_NODE);
+		n++;
+	}
+
+	ASSERTeq(n, nnodes);
+	ASSERTeq(count_objs(pop, TYPE_NODE), nnodes);
+}
+
+/*
+ * test_cancel -- (internal) reserved objects are not allocated unless they
+ *	are published
+ */
+static void
+test_cancel(PMEMobjpool *pop)
+{
+	struct pobj_action act[4];
+	PMEMoid oids[4];
+
+	for (int i = 0; i < 4; ++i) {
+		oids[i] = pmemobj_reserve(pop, &act[i], 128 << (i * 4),
+			TYPE_DATA);
+		ASSERT(!OID_IS_NULL(oids[i]));
+		ASSERT(pmemobj_alloc_usable_size(oids[i]) >=
+			(size_t)(128 << (i * 4)));
+	}
+
+	ASSERTeq(count_objs(pop, TYPE_DATA), 0);
+
+	pmemobj_cancel(pop, act, 4);
+
+	ASSERTeq(count_objs(pop, TYPE_DATA), 0);
+}
+
+/*
+ * test_invalid -- (internal) invalid actions are not carried out
+ */
+static void
+test_invalid(PMEMobjpool *pop, struct root *r)
+{
+	struct pobj_action act[POBJ_MAX_ACTIONS + 1];
+
+	errno = 0;
+	ASSERT(OID_IS_NULL(pmemobj_reserve(pop, &act[0], 0, TYPE_DATA)));
+	ASSERTeq(errno, EINVAL);
+
+	errno = 0;
+	ASSERT(OID_IS_NULL(pmemobj_reserve(pop, &act[0], 64,
+		PMEMOBJ_NUM_OID_TYPES)));
+	ASSERTeq(errno, EINVAL);
+
+	/* a value outside of the pool */
+	uint64_t v;
+	ASSERT(!OID_IS_NULL(pmemobj_reserve(pop, &act[0], 64, TYPE_DATA)));
+	pmemobj_set_value(pop, &act[1], &r->count, 1);
+	pmemobj_set_value(pop, &act[2], &v, 1);
+
+	errno = 0;
+	ASSERTeq(pmemobj_publish(pop, act, 3), -1);
+	ASSERTeq(errno, EINVAL);
+	ASSERTeq(r->count, 0);
+	ASSERTeq(count_objs(pop, TYPE_DATA), 0);
+
+	/* too many actions */
+	for (int i = 1; i <= POBJ_MAX_ACTIONS; ++i)
+		pmemobj_set_value(pop, &act[i], &r->count, (uint64_t)i);
+
+	errno = 0;
+	ASSERTeq(pmemobj_publish(pop, act, POBJ_MAX_ACTIONS + 1), -1);
+	ASSERTeq(errno, EINVAL);
+	ASSERTeq(r->count, 0);
+
+	/* the reservation is still valid */
+	ASSERTeq(pmemobj_publish(pop, act, POBJ_MAX_ACTIONS), 0);
+	ASSERTeq(r->count, POBJ_MAX_ACTIONS - 1);
+	ASSERTeq(count_objs(pop, TYPE_DATA), 1);
+
+	PMEMoid oid = pmemobj_first(pop, TYPE_DATA);
+	pmemobj_free(&oid);
+}
+
+/*
+ * test_types -- (internal) objects of different types published at once
+ */
+static void
+test_types(PMEMobjpool *pop, struct root *r)
+{
+	struct pobj_action act[POBJ_MAX_ACTIONS];
+	size_t nact = 0;
+
+	for (int i = 0; i < 20; ++i) {
+		unsigned type_num = 10 + (unsigned)i % 3;
+		ASSERT(!OID_IS_NULL(pmemobj_reserve(pop, &act[nact++],
+			64 + (size_t)i * 100, type_num)));
+	}
+
+	pmemobj_set_value(pop, &act[nact++], &r->generation, 1);
+
+	ASSERTeq(pmemobj_publish(pop, act, nact), 0);
+
+	ASSERTeq(r->generation, 1);
+	ASSERTeq(count_objs(pop, 10), 7);
+	ASSERTeq(count_objs(pop, 11), 7);
+	ASSERTeq(count_objs(pop, 12), 6);
+
+	/* only values */
+	pmemobj_set_value(pop, &act[0], &r->generation, 2);
+	ASSERTeq(pmemobj_publish(pop, act, 1), 0);
+	ASSERTeq(r->generation, 2);
+
+	ASSERTeq(pmemobj_publish(pop, act, 0), 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_reserve");
+
+	if (argc != 3 || (argv[2][0] != 'l' && argv[2][0] != 'n'))
+		FATAL("usage: %s file l|n", argv[0]);
+
+	const char *path = argv[1];
+	uint64_t flags = argv[2][0] == 'n' ? POBJ_XCREATE_NO_TYPE_LISTS : 0;
+
+	PMEMobjpool *pop = pmemobj_xcreate(path, LAYOUT_NAME, 0,
+		S_IWUSR | S_IRUSR, flags, NULL);
+	if (pop == NULL)
+		FATAL("!pmemobj_xcreate: %s", path);
+
+	struct root *r = pmemobj_direct(pmemobj_root(pop,
+		sizeof (struct root)));
+
+	test_cancel(pop);
+	test_invalid(pop, r);
+
+	for (uint64_t i = 0; i < NNODES; ++i)
+		push_node(pop, r, i);
+
+	check_nodes(pop, r, NNODES);
+
+	test_types(pop, r);
+
+	pmemobj_close(pop);
+
+	ASSERTeq(pmemobj_check(path, LAYOUT_NAME), 1);
+
+	pop = pmemobj_open(path, LAYOUT_NAME);
+	if (pop == NULL)
+		FATAL("!pmemobj_open: %s", path);
+
+	r = pmemobj_direct(pmemobj_root(pop, sizeof (struct root)));
+
+	check_nodes(pop, r, NNODES);
+	ASSERTeq(r->generation, 2);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
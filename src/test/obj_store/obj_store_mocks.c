@@ -121,7 +121,8 @@ FUNC_MOCK_END
  */
 FUNC_MOCK(pmalloc_construct, int, PMEMobjpool *pop, uint64_t *off,
 	size_t size, void (*constructor)(PMEMobjpool *pop, void *ptr,
-	size_t real_size, void *arg), void *arg, uint64_t data_off)
+	size_t real_size, void *arg), void *arg, uint64_t data_off,
+	uint8_t class_id)
 FUNC_MOCK_RUN_DEFAULT {
 	struct heap_header_mock *hheader = (struct heap_header_mock *)pop->heap;
 	if (pmalloc(pop, off, size, data_off))
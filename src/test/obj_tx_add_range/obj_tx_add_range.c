@@ -45,14 +45,20 @@
 
 #define	OBJ_SIZE	1024
 #define	OVERLAP_SIZE	100
+#define	MANY_NFIELDS	4096
+#define	LINES_SIZE	(3 * 4096)
 
 enum type_number {
 	TYPE_OBJ,
 	TYPE_OBJ_ABORT,
+	TYPE_MANY_OBJ,
+	TYPE_LINES_OBJ,
 };
 
 TOID_DECLARE(struct object, 0);
 TOID_DECLARE(struct overlap_object, 1);
+TOID_DECLARE(struct many_object, 2);
+TOID_DECLARE(struct lines_object, 3);
 
 struct object {
 	size_t value;
@@ -63,6 +69,14 @@ struct overlap_object {
 	uint8_t data[OVERLAP_SIZE];
 };
 
+struct many_object {
+	uint64_t field[2 * MANY_NFIELDS];
+};
+
+struct lines_object {
+	uint8_t data[LINES_SIZE];
+};
+
 #define	VALUE_OFF	(offsetof(struct object, value))
 #define	VALUE_SIZE	(sizeof (size_t))
 #define	DATA_OFF	(offsetof(struct object, data))
@@ -86,6 +100,21 @@ do_tx_zalloc(PMEMobjpool *pop, int type_num)
 	return ret;
 }
 
+/*
+ * do_tx_zalloc_size -- do tx allocation of given size
+ */
+static PMEMoid
+do_tx_zalloc_size(PMEMobjpool *pop, size_t size, int type_num)
+{
+	PMEMoid ret = OID_NULL;
+
+	TX_BEGIN(pop) {
+		ret = pmemobj_tx_zalloc(size, type_num);
+	} TX_END
+
+	return ret;
+}
+
 /*
  * do_tx_add_range_alloc_commit -- call pmemobj_add_range on object allocated
  * within the same transaction and commit the transaction
@@ -384,6 +413,123 @@ do_tx_add_range_commit(PMEMobjpool *pop)
 	ASSERTeq(D_RO(obj)->value, TEST_VALUE_1);
 }
 
+/*
+ * do_tx_add_range_many -- call pmemobj_tx_add_range on enough separate fields
+ * to overflow the in-lane undo log and a few arena chunks, then add the whole
+ * object which is too big for an arena chunk
+ */
+static void
+do_tx_add_range_many(PMEMobjpool *pop, int do_abort)
+{
+	TOID(struct many_object) obj;
+	TX_BEGIN(pop) {
+		TOID_ASSIGN(obj, pmemobj_tx_zalloc(sizeof (struct many_object),
+				TYPE_MANY_OBJ));
+	} TX_ONABORT {
+		ASSERT(0);
+	} TX_END
+
+	TX_BEGIN(pop) {
+		for (int i = 0; i < MANY_NFIELDS; ++i) {
+			TX_ADD_FIELD(obj, field[2 * i]);
+			D_RW(obj)->field[2 * i] = (uint64_t)i + 1;
+		}
+
+		TX_ADD(obj);
+		for (int i = 0; i < MANY_NFIELDS; ++i)
+			D_RW(obj)->field[2 * i + 1] = (uint64_t)i + 1;
+
+		if (do_abort)
+			pmemobj_tx_abort(-1);
+	} TX_ONABORT {
+		ASSERT(do_abort);
+	} TX_ONCOMMIT {
+		ASSERT(!do_abort);
+	} TX_END
+
+	for (int i = 0; i < 2 * MANY_NFIELDS; ++i) {
+		uint64_t expected = do_abort ? 0 : (uint64_t)i / 2 + 1;
+		ASSERTeq(D_RO(obj)->field[i], expected);
+	}
+
+	TX_BEGIN(pop) {
+		TX_FREE(obj);
+	} TX_ONABORT {
+		ASSERT(0);
+	} TX_END
+}
+
+/*
+ * do_tx_add_range_lines_add -- (internal) add the range of the object and
+ * overwrite it, the data which is already in the undo log has to stay there
+ */
+static void
+do_tx_add_range_lines_add(TOID(struct lines_object) obj, uint64_t off,
+	uint64_t size, uint8_t val)
+{
+	int ret = pmemobj_tx_add_range(obj.oid, off, size);
+	ASSERTeq(ret, 0);
+
+	memset(&D_RW(obj)->data[off], val, size);
+}
+
+/*
+ * do_tx_add_range_lines -- call pmemobj_tx_add_range with ranges that
+ * partially overlap within cache lines and with ranges too big for the
+ * cache line index, modifying the data in between
+ */
+static void
+do_tx_add_range_lines(PMEMobjpool *pop)
+{
+	TOID(struct lines_object) obj;
+	TOID_ASSIGN(obj, do_tx_zalloc_size(pop, sizeof (struct lines_object),
+			TYPE_LINES_OBJ));
+
+	TX_BEGIN(pop) {
+		/* bytes within one line and across the line boundary */
+		do_tx_add_range_lines_add(obj, 3, 1, 1);
+		do_tx_add_range_lines_add(obj, 60, 8, 2);
+		do_tx_add_range_lines_add(obj, 0, 70, 3);
+		do_tx_add_range_lines_add(obj, 1, 2, 4);
+
+		/* large range covering the lines from the index */
+		do_tx_add_range_lines_add(obj, 100, 4200, 5);
+		do_tx_add_range_lines_add(obj, 0, LINES_SIZE / 2, 6);
+
+		/* small ranges within the large ones */
+		do_tx_add_range_lines_add(obj, 200, 10, 7);
+		do_tx_add_range_lines_add(obj, LINES_SIZE / 2 - 5, 10, 8);
+
+		/* large range overlapping with all of the above */
+		do_tx_add_range_lines_add(obj, 0, LINES_SIZE, 9);
+
+		pmemobj_tx_abort(-1);
+	} TX_ONCOMMIT {
+		ASSERT(0);
+	} TX_END
+
+	ASSERT(util_is_zeroed(D_RO(obj)->data, LINES_SIZE));
+
+	TX_BEGIN(pop) {
+		do_tx_add_range_lines_add(obj, 60, 8, 1);
+		do_tx_add_range_lines_add(obj, 5000, 4100, 2);
+		do_tx_add_range_lines_add(obj, 62, 2, 3);
+		do_tx_add_range_lines_add(obj, 9000, 200, 4);
+	} TX_ONABORT {
+		ASSERT(0);
+	} TX_END
+
+	for (size_t i = 0; i < LINES_SIZE; ++i) {
+		uint8_t expected = 0;
+		if (i >= 60 && i < 68)
+			expected = (i == 62 || i == 63) ? 3 : 1;
+		else if (i >= 5000 && i < 9200)
+			expected = i >= 9000 ? 4 : 2;
+
+		ASSERTeq(D_RO(obj)->data[i], expected);
+	}
+}
+
 /*
  * do_tx_add_range_overlapping -- call pmemobj_tx_add_range with overlapping
  */
@@ -547,6 +693,12 @@ main(int argc, char *argv[])
 	VALGRIND_WRITE_STATS;
 	do_tx_add_range_overlapping(pop);
 	VALGRIND_WRITE_STATS;
+	do_tx_add_range_many(pop, 1);
+	VALGRIND_WRITE_STATS;
+	do_tx_add_range_many(pop, 0);
+	VALGRIND_WRITE_STATS;
+	do_tx_add_range_lines(pop);
+	VALGRIND_WRITE_STATS;
 
 	pmemobj_close(pop);
 
@@ -0,0 +1,273 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * obj_tx_redo.c -- unit test for the redo mode of transactions
+ */
+#include <string.h>
+
+#include "unittest.h"
+
+#define	LAYOUT_NAME "tx_redo"
+
+#define	DATA_SIZE	64
+#define	LARGE_SIZE	(40 * 1024)
+
+struct object {
+	uint64_t value;
+	uint8_t data[DATA_SIZE];
+	uint8_t large[LARGE_SIZE];
+};
+
+TOID_DECLARE(struct object, 0);
+
+/*
+ * do_tx_write_commit -- write in the redo mode is visible through
+ *	pmemobj_tx_read and applied in place on commit
+ */
+static void
+do_tx_write_commit(PMEMobjpool *pop, TOID(struct object) obj)
+{
+	uint64_t value = 1;
+
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO) {
+		pmemobj_tx_write(&D_RW(obj)->value, &value, sizeof (value));
+		ASSERTeq(D_RO(obj)->value, 0);
+
+		uint64_t v = 0;
+		pmemobj_tx_read(&v, &D_RO(obj)->value, sizeof (v));
+		ASSERTeq(v, 1);
+	} TX_ONABORT {
+		ASSERT(0);
+	} TX_END
+
+	ASSERTeq(D_RO(obj)->value, 1);
+}
+
+/*
+ * do_tx_write_abort -- write in the redo mode is discarded on abort
+ */
+static void
+do_tx_write_abort(PMEMobjpool *pop, TOID(struct object) obj)
+{
+	uint64_t value = 2;
+
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO) {
+		pmemobj_tx_write(&D_RW(obj)->value, &value, sizeof (value));
+		pmemobj_tx_abort(-1);
+	} TX_ONCOMMIT {
+		ASSERT(0);
+	} TX_END
+
+	ASSERTeq(D_RO(obj)->value, 1);
+}
+
+/*
+ * do_tx_write_overlap -- later writes take precedence, also when a write is
+ *	contained in the previous one
+ */
+static void
+do_tx_write_overlap(PMEMobjpool *pop, TOID(struct object) obj)
+{
+	uint8_t buf[DATA_SIZE];
+	uint8_t exp[DATA_SIZE];
+
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO) {
+		memset(buf, 1, DATA_SIZE);
+		pmemobj_tx_write(D_RW(obj)->data, buf, DATA_SIZE);
+
+		memset(buf, 2, 8);
+		pmemobj_tx_write(D_RW(obj)->data + 8, buf, 8);
+
+		memset(buf, 3, 16);
+		pmemobj_tx_write(D_RW(obj)->data + 32, buf, 16);
+
+		memset(buf, 4, 16);
+		pmemobj_tx_write(D_RW(obj)->data + 40, buf, 16);
+
+		memset(exp, 1, DATA_SIZE);
+		memset(exp + 8, 2, 8);
+		memset(exp + 32, 3, 8);
+		memset(exp + 40, 4, 16);
+
+		pmemobj_tx_read(buf, D_RO(obj)->data, DATA_SIZE);
+		ASSERTeq(memcmp(buf, exp, DATA_SIZE), 0);
+
+		pmemobj_tx_read(buf, D_RO(obj)->data + 36, 8);
+		ASSERTeq(memcmp(buf, exp + 36, 8), 0);
+	} TX_ONABORT {
+		ASSERT(0);
+	} TX_END
+
+	ASSERTeq(memcmp(D_RO(obj)->data, exp, DATA_SIZE), 0);
+}
+
+/*
+ * do_tx_write_nested -- nested transactions inherit the mode of the
+ *	outermost one
+ */
+static void
+do_tx_write_nested(PMEMobjpool *pop, TOID(struct object) obj)
+{
+	uint64_t value = 3;
+
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO) {
+		TX_BEGIN(pop) {
+			pmemobj_tx_write(&D_RW(obj)->value, &value,
+				sizeof (value));
+		} TX_END
+
+		ASSERTeq(D_RO(obj)->value, 1);
+	} TX_END
+
+	ASSERTeq(D_RO(obj)->value, 3);
+
+	value = 4;
+	TX_BEGIN(pop) {
+		TX_BEGIN_PARAM(pop, TX_PARAM_REDO) {
+			pmemobj_tx_write(&D_RW(obj)->value, &value,
+				sizeof (value));
+		} TX_END
+
+		/* undo mode, the object is modified directly */
+		ASSERTeq(D_RO(obj)->value, 4);
+		pmemobj_tx_abort(-1);
+	} TX_END
+
+	ASSERTeq(D_RO(obj)->value, 3);
+}
+
+/*
+ * do_tx_write_mixed -- redo log writes and snapshots in one transaction
+ */
+static void
+do_tx_write_mixed(PMEMobjpool *pop, TOID(struct object) obj, int abort)
+{
+	uint64_t value = 5;
+
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO) {
+		TX_ADD_FIELD(obj, data);
+		memset(D_RW(obj)->data, 5, DATA_SIZE);
+
+		pmemobj_tx_write(&D_RW(obj)->value, &value, sizeof (value));
+
+		if (abort)
+			pmemobj_tx_abort(-1);
+	} TX_END
+
+	if (abort) {
+		ASSERTeq(D_RO(obj)->value, 3);
+		ASSERTne(D_RO(obj)->data[0], 5);
+	} else {
+		ASSERTeq(D_RO(obj)->value, 5);
+		ASSERTeq(D_RO(obj)->data[0], 5);
+	}
+}
+
+/*
+ * do_tx_write_large -- write bigger than an undo log arena chunk
+ */
+static void
+do_tx_write_large(PMEMobjpool *pop, TOID(struct object) obj)
+{
+	static uint8_t buf[LARGE_SIZE];
+	for (size_t i = 0; i < LARGE_SIZE; ++i)
+		buf[i] = (uint8_t)i;
+
+	TX_BEGIN_PARAM(pop, TX_PARAM_REDO) {
+		pmemobj_tx_write(D_RW(obj)->large, buf, LARGE_SIZE);
+
+		uint8_t v[64];
+		pmemobj_tx_read(v, D_RO(obj)->large + 16380, sizeof (v));
+		ASSERTeq(memcmp(v, buf + 16380, sizeof (v)), 0);
+		ASSERTeq(D_RO(obj)->large[16380], 0);
+	} TX_ONABORT {
+		ASSERT(0);
+	} TX_END
+
+	ASSERTeq(memcmp(D_RO(obj)->large, buf, LARGE_SIZE), 0);
+}
+
+/*
+ * do_tx_write_undo -- outside of the redo mode pmemobj_tx_write modifies
+ *	the memory directly and the abort restores it
+ */
+static void
+do_tx_write_undo(PMEMobjpool *pop, TOID(struct object) obj)
+{
+	uint64_t value = 6;
+
+	TX_BEGIN(pop) {
+		pmemobj_tx_write(&D_RW(obj)->value, &value, sizeof (value));
+		ASSERTeq(D_RO(obj)->value, 6);
+
+		uint64_t v = 0;
+		pmemobj_tx_read(&v, &D_RO(obj)->value, sizeof (v));
+		ASSERTeq(v, 6);
+
+		pmemobj_tx_abort(-1);
+	} TX_END
+
+	ASSERTeq(D_RO(obj)->value, 5);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_tx_redo");
+
+	if (argc != 2)
+		FATAL("usage: %s [file]", argv[0]);
+
+	PMEMobjpool *pop;
+	if ((pop = pmemobj_create(argv[1], LAYOUT_NAME, PMEMOBJ_MIN_POOL,
+	    S_IWUSR | S_IRUSR)) == NULL)
+		FATAL("!pmemobj_create");
+
+	TOID(struct object) obj;
+	POBJ_ZNEW(pop, &obj, struct object);
+	ASSERT(!TOID_IS_NULL(obj));
+
+	do_tx_write_commit(pop, obj);
+	do_tx_write_abort(pop, obj);
+	do_tx_write_overlap(pop, obj);
+	do_tx_write_nested(pop, obj);
+	do_tx_write_mixed(pop, obj, 1);
+	do_tx_write_mixed(pop, obj, 0);
+	do_tx_write_large(pop, obj);
+	do_tx_write_undo(pop, obj);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -0,0 +1,241 @@
+/*
+ * Copyright 2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/*
+ * obj_walk.c -- unit test for pmemobj_walk
+ *
+ * usage: obj_walk file l|n
+ *
+ * l - pool with the per-type lists, n - pool created without them
+ */
+
+#include "unittest.h"
+
+#define	LAYOUT_NAME "walk"
+
+#define	NOBJS 3000
+#define	NTYPES 3
+#define	NPARTS_MAX 7
+#define	NTHREADS 4
+#define	STOP_AFTER 10
+#define	STOP_VALUE 42
+
+struct root {
+	PMEMoid objs[NOBJS];
+};
+
+/* state of a single walk */
+struct walk {
+	unsigned type_num;
+	size_t count;
+	uint64_t first;
+	uint64_t last;
+};
+
+/*
+ * walk_cb -- counts the visited objects and checks their order
+ */
+static int
+walk_cb(PMEMobjpool *pop, PMEMoid oid, void *arg)
+{
+	struct walk *w = arg;
+
+	if (w->type_num != POBJ_WALK_ANY_TYPE)
+		ASSERTeq(pmemobj_type_num(oid), (int)w->type_num);
+
+	ASSERT(oid.off > w->last);
+	if (w->count == 0)
+		w->first = oid.off;
+	w->last = oid.off;
+	w->count++;
+
+	return 0;
+}
+
+/*
+ * stop_cb -- stops the walk after a few objects
+ */
+static int
+stop_cb(PMEMobjpool *pop, PMEMoid oid, void *arg)
+{
+	size_t *n = arg;
+
+	return ++(*n) == STOP_AFTER ? STOP_VALUE : 0;
+}
+
+/*
+ * count_list -- (internal) counts the objects of a type with pmemobj_next
+ */
+static size_t
+count_list(PMEMobjpool *pop, unsigned type_num)
+{
+	size_t n = 0;
+	for (PMEMoid oid = pmemobj_first(pop, type_num); !OID_IS_NULL(oid);
+		oid = pmemobj_next(oid))
+		n++;
+
+	return n;
+}
+
+/*
+ * count_parts -- (internal) walks all the parts one after another and checks
+ *	that they are disjoint
+ */
+static size_t
+count_parts(PMEMobjpool *pop, unsigned type_num, unsigned nparts)
+{
+	size_t n = 0;
+	uint64_t last = 0;
+
+	for (unsigned p = 0; p < nparts; ++p) {
+		struct walk w = { type_num, 0, 0, 0 };
+		ASSERTeq(pmemobj_walk(pop, type_num, p, nparts, walk_cb, &w),
+			0);
+
+		if (w.count != 0) {
+			ASSERT(w.first > last);
+			last = w.last;
+		}
+		n += w.count;
+	}
+
+	return n;
+}
+
+/* arguments of the walking threads */
+struct thread_args {
+	PMEMobjpool *pop;
+	unsigned part;
+	struct walk w;
+};
+
+/*
+ * walker -- walks a single part of the heap
+ */
+static void *
+walker(void *arg)
+{
+	struct thread_args *a = arg;
+
+	ASSERTeq(pmemobj_walk(a->pop, POBJ_WALK_ANY_TYPE, a->part, NTHREADS,
+		walk_cb, &a->w), 0);
+
+	return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "obj_walk");
+
+	if (argc != 3 || (argv[2][0] != 'l' && argv[2][0] != 'n'))
+		FATAL("usage: %s file l|n", argv[0]);
+
+	const char *path = argv[1];
+	uint64_t flags = argv[2][0] == 'n' ? POBJ_XCREATE_NO_TYPE_LISTS : 0;
+
+	PMEMobjpool *pop = pmemobj_xcreate(path, LAYOUT_NAME, 0,
+		S_IWUSR | S_IRUSR, flags, NULL);
+	if (pop == NULL)
+		FATAL("!pmemobj_xcreate: %s", path);
+
+	struct root *r = pmemobj_direct(pmemobj_root(pop,
+		sizeof (struct root)));
+
+	/* a mix of small objects and ones taking whole chunks */
+	for (unsigned i = 0; i < NOBJS; ++i) {
+		size_t size = i % 100 == 0 ? 300 * 1024 : 64 + i % 500;
+		ASSERTeq(pmemobj_alloc(pop, &r->objs[i], size, i % NTYPES,
+			NULL, NULL), 0);
+	}
+
+	for (unsigned i = 0; i < NOBJS; i += 5)
+		pmemobj_free(&r->objs[i]);
+
+	/* invalid arguments */
+	struct walk w = { 0, 0, 0, 0 };
+	errno = 0;
+	ASSERTeq(pmemobj_walk(pop, 0, 1, 1, walk_cb, &w), -1);
+	ASSERTeq(errno, EINVAL);
+	errno = 0;
+	ASSERTeq(pmemobj_walk(pop, 0, 0, 0, walk_cb, &w), -1);
+	ASSERTeq(errno, EINVAL);
+	errno = 0;
+	ASSERTeq(pmemobj_walk(pop, PMEMOBJ_NUM_OID_TYPES, 0, 1, walk_cb, &w),
+		-1);
+	ASSERTeq(errno, EINVAL);
+	errno = 0;
+	ASSERTeq(pmemobj_walk(pop, 0, 0, 1, NULL, &w), -1);
+	ASSERTeq(errno, EINVAL);
+
+	/* the same objects as the ones found by pmemobj_first/next */
+	size_t total = 0;
+	for (unsigned t = 0; t < NTYPES; ++t) {
+		size_t n = count_list(pop, t);
+		ASSERT(n > 0);
+		for (unsigned nparts = 1; nparts <= NPARTS_MAX; nparts += 3)
+			ASSERTeq(count_parts(pop, t, nparts), n);
+		total += n;
+	}
+
+	ASSERTeq(total, NOBJS - NOBJS / 5);
+	ASSERTeq(count_parts(pop, POBJ_WALK_ANY_TYPE, 1), total);
+
+	/* the callback stops the walk */
+	size_t visited = 0;
+	ASSERTeq(pmemobj_walk(pop, POBJ_WALK_ANY_TYPE, 0, 1, stop_cb,
+		&visited), STOP_VALUE);
+	ASSERTeq(visited, STOP_AFTER);
+
+	/* all parts walked in parallel */
+	pthread_t threads[NTHREADS];
+	struct thread_args args[NTHREADS];
+	for (unsigned i = 0; i < NTHREADS; ++i) {
+		args[i].pop = pop;
+		args[i].part = i;
+		memset(&args[i].w, 0, sizeof (args[i].w));
+		args[i].w.type_num = POBJ_WALK_ANY_TYPE;
+		PTHREAD_CREATE(&threads[i], NULL, walker, &args[i]);
+	}
+
+	size_t nparallel = 0;
+	for (unsigned i = 0; i < NTHREADS; ++i) {
+		PTHREAD_JOIN(threads[i], NULL);
+		nparallel += args[i].w.count;
+	}
+	ASSERTeq(nparallel, total);
+
+	pmemobj_close(pop);
+
+	DONE(NULL);
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright 2014-2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * pmem_is_pmem_map.c -- unit test for pmem_is_pmem() on ranges mapped
+ *	by pmem_map()
+ *
+ * usage: pmem_is_pmem_map file
+ *
+ * Counts the opens of /proc/self/smaps to verify the answer for a range
+ * created by pmem_map() is looked up only once, and that it is forgotten
+ * by pmem_unmap().
+ */
+
+#define	_GNU_SOURCE
+#include "unittest.h"
+
+#include <dlfcn.h>
+
+static int Smaps_opens;
+
+/*
+ * fopen -- interpose on libc fopen()
+ *
+ * This counts the opens of /proc/self/smaps.
+ */
+FILE *
+fopen(const char *path, const char *mode)
+{
+	static FILE *(*fopen_ptr)(const char *path, const char *mode);
+
+	if (strcmp(path, "/proc/self/smaps") == 0)
+		Smaps_opens++;
+
+	if (fopen_ptr == NULL)
+		fopen_ptr = dlsym(RTLD_NEXT, "fopen");
+
+	return (*fopen_ptr)(path, mode);
+}
+
+/*
+ * check_is_pmem -- print pmem_is_pmem() result and the number of smaps opens
+ *	it took
+ */
+static void
+check_is_pmem(const char *what, void *addr, size_t len)
+{
+	int prev = Smaps_opens;
+	int ret = pmem_is_pmem(addr, len);
+
+	OUT("%s: is_pmem %d smaps opens %d", what, ret, Smaps_opens - prev);
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "pmem_is_pmem_map");
+
+	if (argc != 2)
+		FATAL("usage: %s file", argv[0]);
+
+	int fd = OPEN(argv[1], O_RDWR);
+
+	struct stat stbuf;
+	FSTAT(fd, &stbuf);
+	size_t size = (size_t)stbuf.st_size;
+
+	char *addr = pmem_map(fd);
+	if (addr == NULL)
+		FATAL("!pmem_map");
+
+	CLOSE(fd);
+
+	check_is_pmem("whole range", addr, size);
+	check_is_pmem("whole range again", addr, size);
+	check_is_pmem("first page", addr, Ut_pagesize);
+	check_is_pmem("last page", addr + size - Ut_pagesize, Ut_pagesize);
+	check_is_pmem("beyond the end", addr + size - Ut_pagesize, 2 * Ut_pagesize);
+
+	/* unmap the middle of the range, the rest should still be known */
+	pmem_unmap(addr + Ut_pagesize, size - 2 * Ut_pagesize);
+	check_is_pmem("first page after partial unmap", addr, Ut_pagesize);
+	check_is_pmem("last page after partial unmap",
+		addr + size - Ut_pagesize, Ut_pagesize);
+	check_is_pmem("unmapped part", addr + Ut_pagesize, Ut_pagesize);
+
+	pmem_unmap(addr, Ut_pagesize);
+	pmem_unmap(addr + size - Ut_pagesize, Ut_pagesize);
+	check_is_pmem("first page after unmap", addr, Ut_pagesize);
+
+	DONE(NULL);
+}
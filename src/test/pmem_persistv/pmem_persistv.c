@@ -0,0 +1,116 @@
+/*
+ * Copyright 2014-2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * pmem_persistv.c -- unit test for pmem_persistv() and pmem_flushv()
+ *
+ * usage: pmem_persistv file
+ *
+ * Fills a set of overlapping, adjacent, empty and scattered ranges with
+ * a pattern, persists them with the vectored functions and verifies the
+ * content after the file is mapped again.
+ */
+
+#include "unittest.h"
+
+#define	NRANGES 40
+
+/*
+ * fill_ranges -- build the test vector and write the pattern to it
+ */
+static void
+fill_ranges(char *base, struct pmem_vec *vec)
+{
+	for (int i = 0; i < NRANGES; ++i) {
+		/* some of the ranges overlap or share cache lines */
+		size_t off = (size_t)i * 100;
+		size_t len = (size_t)(i % 5) * 37;
+
+		vec[i].addr = base + off;
+		vec[i].len = len;
+		memset(base + off, 'a' + i % 26, len);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "pmem_persistv");
+
+	if (argc != 2)
+		FATAL("usage: %s file", argv[0]);
+
+	int fd = OPEN(argv[1], O_RDWR);
+
+	struct stat stbuf;
+	FSTAT(fd, &stbuf);
+
+	char *base = pmem_map(fd);
+	if (base == NULL)
+		FATAL("!pmem_map");
+
+	struct pmem_vec vec[NRANGES];
+	fill_ranges(base, vec);
+
+	/* more ranges than processed in a single batch */
+	pmem_persistv(vec, NRANGES);
+
+	/* second half of the file, flushed and drained separately */
+	fill_ranges(base + stbuf.st_size / 2, vec);
+	pmem_flushv(vec, NRANGES);
+	pmem_drain();
+
+	/* nothing to do */
+	pmem_persistv(vec, 0);
+
+	/* the results of both calls have to be identical */
+	ASSERTeq(memcmp(base, base + stbuf.st_size / 2, stbuf.st_size / 2), 0);
+
+	char *copy = MALLOC(stbuf.st_size / 2);
+	memcpy(copy, base, stbuf.st_size / 2);
+
+	pmem_unmap(base, stbuf.st_size);
+
+	base = pmem_map(fd);
+	if (base == NULL)
+		FATAL("!pmem_map");
+
+	ASSERTeq(memcmp(base, copy, stbuf.st_size / 2), 0);
+	ASSERTeq(memcmp(base + stbuf.st_size / 2, copy, stbuf.st_size / 2), 0);
+
+	FREE(copy);
+	pmem_unmap(base, stbuf.st_size);
+
+	CLOSE(fd);
+
+	DONE(NULL);
+}
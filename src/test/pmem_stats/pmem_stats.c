@@ -0,0 +1,147 @@
+/*
+ * Copyright 2014-2016, Intel Corporation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *
+ *     * Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * pmem_stats.c -- unit test for flush/fence statistics
+ *
+ * usage: pmem_stats file
+ */
+
+#include "unittest.h"
+
+#define	NTHREADS 4
+#define	NFLUSHES 100
+
+static char *Base;
+
+/*
+ * print_reset_stats -- print statistics gathered since the previous call
+ */
+static void
+print_reset_stats(const char *task)
+{
+	static struct pmem_stats prev;
+	struct pmem_stats cur;
+
+	pmem_stats_get(&cur);
+
+	OUT("%s: flush_bytes %ju flush_lines %ju drains %ju movnt_bytes %ju",
+		task,
+		cur.flush_bytes - prev.flush_bytes,
+		cur.flush_lines - prev.flush_lines,
+		cur.drains - prev.drains,
+		cur.movnt_bytes - prev.movnt_bytes);
+
+	/* every drain issues at most two fences */
+	ASSERT(cur.fences - prev.fences <= 2 * (cur.drains - prev.drains) +
+		(cur.movnt_bytes != prev.movnt_bytes ? 1 : 0));
+
+	prev = cur;
+}
+
+/*
+ * worker -- flush a thread-private range many times
+ */
+static void *
+worker(void *arg)
+{
+	char *addr = Base + (uintptr_t)arg * 4096;
+
+	for (int i = 0; i < NFLUSHES; ++i)
+		pmem_persist(addr, 128);
+
+	return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+	START(argc, argv, "pmem_stats");
+
+	if (argc != 2)
+		FATAL("usage: %s file", argv[0]);
+
+	int fd = OPEN(argv[1], O_RDWR);
+
+	struct stat stbuf;
+	FSTAT(fd, &stbuf);
+
+	Base = pmem_map(fd);
+	if (Base == NULL)
+		FATAL("!pmem_map");
+
+	/* nothing is counted until enabled */
+	pmem_persist(Base, 4096);
+	print_reset_stats("disabled");
+
+	pmem_stats_enable(1);
+
+	pmem_flush(Base, 1);
+	pmem_flush(Base + 63, 2);
+	pmem_flush(Base + 128, 0);
+	print_reset_stats("flush");
+
+	pmem_persist(Base + 32, 64);
+	print_reset_stats("persist");
+
+	struct pmem_vec vec[] = {
+		{ Base, 8 },
+		{ Base + 16, 8 },
+		{ Base + 256, 64 },
+		{ Base + 300, 100 },
+	};
+	pmem_persistv(vec, sizeof (vec) / sizeof (vec[0]));
+	print_reset_stats("persistv");
+
+	/* aligned destination, copied with movnt above the threshold */
+	pmem_memset_persist(Base, 0, 4096 + 20);
+	print_reset_stats("memset");
+
+	pthread_t threads[NTHREADS];
+	for (uintptr_t i = 0; i < NTHREADS; ++i)
+		PTHREAD_CREATE(&threads[i], NULL, worker, (void *)i);
+
+	for (int i = 0; i < NTHREADS; ++i)
+		PTHREAD_JOIN(threads[i], NULL);
+
+	print_reset_stats("threads");
+
+	pmem_stats_enable(0);
+
+	pmem_persist(Base, 4096);
+	print_reset_stats("disabled again");
+
+	pmem_unmap(Base, stbuf.st_size);
+	CLOSE(fd);
+
+	DONE(NULL);
+}
@@ -1196,6 +1196,65 @@ pmemspoil_process_tx_range(struct pmemspoil *psp,
 	return PROCESS_RET;
 }
 
+/*
+ * pmemspoil_process_undo_range -- process range from in-lane undo log arena
+ */
+static int
+pmemspoil_process_undo_range(struct pmemspoil *psp,
+	struct pmemspoil_list *pfp, struct tx_undo_entry *entry)
+{
+	struct tx_range *range = (struct tx_range *)(entry + 1);
+
+	PROCESS_BEGIN(psp, pfp) {
+		struct checksum_args checksum_args = {
+			.ptr = entry,
+			.len = TX_UNDO_CHECKSUM_LEN(range->offset,
+					range->size),
+			.checksum = &entry->checksum,
+		};
+
+		PROCESS_FIELD(entry, gen, uint64_t);
+		PROCESS_FIELD(range, offset, uint64_t);
+		PROCESS_FIELD(range, size, uint64_t);
+
+		PROCESS_FUNC("checksum_gen", checksum_gen, checksum_args);
+	} PROCESS_END
+
+	return PROCESS_RET;
+}
+
+/*
+ * pmemspoil_undo_ranges -- return number of ranges in the in-lane part of
+ * undo log arena and the entry of the nth range
+ */
+static size_t
+pmemspoil_undo_ranges(struct pmemobjpool *pop, struct lane_tx_layout *sec,
+	size_t n, struct tx_undo_entry **entryp)
+{
+	size_t capacity = OBJ_LANE_SECTION_LEN(pop) - sizeof (*sec);
+	size_t pos = 0;
+	size_t i = 0;
+
+	*entryp = NULL;
+	while (pos + TX_UNDO_ENTRY_LEN(0) <= capacity) {
+		struct tx_undo_entry *entry = (void *)(sec->undo_arena + pos);
+		struct tx_range *range = (struct tx_range *)(entry + 1);
+		if (entry->gen != sec->undo_gen || range->offset == 0 ||
+			range->size == 0 || range->size > capacity - pos ||
+			TX_UNDO_ENTRY_LEN(range->size) > capacity - pos)
+			break;
+
+		/* the checksum isn't verified, so that it can be fixed up */
+		if (i == n)
+			*entryp = entry;
+
+		pos += TX_UNDO_ENTRY_LEN(range->size);
+		i++;
+	}
+
+	return i;
+}
+
 /*
  * pmemspoil_process_entry -- process list entry
  */
@@ -1247,11 +1306,18 @@ static int
 pmemspoil_process_sec_tx(struct pmemspoil *psp,
 	struct pmemspoil_list *pfp, struct lane_tx_layout *sec)
 {
+	struct tx_undo_entry *entry;
+
 	PROCESS_BEGIN(psp, pfp) {
+		size_t nranges = pmemspoil_undo_ranges(psp->addr, sec,
+				PROCESS_INDEX, &entry);
+
 		PROCESS_FIELD(sec, state, uint64_t);
 		PROCESS_NAME("undo_alloc", list, &sec->undo_alloc, 1);
 		PROCESS_NAME("undo_set", list, &sec->undo_set, 1);
 		PROCESS_NAME("undo_free", list, &sec->undo_free, 1);
+		PROCESS_FIELD(sec, undo_gen, uint64_t);
+		PROCESS(undo_range, entry, nranges);
 	} PROCESS_END
 
 	return PROCESS_RET;
@@ -1279,15 +1345,18 @@ pmemspoil_process_sec_list(struct pmemspoil *psp,
  */
 static int
 pmemspoil_process_lane(struct pmemspoil *psp, struct pmemspoil_list *pfp,
-		struct lane_layout *lane)
+		char *lane)
 {
+	struct pmemobjpool *pop = psp->addr;
+	uint64_t section_len = OBJ_LANE_SECTION_LEN(pop);
+
 	struct lane_tx_layout *sec_tx = (struct lane_tx_layout *)
-		&lane->sections[LANE_SECTION_TRANSACTION];
+		(lane + section_len * LANE_SECTION_TRANSACTION);
 	struct lane_list_section *sec_list = (struct lane_list_section *)
-		&lane->sections[LANE_SECTION_LIST];
+		(lane + section_len * LANE_SECTION_LIST);
 	struct allocator_lane_section *sec_alloc =
 		(struct allocator_lane_section *)
-		&lane->sections[LANE_SECTION_ALLOCATOR];
+		(lane + section_len * LANE_SECTION_ALLOCATOR);
 
 	PROCESS_BEGIN(psp, pfp) {
 		PROCESS_NAME("allocator", sec_allocator, sec_alloc, 1);
@@ -1322,7 +1391,7 @@ pmemspoil_process_pmemobj(struct pmemspoil *psp,
 {
 	struct pmemobjpool *pop = psp->addr;
 	struct heap_layout *hlayout = (void *)((char *)pop + pop->heap_offset);
-	struct lane_layout *lanes = (void *)((char *)pop + pop->lanes_offset);
+	char *lanes = (char *)pop + pop->lanes_offset;
 	struct object_store *obj_store =
 			(void *)((char *)pop + pop->obj_store_offset);
 
@@ -1340,6 +1409,7 @@ pmemspoil_process_pmemobj(struct pmemspoil *psp,
 		PROCESS_FIELD(pop, obj_store_size, uint64_t);
 		PROCESS_FIELD(pop, heap_offset, uint64_t);
 		PROCESS_FIELD(pop, heap_size, uint64_t);
+		PROCESS_FIELD(pop, lane_section_len, uint64_t);
 		PROCESS_FIELD(pop, unused, char);
 		PROCESS_FIELD(pop, checksum, uint64_t);
 		PROCESS_FIELD(pop, run_id, uint64_t);
@@ -1347,7 +1417,8 @@ pmemspoil_process_pmemobj(struct pmemspoil *psp,
 		PROCESS_FUNC("checksum_gen", checksum_gen, checksum_args);
 
 		PROCESS(heap, hlayout, 1);
-		PROCESS(lane, &lanes[PROCESS_INDEX], pop->nlanes);
+		PROCESS(lane, lanes + PROCESS_INDEX * OBJ_LANE_SIZE(pop),
+			pop->nlanes);
 		PROCESS(obj_store, obj_store, 1);
 	} PROCESS_END
 
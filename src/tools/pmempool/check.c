@@ -1023,7 +1023,13 @@ pmempool_check_pool_hdr_default(struct pmempool_check *pcp,
 		}
 	}
 
-	if (hdrp->incompat_features != def_hdrp->incompat_features) {
+	/* the optional features of obj pools are chosen at creation time */
+	uint32_t incompat = hdrp->incompat_features;
+	if (pcp->params.type == PMEM_POOL_TYPE_OBJ)
+		incompat &= ~(uint32_t)(OBJ_INCOMPAT_NO_TYPE_LISTS |
+				OBJ_INCOMPAT_LANE_SECTION_LEN);
+
+	if (incompat != def_hdrp->incompat_features) {
 		outv(1, "pool_hdr.incompat_features is not valid\n");
 		if (ask_Yn(pcp->ans, "Do you want to set it to default value "
 			"0x%x?", def_hdrp->incompat_features) == 'y') {
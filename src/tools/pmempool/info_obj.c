@@ -102,37 +102,92 @@ lane_need_recovery_alloc(struct lane_section_layout *layout)
 	return lane_need_recovery_redo(&section->redo[0], REDO_LOG_SIZE);
 }
 
+/*
+ * obj_has_undo_arena -- return 1 if the transaction lane sections of the pool
+ * hold an undo log arena, it's not there in the pools of the older format
+ */
+static int
+obj_has_undo_arena(struct pmemobjpool *pop)
+{
+	return (le32toh(pop->hdr.incompat_features) &
+			OBJ_INCOMPAT_CSUM_LOGS) != 0;
+}
+
+/*
+ * lane_need_recovery_undo_buf -- return 1 if undo log arena buffer is not
+ * empty
+ */
+static int
+lane_need_recovery_undo_buf(void *buf, uint64_t gen)
+{
+	struct tx_undo_entry *entry = buf;
+	struct tx_range *range = (struct tx_range *)(entry + 1);
+
+	return entry->gen == gen && range->offset != 0 && range->size != 0;
+}
+
 /*
  * lane_need_recovery_tx -- return 1 if transaction's section needs recovery
  */
 static int
-lane_need_recovery_tx(struct lane_section_layout *layout)
+lane_need_recovery_tx(struct pmemobjpool *pop,
+	struct lane_section_layout *layout)
 {
 	struct lane_tx_layout *section = (struct lane_tx_layout *)layout;
 
+	if (section->state != TX_STATE_NONE)
+		return 0;
+
 	/*
 	 * The transaction section needs recovery
 	 * if state is not committed and
 	 * any undo log not empty
 	 */
-	return section->state == TX_STATE_NONE &&
-		(!PLIST_EMPTY(&section->undo_alloc) ||
+	if (!PLIST_EMPTY(&section->undo_alloc) ||
 		!PLIST_EMPTY(&section->undo_free) ||
-		!PLIST_EMPTY(&section->undo_set));
+		!PLIST_EMPTY(&section->undo_set))
+		return 1;
+
+	if (!obj_has_undo_arena(pop))
+		return 0;
+
+	if (lane_need_recovery_undo_buf(section->undo_arena,
+			section->undo_gen))
+		return 1;
+
+	/* the undo log arena chunks are kept in the lane when empty */
+	struct list_entry *entryp;
+	PLIST_FOREACH(entryp, pop, &section->undo_set_cache) {
+		if (lane_need_recovery_undo_buf((char *)entryp + OBJ_OOB_SIZE,
+				section->undo_gen))
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * lane_section -- return pointer to the lane section, the size of sections
+ * is recorded in the pool descriptor
+ */
+static struct lane_section_layout *
+lane_section(struct pmemobjpool *pop, void *lane, enum lane_section_type type)
+{
+	return (void *)((char *)lane + OBJ_LANE_SECTION_LEN(pop) * type);
 }
 
 /*
  * lane_need_recovery -- return 1 if lane section needs recovery
  */
 static int
-lane_need_recovery(struct lane_layout *lane)
+lane_need_recovery(struct pmemobjpool *pop, void *lane)
 {
 	int alloc = lane_need_recovery_alloc(
-			&lane->sections[LANE_SECTION_ALLOCATOR]);
+			lane_section(pop, lane, LANE_SECTION_ALLOCATOR));
 	int list = lane_need_recovery_list(
-			&lane->sections[LANE_SECTION_LIST]);
-	int tx = lane_need_recovery_tx(
-			&lane->sections[LANE_SECTION_TRANSACTION]);
+			lane_section(pop, lane, LANE_SECTION_LIST));
+	int tx = lane_need_recovery_tx(pop,
+			lane_section(pop, lane, LANE_SECTION_TRANSACTION));
 
 	return alloc || list || tx;
 }
@@ -367,6 +422,68 @@ set_entry_cb(struct pmem_info *pip, int v, int vnum, struct pmemobjpool *pop,
 			out_get_size_str(range->size, pip->args.human));
 }
 
+/*
+ * info_obj_undo_buf -- print ranges from undo log arena buffer, returns
+ * the number of ranges counted so far
+ */
+static size_t
+info_obj_undo_buf(struct pmem_info *pip, int vnum, void *buf,
+		size_t capacity, uint64_t gen, size_t i)
+{
+	size_t pos = 0;
+	while (pos + TX_UNDO_ENTRY_LEN(0) <= capacity) {
+		struct tx_undo_entry *entry = (void *)((uintptr_t)buf + pos);
+		struct tx_range *range = (struct tx_range *)(entry + 1);
+		if (entry->gen != gen || range->offset == 0 ||
+			range->size == 0 || range->size > capacity - pos ||
+			TX_UNDO_ENTRY_LEN(range->size) > capacity - pos)
+			break;
+
+		size_t cslen = TX_UNDO_CHECKSUM_LEN(range->offset,
+				range->size);
+		if (!util_checksum(entry, cslen, &entry->checksum, 0))
+			break;
+
+		outv_field(vnum, "Range", "%lu", i);
+		out_indent(1);
+		outv_field(vnum, "Offset", "0x%016lx",
+				range->offset & ~TX_RANGE_REDO);
+		outv_field(vnum, "Size", "%s",
+				out_get_size_str(range->size, pip->args.human));
+		if (range->offset & TX_RANGE_REDO)
+			outv_field(vnum, "Type", "redo");
+		out_indent(-1);
+
+		pos += TX_UNDO_ENTRY_LEN(range->size);
+		i++;
+	}
+
+	return i;
+}
+
+/*
+ * info_obj_undo_arena -- print ranges from undo log arena, the in-lane part
+ * and all the chunks, returns the number of ranges
+ */
+static size_t
+info_obj_undo_arena(struct pmem_info *pip, int vnum, struct pmemobjpool *pop,
+		struct lane_tx_layout *section)
+{
+	size_t i = info_obj_undo_buf(pip, vnum, section->undo_arena,
+			OBJ_LANE_SECTION_LEN(pop) - sizeof (*section),
+			section->undo_gen, 0);
+
+	struct list_entry *entryp;
+	PLIST_FOREACH(entryp, pop, &section->undo_set_cache) {
+		struct allocation_header *alloc = ENTRY_TO_ALLOC_HDR(entryp);
+		size_t capacity = alloc->size - sizeof (*alloc) - OBJ_OOB_SIZE;
+		i = info_obj_undo_buf(pip, vnum, ENTRY_TO_DATA(entryp),
+				capacity, section->undo_gen, i);
+	}
+
+	return i;
+}
+
 /*
  * info_obj_lane_tx -- print transaction's lane section
  */
@@ -385,6 +502,16 @@ info_obj_lane_tx(struct pmem_info *pip, int v, struct pmemobjpool *pop,
 			"Undo Log - free", obj_object_cb);
 	info_obj_list(pip, v, vnum, pop, &section->undo_set,
 			"Undo Log - set", set_entry_cb);
+
+	if (!obj_has_undo_arena(pop))
+		return;
+
+	size_t nranges = info_obj_undo_arena(pip, 0, pop, section);
+	outv_field(v, "Undo Log - arena", "%lu range%s",
+			nranges, nranges != 1 ? "s" : "");
+	out_indent(1);
+	info_obj_undo_arena(pip, v, pop, section);
+	out_indent(-1);
 }
 
 /*
@@ -392,30 +519,32 @@ info_obj_lane_tx(struct pmem_info *pip, int v, struct pmemobjpool *pop,
  */
 static void
 info_obj_lane_section(struct pmem_info *pip, int v, struct pmemobjpool *pop,
-	struct lane_layout *lane, enum lane_section_type type)
+	void *lane, enum lane_section_type type)
 {
 	if (!(pip->args.obj.lane_sections & (1U << type)))
 		return;
 
+	struct lane_section_layout *section = lane_section(pop, lane, type);
+
 	outv_nl(v);
 	outv_field(v, "Lane section", "%s",
 		out_get_lane_section_str(type));
 	outv_hexdump(v && pip->args.vhdrdump,
-			&lane->sections[type],
-			LANE_SECTION_LEN,
-			PTR_TO_OFF(pop, &lane->sections[type]),
+			section,
+			OBJ_LANE_SECTION_LEN(pop),
+			PTR_TO_OFF(pop, section),
 			1);
 
 	out_indent(1);
 	switch (type) {
 	case LANE_SECTION_ALLOCATOR:
-		info_obj_lane_alloc(v, &lane->sections[type]);
+		info_obj_lane_alloc(v, section);
 		break;
 	case LANE_SECTION_LIST:
-		info_obj_lane_list(pip, v, &lane->sections[type]);
+		info_obj_lane_list(pip, v, section);
 		break;
 	case LANE_SECTION_TRANSACTION:
-		info_obj_lane_tx(pip, v, pop, &lane->sections[type]);
+		info_obj_lane_tx(pip, v, pop, section);
 		break;
 	default:
 		break;
@@ -437,27 +566,27 @@ info_obj_lanes(struct pmem_info *pip, int v,
 	 * Iterate through all lanes from specified range and print
 	 * specified sections.
 	 */
-	struct lane_layout *lanes = (void *)((char *)pip->obj.addr +
-			pop->lanes_offset);
+	char *lanes = (char *)pip->obj.addr + pop->lanes_offset;
 	uint64_t i;
 	struct range *curp = NULL;
 	FOREACH_RANGE(curp, &pip->args.obj.lane_ranges) {
 		for (i = curp->first;
 			i <= curp->last && i < pop->nlanes; i++) {
+			void *lane = lanes + i * OBJ_LANE_SIZE(pop);
 
 			/* For -R check print lane only if needs recovery */
 			if (pip->args.obj.lanes_recovery &&
-				!lane_need_recovery(&lanes[i]))
+				!lane_need_recovery(pop, lane))
 				continue;
 
 			outv_title(v, "Lane", "%d", i);
 
 			out_indent(1);
-			info_obj_lane_section(pip, v, pop, &lanes[i],
+			info_obj_lane_section(pip, v, pop, lane,
 					LANE_SECTION_ALLOCATOR);
-			info_obj_lane_section(pip, v, pop, &lanes[i],
+			info_obj_lane_section(pip, v, pop, lane,
 					LANE_SECTION_LIST);
-			info_obj_lane_section(pip, v, pop, &lanes[i],
+			info_obj_lane_section(pip, v, pop, lane,
 					LANE_SECTION_TRANSACTION);
 			out_indent(-1);
 		}
@@ -791,6 +920,9 @@ info_obj_descriptor(struct pmem_info *pip, int v,
 	outv_field(v, "Layout", layout);
 	outv_field(v, "Lanes offset", "0x%lx", pop->lanes_offset);
 	outv_field(v, "Number of lanes", "%lu", pop->nlanes);
+	outv_field(v, "Lane section size", "%s",
+			out_get_size_str(OBJ_LANE_SECTION_LEN(pop),
+			pip->args.human));
 	outv_field(v, "Object store offset", "0x%lx", pop->obj_store_offset);
 	outv_field(v, "Object store size", "%s",
 			out_get_size_str(pop->obj_store_size, pip->args.human));